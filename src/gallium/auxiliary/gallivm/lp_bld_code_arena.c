@@ -0,0 +1,343 @@
+/*
+ * Copyright © 2024 Mesa contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * @file
+ * Process wide pool of memory for JIT generated code, see
+ * lp_bld_code_arena.h.
+ *
+ * Chunks are sub-allocated with util_vma_heap, which works on the
+ * addresses of the read-write view.  Allocations are done first fit over
+ * the chunks in creation order, so long lived code ends up packed in the
+ * oldest chunks and chunks that become empty can be unmapped.
+ */
+
+#include "util/detect_os.h"
+#include "util/list.h"
+#include "util/simple_mtx.h"
+#include "util/u_debug.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "util/vma.h"
+
+#include "lp_bld_code_arena.h"
+
+#if DETECT_OS_LINUX
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "util/anon_file.h"
+#endif
+
+
+/* Huge page size on x86-64, the size and alignment of a chunk */
+#define LP_CODE_CHUNK_SIZE (2 * 1024 * 1024)
+#define LP_CODE_MIN_ALIGNMENT 16
+
+
+struct lp_code_chunk {
+   struct list_head link;
+   uint8_t *rw;
+   uint8_t *rx;
+   size_t size;
+   size_t used;
+   bool huge_pages;
+   struct util_vma_heap heap;
+};
+
+static struct {
+   simple_mtx_t lock;
+   struct list_head chunks;
+   struct lp_code_arena_stats stats;
+   bool available;
+   bool shmem_huge_pages;
+} arena = {
+   .lock = SIMPLE_MTX_INITIALIZER,
+};
+
+static once_flag arena_once_flag = ONCE_FLAG_INIT;
+
+
+#if DETECT_OS_LINUX
+
+/**
+ * Whether the shmem transparent huge page policy lets madvised memfds use
+ * huge pages.  MADV_HUGEPAGE succeeds on shared memory even when the policy
+ * is "never", so the result of madvise alone doesn't tell.
+ */
+static bool
+shmem_huge_pages_enabled(void)
+{
+   FILE *f = fopen("/sys/kernel/mm/transparent_hugepage/shmem_enabled", "r");
+   if (!f)
+      return false;
+
+   char buf[128];
+   size_t len = fread(buf, 1, sizeof(buf) - 1, f);
+   fclose(f);
+   buf[len] = '\0';
+
+   /* The active policy is the one in brackets. */
+   const char *policy = strchr(buf, '[');
+   if (!policy)
+      return false;
+
+   return strncmp(policy, "[always]", 8) == 0 ||
+          strncmp(policy, "[within_size]", 13) == 0 ||
+          strncmp(policy, "[advise]", 8) == 0 ||
+          strncmp(policy, "[force]", 7) == 0;
+}
+
+
+/**
+ * Map the file at a chunk aligned address, as only aligned 2MB ranges can
+ * be backed by huge pages.  *huge_pages is cleared if the range can't be.
+ */
+static uint8_t *
+map_aligned(int fd, size_t size, int prot, bool *huge_pages)
+{
+   size_t reserve = size + LP_CODE_CHUNK_SIZE;
+   uint8_t *base = mmap(NULL, reserve, PROT_NONE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+   if (base == MAP_FAILED)
+      return NULL;
+
+   uint8_t *ptr = (uint8_t *)align_uintptr((uintptr_t)base, LP_CODE_CHUNK_SIZE);
+   if (mmap(ptr, size, prot, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+      munmap(base, reserve);
+      return NULL;
+   }
+
+   if (ptr > base)
+      munmap(base, ptr - base);
+   if (ptr + size < base + reserve)
+      munmap(ptr + size, base + reserve - (ptr + size));
+
+#ifdef MADV_HUGEPAGE
+   if (madvise(ptr, size, MADV_HUGEPAGE) != 0)
+      *huge_pages = false;
+#else
+   *huge_pages = false;
+#endif
+   return ptr;
+}
+
+
+static struct lp_code_chunk *
+code_chunk_create(size_t size)
+{
+   struct lp_code_chunk *chunk = CALLOC_STRUCT(lp_code_chunk);
+   if (!chunk)
+      return NULL;
+
+   int fd = os_create_anonymous_file(size, "gallivm-code");
+   if (fd < 0) {
+      FREE(chunk);
+      return NULL;
+   }
+
+   chunk->huge_pages = arena.shmem_huge_pages;
+   chunk->rw = map_aligned(fd, size, PROT_READ | PROT_WRITE, &chunk->huge_pages);
+   if (chunk->rw)
+      chunk->rx = map_aligned(fd, size, PROT_READ | PROT_EXEC, &chunk->huge_pages);
+   close(fd);
+
+   if (!chunk->rx) {
+      if (chunk->rw)
+         munmap(chunk->rw, size);
+      FREE(chunk);
+      return NULL;
+   }
+
+   chunk->size = size;
+   util_vma_heap_init(&chunk->heap, (uintptr_t)chunk->rw, size);
+   chunk->heap.alloc_high = false;
+
+   arena.stats.mapped += size;
+   if (chunk->huge_pages)
+      arena.stats.huge_page_mapped += size;
+   arena.stats.chunks++;
+   return chunk;
+}
+
+
+static void
+code_chunk_destroy(struct lp_code_chunk *chunk)
+{
+   arena.stats.mapped -= chunk->size;
+   if (chunk->huge_pages)
+      arena.stats.huge_page_mapped -= chunk->size;
+   arena.stats.chunks--;
+
+   list_del(&chunk->link);
+   util_vma_heap_finish(&chunk->heap);
+   munmap(chunk->rx, chunk->size);
+   munmap(chunk->rw, chunk->size);
+   FREE(chunk);
+}
+
+#else
+
+static struct lp_code_chunk *
+code_chunk_create(size_t size)
+{
+   return NULL;
+}
+
+
+static void
+code_chunk_destroy(struct lp_code_chunk *chunk)
+{
+}
+
+#endif
+
+
+static void
+arena_init(void)
+{
+   list_inithead(&arena.chunks);
+
+   if (!debug_get_bool_option("GALLIVM_CODE_ARENA", true))
+      return;
+
+#if DETECT_OS_LINUX
+   arena.shmem_huge_pages = shmem_huge_pages_enabled();
+#endif
+
+   /*
+    * Shared executable mappings may be forbidden (e.g. SELinux execmem),
+    * so find out once and keep the chunk for the first allocations.
+    */
+   struct lp_code_chunk *chunk = code_chunk_create(LP_CODE_CHUNK_SIZE);
+   if (chunk) {
+      list_addtail(&chunk->link, &arena.chunks);
+      arena.available = true;
+   }
+}
+
+
+/**
+ * Whether the arena can be used, otherwise the JIT falls back to mapping
+ * memory per module.
+ */
+bool
+lp_code_arena_available(void)
+{
+   call_once(&arena_once_flag, arena_init);
+   return arena.available;
+}
+
+
+/**
+ * Allocate size bytes.  Returns the address to write the code to in *rw
+ * and the address to run it from in *rx.
+ */
+bool
+lp_code_arena_alloc(size_t size, unsigned alignment,
+                    uint8_t **rw, uint8_t **rx)
+{
+   struct lp_code_chunk *chunk = NULL;
+   uint64_t addr = 0;
+
+   assert(arena.available);
+   assert(!alignment || util_is_power_of_two_nonzero(alignment));
+
+   size = ALIGN_POT(MAX2(size, 1), LP_CODE_MIN_ALIGNMENT);
+   alignment = MAX2(alignment, LP_CODE_MIN_ALIGNMENT);
+   if (alignment > LP_CODE_CHUNK_SIZE)
+      return false;
+
+   simple_mtx_lock(&arena.lock);
+
+   list_for_each_entry(struct lp_code_chunk, iter, &arena.chunks, link) {
+      addr = util_vma_heap_alloc(&iter->heap, size, alignment);
+      if (addr) {
+         chunk = iter;
+         break;
+      }
+   }
+
+   if (!addr) {
+      chunk = code_chunk_create(ALIGN_POT(size, LP_CODE_CHUNK_SIZE));
+      if (!chunk) {
+         simple_mtx_unlock(&arena.lock);
+         return false;
+      }
+      list_addtail(&chunk->link, &arena.chunks);
+      addr = util_vma_heap_alloc(&chunk->heap, size, alignment);
+      assert(addr);
+   }
+
+   chunk->used += size;
+   arena.stats.used += size;
+   arena.stats.peak_used = MAX2(arena.stats.peak_used, arena.stats.used);
+   arena.stats.allocations++;
+
+   *rw = (uint8_t *)(uintptr_t)addr;
+   *rx = chunk->rx + (*rw - chunk->rw);
+
+   simple_mtx_unlock(&arena.lock);
+   return true;
+}
+
+
+/**
+ * Free an allocation, size must be the size it was allocated with.
+ */
+void
+lp_code_arena_free(uint8_t *rw, size_t size)
+{
+   size = ALIGN_POT(MAX2(size, 1), LP_CODE_MIN_ALIGNMENT);
+
+   simple_mtx_lock(&arena.lock);
+
+   list_for_each_entry(struct lp_code_chunk, chunk, &arena.chunks, link) {
+      if (rw < chunk->rw || rw >= chunk->rw + chunk->size)
+         continue;
+
+      util_vma_heap_free(&chunk->heap, (uintptr_t)rw, size);
+      chunk->used -= size;
+      arena.stats.used -= size;
+      arena.stats.allocations--;
+
+      /* Keep the first chunk so that variant churn doesn't remap memory. */
+      if (!chunk->used && chunk->link.prev != &arena.chunks)
+         code_chunk_destroy(chunk);
+      break;
+   }
+
+   simple_mtx_unlock(&arena.lock);
+}
+
+
+void
+lp_code_arena_get_stats(struct lp_code_arena_stats *stats)
+{
+   call_once(&arena_once_flag, arena_init);
+
+   simple_mtx_lock(&arena.lock);
+   *stats = arena.stats;
+   simple_mtx_unlock(&arena.lock);
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright © 2024 Mesa contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * Process wide pool of memory for JIT generated code.
+ *
+ * Code from all gallivm modules is packed into 2MB chunks which are
+ * candidates for transparent huge pages, instead of every module mapping
+ * its own pages.  Each chunk is a memfd mapped twice: a read-write view
+ * which the linker writes through and a read-execute view the code runs
+ * from, so no page is ever writable and executable at the same time.
+ *
+ * Being shared memory, the chunks only get huge pages if the shmem
+ * transparent huge page policy allows it, which many distributions don't.
+ * huge_page_mapped tells how much of the arena is eligible.
+ */
+
+#ifndef LP_BLD_CODE_ARENA_H
+#define LP_BLD_CODE_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct lp_code_arena_stats {
+   uint64_t mapped;     /**< bytes of chunks mapped */
+   uint64_t huge_page_mapped;  /**< bytes of chunks eligible for huge pages */
+   uint64_t used;       /**< bytes handed out */
+   uint64_t peak_used;
+   unsigned chunks;
+   unsigned allocations;
+};
+
+bool
+lp_code_arena_available(void);
+
+bool
+lp_code_arena_alloc(size_t size, unsigned alignment,
+                    uint8_t **rw, uint8_t **rx);
+
+void
+lp_code_arena_free(uint8_t *rw, size_t size);
+
+void
+lp_code_arena_get_stats(struct lp_code_arena_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LP_BLD_CODE_ARENA_H */
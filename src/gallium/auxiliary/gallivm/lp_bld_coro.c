@@ -161,12 +161,10 @@ coro_free(char *ptr)
 
 void lp_build_coro_add_malloc_hooks(struct gallivm_state *gallivm)
 {
-   assert(gallivm->engine);
-
    assert(gallivm->coro_malloc_hook);
    assert(gallivm->coro_free_hook);
-   LLVMAddGlobalMapping(gallivm->engine, gallivm->coro_malloc_hook, coro_malloc);
-   LLVMAddGlobalMapping(gallivm->engine, gallivm->coro_free_hook, coro_free);
+   gallivm_add_global_mapping(gallivm, gallivm->coro_malloc_hook, coro_malloc);
+   gallivm_add_global_mapping(gallivm, gallivm->coro_free_hook, coro_free);
 }
 
 void lp_build_coro_declare_malloc_hooks(struct gallivm_state *gallivm)
@@ -206,25 +204,38 @@ LLVMValueRef lp_build_coro_begin_alloc_mem(struct gallivm_state *gallivm, LLVMVa
    return coro_hdl;
 }
 
+/*
+ * Make sure the frame memory at *coro_hdl_ptr can hold coro_num_hdls frames
+ * and return the byte offset of frame coro_idx in it.
+ *
+ * *coro_size_ptr holds the size of the current allocation, it is only ever
+ * grown so callers can keep the memory around across invocations.
+ */
 LLVMValueRef lp_build_coro_alloc_mem_array(struct gallivm_state *gallivm,
-					   LLVMValueRef coro_hdl_ptr, LLVMValueRef coro_idx,
-					   LLVMValueRef coro_num_hdls)
+					   LLVMValueRef coro_hdl_ptr, LLVMValueRef coro_size_ptr,
+					   LLVMValueRef coro_idx, LLVMValueRef coro_num_hdls)
 {
    LLVMTypeRef mem_ptr_type = LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0);
-   LLVMValueRef alloced_ptr = LLVMBuildLoad2(gallivm->builder, mem_ptr_type, coro_hdl_ptr, "");
-
-   LLVMValueRef not_alloced = LLVMBuildICmp(gallivm->builder, LLVMIntEQ, alloced_ptr, LLVMConstNull(mem_ptr_type), "");
+   LLVMTypeRef int32_type = LLVMInt32TypeInContext(gallivm->context);
+   LLVMValueRef alloced_size = LLVMBuildLoad2(gallivm->builder, int32_type, coro_size_ptr, "");
    LLVMValueRef coro_size = lp_build_coro_size(gallivm);
+   LLVMValueRef alloc_size = LLVMBuildMul(gallivm->builder, coro_num_hdls, coro_size, "");
+
+   LLVMValueRef too_small = LLVMBuildICmp(gallivm->builder, LLVMIntULT, alloced_size, alloc_size, "");
 
    struct lp_build_if_state if_state_coro;
-   lp_build_if(&if_state_coro, gallivm, not_alloced);
+   lp_build_if(&if_state_coro, gallivm, too_small);
 
+   LLVMValueRef alloced_ptr = LLVMBuildLoad2(gallivm->builder, mem_ptr_type, coro_hdl_ptr, "");
    LLVMValueRef alloc_mem;
-   LLVMValueRef alloc_size = LLVMBuildMul(gallivm->builder, coro_num_hdls, coro_size, "");
    assert(gallivm->coro_malloc_hook);
    assert(gallivm->coro_malloc_hook_type);
+   assert(gallivm->coro_free_hook);
+   assert(gallivm->coro_free_hook_type);
+   LLVMBuildCall2(gallivm->builder, gallivm->coro_free_hook_type, gallivm->coro_free_hook, &alloced_ptr, 1, "");
    alloc_mem = LLVMBuildCall2(gallivm->builder, gallivm->coro_malloc_hook_type, gallivm->coro_malloc_hook, &alloc_size, 1, "");
    LLVMBuildStore(gallivm->builder, alloc_mem, coro_hdl_ptr);
+   LLVMBuildStore(gallivm->builder, alloc_size, coro_size_ptr);
    lp_build_endif(&if_state_coro);
 
    return LLVMBuildMul(gallivm->builder, coro_size, coro_idx, "");
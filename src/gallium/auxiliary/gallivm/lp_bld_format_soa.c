@@ -972,13 +972,16 @@ lp_build_insert_soa_chan(struct lp_build_context *bld,
        } else
           assert(0);
        break;
+    case UTIL_FORMAT_TYPE_VOID:
+       /* padding, leave as zero */
+       break;
     default:
        assert(0);
        *output = bld->undef;
     }
 }
 
-static void
+void
 lp_build_pack_rgba_soa(struct gallivm_state *gallivm,
                        const struct util_format_description *format_desc,
                        struct lp_type type,
@@ -259,6 +259,10 @@ gallivm_free_code(struct gallivm_state *gallivm)
 {
    assert(!gallivm->module);
    assert(!gallivm->engine);
+#if GALLIVM_USE_ORCJIT
+   lp_build_orc_destroy_module(gallivm->orc);
+   gallivm->orc = NULL;
+#endif
    lp_free_generated_code(gallivm->code);
    gallivm->code = NULL;
    lp_free_memory_manager(gallivm->memorymgr);
@@ -269,6 +273,11 @@ gallivm_free_code(struct gallivm_state *gallivm)
 static bool
 init_gallivm_engine(struct gallivm_state *gallivm)
 {
+#if GALLIVM_USE_ORCJIT
+   gallivm->orc = lp_build_orc_create_module(gallivm->module,
+                                             gallivm->module_name);
+   return gallivm->orc != NULL;
+#else
    if (1) {
       enum LLVM_CodeGenOpt_Level optlevel;
       char *error = NULL;
@@ -320,6 +329,7 @@ init_gallivm_engine(struct gallivm_state *gallivm)
 
 fail:
    return false;
+#endif
 }
 
 
@@ -364,9 +374,11 @@ init_gallivm_state(struct gallivm_state *gallivm, const char *name,
    if (!gallivm->builder)
       goto fail;
 
+#if !GALLIVM_USE_ORCJIT
    gallivm->memorymgr = lp_get_default_memory_manager();
    if (!gallivm->memorymgr)
       goto fail;
+#endif
 
    /* FIXME: MC-JIT only allows compiling one module at a time, and it must be
     * complete when MC-JIT is created. So defer the MC-JIT engine creation for
@@ -423,7 +435,12 @@ fail:
 unsigned
 lp_build_init_native_width(void)
 {
-   // Default to 256 until we're confident llvmpipe with 512 is as correct and not slower than 256
+   /*
+    * Default to 256 until we're confident llvmpipe with 512 is as correct
+    * and not slower than 256.  512 changes the SIMD and subgroup size seen
+    * by compute shaders and lavapipe, so it is opt-in through
+    * LP_NATIVE_VECTOR_WIDTH.
+    */
    lp_native_vector_width = MIN2(util_get_cpu_caps()->max_vector_bits, 256);
    assert(lp_native_vector_width);
 
@@ -540,6 +557,34 @@ gallivm_verify_function(struct gallivm_state *gallivm,
    }
 }
 
+/**
+ * Resolve an external symbol of the module to a function of ours.
+ * Must be called after gallivm_compile_module() created the engine.
+ */
+void
+gallivm_add_global_mapping(struct gallivm_state *gallivm,
+                           LLVMValueRef global, void *addr)
+{
+#if GALLIVM_USE_ORCJIT
+   assert(gallivm->orc);
+   lp_build_orc_add_global_mapping(gallivm->orc, LLVMGetValueName(global), addr);
+#else
+   assert(gallivm->engine);
+   LLVMAddGlobalMapping(gallivm->engine, global, addr);
+#endif
+}
+
+static void *
+gallivm_get_function_code(struct gallivm_state *gallivm,
+                          LLVMValueRef func)
+{
+#if GALLIVM_USE_ORCJIT
+   return lp_build_orc_lookup(gallivm->orc, LLVMGetValueName(func));
+#else
+   return LLVMGetPointerToGlobal(gallivm->engine, func);
+#endif
+}
+
 void lp_init_clock_hook(struct gallivm_state *gallivm)
 {
    if (gallivm->get_time_hook)
@@ -565,12 +610,13 @@ gallivm_compile_module(struct gallivm_state *gallivm)
       gallivm->builder = NULL;
    }
 
+#if !GALLIVM_USE_ORCJIT
    LLVMSetDataLayout(gallivm->module, "");
+#endif
    assert(!gallivm->engine);
    if (!init_gallivm_engine(gallivm)) {
       assert(0);
    }
-   assert(gallivm->engine);
 
    if (gallivm->cache && gallivm->cache->data_size) {
       goto skip_cached;
@@ -605,8 +651,13 @@ gallivm_compile_module(struct gallivm_state *gallivm)
     */
    strcpy(passes, "default<O0>");
 
+#if GALLIVM_USE_ORCJIT
+   LLVMTargetMachineRef tm = lp_build_orc_get_target_machine(gallivm->orc);
+#else
+   LLVMTargetMachineRef tm = LLVMGetExecutionEngineTargetMachine(gallivm->engine);
+#endif
    LLVMPassBuilderOptionsRef opts = LLVMCreatePassBuilderOptions();
-   LLVMRunPasses(gallivm->module, passes, LLVMGetExecutionEngineTargetMachine(gallivm->engine), opts);
+   LLVMRunPasses(gallivm->module, passes, tm, opts);
 
    if (!(gallivm_perf & GALLIVM_PERF_NO_OPT))
 #if LLVM_VERSION_MAJOR >= 18
@@ -617,7 +668,7 @@ gallivm_compile_module(struct gallivm_state *gallivm)
    else
       strcpy(passes, "mem2reg");
 
-   LLVMRunPasses(gallivm->module, passes, LLVMGetExecutionEngineTargetMachine(gallivm->engine), opts);
+   LLVMRunPasses(gallivm->module, passes, tm, opts);
    LLVMDisposePassBuilderOptions(opts);
 #else
 #if GALLIVM_HAVE_CORO == 1
@@ -671,13 +722,40 @@ gallivm_compile_module(struct gallivm_state *gallivm)
     */
  skip_cached:
 
+#if GALLIVM_USE_ORCJIT
+   /*
+    * MCJIT generates code on the first gallivm_jit_function() call, ORC
+    * needs the final module to create the object, so it's done here.
+    */
+   if (gallivm_debug & GALLIVM_DEBUG_PERF)
+      time_begin = os_time_get();
+
+   {
+      char *error = NULL;
+      if (lp_build_orc_add_module(gallivm->orc, gallivm->module,
+                                  gallivm->cache, &error)) {
+         _debug_printf("%s\n", error);
+         free(error);
+         assert(0);
+      }
+   }
+
+   if (gallivm_debug & GALLIVM_DEBUG_PERF) {
+      int64_t time_end = os_time_get();
+      int time_msec = (int)((time_end - time_begin) / 1000);
+      debug_printf("   codegen of module %s took %d msec, %u bytes object\n",
+                   gallivm->module_name, time_msec,
+                   (unsigned)lp_build_orc_get_object_size(gallivm->orc));
+   }
+#endif
+
    ++gallivm->compiled;
 
    lp_init_printf_hook(gallivm);
-   LLVMAddGlobalMapping(gallivm->engine, gallivm->debug_printf_hook, debug_printf);
+   gallivm_add_global_mapping(gallivm, gallivm->debug_printf_hook, debug_printf);
 
    lp_init_clock_hook(gallivm);
-   LLVMAddGlobalMapping(gallivm->engine, gallivm->get_time_hook, os_time_get_nano);
+   gallivm_add_global_mapping(gallivm, gallivm->get_time_hook, os_time_get_nano);
 
    lp_build_coro_add_malloc_hooks(gallivm);
 
@@ -691,7 +769,7 @@ gallivm_compile_module(struct gallivm_state *gallivm)
           * LLVMGetPointerToGlobal() will abort otherwise.
           */
          if (!LLVMIsDeclaration(llvm_func)) {
-            void *func_code = LLVMGetPointerToGlobal(gallivm->engine, llvm_func);
+            void *func_code = gallivm_get_function_code(gallivm, llvm_func);
             lp_disassemble(llvm_func, func_code);
          }
          llvm_func = LLVMGetNextFunction(llvm_func);
@@ -704,7 +782,7 @@ gallivm_compile_module(struct gallivm_state *gallivm)
 
       while (llvm_func) {
          if (!LLVMIsDeclaration(llvm_func)) {
-            void *func_code = LLVMGetPointerToGlobal(gallivm->engine, llvm_func);
+            void *func_code = gallivm_get_function_code(gallivm, llvm_func);
             lp_profile(llvm_func, func_code);
          }
          llvm_func = LLVMGetNextFunction(llvm_func);
@@ -724,12 +802,11 @@ gallivm_jit_function(struct gallivm_state *gallivm,
    int64_t time_begin = 0;
 
    assert(gallivm->compiled);
-   assert(gallivm->engine);
 
    if (gallivm_debug & GALLIVM_DEBUG_PERF)
       time_begin = os_time_get();
 
-   code = LLVMGetPointerToGlobal(gallivm->engine, func);
+   code = gallivm_get_function_code(gallivm, func);
    assert(code);
    jit_func = pointer_to_func(code);
 
@@ -40,6 +40,7 @@ extern "C" {
 #endif
 
 struct lp_cached_code;
+struct lp_orc_module;
 struct gallivm_state
 {
    char *module_name;
@@ -56,6 +57,9 @@ struct gallivm_state
    LLVMBuilderRef builder;
    LLVMMCJITMemoryManagerRef memorymgr;
    struct lp_generated_code *code;
+#if GALLIVM_USE_ORCJIT
+   struct lp_orc_module *orc;
+#endif
    struct lp_cached_code *cache;
    unsigned compiled;
    LLVMValueRef coro_malloc_hook;
@@ -99,6 +103,10 @@ func_pointer
 gallivm_jit_function(struct gallivm_state *gallivm,
                      LLVMValueRef func);
 
+void
+gallivm_add_global_mapping(struct gallivm_state *gallivm,
+                           LLVMValueRef global, void *addr);
+
 unsigned gallivm_get_perf_flags(void);
 
 void lp_init_clock_hook(struct gallivm_state *gallivm);
@@ -79,14 +79,29 @@
 #include <llvm/ExecutionEngine/JITEventListener.h>
 #endif
 
+#if GALLIVM_USE_ORCJIT
+#include <atomic>
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h>
+#include <llvm/Target/TargetMachine.h>
+#endif
+
 #include "c11/threads.h"
 #include "util/u_thread.h"
 #include "util/detect.h"
 #include "util/u_debug.h"
 #include "util/u_cpu_detect.h"
+#include "util/os_memory.h"
 
 #include "lp_bld_misc.h"
 #include "lp_bld_debug.h"
+#include "lp_bld_code_arena.h"
+#if GALLIVM_USE_ORCJIT
+#include "lp_bld_init.h"
+#endif
 
 static void lp_run_atexit_for_destructors(void);
 
@@ -224,6 +239,10 @@ class DelegatingJITMemoryManager : public BaseMemoryManager {
       virtual bool finalizeMemory(std::string *ErrMsg = 0) {
          return mgr()->finalizeMemory(ErrMsg);
       }
+      virtual void notifyObjectLoaded(llvm::RuntimeDyld &RTDyld,
+                                      const llvm::object::ObjectFile &Obj) {
+         mgr()->notifyObjectLoaded(RTDyld, Obj);
+      }
 };
 
 
@@ -289,6 +308,99 @@ class ShaderMemoryManager : public DelegatingJITMemoryManager {
       }
 };
 
+/*
+ * Memory manager allocating from the process wide code arena.
+ *
+ * Sections are written through the arena's read-write view.  Once an
+ * object has been loaded, and before relocations are applied, the sections
+ * are moved to their read-execute view with mapSectionAddress(), so code
+ * is relocated for and run from the executable view and no page is ever
+ * writable and executable at once.  Writable data sections don't go to the
+ * arena.  Everything is returned to the arena on destruction.
+ */
+class CodeArenaMemoryManager : public BaseMemoryManager {
+
+   struct Block {
+      uint8_t *RW;
+      uint8_t *RX;
+      size_t Size;
+   };
+
+   std::vector<Block> Blocks;
+   std::vector<void *> DataBlocks;
+   /* Blocks not yet moved to the executable view / flushed from icache */
+   size_t NumUnmapped = 0;
+   size_t NumUnflushed = 0;
+
+   uint8_t *allocateBlock(uintptr_t Size, unsigned Alignment) {
+      Block B;
+      if (!lp_code_arena_alloc(Size, Alignment, &B.RW, &B.RX))
+         return NULL;
+      B.Size = Size;
+      Blocks.push_back(B);
+      return B.RW;
+   }
+
+   public:
+      virtual ~CodeArenaMemoryManager() {
+         for (const Block &B : Blocks)
+            lp_code_arena_free(B.RW, B.Size);
+         for (void *Data : DataBlocks)
+            os_free_aligned(Data);
+      }
+
+      virtual uint8_t *allocateCodeSection(uintptr_t Size,
+                                           unsigned Alignment,
+                                           unsigned SectionID,
+                                           llvm::StringRef SectionName) {
+         return allocateBlock(Size, Alignment);
+      }
+
+      virtual uint8_t *allocateDataSection(uintptr_t Size,
+                                           unsigned Alignment,
+                                           unsigned SectionID,
+                                           llvm::StringRef SectionName,
+                                           bool IsReadOnly) {
+         if (IsReadOnly)
+            return allocateBlock(Size, Alignment);
+
+         void *Data = os_malloc_aligned(MAX2(Size, 1), MAX2(Alignment, 16));
+         if (Data)
+            DataBlocks.push_back(Data);
+         return (uint8_t *)Data;
+      }
+
+      virtual void notifyObjectLoaded(llvm::RuntimeDyld &RTDyld,
+                                      const llvm::object::ObjectFile &Obj) {
+         for (; NumUnmapped < Blocks.size(); NumUnmapped++) {
+            const Block &B = Blocks[NumUnmapped];
+            RTDyld.mapSectionAddress(B.RW, (uint64_t)(uintptr_t)B.RX);
+         }
+      }
+
+      /* The unwinder must see the frames at the address the code runs from. */
+      virtual void registerEHFrames(uint8_t *Addr, uint64_t LoadAddr, size_t Size) {
+         BaseMemoryManager::registerEHFrames((uint8_t *)(uintptr_t)LoadAddr,
+                                             LoadAddr, Size);
+      }
+
+      virtual bool finalizeMemory(std::string *ErrMsg = 0) {
+         for (; NumUnflushed < Blocks.size(); NumUnflushed++) {
+            const Block &B = Blocks[NumUnflushed];
+            llvm::sys::Memory::InvalidateInstructionCache(B.RX, B.Size);
+         }
+         return false;
+      }
+};
+
+static BaseMemoryManager *
+lp_create_code_memory_manager(void)
+{
+   if (lp_code_arena_available())
+      return new CodeArenaMemoryManager();
+   return new llvm::SectionMemoryManager();
+}
+
 class LPObjectCache : public llvm::ObjectCache {
 private:
    bool has_object;
@@ -321,69 +433,13 @@ public:
 };
 
 /**
- * Same as LLVMCreateJITCompilerForModule, but:
- * - allows using MCJIT and enabling AVX feature where available.
- * - set target options
- *
- * See also:
- * - llvm/lib/ExecutionEngine/ExecutionEngineBindings.cpp
- * - llvm/tools/lli/lli.cpp
- * - http://markmail.org/message/ttkuhvgj4cxxy2on#query:+page:1+mid:aju2dggerju3ivd3+state:results
+ * Pick the cpu and the feature attributes to generate code for, shared by
+ * the MCJIT and ORC engines.
  */
-extern "C"
-LLVMBool
-lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
-                                        lp_generated_code **OutCode,
-                                        struct lp_cached_code *cache_out,
-                                        LLVMModuleRef M,
-                                        LLVMMCJITMemoryManagerRef CMM,
-                                        unsigned OptLevel,
-                                        char **OutError)
+static void
+lp_get_host_target(std::string &MCPU,
+                   llvm::SmallVector<std::string, 16> &MAttrs)
 {
-   using namespace llvm;
-
-   std::string Error;
-   EngineBuilder builder(std::unique_ptr<Module>(unwrap(M)));
-
-   /**
-    * LLVM 3.1+ haven't more "extern unsigned llvm::StackAlignmentOverride" and
-    * friends for configuring code generation options, like stack alignment.
-    */
-   TargetOptions options;
-#if DETECT_ARCH_X86 && LLVM_VERSION_MAJOR < 13
-   options.StackAlignmentOverride = 4;
-#endif
-
-   builder.setEngineKind(EngineKind::JIT)
-          .setErrorStr(&Error)
-          .setTargetOptions(options)
-#if LLVM_VERSION_MAJOR >= 18
-          .setOptLevel((CodeGenOptLevel)OptLevel);
-#else
-          .setOptLevel((CodeGenOpt::Level)OptLevel);
-#endif
-
-#if DETECT_OS_WINDOWS
-    /*
-     * MCJIT works on Windows, but currently only through ELF object format.
-     *
-     * XXX: We could use `LLVM_HOST_TRIPLE "-elf"` but LLVM_HOST_TRIPLE has
-     * different strings for MinGW/MSVC, so better play it safe and be
-     * explicit.
-     */
-#  if DETECT_ARCH_X86_64
-    LLVMSetTarget(M, "x86_64-pc-win32-elf");
-#  elif DETECT_ARCH_X86
-    LLVMSetTarget(M, "i686-pc-win32-elf");
-#  elif DETECT_ARCH_AARCH64
-    LLVMSetTarget(M, "aarch64-pc-win32-elf");
-#  else
-#    error Unsupported architecture for MCJIT on Windows.
-#  endif
-#endif
-
-   llvm::SmallVector<std::string, 16> MAttrs;
-
 #if DETECT_ARCH_ARM
    /* llvm-3.3+ implements sys::getHostCPUFeatures for Arm,
     * which allows us to enable/disable code generation based
@@ -467,8 +523,6 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
    MAttrs.push_back("+fp64");
 #endif
 
-   builder.setMAttrs(MAttrs);
-
    if (gallivm_debug & (GALLIVM_DEBUG_IR | GALLIVM_DEBUG_ASM | GALLIVM_DEBUG_DUMP_BC)) {
       int n = MAttrs.size();
       if (n > 0) {
@@ -479,7 +533,7 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
       }
    }
 
-   StringRef MCPU = llvm::sys::getHostCPUName();
+   MCPU = llvm::sys::getHostCPUName().str();
    /*
     * The cpu bits are no longer set automatically, so need to set mcpu manually.
     * Note that the MAttrs set above will be sort of ignored (since we should
@@ -494,17 +548,6 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
     */
 
 #if DETECT_ARCH_PPC_64
-   /*
-    * Large programs, e.g. gnome-shell and firefox, may tax the addressability
-    * of the Medium code model once dynamically generated JIT-compiled shader
-    * programs are linked in and relocated.  Yet the default code model as of
-    * LLVM 8 is Medium or even Small.
-    * The cost of changing from Medium to Large is negligible:
-    * - an additional 8-byte pointer stored immediately before the shader entrypoint;
-    * - change an add-immediate (addis) instruction to a load (ld).
-    */
-   builder.setCodeModel(CodeModel::Large);
-
 #if UTIL_ARCH_LITTLE_ENDIAN
    /*
     * Versions of LLVM prior to 4.0 lacked a table entry for "POWER8NVL",
@@ -532,10 +575,91 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
       MCPU = util_get_cpu_caps()->has_msa ? "mips64r5" : "mips64r2";
 #endif
 
-   builder.setMCPU(MCPU);
    if (gallivm_debug & (GALLIVM_DEBUG_IR | GALLIVM_DEBUG_ASM | GALLIVM_DEBUG_DUMP_BC)) {
-      debug_printf("llc -mcpu option: %s\n", MCPU.str().c_str());
+      debug_printf("llc -mcpu option: %s\n", MCPU.c_str());
    }
+}
+
+/**
+ * Same as LLVMCreateJITCompilerForModule, but:
+ * - allows using MCJIT and enabling AVX feature where available.
+ * - set target options
+ *
+ * See also:
+ * - llvm/lib/ExecutionEngine/ExecutionEngineBindings.cpp
+ * - llvm/tools/lli/lli.cpp
+ * - http://markmail.org/message/ttkuhvgj4cxxy2on#query:+page:1+mid:aju2dggerju3ivd3+state:results
+ */
+extern "C"
+LLVMBool
+lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
+                                        lp_generated_code **OutCode,
+                                        struct lp_cached_code *cache_out,
+                                        LLVMModuleRef M,
+                                        LLVMMCJITMemoryManagerRef CMM,
+                                        unsigned OptLevel,
+                                        char **OutError)
+{
+   using namespace llvm;
+
+   std::string Error;
+   EngineBuilder builder(std::unique_ptr<Module>(unwrap(M)));
+
+   /**
+    * LLVM 3.1+ haven't more "extern unsigned llvm::StackAlignmentOverride" and
+    * friends for configuring code generation options, like stack alignment.
+    */
+   TargetOptions options;
+#if DETECT_ARCH_X86 && LLVM_VERSION_MAJOR < 13
+   options.StackAlignmentOverride = 4;
+#endif
+
+   builder.setEngineKind(EngineKind::JIT)
+          .setErrorStr(&Error)
+          .setTargetOptions(options)
+#if LLVM_VERSION_MAJOR >= 18
+          .setOptLevel((CodeGenOptLevel)OptLevel);
+#else
+          .setOptLevel((CodeGenOpt::Level)OptLevel);
+#endif
+
+#if DETECT_OS_WINDOWS
+    /*
+     * MCJIT works on Windows, but currently only through ELF object format.
+     *
+     * XXX: We could use `LLVM_HOST_TRIPLE "-elf"` but LLVM_HOST_TRIPLE has
+     * different strings for MinGW/MSVC, so better play it safe and be
+     * explicit.
+     */
+#  if DETECT_ARCH_X86_64
+    LLVMSetTarget(M, "x86_64-pc-win32-elf");
+#  elif DETECT_ARCH_X86
+    LLVMSetTarget(M, "i686-pc-win32-elf");
+#  elif DETECT_ARCH_AARCH64
+    LLVMSetTarget(M, "aarch64-pc-win32-elf");
+#  else
+#    error Unsupported architecture for MCJIT on Windows.
+#  endif
+#endif
+
+   llvm::SmallVector<std::string, 16> MAttrs;
+   std::string MCPU;
+   lp_get_host_target(MCPU, MAttrs);
+
+   builder.setMAttrs(MAttrs);
+   builder.setMCPU(MCPU);
+#if DETECT_ARCH_PPC_64
+   /*
+    * Large programs, e.g. gnome-shell and firefox, may tax the addressability
+    * of the Medium code model once dynamically generated JIT-compiled shader
+    * programs are linked in and relocated.  Yet the default code model as of
+    * LLVM 8 is Medium or even Small.
+    * The cost of changing from Medium to Large is negligible:
+    * - an additional 8-byte pointer stored immediately before the shader entrypoint;
+    * - change an add-immediate (addis) instruction to a load (ld).
+    */
+   builder.setCodeModel(CodeModel::Large);
+#endif
 
    ShaderMemoryManager *MM = NULL;
    BaseMemoryManager* JMM = reinterpret_cast<BaseMemoryManager*>(CMM);
@@ -583,7 +707,7 @@ LLVMMCJITMemoryManagerRef
 lp_get_default_memory_manager()
 {
    BaseMemoryManager *mm;
-   mm = new llvm::SectionMemoryManager();
+   mm = lp_create_code_memory_manager();
    return reinterpret_cast<LLVMMCJITMemoryManagerRef>(mm);
 }
 
@@ -601,6 +725,261 @@ lp_free_objcache(void *objcache_ptr)
    delete objcache;
 }
 
+#if GALLIVM_USE_ORCJIT
+
+/*
+ * ORC engine.
+ *
+ * Instead of one MCJIT ExecutionEngine per module, all modules share one
+ * LLJIT session for the whole process.  Each module gets its own JITDylib,
+ * so symbol names of different shaders never clash and all of a module's
+ * code is released at once with its JITDylib.
+ *
+ * A module is compiled to an object file on the calling thread with a
+ * target machine of its own, so threads that compile modules at the same
+ * time only share the session when adding and linking the object.  There
+ * is no compile thread pool of our own.  ORC links an object on the first
+ * lookup of one of its symbols, but gallivm_jit_function() is called right
+ * after every compile, so in practice nothing is linked lazily.
+ */
+
+struct lp_orc_module {
+   llvm::orc::JITDylib *JD;
+   std::unique_ptr<llvm::TargetMachine> TM;
+   size_t ObjectSize;
+};
+
+static llvm::orc::LLJIT *lp_orc_jit = NULL;
+static llvm::orc::JITTargetMachineBuilder *lp_orc_jtmb = NULL;
+static once_flag lp_orc_jit_once_flag = ONCE_FLAG_INIT;
+
+/* Both are never freed, like the rest of LLVM's global state. */
+static void
+lp_orc_create_jit(void)
+{
+   using namespace llvm;
+
+   Triple TT(sys::getProcessTriple());
+#if DETECT_OS_WINDOWS
+   /* Same as MCJIT, only ELF objects can be loaded on Windows. */
+   TT.setObjectFormat(Triple::ELF);
+#endif
+
+   llvm::SmallVector<std::string, 16> MAttrs;
+   std::string MCPU;
+   lp_get_host_target(MCPU, MAttrs);
+
+   lp_orc_jtmb = new orc::JITTargetMachineBuilder(TT);
+   lp_orc_jtmb->setCPU(MCPU);
+   lp_orc_jtmb->addFeatures(std::vector<std::string>(MAttrs.begin(), MAttrs.end()));
+#if LLVM_VERSION_MAJOR >= 18
+   lp_orc_jtmb->setCodeGenOptLevel(gallivm_get_perf_flags() & GALLIVM_PERF_NO_OPT ?
+                                   CodeGenOptLevel::None : CodeGenOptLevel::Default);
+#else
+   lp_orc_jtmb->setCodeGenOptLevel(gallivm_get_perf_flags() & GALLIVM_PERF_NO_OPT ?
+                                   CodeGenOpt::None : CodeGenOpt::Default);
+#endif
+#if DETECT_ARCH_PPC_64
+   /* See lp_build_create_jit_compiler_for_module(). */
+   lp_orc_jtmb->setCodeModel(CodeModel::Large);
+#endif
+
+   /*
+    * Use RuntimeDyld with the same memory managers as MCJIT, one per object,
+    * so the generated code is the same with both engines.  The memory manager
+    * getter takes the object buffer as argument on newer LLVM versions.
+    */
+   auto J = orc::LLJITBuilder()
+      .setJITTargetMachineBuilder(*lp_orc_jtmb)
+      .setObjectLinkingLayerCreator(
+         [](orc::ExecutionSession &ES, const Triple &TT)
+               -> Expected<std::unique_ptr<orc::ObjectLayer>> {
+            auto GetMemoryManager = [](auto &&...) {
+               return std::unique_ptr<RuntimeDyld::MemoryManager>(
+                  lp_create_code_memory_manager());
+            };
+            return std::make_unique<orc::RTDyldObjectLinkingLayer>(ES, GetMemoryManager);
+         })
+      .create();
+   if (!J) {
+      _debug_printf("gallivm: failed to create ORC JIT: %s\n",
+                    toString(J.takeError()).c_str());
+      return;
+   }
+
+   lp_orc_jit = J->release();
+}
+
+/**
+ * Set up a module for the ORC engine, this must be done before running the
+ * optimization passes as it sets the module's target and data layout.
+ */
+extern "C" struct lp_orc_module *
+lp_build_orc_create_module(LLVMModuleRef MRef, const char *name)
+{
+   using namespace llvm;
+   static std::atomic<unsigned> lp_orc_module_id;
+
+   call_once(&lp_orc_jit_once_flag, lp_orc_create_jit);
+   if (!lp_orc_jit)
+      return NULL;
+
+   auto TM = orc::JITTargetMachineBuilder(*lp_orc_jtmb).createTargetMachine();
+   if (!TM) {
+      _debug_printf("gallivm: %s\n", toString(TM.takeError()).c_str());
+      return NULL;
+   }
+
+   /* JITDylib names must be unique in the session. */
+   std::string JDName = std::string(name ? name : "gallivm") + "." +
+                        std::to_string(lp_orc_module_id++);
+   auto JD = lp_orc_jit->createJITDylib(JDName);
+   if (!JD) {
+      _debug_printf("gallivm: %s\n", toString(JD.takeError()).c_str());
+      return NULL;
+   }
+
+   /* Resolve libc/libm calls (memcpy, powf, ...) like MCJIT does. */
+   auto Generator = orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+      lp_orc_jit->getDataLayout().getGlobalPrefix());
+   if (Generator)
+      JD->addGenerator(std::move(*Generator));
+   else
+      consumeError(Generator.takeError());
+
+   Module *M = unwrap(MRef);
+   M->setTargetTriple((*TM)->getTargetTriple().str());
+   M->setDataLayout((*TM)->createDataLayout());
+
+   struct lp_orc_module *orc = new lp_orc_module;
+   orc->JD = &*JD;
+   orc->TM = std::move(*TM);
+   orc->ObjectSize = 0;
+   return orc;
+}
+
+/**
+ * The target machine to run the optimization passes with, only valid until
+ * lp_build_orc_add_module().
+ */
+extern "C" LLVMTargetMachineRef
+lp_build_orc_get_target_machine(struct lp_orc_module *orc)
+{
+   return reinterpret_cast<LLVMTargetMachineRef>(orc->TM.get());
+}
+
+/**
+ * Compile the module to an object, or take it from the shader cache, and
+ * add it to the module's JITDylib.  It is linked on the first lookup.
+ */
+extern "C" LLVMBool
+lp_build_orc_add_module(struct lp_orc_module *orc,
+                        LLVMModuleRef MRef,
+                        struct lp_cached_code *cache_out,
+                        char **OutError)
+{
+   using namespace llvm;
+
+   LPObjectCache *objcache = NULL;
+   if (cache_out) {
+      objcache = new LPObjectCache(cache_out);
+      cache_out->jit_obj_cache = (void *)objcache;
+   }
+
+   orc::SimpleCompiler Compile(*orc->TM, objcache);
+   auto Obj = Compile(*unwrap(MRef));
+   if (!Obj) {
+      *OutError = strdup(toString(Obj.takeError()).c_str());
+      return 1;
+   }
+
+   std::unique_ptr<MemoryBuffer> Buffer = std::move(*Obj);
+   /*
+    * An object from the shader cache points at cache_out->data, which is
+    * freed with the IR, while linking only happens on the first lookup.
+    */
+   if (cache_out && Buffer->getBufferStart() == cache_out->data)
+      Buffer = MemoryBuffer::getMemBufferCopy(Buffer->getBuffer());
+
+   orc->ObjectSize = Buffer->getBufferSize();
+   orc->TM.reset();
+
+   if (Error Err = lp_orc_jit->addObjectFile(*orc->JD, std::move(Buffer))) {
+      *OutError = strdup(toString(std::move(Err)).c_str());
+      return 1;
+   }
+   return 0;
+}
+
+extern "C" size_t
+lp_build_orc_get_object_size(struct lp_orc_module *orc)
+{
+   return orc->ObjectSize;
+}
+
+/**
+ * Make an external symbol of the module resolve to addr, the ORC version of
+ * LLVMAddGlobalMapping().
+ */
+extern "C" void
+lp_build_orc_add_global_mapping(struct lp_orc_module *orc,
+                                const char *name, void *addr)
+{
+   using namespace llvm;
+
+   orc::SymbolMap Symbols;
+#if LLVM_VERSION_MAJOR >= 17
+   Symbols[lp_orc_jit->mangleAndIntern(name)] =
+      orc::ExecutorSymbolDef(orc::ExecutorAddr::fromPtr(addr),
+                             JITSymbolFlags::Exported);
+#else
+   Symbols[lp_orc_jit->mangleAndIntern(name)] =
+      JITEvaluatedSymbol(pointerToJITTargetAddress(addr),
+                         JITSymbolFlags::Exported);
+#endif
+   if (Error Err = orc->JD->define(orc::absoluteSymbols(std::move(Symbols))))
+      _debug_printf("gallivm: %s\n", toString(std::move(Err)).c_str());
+}
+
+/**
+ * Look up a function of the module, linking the module's object if this is
+ * the first lookup.
+ */
+extern "C" void *
+lp_build_orc_lookup(struct lp_orc_module *orc, const char *name)
+{
+   using namespace llvm;
+
+   auto Sym = lp_orc_jit->lookup(*orc->JD, name);
+   if (!Sym) {
+      _debug_printf("gallivm: %s\n", toString(Sym.takeError()).c_str());
+      return NULL;
+   }
+#if LLVM_VERSION_MAJOR >= 15
+   return Sym->toPtr<void *>();
+#else
+   return jitTargetAddressToPointer<void *>(Sym->getAddress());
+#endif
+}
+
+/**
+ * Release the module's JITDylib and with it all of the module's code.
+ */
+extern "C" void
+lp_build_orc_destroy_module(struct lp_orc_module *orc)
+{
+   using namespace llvm;
+
+   if (!orc)
+      return;
+
+   if (Error Err = lp_orc_jit->getExecutionSession().removeJITDylib(*orc->JD))
+      _debug_printf("gallivm: %s\n", toString(std::move(Err)).c_str());
+   delete orc;
+}
+
+#endif /* GALLIVM_USE_ORCJIT */
+
 extern "C" LLVMValueRef
 lp_get_called_value(LLVMValueRef call)
 {
@@ -77,6 +77,35 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
 extern void
 lp_free_generated_code(struct lp_generated_code *code);
 
+#if GALLIVM_USE_ORCJIT
+struct lp_orc_module;
+
+extern struct lp_orc_module *
+lp_build_orc_create_module(LLVMModuleRef M, const char *name);
+
+extern LLVMTargetMachineRef
+lp_build_orc_get_target_machine(struct lp_orc_module *orc);
+
+extern LLVMBool
+lp_build_orc_add_module(struct lp_orc_module *orc,
+                        LLVMModuleRef M,
+                        struct lp_cached_code *cache_out,
+                        char **OutError);
+
+extern size_t
+lp_build_orc_get_object_size(struct lp_orc_module *orc);
+
+extern void
+lp_build_orc_add_global_mapping(struct lp_orc_module *orc,
+                                const char *name, void *addr);
+
+extern void *
+lp_build_orc_lookup(struct lp_orc_module *orc, const char *name);
+
+extern void
+lp_build_orc_destroy_module(struct lp_orc_module *orc);
+#endif
+
 extern LLVMMCJITMemoryManagerRef
 lp_get_default_memory_manager();
 
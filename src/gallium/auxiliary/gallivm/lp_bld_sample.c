@@ -127,6 +127,8 @@ lp_sampler_static_texture_state(struct lp_static_texture_state *state,
    state->pot_height = util_is_power_of_two_or_zero(texture->height0);
    state->pot_depth = util_is_power_of_two_or_zero(texture->depth0);
    state->level_zero_only = !view->u.tex.last_level;
+   state->tiled = !view->is_tex2d_from_buf &&
+                  !!(texture->flags & LP_RESOURCE_FLAG_TILED);
 
    /*
     * the layer / element / level parameters are all either dynamic
@@ -2196,6 +2198,70 @@ lp_build_sample_offset(struct lp_build_context *bld,
 }
 
 
+/**
+ * Compute the offset of a pixel block in a LP_RESOURCE_FLAG_TILED texture.
+ *
+ * Pixel blocks are grouped in 4x4 micro-tiles stored contiguously, in
+ * row-major order both inside a micro-tile and for the micro-tiles
+ * themselves. y_stride is still the size of one row of pixel blocks, so
+ * a row of micro-tiles takes 4 * y_stride bytes. z_stride is unchanged.
+ *
+ * Unlike with linear textures, neighbouring texels in both x and y usually
+ * end up in the same cache line, which helps minified and rotated access.
+ */
+void
+lp_build_sample_offset_tiled(struct lp_build_context *bld,
+                             const struct util_format_description *format_desc,
+                             LLVMValueRef x,
+                             LLVMValueRef y,
+                             LLVMValueRef z,
+                             LLVMValueRef y_stride,
+                             LLVMValueRef z_stride,
+                             LLVMValueRef *out_offset,
+                             LLVMValueRef *out_i,
+                             LLVMValueRef *out_j)
+{
+   struct gallivm_state *gallivm = bld->gallivm;
+   const unsigned tile = LP_TEXTURE_MICROTILE_SIZE;
+   const unsigned block_bytes = format_desc->block.bits / 8;
+   LLVMValueRef tile_mask = lp_build_const_int_vec(gallivm, bld->type, tile - 1);
+   LLVMValueRef tile_shift = lp_build_const_int_vec(gallivm, bld->type,
+                                                    util_logbase2(tile));
+   LLVMValueRef offset, tmp;
+
+   /* block coordinates, the tiling is in units of pixel blocks */
+   lp_build_sample_partial_offset(bld, format_desc->block.width, x,
+                                  bld->one, &x, out_i);
+
+   /* x: (x / 4) * (16 * block_bytes) + (x % 4) * block_bytes */
+   tmp = LLVMBuildLShr(gallivm->builder, x, tile_shift, "");
+   offset = lp_build_mul_imm(bld, tmp, tile * tile * block_bytes);
+   tmp = LLVMBuildAnd(gallivm->builder, x, tile_mask, "");
+   offset = lp_build_add(bld, offset,
+                         lp_build_mul_imm(bld, tmp, block_bytes));
+
+   if (y && y_stride) {
+      /* y: (y / 4) * (4 * y_stride) + (y % 4) * (4 * block_bytes) */
+      lp_build_sample_partial_offset(bld, format_desc->block.height, y,
+                                     bld->one, &y, out_j);
+      tmp = LLVMBuildLShr(gallivm->builder, y, tile_shift, "");
+      tmp = lp_build_mul(bld, tmp, lp_build_mul_imm(bld, y_stride, tile));
+      offset = lp_build_add(bld, offset, tmp);
+      tmp = LLVMBuildAnd(gallivm->builder, y, tile_mask, "");
+      offset = lp_build_add(bld, offset,
+                            lp_build_mul_imm(bld, tmp, tile * block_bytes));
+   } else {
+      *out_j = bld->zero;
+   }
+
+   if (z && z_stride) {
+      offset = lp_build_add(bld, offset, lp_build_mul(bld, z, z_stride));
+   }
+
+   *out_offset = offset;
+}
+
+
 static LLVMValueRef
 lp_build_sample_min(struct lp_build_context *bld,
                     LLVMValueRef x,
@@ -176,6 +176,15 @@ struct lp_img_params
 };
 
 
+/**
+ * pipe_resource flag a driver sets on textures whose mip levels are stored
+ * as LP_TEXTURE_MICROTILE_SIZE x LP_TEXTURE_MICROTILE_SIZE blocks of pixel
+ * blocks instead of linear rows, see lp_build_sample_offset_tiled().
+ */
+#define LP_RESOURCE_FLAG_TILED PIPE_RESOURCE_FLAG_DRV_PRIV
+#define LP_TEXTURE_MICROTILE_SIZE 4
+
+
 /**
  * Texture static state.
  *
@@ -198,6 +207,7 @@ struct lp_static_texture_state
    unsigned pot_height:1;
    unsigned pot_depth:1;
    unsigned level_zero_only:1;
+   unsigned tiled:1;         /**< LP_RESOURCE_FLAG_TILED layout */
 };
 
 
@@ -738,6 +748,19 @@ lp_build_sample_offset(struct lp_build_context *bld,
                        LLVMValueRef *out_j);
 
 
+void
+lp_build_sample_offset_tiled(struct lp_build_context *bld,
+                             const struct util_format_description *format_desc,
+                             LLVMValueRef x,
+                             LLVMValueRef y,
+                             LLVMValueRef z,
+                             LLVMValueRef y_stride,
+                             LLVMValueRef z_stride,
+                             LLVMValueRef *out_offset,
+                             LLVMValueRef *out_i,
+                             LLVMValueRef *out_j);
+
+
 void
 lp_build_sample_soa_code(struct gallivm_state *gallivm,
                          const struct lp_static_texture_state *static_texture_state,
@@ -514,6 +514,41 @@ lp_build_occlusion_count(struct gallivm_state *gallivm,
 }
 
 
+/**
+ * Concatenate the results of the two 8-wide halves of a 16-wide depth/stencil
+ * vector, which is all that is needed as a 16-wide vector is simply two
+ * 8-wide ones (rows 0-1 and rows 2-3 of the 4x4 block) back to back.
+ */
+static LLVMValueRef
+lp_build_depth_concat_halves(struct gallivm_state *gallivm,
+                             LLVMValueRef lo, LLVMValueRef hi)
+{
+   LLVMValueRef shuffles[LP_MAX_VECTOR_LENGTH];
+   unsigned length = LLVMGetVectorSize(LLVMTypeOf(lo));
+
+   assert(length * 2 <= ARRAY_SIZE(shuffles));
+   for (unsigned i = 0; i < length * 2; i++) {
+      shuffles[i] = lp_build_const_int32(gallivm, i);
+   }
+   return LLVMBuildShuffleVector(gallivm->builder, lo, hi,
+                                 LLVMConstVector(shuffles, length * 2), "");
+}
+
+
+static LLVMValueRef
+lp_build_depth_extract_half(struct gallivm_state *gallivm,
+                            LLVMValueRef value, unsigned half)
+{
+   unsigned length;
+
+   if (!value)
+      return NULL;
+
+   length = LLVMGetVectorSize(LLVMTypeOf(value)) / 2;
+   return lp_build_extract_range(gallivm, value, half * length, length);
+}
+
+
 /**
  * Load depth/stencil values.
  * The stored values are linear, swizzle them.
@@ -547,6 +582,26 @@ lp_build_depth_stencil_load_swizzled(struct gallivm_state *gallivm,
    struct lp_type zs_load_type = zs_type;
    zs_load_type.length = zs_load_type.length / 2;
 
+   if (z_src_type.length == 16) {
+      struct lp_type half_type = z_src_type;
+      LLVMValueRef z_half[2], s_half[2];
+
+      /* 1d resources only ever run the upper half of the stamp */
+      assert(!is_1d);
+      half_type.length = 8;
+      for (unsigned i = 0; i < 2; i++) {
+         lp_build_depth_stencil_load_swizzled(gallivm, half_type, format_desc,
+                                              is_1d, depth_ptr, depth_stride,
+                                              &z_half[i], &s_half[i],
+                                              lp_build_const_int32(gallivm, i));
+      }
+      *z_fb = lp_build_depth_concat_halves(gallivm, z_half[0], z_half[1]);
+      *s_fb = lp_build_depth_concat_halves(gallivm, s_half[0], s_half[1]);
+      lp_build_name(*z_fb, "z_dst");
+      lp_build_name(*s_fb, "s_dst");
+      return;
+   }
+
    LLVMTypeRef zs_dst_type = lp_build_vec_type(gallivm, zs_load_type);
 
    if (z_src_type.length == 4) {
@@ -691,6 +746,25 @@ lp_build_depth_stencil_write_swizzled(struct gallivm_state *gallivm,
    struct lp_type z_type = zs_type;
    struct lp_type zs_load_type = zs_type;
 
+   if (z_src_type.length == 16) {
+      struct lp_type half_type = z_src_type;
+
+      assert(!is_1d);
+      half_type.length = 8;
+      for (unsigned i = 0; i < 2; i++) {
+         lp_build_depth_stencil_write_swizzled(gallivm, half_type, format_desc,
+                                               is_1d,
+                                               lp_build_depth_extract_half(gallivm, mask_value, i),
+                                               lp_build_depth_extract_half(gallivm, z_fb, i),
+                                               lp_build_depth_extract_half(gallivm, s_fb, i),
+                                               lp_build_const_int32(gallivm, i),
+                                               depth_ptr, depth_stride,
+                                               lp_build_depth_extract_half(gallivm, z_value, i),
+                                               lp_build_depth_extract_half(gallivm, s_value, i));
+      }
+      return;
+   }
+
    zs_load_type.length = zs_load_type.length / 2;
    load_ptr_type = LLVMPointerType(lp_build_vec_type(gallivm, zs_load_type), 0);
 
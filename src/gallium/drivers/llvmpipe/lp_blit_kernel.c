@@ -0,0 +1,657 @@
+/*
+ * Copyright © 2024 Mesa contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * JIT compiled blit kernels.
+ *
+ * The generic blit path goes through u_blitter, which sets up a full draw
+ * with a fragment shader sampling the source, bins a quad and rasterizes
+ * it.  For the common case of a plain color blit without scissor or
+ * blending that is a lot of machinery for what is really a per-row format
+ * conversion, so such blits are instead done with a small JIT compiled
+ * function which fetches a vector of source pixels, converts them with
+ * the gallivm format code and stores them, and is run over bands of rows
+ * on the compute thread pool.
+ */
+
+#include "util/format/u_format.h"
+#include "util/hash_table.h"
+#include "util/os_time.h"
+#include "util/u_inlines.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+
+#include "gallivm/lp_bld_arit.h"
+#include "gallivm/lp_bld_bitarit.h"
+#include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_debug.h"
+#include "gallivm/lp_bld_flow.h"
+#include "gallivm/lp_bld_format.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_logic.h"
+#include "gallivm/lp_bld_sample.h"
+#include "gallivm/lp_bld_type.h"
+
+#include "lp_blit_kernel.h"
+#include "lp_context.h"
+#include "lp_cs_tpool.h"
+#include "lp_debug.h"
+#include "lp_limits.h"
+#include "lp_perf.h"
+#include "lp_screen.h"
+
+
+/** Number of destination rows handed to a thread at a time */
+#define LP_BLIT_BAND_HEIGHT TILE_SIZE
+
+
+static bool
+blit_format_supported(const struct util_format_description *desc,
+                      bool is_dst)
+{
+   if (desc->layout != UTIL_FORMAT_LAYOUT_PLAIN ||
+       desc->colorspace != UTIL_FORMAT_COLORSPACE_RGB ||
+       desc->block.width != 1 ||
+       desc->block.height != 1)
+      return false;
+
+   const unsigned bits = desc->block.bits;
+   if (bits < 8 || bits > 128 || !util_is_power_of_two_nonzero(bits))
+      return false;
+
+   const int first = util_format_get_first_non_void_channel(desc->format);
+   if (first < 0)
+      return false;
+
+   const struct util_format_channel_description *chan0 =
+      &desc->channel[first];
+
+   for (unsigned chan = 0; chan < desc->nr_channels; chan++) {
+      const struct util_format_channel_description *c = &desc->channel[chan];
+
+      if (c->type == UTIL_FORMAT_TYPE_VOID) {
+         /* padding is only handled by the packed store path */
+         if (bits > 32)
+            return false;
+         continue;
+      }
+
+      if (c->type != chan0->type ||
+          c->normalized != chan0->normalized ||
+          c->pure_integer != chan0->pure_integer ||
+          c->size > 32)
+         return false;
+
+      if (is_dst) {
+         /*
+          * The store code maps rgba to format channels with the format
+          * swizzle itself, which is only right when the swizzle is its own
+          * inverse (RGBA, BGRA, ABGR, ...).  Wide formats are stored
+          * without any swizzling at all.
+          */
+         const unsigned swz = desc->swizzle[chan];
+         if (swz > PIPE_SWIZZLE_W || desc->swizzle[swz] != chan)
+            return false;
+         if (bits > 32 && swz != chan)
+            return false;
+      }
+   }
+
+   switch (chan0->type) {
+   case UTIL_FORMAT_TYPE_UNSIGNED:
+   case UTIL_FORMAT_TYPE_SIGNED:
+      /* no scaled formats */
+      if (!chan0->normalized && !chan0->pure_integer)
+         return false;
+      break;
+   case UTIL_FORMAT_TYPE_FLOAT:
+      if (chan0->size != 16 && chan0->size != 32)
+         return false;
+      break;
+   default:
+      return false;
+   }
+
+   if (is_dst &&
+       (util_format_is_alpha(desc->format) ||
+        util_format_is_luminance(desc->format) ||
+        util_format_is_luminance_alpha(desc->format) ||
+        util_format_is_intensity(desc->format)))
+      return false;
+
+   return true;
+}
+
+
+bool
+lp_blit_kernel_supported(enum pipe_format src_format,
+                         enum pipe_format dst_format)
+{
+   const struct util_format_description *src_desc =
+      util_format_description(src_format);
+   const struct util_format_description *dst_desc =
+      util_format_description(dst_format);
+
+   if (!src_desc || !dst_desc)
+      return false;
+
+   if (!blit_format_supported(src_desc, false) ||
+       !blit_format_supported(dst_desc, true))
+      return false;
+
+   /* no conversions between integer and non-integer, or signedness */
+   if (util_format_is_pure_uint(src_format) !=
+       util_format_is_pure_uint(dst_format) ||
+       util_format_is_pure_sint(src_format) !=
+       util_format_is_pure_sint(dst_format))
+      return false;
+
+   return true;
+}
+
+
+/**
+ * Fetch and convert the source pixels of the destination pixels x_vec,
+ * and store them at dst_offset.
+ */
+static void
+emit_blit_pixels(struct gallivm_state *gallivm,
+                 const struct util_format_description *src_desc,
+                 const struct util_format_description *dst_desc,
+                 struct lp_type type,
+                 LLVMValueRef src_ptr,
+                 LLVMValueRef dst_ptr,
+                 LLVMValueRef sx,
+                 LLVMValueRef x,
+                 LLVMValueRef x_vec,
+                 LLVMValueRef out_of_bounds)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_type int_type = lp_int_type(type);
+   struct lp_build_context int_bld;
+   const unsigned src_bpp = src_desc->block.bits / 8;
+   const unsigned dst_bpp = dst_desc->block.bits / 8;
+   LLVMValueRef rgba[4];
+
+   lp_build_context_init(&int_bld, gallivm, int_type);
+
+   LLVMValueRef src_offset =
+      lp_build_mul_imm(&int_bld, sx, src_bpp);
+   if (out_of_bounds)
+      src_offset = lp_build_andnot(&int_bld, src_offset, out_of_bounds);
+
+   lp_build_fetch_rgba_soa(gallivm, src_desc,
+                           lp_build_texel_type(type, src_desc), false,
+                           src_ptr, src_offset,
+                           int_bld.zero, int_bld.zero,
+                           NULL, rgba);
+
+   if (!out_of_bounds && dst_desc->block.bits <= type.width) {
+      /* whole vector of packed pixels, store it in one go */
+      LLVMValueRef packed = NULL;
+      lp_build_pack_rgba_soa(gallivm, dst_desc, type, rgba, &packed);
+
+      LLVMTypeRef vec_type =
+         LLVMVectorType(LLVMIntTypeInContext(gallivm->context,
+                                             dst_desc->block.bits),
+                        type.length);
+      if (dst_desc->block.bits < type.width)
+         packed = LLVMBuildTrunc(builder, packed, vec_type, "");
+
+      LLVMValueRef dst_offset =
+         LLVMBuildMul(builder, x, lp_build_const_int32(gallivm, dst_bpp), "");
+      LLVMValueRef ptr =
+         LLVMBuildGEP2(builder, LLVMInt8TypeInContext(gallivm->context),
+                       dst_ptr, &dst_offset, 1, "");
+      ptr = LLVMBuildBitCast(builder, ptr, LLVMPointerType(vec_type, 0), "");
+      LLVMValueRef store = LLVMBuildStore(builder, packed, ptr);
+      LLVMSetAlignment(store, dst_bpp);
+   } else {
+      LLVMValueRef dst_offset = lp_build_mul_imm(&int_bld, x_vec, dst_bpp);
+      if (!out_of_bounds)
+         out_of_bounds = int_bld.zero;
+      lp_build_store_rgba_soa(gallivm, dst_desc, type,
+                              lp_build_const_int_vec(gallivm, int_type, -1),
+                              dst_ptr, dst_offset, out_of_bounds, rgba);
+   }
+}
+
+
+struct lp_blit_kernel *
+lp_blit_kernel_create(LLVMContextRef context,
+                      enum pipe_format src_format,
+                      enum pipe_format dst_format)
+{
+   const struct util_format_description *src_desc =
+      util_format_description(src_format);
+   const struct util_format_description *dst_desc =
+      util_format_description(dst_format);
+   struct lp_blit_kernel *kernel;
+   char func_name[64];
+
+   assert(lp_blit_kernel_supported(src_format, dst_format));
+
+   kernel = CALLOC_STRUCT(lp_blit_kernel);
+   if (!kernel)
+      return NULL;
+
+   kernel->src_format = src_format;
+   kernel->dst_format = dst_format;
+
+   snprintf(func_name, sizeof(func_name), "blit_%s_%s",
+            util_format_short_name(src_format),
+            util_format_short_name(dst_format));
+
+   struct gallivm_state *gallivm = gallivm_create(func_name, context, NULL);
+   if (!gallivm) {
+      FREE(kernel);
+      return NULL;
+   }
+   kernel->gallivm = gallivm;
+
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef int8_type = LLVMInt8TypeInContext(gallivm->context);
+   LLVMTypeRef int32_type = LLVMInt32TypeInContext(gallivm->context);
+
+   LLVMTypeRef arg_types[5];
+   arg_types[0] = LLVMPointerType(int8_type, 0);  /* src */
+   arg_types[1] = LLVMPointerType(int8_type, 0);  /* dst */
+   arg_types[2] = int32_type;                     /* width */
+   arg_types[3] = int32_type;                     /* x0 */
+   arg_types[4] = int32_type;                     /* dx */
+
+   LLVMTypeRef func_type =
+      LLVMFunctionType(LLVMVoidTypeInContext(gallivm->context),
+                       arg_types, ARRAY_SIZE(arg_types), 0);
+
+   LLVMValueRef function = LLVMAddFunction(gallivm->module, func_name,
+                                           func_type);
+   LLVMSetFunctionCallConv(function, LLVMCCallConv);
+
+   LLVMValueRef src_ptr = LLVMGetParam(function, 0);
+   LLVMValueRef dst_ptr = LLVMGetParam(function, 1);
+   LLVMValueRef width = LLVMGetParam(function, 2);
+   LLVMValueRef x0 = LLVMGetParam(function, 3);
+   LLVMValueRef dx = LLVMGetParam(function, 4);
+
+   lp_build_name(src_ptr, "src");
+   lp_build_name(dst_ptr, "dst");
+   lp_build_name(width, "width");
+   lp_build_name(x0, "x0");
+   lp_build_name(dx, "dx");
+
+   LLVMBasicBlockRef block =
+      LLVMAppendBasicBlockInContext(gallivm->context, function, "entry");
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   struct lp_type type = lp_type_float_vec(32, lp_native_vector_width);
+   struct lp_type int_type = lp_int_type(type);
+   struct lp_build_context int_bld;
+   lp_build_context_init(&int_bld, gallivm, int_type);
+
+   LLVMValueRef lanes[LP_MAX_VECTOR_LENGTH];
+   for (unsigned i = 0; i < type.length; i++)
+      lanes[i] = lp_build_const_int32(gallivm, i);
+   LLVMValueRef lane = LLVMConstVector(lanes, type.length);
+
+   /* source x of lane i is (x0 + (x + i) * dx) >> 16 */
+   LLVMValueRef lane_x0 =
+      lp_build_add(&int_bld, lp_build_broadcast_scalar(&int_bld, x0),
+                   lp_build_mul(&int_bld, lane,
+                                lp_build_broadcast_scalar(&int_bld, dx)));
+
+   LLVMValueRef full_width =
+      LLVMBuildAnd(builder, width,
+                   lp_build_const_int32(gallivm, ~(type.length - 1)), "");
+
+   struct lp_build_for_loop_state loop;
+   lp_build_for_loop_begin(&loop, gallivm, lp_build_const_int32(gallivm, 0),
+                           LLVMIntSLT, full_width,
+                           lp_build_const_int32(gallivm, type.length));
+   {
+      LLVMValueRef x = loop.counter;
+      LLVMValueRef sx = LLVMBuildMul(builder, x, dx, "");
+      sx = lp_build_add(&int_bld, lane_x0,
+                        lp_build_broadcast_scalar(&int_bld, sx));
+      sx = lp_build_shr_imm(&int_bld, sx, 16);
+
+      /* formats wider than a lane are stored per pixel at x_vec */
+      LLVMValueRef x_vec =
+         lp_build_add(&int_bld, lp_build_broadcast_scalar(&int_bld, x), lane);
+
+      emit_blit_pixels(gallivm, src_desc, dst_desc, type, src_ptr, dst_ptr,
+                       sx, x, x_vec, NULL);
+   }
+   lp_build_for_loop_end(&loop);
+
+   /* remaining pixels, with the lanes past the end masked out */
+   struct lp_build_if_state ifthen;
+   lp_build_if(&ifthen, gallivm,
+               LLVMBuildICmp(builder, LLVMIntSLT, full_width, width, ""));
+   {
+      LLVMValueRef x_vec =
+         lp_build_add(&int_bld, lp_build_broadcast_scalar(&int_bld, full_width),
+                      lane);
+      LLVMValueRef out_of_bounds =
+         lp_build_cmp(&int_bld, PIPE_FUNC_GEQUAL, x_vec,
+                      lp_build_broadcast_scalar(&int_bld, width));
+      LLVMValueRef sx = LLVMBuildMul(builder, full_width, dx, "");
+      sx = lp_build_add(&int_bld, lane_x0,
+                        lp_build_broadcast_scalar(&int_bld, sx));
+      sx = lp_build_shr_imm(&int_bld, sx, 16);
+
+      emit_blit_pixels(gallivm, src_desc, dst_desc, type, src_ptr, dst_ptr,
+                       sx, full_width, x_vec, out_of_bounds);
+   }
+   lp_build_endif(&ifthen);
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, function);
+
+   gallivm_compile_module(gallivm);
+
+   kernel->row = (lp_blit_row_func)gallivm_jit_function(gallivm, function);
+
+   gallivm_free_ir(gallivm);
+
+   if (!kernel->row) {
+      lp_blit_kernel_destroy(kernel);
+      return NULL;
+   }
+
+   return kernel;
+}
+
+
+void
+lp_blit_kernel_destroy(struct lp_blit_kernel *kernel)
+{
+   if (kernel->gallivm)
+      gallivm_destroy(kernel->gallivm);
+   FREE(kernel);
+}
+
+
+void
+llvmpipe_init_blit_kernels(struct llvmpipe_context *lp)
+{
+   lp->blit_kernels = _mesa_hash_table_u64_create(NULL);
+}
+
+
+void
+llvmpipe_destroy_blit_kernels(struct llvmpipe_context *lp)
+{
+   if (!lp->blit_kernels)
+      return;
+
+   hash_table_u64_foreach(lp->blit_kernels, entry)
+      lp_blit_kernel_destroy(entry.data);
+
+   _mesa_hash_table_u64_destroy(lp->blit_kernels);
+   lp->blit_kernels = NULL;
+}
+
+
+static struct lp_blit_kernel *
+get_blit_kernel(struct llvmpipe_context *lp,
+                enum pipe_format src_format,
+                enum pipe_format dst_format)
+{
+   const uint64_t key = ((uint64_t)src_format << 32) | dst_format;
+   struct lp_blit_kernel *kernel =
+      _mesa_hash_table_u64_search(lp->blit_kernels, key);
+   if (kernel)
+      return kernel;
+
+   int64_t t0 = os_time_get();
+
+   kernel = lp_blit_kernel_create(lp->context, src_format, dst_format);
+   if (!kernel)
+      return NULL;
+
+   int64_t t1 = os_time_get();
+   LP_COUNT_ADD(llvm_compile_time, t1 - t0);
+   LP_COUNT_ADD(nr_llvm_compiles, 1);
+   lp_perf_add(&lp->perf, LP_PERF_COUNTER_LLVM_COMPILE_TIME, t1 - t0);
+   lp_perf_add(&lp->perf, LP_PERF_COUNTER_LLVM_COMPILES, 1);
+
+   _mesa_hash_table_u64_insert(lp->blit_kernels, key, kernel);
+
+   return kernel;
+}
+
+
+/** Turn a source box with negative width/height into the box it reads */
+static void
+normalize_box(struct pipe_box *box)
+{
+   if (box->width < 0) {
+      box->x += box->width;
+      box->width = -box->width;
+   }
+   if (box->height < 0) {
+      box->y += box->height;
+      box->height = -box->height;
+   }
+}
+
+
+static bool
+can_blit_with_kernel(const struct pipe_blit_info *info)
+{
+   const struct pipe_resource *src = info->src.resource;
+   const struct pipe_resource *dst = info->dst.resource;
+
+   if (info->scissor_enable ||
+       info->num_window_rectangles ||
+       info->alpha_blend ||
+       info->mask != PIPE_MASK_RGBA)
+      return false;
+
+   if (src->target == PIPE_BUFFER || dst->target == PIPE_BUFFER ||
+       src->nr_samples > 1 || dst->nr_samples > 1)
+      return false;
+
+   /* src == dst blits may overlap */
+   if (src == dst)
+      return false;
+
+   if (util_format_get_blocksize(info->src.format) !=
+       util_format_get_blocksize(src->format) ||
+       util_format_get_blocksize(info->dst.format) !=
+       util_format_get_blocksize(dst->format))
+      return false;
+
+   if (info->dst.box.width <= 0 ||
+       info->dst.box.height <= 0 ||
+       info->dst.box.depth <= 0 ||
+       info->src.box.width == 0 ||
+       info->src.box.height == 0 ||
+       info->src.box.depth != info->dst.box.depth)
+      return false;
+
+   /* the kernels only do nearest filtering */
+   if (info->filter != PIPE_TEX_FILTER_NEAREST &&
+       (abs(info->src.box.width) != info->dst.box.width ||
+        abs(info->src.box.height) != info->dst.box.height))
+      return false;
+
+   /* keep the 16.16 fixed point coordinates from overflowing */
+   if (abs(info->src.box.width) >= (1 << 15) ||
+       abs(info->src.box.height) >= (1 << 15))
+      return false;
+
+   /* no clamping of the source coordinates */
+   struct pipe_box src_box = info->src.box;
+   normalize_box(&src_box);
+   if (src_box.x < 0 || src_box.y < 0 || src_box.z < 0 ||
+       src_box.x + src_box.width >
+          u_minify(src->width0, info->src.level) ||
+       src_box.y + src_box.height >
+          u_minify(src->height0, info->src.level) ||
+       src_box.z + src_box.depth >
+          util_num_layers(src, info->src.level))
+      return false;
+
+   return lp_blit_kernel_supported(info->src.format, info->dst.format);
+}
+
+
+struct lp_blit_job
+{
+   lp_blit_row_func row;
+
+   const uint8_t *src;
+   unsigned src_stride;
+   uintptr_t src_layer_stride;
+
+   uint8_t *dst;
+   unsigned dst_stride;
+   uintptr_t dst_layer_stride;
+
+   int32_t width;
+   int32_t height;
+   unsigned num_bands;
+
+   /* 16.16 fixed point source coordinates */
+   int32_t x0, dx;
+   int32_t y0, dy;
+};
+
+
+static void
+blit_band(void *data, int iter_idx, struct lp_cs_local_mem *lmem)
+{
+   const struct lp_blit_job *job = data;
+   const unsigned layer = iter_idx / job->num_bands;
+   const unsigned band = iter_idx % job->num_bands;
+   const int y_start = band * LP_BLIT_BAND_HEIGHT;
+   const int y_end = MIN2(y_start + LP_BLIT_BAND_HEIGHT, job->height);
+   const uint8_t *src = job->src + layer * job->src_layer_stride;
+   uint8_t *dst = job->dst + layer * job->dst_layer_stride +
+                  y_start * job->dst_stride;
+
+   for (int y = y_start; y < y_end; y++) {
+      const int sy = (job->y0 + y * job->dy) >> 16;
+      job->row(src + sy * job->src_stride, dst,
+               job->width, job->x0, job->dx);
+      dst += job->dst_stride;
+   }
+}
+
+
+static void
+setup_fixed_point(int src_size, int dst_size, int32_t *start, int32_t *step)
+{
+   const int32_t abs_step = (abs(src_size) << 16) / dst_size;
+
+   /* sample at the destination pixel centers */
+   if (src_size > 0) {
+      *start = abs_step / 2;
+      *step = abs_step;
+   } else {
+      *start = (-src_size << 16) - abs_step / 2;
+      *step = -abs_step;
+   }
+}
+
+
+/**
+ * Do a blit with a JIT blit kernel if possible.
+ * \return false if the blit has to be done some other way
+ */
+bool
+llvmpipe_blit_with_kernel(struct llvmpipe_context *lp,
+                          const struct pipe_blit_info *info)
+{
+   struct pipe_context *pipe = &lp->pipe;
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+
+   if (!lp->blit_kernels || !can_blit_with_kernel(info))
+      return false;
+
+   struct lp_blit_kernel *kernel =
+      get_blit_kernel(lp, info->src.format, info->dst.format);
+   if (!kernel)
+      return false;
+
+   struct pipe_box src_box = info->src.box;
+   normalize_box(&src_box);
+
+   struct pipe_transfer *src_transfer, *dst_transfer;
+   const uint8_t *src_map =
+      pipe->texture_map(pipe, info->src.resource, info->src.level,
+                        PIPE_MAP_READ, &src_box, &src_transfer);
+   if (!src_map)
+      return false;
+
+   uint8_t *dst_map =
+      pipe->texture_map(pipe, info->dst.resource, info->dst.level,
+                        PIPE_MAP_WRITE, &info->dst.box, &dst_transfer);
+   if (!dst_map) {
+      pipe->texture_unmap(pipe, src_transfer);
+      return false;
+   }
+
+   struct lp_blit_job job;
+   job.row = kernel->row;
+   job.src = src_map;
+   job.src_stride = src_transfer->stride;
+   job.src_layer_stride = src_transfer->layer_stride;
+   job.dst = dst_map;
+   job.dst_stride = dst_transfer->stride;
+   job.dst_layer_stride = dst_transfer->layer_stride;
+   job.width = info->dst.box.width;
+   job.height = info->dst.box.height;
+   job.num_bands = DIV_ROUND_UP(job.height, LP_BLIT_BAND_HEIGHT);
+   setup_fixed_point(info->src.box.width, info->dst.box.width,
+                     &job.x0, &job.dx);
+   setup_fixed_point(info->src.box.height, info->dst.box.height,
+                     &job.y0, &job.dy);
+
+   const int num_tasks = job.num_bands * info->dst.box.depth;
+   struct lp_cs_tpool_task *task = NULL;
+   if (num_tasks > 1 && screen->cs_tpool->num_threads > 0) {
+      mtx_lock(&screen->cs_mutex);
+      task = lp_cs_tpool_queue_task(screen->cs_tpool, blit_band, &job,
+                                    num_tasks);
+      mtx_unlock(&screen->cs_mutex);
+   }
+
+   if (task) {
+      lp_cs_tpool_wait_for_task(screen->cs_tpool, &task);
+   } else {
+      /* one band, no worker threads or the task couldn't be allocated */
+      for (int i = 0; i < num_tasks; i++)
+         blit_band(&job, i, NULL);
+   }
+
+   pipe->texture_unmap(pipe, dst_transfer);
+   pipe->texture_unmap(pipe, src_transfer);
+
+   lp_perf_add(&lp->perf, LP_PERF_COUNTER_KERNEL_BLITS, 1);
+
+   return true;
+}
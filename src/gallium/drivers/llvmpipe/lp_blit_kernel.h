@@ -0,0 +1,84 @@
+/*
+ * Copyright © 2024 Mesa contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * JIT compiled kernels for format converting and scaling blits.
+ *
+ * A kernel converts one row of pixels from src_format to dst_format with
+ * nearest filtering: destination pixel i reads source pixel
+ * (x0 + i * dx) >> 16, with x0 and dx in 16.16 fixed point.  Rows, layers
+ * and the split of the work over threads are handled by the caller.
+ */
+
+#ifndef LP_BLIT_KERNEL_H
+#define LP_BLIT_KERNEL_H
+
+#include "util/format/u_formats.h"
+#include "gallivm/lp_bld.h"
+
+
+struct llvmpipe_context;
+struct pipe_blit_info;
+struct gallivm_state;
+
+
+typedef void
+(*lp_blit_row_func)(const uint8_t *src, uint8_t *dst,
+                    int32_t width, int32_t x0, int32_t dx);
+
+
+struct lp_blit_kernel
+{
+   enum pipe_format src_format;
+   enum pipe_format dst_format;
+
+   struct gallivm_state *gallivm;
+   lp_blit_row_func row;
+};
+
+
+bool
+lp_blit_kernel_supported(enum pipe_format src_format,
+                         enum pipe_format dst_format);
+
+struct lp_blit_kernel *
+lp_blit_kernel_create(LLVMContextRef context,
+                      enum pipe_format src_format,
+                      enum pipe_format dst_format);
+
+void
+lp_blit_kernel_destroy(struct lp_blit_kernel *kernel);
+
+
+void
+llvmpipe_init_blit_kernels(struct llvmpipe_context *lp);
+
+void
+llvmpipe_destroy_blit_kernels(struct llvmpipe_context *lp);
+
+bool
+llvmpipe_blit_with_kernel(struct llvmpipe_context *lp,
+                          const struct pipe_blit_info *info);
+
+
+#endif /* LP_BLIT_KERNEL_H */
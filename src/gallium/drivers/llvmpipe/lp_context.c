@@ -38,6 +38,7 @@
 #include "util/u_memory.h"
 #include "util/list.h"
 #include "util/u_upload_mgr.h"
+#include "lp_blit_kernel.h"
 #include "lp_clear.h"
 #include "lp_context.h"
 #include "lp_flush.h"
@@ -105,6 +106,8 @@ llvmpipe_destroy(struct pipe_context *pipe)
 
    lp_delete_setup_variants(llvmpipe);
 
+   llvmpipe_destroy_blit_kernels(llvmpipe);
+
    llvmpipe_sampler_matrix_destroy(llvmpipe);
 
 #ifndef USE_GLOBAL_LLVM_CONTEXT
@@ -269,6 +272,8 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    LLVMContextSetOpaquePointers(llvmpipe->context, false);
 #endif
 
+   llvmpipe_init_blit_kernels(llvmpipe);
+
    /*
     * Create drawing context and plug our rendering stage into it.
     */
@@ -38,6 +38,7 @@
 
 #include "lp_tex_sample.h"
 #include "lp_jit.h"
+#include "lp_perf.h"
 #include "lp_texture_handle.h"
 #include "lp_setup.h"
 #include "lp_state_fs.h"
@@ -55,6 +56,7 @@ struct lp_blend_state;
 struct lp_setup_context;
 struct lp_setup_variant;
 struct lp_velems_state;
+struct hash_table_u64;
 
 struct llvmpipe_context {
    struct pipe_context pipe;  /**< base class */
@@ -117,6 +119,9 @@ struct llvmpipe_context {
 
    bool queries_disabled;
 
+   /** Always-on counters, read by the driver specific queries */
+   struct lp_perf_counters perf;
+
    uint64_t dirty; /**< Mask of LP_NEW_x flags */
    unsigned cs_dirty; /**< Mask of LP_CSNEW_x flags */
    /** Mapped vertex buffers */
@@ -192,6 +197,9 @@ struct llvmpipe_context {
    /** The LLVMContext to use for LLVM related work */
    LLVMContextRef context;
 
+   /** JIT blit kernels, keyed by (src_format << 32) | dst_format */
+   struct hash_table_u64 *blit_kernels;
+
    int max_global_buffers;
    struct pipe_resource **global_buffers;
 
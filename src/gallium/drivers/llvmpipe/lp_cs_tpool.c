@@ -32,6 +32,14 @@
 #include "util/u_memory.h"
 #include "lp_cs_tpool.h"
 
+static void
+lp_cs_local_mem_fini(struct lp_cs_local_mem *lmem)
+{
+   FREE(lmem->local_mem_ptr);
+   /* allocated by the JIT code through the gallivm coroutine malloc hook */
+   os_free_aligned(lmem->coro_mem_ptr);
+}
+
 static int
 lp_cs_tpool_worker(void *data)
 {
@@ -79,7 +87,7 @@ lp_cs_tpool_worker(void *data)
          cnd_broadcast(&task->finish);
    }
    mtx_unlock(&pool->m);
-   FREE(lmem.local_mem_ptr);
+   lp_cs_local_mem_fini(&lmem);
    return 0;
 }
 
@@ -139,7 +147,7 @@ lp_cs_tpool_queue_task(struct lp_cs_tpool *pool,
       for (unsigned t = 0; t < num_iters; t++) {
          work(data, t, &lmem);
       }
-      FREE(lmem.local_mem_ptr);
+      lp_cs_local_mem_fini(&lmem);
       return NULL;
    }
    task = CALLOC_STRUCT(lp_cs_tpool_task);
@@ -54,6 +54,10 @@ struct lp_cs_tpool {
 struct lp_cs_local_mem {
    unsigned local_size;
    void *local_mem_ptr;
+
+   /* compute shader coroutine frames, see lp_jit_cs_thread_data */
+   unsigned coro_mem_size;
+   void *coro_mem_ptr;
 };
 
 typedef void (*lp_cs_tpool_task_func)(void *data, int iter_idx, struct lp_cs_local_mem *lmem);
@@ -258,6 +258,8 @@ lp_jit_create_cs_types(struct lp_compute_shader_variant *lp)
       elem_types[LP_JIT_CS_THREAD_DATA_SHARED] = LLVMPointerType(LLVMInt32TypeInContext(lc), 0);
 
       elem_types[LP_JIT_CS_THREAD_DATA_PAYLOAD] = LLVMPointerType(LLVMInt8TypeInContext(lc), 0);
+      elem_types[LP_JIT_CS_THREAD_DATA_CORO_MEM] = LLVMPointerType(LLVMInt8TypeInContext(lc), 0);
+      elem_types[LP_JIT_CS_THREAD_DATA_CORO_MEM_SIZE] = LLVMInt32TypeInContext(lc);
       thread_data_type = LLVMStructTypeInContext(lc, elem_types,
                                                  ARRAY_SIZE(elem_types), 0);
 
@@ -300,6 +300,10 @@ struct lp_jit_cs_thread_data
    struct lp_build_format_cache *cache;
    void *shared;
    void *payload;
+
+   /* coroutine frames, kept by the worker thread between workgroups */
+   void *coro_mem;
+   uint32_t coro_mem_size;
 };
 
 
@@ -307,6 +311,8 @@ enum {
    LP_JIT_CS_THREAD_DATA_CACHE = 0,
    LP_JIT_CS_THREAD_DATA_SHARED = 1,
    LP_JIT_CS_THREAD_DATA_PAYLOAD = 2,
+   LP_JIT_CS_THREAD_DATA_CORO_MEM = 3,
+   LP_JIT_CS_THREAD_DATA_CORO_MEM_SIZE = 4,
    LP_JIT_CS_THREAD_DATA_COUNT
 };
 
@@ -320,6 +326,12 @@ enum {
 #define lp_jit_cs_thread_data_payload(_gallivm, _type, _ptr) \
    lp_build_struct_get2(_gallivm, _type, _ptr, LP_JIT_CS_THREAD_DATA_PAYLOAD, "payload")
 
+#define lp_jit_cs_thread_data_coro_mem(_gallivm, _type, _ptr) \
+   lp_build_struct_get_ptr2(_gallivm, _type, _ptr, LP_JIT_CS_THREAD_DATA_CORO_MEM, "coro_mem")
+
+#define lp_jit_cs_thread_data_coro_mem_size(_gallivm, _type, _ptr) \
+   lp_build_struct_get_ptr2(_gallivm, _type, _ptr, LP_JIT_CS_THREAD_DATA_CORO_MEM_SIZE, "coro_mem_size")
+
 
 struct lp_jit_cs_context
 {
@@ -68,6 +68,9 @@
 
 #define LP_MAX_THREADS 32
 
+/** Max number of threads binning a single vertex batch */
+#define LP_MAX_BIN_THREADS 8
+
 
 /**
  * Max number of shader variants (for all shaders combined,
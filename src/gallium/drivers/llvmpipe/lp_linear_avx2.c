@@ -0,0 +1,273 @@
+/*
+ * Copyright © 2024 Mesa contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/**
+ * @file
+ * AVX2 versions of the linear path's bilinear texel fetch rows.
+ *
+ * These are built in a separate library with -mavx2 and are only called
+ * when the CPU supports AVX2.  They process eight bgra8 pixels per
+ * iteration and produce exactly the same results as the SSE2 code in
+ * lp_linear_sampler.c, including for the 1-4 pixels at the end of a row.
+ */
+
+
+#include "util/detect.h"
+
+#if DETECT_ARCH_SSE
+
+#include <immintrin.h>
+
+#include "util/u_sse.h"
+
+#include "lp_linear_avx2.h"
+
+
+/* 256-bit version of util_sse2_lerp_epi16() */
+static inline __m256i
+lerp_epi16_avx2(__m256i w, __m256i a, __m256i b)
+{
+   __m256i res;
+
+   res = _mm256_sub_epi16(b, a);
+   res = _mm256_mullo_epi16(res, w);
+   res = _mm256_srli_epi16(res, 8);
+   res = _mm256_add_epi8(res, a);
+
+   return res;
+}
+
+
+/* 256-bit version of util_sse2_lerp_epi8_fixed88() */
+static inline __m256i
+lerp_epi8_fixed88_avx2(__m256i src0, __m256i src1,
+                       __m256i weight_lo, __m256i weight_hi)
+{
+   const __m256i zero = _mm256_setzero_si256();
+   __m256i dst_lo, dst_hi;
+
+   dst_lo = lerp_epi16_avx2(weight_lo,
+                            _mm256_unpacklo_epi8(src0, zero),
+                            _mm256_unpacklo_epi8(src1, zero));
+   dst_hi = lerp_epi16_avx2(weight_hi,
+                            _mm256_unpackhi_epi8(src0, zero),
+                            _mm256_unpackhi_epi8(src1, zero));
+
+   return _mm256_packus_epi16(dst_lo, dst_hi);
+}
+
+
+/* Bilinear filter of eight pixels.  ws and wt hold one 0.8 weight per
+ * 32-bit pixel; unpack, pack and shuffle all work within 128-bit lanes so
+ * each weight lines up with its own pixel.
+ */
+static inline __m256i
+lerp_2d_avx2(__m256i s0t0, __m256i s1t0, __m256i s0t1, __m256i s1t1,
+             __m256i ws, __m256i wt)
+{
+   ws = _mm256_or_si256(ws, _mm256_slli_epi32(ws, 16));
+   wt = _mm256_or_si256(wt, _mm256_slli_epi32(wt, 16));
+
+   const __m256i wsl = _mm256_shuffle_epi32(ws, _MM_SHUFFLE(1,1,0,0));
+   const __m256i wsh = _mm256_shuffle_epi32(ws, _MM_SHUFFLE(3,3,2,2));
+   const __m256i wtl = _mm256_shuffle_epi32(wt, _MM_SHUFFLE(1,1,0,0));
+   const __m256i wth = _mm256_shuffle_epi32(wt, _MM_SHUFFLE(3,3,2,2));
+
+   __m256i s0 = lerp_epi8_fixed88_avx2(s0t0, s0t1, wtl, wth);
+   __m256i s1 = lerp_epi8_fixed88_avx2(s1t0, s1t1, wtl, wth);
+
+   return lerp_epi8_fixed88_avx2(s0, s1, wsl, wsh);
+}
+
+
+/* 128-bit version of the above for the last pixels of a row. */
+static inline __m128i
+lerp_2d_sse(__m128i s0t0, __m128i s1t0, __m128i s0t1, __m128i s1t1,
+            __m128i ws, __m128i wt)
+{
+   ws = _mm_or_si128(ws, _mm_slli_epi32(ws, 16));
+   wt = _mm_or_si128(wt, _mm_slli_epi32(wt, 16));
+
+   const __m128i wsl = _mm_shuffle_epi32(ws, _MM_SHUFFLE(1,1,0,0));
+   const __m128i wsh = _mm_shuffle_epi32(ws, _MM_SHUFFLE(3,3,2,2));
+   const __m128i wtl = _mm_shuffle_epi32(wt, _MM_SHUFFLE(1,1,0,0));
+   const __m128i wth = _mm_shuffle_epi32(wt, _MM_SHUFFLE(3,3,2,2));
+
+   __m128i s0 = util_sse2_lerp_epi8_fixed88(s0t0, s0t1, &wtl, &wth);
+   __m128i s1 = util_sse2_lerp_epi8_fixed88(s1t0, s1t1, &wtl, &wth);
+
+   return util_sse2_lerp_epi8_fixed88(s0, s1, &wsl, &wsh);
+}
+
+
+void
+lp_linear_lerp_row_avx2(uint32_t * restrict dst,
+                        const uint32_t * restrict src0,
+                        const uint32_t * restrict src1,
+                        int width, int weight)
+{
+   const __m256i w8 = _mm256_set1_epi16(weight);
+   const __m128i w4 = _mm_set1_epi16(weight);
+   int i;
+
+   for (i = 0; i + 4 < width; i += 8) {
+      __m256i a = _mm256_loadu_si256((const __m256i *)&src0[i]);
+      __m256i b = _mm256_loadu_si256((const __m256i *)&src1[i]);
+
+      _mm256_storeu_si256((__m256i *)&dst[i],
+                          lerp_epi8_fixed88_avx2(a, b, w8, w8));
+   }
+
+   if (i < width) {
+      __m128i a = _mm_loadu_si128((const __m128i *)&src0[i]);
+      __m128i b = _mm_loadu_si128((const __m128i *)&src1[i]);
+
+      _mm_storeu_si128((__m128i *)&dst[i],
+                       util_sse2_lerp_epi8_fixed88(a, b, &w4, &w4));
+   }
+}
+
+
+void
+lp_linear_fetch_linear_row_avx2(uint32_t * restrict row,
+                                const uint32_t *data, int stride,
+                                int s, int t, int dsdx, int dtdx,
+                                int width)
+{
+   const __m256i ramp = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+   const __m256i mask = _mm256_set1_epi32(0xff);
+   const __m256i stride8 = _mm256_set1_epi32(stride);
+   __m256i s8 = _mm256_add_epi32(_mm256_set1_epi32(s),
+                                 _mm256_mullo_epi32(ramp, _mm256_set1_epi32(dsdx)));
+   __m256i t8 = _mm256_add_epi32(_mm256_set1_epi32(t),
+                                 _mm256_mullo_epi32(ramp, _mm256_set1_epi32(dtdx)));
+   const __m256i dsdx8 = _mm256_set1_epi32(8 * dsdx);
+   const __m256i dtdx8 = _mm256_set1_epi32(8 * dtdx);
+   int i;
+
+   for (i = 0; i + 4 < width; i += 8) {
+      __m256i addr = _mm256_add_epi32(
+         _mm256_mullo_epi32(_mm256_srai_epi32(t8, 16), stride8),
+         _mm256_srai_epi32(s8, 16));
+      const int *src0 = (const int *)data;
+      const int *src1 = (const int *)(data + stride);
+
+      __m256i s0t0 = _mm256_i32gather_epi32(src0, addr, 4);
+      __m256i s1t0 = _mm256_i32gather_epi32(src0 + 1, addr, 4);
+      __m256i s0t1 = _mm256_i32gather_epi32(src1, addr, 4);
+      __m256i s1t1 = _mm256_i32gather_epi32(src1 + 1, addr, 4);
+
+      __m256i ws = _mm256_and_si256(_mm256_srli_epi32(s8, 8), mask);
+      __m256i wt = _mm256_and_si256(_mm256_srli_epi32(t8, 8), mask);
+
+      _mm256_storeu_si256((__m256i *)&row[i],
+                          lerp_2d_avx2(s0t0, s1t0, s0t1, s1t1, ws, wt));
+
+      s8 = _mm256_add_epi32(s8, dsdx8);
+      t8 = _mm256_add_epi32(t8, dtdx8);
+   }
+
+   if (i < width) {
+      __m128i s4 = _mm256_castsi256_si128(s8);
+      __m128i t4 = _mm256_castsi256_si128(t8);
+      __m128i addr = _mm_add_epi32(
+         _mm_mullo_epi32(_mm_srai_epi32(t4, 16), _mm_set1_epi32(stride)),
+         _mm_srai_epi32(s4, 16));
+      const int *src0 = (const int *)data;
+      const int *src1 = (const int *)(data + stride);
+
+      __m128i s0t0 = _mm_i32gather_epi32(src0, addr, 4);
+      __m128i s1t0 = _mm_i32gather_epi32(src0 + 1, addr, 4);
+      __m128i s0t1 = _mm_i32gather_epi32(src1, addr, 4);
+      __m128i s1t1 = _mm_i32gather_epi32(src1 + 1, addr, 4);
+
+      __m128i ws = _mm_and_si128(_mm_srli_epi32(s4, 8), _mm_set1_epi32(0xff));
+      __m128i wt = _mm_and_si128(_mm_srli_epi32(t4, 8), _mm_set1_epi32(0xff));
+
+      _mm_storeu_si128((__m128i *)&row[i],
+                       lerp_2d_sse(s0t0, s1t0, s0t1, s1t1, ws, wt));
+   }
+}
+
+
+void
+lp_linear_fetch_clamp_linear_row_avx2(uint32_t * restrict row,
+                                      const uint32_t *data, int stride,
+                                      int tex_width, int tex_height,
+                                      int s, int t, int dsdx, int dtdx,
+                                      int width)
+{
+   const __m256i ramp = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+   const __m256i mask = _mm256_set1_epi32(0xff);
+   const __m256i zero = _mm256_setzero_si256();
+   const __m256i one = _mm256_set1_epi32(1);
+   const __m256i stride8 = _mm256_set1_epi32(stride);
+   const __m256i max_s = _mm256_set1_epi32(tex_width - 1);
+   const __m256i max_t = _mm256_set1_epi32(tex_height - 1);
+   __m256i s8 = _mm256_add_epi32(_mm256_set1_epi32(s),
+                                 _mm256_mullo_epi32(ramp, _mm256_set1_epi32(dsdx)));
+   __m256i t8 = _mm256_add_epi32(_mm256_set1_epi32(t),
+                                 _mm256_mullo_epi32(ramp, _mm256_set1_epi32(dtdx)));
+   const __m256i dsdx8 = _mm256_set1_epi32(8 * dsdx);
+   const __m256i dtdx8 = _mm256_set1_epi32(8 * dtdx);
+   const int *src = (const int *)data;
+
+   /* Coordinates are always clamped, so whole vectors can be fetched even
+    * for the last pixels of a row.
+    */
+   for (int i = 0; i < width; i += 8) {
+      __m256i si = _mm256_srai_epi32(s8, 16);
+      __m256i ti = _mm256_srai_epi32(t8, 16);
+
+      __m256i cs0 = _mm256_min_epi32(_mm256_max_epi32(si, zero), max_s);
+      __m256i cs1 = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(si, one),
+                                                      zero), max_s);
+      __m256i ct0 = _mm256_min_epi32(_mm256_max_epi32(ti, zero), max_t);
+      __m256i ct1 = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(ti, one),
+                                                      zero), max_t);
+
+      __m256i row0 = _mm256_mullo_epi32(ct0, stride8);
+      __m256i row1 = _mm256_mullo_epi32(ct1, stride8);
+
+      __m256i s0t0 = _mm256_i32gather_epi32(src, _mm256_add_epi32(row0, cs0), 4);
+      __m256i s1t0 = _mm256_i32gather_epi32(src, _mm256_add_epi32(row0, cs1), 4);
+      __m256i s0t1 = _mm256_i32gather_epi32(src, _mm256_add_epi32(row1, cs0), 4);
+      __m256i s1t1 = _mm256_i32gather_epi32(src, _mm256_add_epi32(row1, cs1), 4);
+
+      __m256i ws = _mm256_and_si256(_mm256_srli_epi32(s8, 8), mask);
+      __m256i wt = _mm256_and_si256(_mm256_srli_epi32(t8, 8), mask);
+
+      __m256i res = lerp_2d_avx2(s0t0, s1t0, s0t1, s1t1, ws, wt);
+
+      if (width - i > 4)
+         _mm256_storeu_si256((__m256i *)&row[i], res);
+      else
+         _mm_storeu_si128((__m128i *)&row[i], _mm256_castsi256_si128(res));
+
+      s8 = _mm256_add_epi32(s8, dsdx8);
+      t8 = _mm256_add_epi32(t8, dtdx8);
+   }
+}
+
+#endif /* DETECT_ARCH_SSE */
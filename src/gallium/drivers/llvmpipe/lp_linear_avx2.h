@@ -0,0 +1,63 @@
+/*
+ * Copyright © 2024 Mesa contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef LP_LINEAR_AVX2_H
+#define LP_LINEAR_AVX2_H
+
+#include <stdint.h>
+
+#include "util/compiler.h"
+
+
+/*
+ * AVX2 row kernels for the linear path samplers.  Only call these if
+ * util_get_cpu_caps()->has_avx2 is set.
+ *
+ * Rows are bgra8 pixels, texture coordinates and weights are 16.16 fixed
+ * point and strides are in pixels.  Like the SSE2 code they replace, they
+ * may write up to 3 pixels past width.
+ */
+
+/* dst = src0 + (src1 - src0) * weight / 256 */
+void
+lp_linear_lerp_row_avx2(uint32_t * restrict dst,
+                        const uint32_t * restrict src0,
+                        const uint32_t * restrict src1,
+                        int width, int weight);
+
+/* Bilinear fetch of a row, all texels must be inside the texture */
+void
+lp_linear_fetch_linear_row_avx2(uint32_t * restrict row,
+                                const uint32_t *data, int stride,
+                                int s, int t, int dsdx, int dtdx,
+                                int width);
+
+/* Bilinear fetch of a row with clamp to edge wrapping */
+void
+lp_linear_fetch_clamp_linear_row_avx2(uint32_t * restrict row,
+                                      const uint32_t *data, int stride,
+                                      int tex_width, int tex_height,
+                                      int s, int t, int dsdx, int dtdx,
+                                      int width);
+
+#endif /* LP_LINEAR_AVX2_H */
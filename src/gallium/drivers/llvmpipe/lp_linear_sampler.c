@@ -38,6 +38,7 @@
 #include "lp_debug.h"
 #include "lp_state_fs.h"
 #include "lp_linear_priv.h"
+#include "lp_linear_avx2.h"
 
 #if DETECT_ARCH_SSE
 
@@ -270,6 +271,11 @@ fetch_axis_aligned_linear_bgra(struct lp_linear_elem *elem)
 
    const uint32_t * restrict src_row1 = fetch_and_stretch_bgra_row(samp, y + 1);
 
+   if (util_get_cpu_caps()->has_avx2) {
+      lp_linear_lerp_row_avx2(row, src_row0, src_row1, width, w);
+      return row;
+   }
+
    __m128i wt = _mm_set1_epi16(w);
 
    /* Combine the two rows using a constant weight.
@@ -302,6 +308,14 @@ fetch_linear_bgra(struct lp_linear_elem *elem)
    int s = samp->s;
    int t = samp->t;
 
+   if (util_get_cpu_caps()->has_avx2) {
+      lp_linear_fetch_linear_row_avx2(row, data, stride,
+                                      s, t, dsdx, dtdx, width);
+      samp->s += samp->dsdy;
+      samp->t += samp->dtdy;
+      return row;
+   }
+
    for (int i = 0; i < width; i += 4) {
       union m128i si0, si1, si2, si3, ws, wt;
       __m128i si02, si13;
@@ -358,6 +372,15 @@ fetch_clamp_linear_bgra(struct lp_linear_elem *elem)
    int s = samp->s;
    int t = samp->t;
 
+   if (util_get_cpu_caps()->has_avx2) {
+      lp_linear_fetch_clamp_linear_row_avx2(row, data, stride,
+                                            texture->width, texture->height,
+                                            s, t, dsdx, dtdx, width);
+      samp->s += samp->dsdy;
+      samp->t += samp->dtdy;
+      return row;
+   }
+
    /* width, height, stride (in pixels) must be smaller than 32768 */
    __m128i dsdx4, dtdx4, s4, t4, stride4, w4, h4, zero, one;
    s4 = _mm_set1_epi32(s);
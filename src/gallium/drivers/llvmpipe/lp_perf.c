@@ -34,6 +34,33 @@
 struct lp_counters lp_count;
 
 
+static const char *lp_perf_counter_names[LP_PERF_COUNTER_COUNT] = {
+   [LP_PERF_COUNTER_SCENES] = "scenes",
+   [LP_PERF_COUNTER_TRIANGLES] = "triangles-binned",
+   [LP_PERF_COUNTER_TILES] = "tiles",
+   [LP_PERF_COUNTER_BLIT_TILES] = "tiles-blit",
+   [LP_PERF_COUNTER_LINEAR_TILES] = "tiles-linear",
+   [LP_PERF_COUNTER_TILE_CLEARS] = "tile-clears",
+   [LP_PERF_COUNTER_KERNEL_BLITS] = "kernel-blits",
+   [LP_PERF_COUNTER_LLVM_COMPILES] = "llvm-compiles",
+   [LP_PERF_COUNTER_LLVM_COMPILE_TIME] = "llvm-compile-time",
+   [LP_PERF_COUNTER_JIT_CODE_USED] = "jit-code-used",
+   [LP_PERF_COUNTER_JIT_CODE_MAPPED] = "jit-code-mapped",
+   [LP_PERF_COUNTER_JIT_CODE_HUGE_PAGES] = "jit-code-huge-pages",
+   [LP_PERF_COUNTER_BIN_TIME] = "bin-time",
+   [LP_PERF_COUNTER_RAST_TIME] = "rast-time",
+   [LP_PERF_COUNTER_SHADE_TIME] = "shade-time",
+};
+
+
+const char *
+lp_perf_counter_name(enum lp_perf_counter_id id)
+{
+   assert(id < LP_PERF_COUNTER_COUNT);
+   return lp_perf_counter_names[id];
+}
+
+
 void
 lp_reset_counters(void)
 {
@@ -52,6 +79,7 @@ lp_print_counters(void)
       debug_printf("llvmpipe: nr_culled_triangles:          %9u\n", lp_count.nr_culled_tris);
       debug_printf("llvmpipe: nr_rectangles:                %9u\n", lp_count.nr_rects);
       debug_printf("llvmpipe: nr_culled_rectangles:         %9u\n", lp_count.nr_culled_rects);
+      debug_printf("llvmpipe: nr_depth_culled_64:           %9u\n", lp_count.nr_depth_culled_64);
 
       total_64 = (lp_count.nr_empty_64 + 
                   lp_count.nr_fully_covered_64 +
@@ -34,6 +34,64 @@
 #define LP_PERF_H
 
 #include "util/compiler.h"
+#include "util/u_atomic.h"
+
+
+/**
+ * Counters which are always compiled in.  They are accumulated per
+ * context when a scene has been rasterized (or, for the shader compile
+ * counters, when the compile finishes) and exposed as driver queries so
+ * that the HUD, GL_AMD_performance_monitor and Perfetto can sample them
+ * in release builds.
+ *
+ * The rasterizer threads count into lp_rasterizer_task::counters without
+ * atomics and only flush them once per scene.
+ */
+enum lp_perf_counter_id
+{
+   LP_PERF_COUNTER_SCENES,
+   LP_PERF_COUNTER_TRIANGLES,     /**< triangles binned */
+   LP_PERF_COUNTER_TILES,         /**< non-empty tiles rasterized */
+   LP_PERF_COUNTER_BLIT_TILES,    /**< tiles taking the blit fast path */
+   LP_PERF_COUNTER_LINEAR_TILES,  /**< tiles taking the linear rasterizer */
+   LP_PERF_COUNTER_TILE_CLEARS,   /**< color tile clears */
+   LP_PERF_COUNTER_KERNEL_BLITS,  /**< blits done by a JIT blit kernel */
+   LP_PERF_COUNTER_LLVM_COMPILES,
+   LP_PERF_COUNTER_LLVM_COMPILE_TIME,  /**< microseconds */
+   LP_PERF_COUNTER_JIT_CODE_USED,    /**< bytes, current level */
+   LP_PERF_COUNTER_JIT_CODE_MAPPED,  /**< bytes, current level */
+   LP_PERF_COUNTER_JIT_CODE_HUGE_PAGES,  /**< bytes, current level */
+   LP_PERF_COUNTER_BIN_TIME,      /**< microseconds, wall clock */
+   LP_PERF_COUNTER_RAST_TIME,     /**< microseconds, wall clock */
+   LP_PERF_COUNTER_SHADE_TIME,    /**< microseconds, summed over threads */
+   LP_PERF_COUNTER_COUNT
+};
+
+
+struct lp_perf_counters
+{
+   uint64_t value[LP_PERF_COUNTER_COUNT];
+};
+
+
+static inline void
+lp_perf_add(struct lp_perf_counters *perf, enum lp_perf_counter_id id,
+            uint64_t value)
+{
+   p_atomic_add(&perf->value[id], value);
+}
+
+
+static inline uint64_t
+lp_perf_read(const struct lp_perf_counters *perf, enum lp_perf_counter_id id)
+{
+   return p_atomic_read(&perf->value[id]);
+}
+
+
+extern const char *
+lp_perf_counter_name(enum lp_perf_counter_id id);
+
 
 /**
  * Various counters
@@ -44,6 +102,7 @@ struct lp_counters
    unsigned nr_culled_tris;
    unsigned nr_rects;
    unsigned nr_culled_rects;
+   unsigned nr_depth_culled_64;
    unsigned nr_empty_64;
    unsigned nr_fully_covered_64;
    unsigned nr_partially_covered_64;
@@ -31,6 +31,7 @@
  */
 
 #include "draw/draw_context.h"
+#include "gallivm/lp_bld_code_arena.h"
 #include "pipe/p_defines.h"
 #include "util/u_memory.h"
 #include "util/os_time.h"
@@ -50,12 +51,108 @@ llvmpipe_query(struct pipe_query *p)
 }
 
 
+static inline bool
+is_perf_query(unsigned type)
+{
+   return type >= PIPE_QUERY_DRIVER_SPECIFIC &&
+          type < PIPE_QUERY_DRIVER_SPECIFIC + LP_PERF_COUNTER_COUNT;
+}
+
+
+/**
+ * The perf counters are only accumulated once a scene has been
+ * rasterized, so the result covers the scenes finished between begin and
+ * the wait on the query fence.  Work from other scenes that finish in the
+ * same window is included too; this is good enough for the HUD.
+ *
+ * The JIT code memory counters are levels of the process wide code arena
+ * rather than events, they report the current value.
+ */
+static uint64_t
+perf_query_value(struct llvmpipe_context *llvmpipe,
+                 const struct llvmpipe_query *pq)
+{
+   enum lp_perf_counter_id id = pq->type - PIPE_QUERY_DRIVER_SPECIFIC;
+   struct lp_code_arena_stats stats;
+
+   switch (id) {
+   case LP_PERF_COUNTER_JIT_CODE_USED:
+      lp_code_arena_get_stats(&stats);
+      return stats.used;
+   case LP_PERF_COUNTER_JIT_CODE_MAPPED:
+      lp_code_arena_get_stats(&stats);
+      return stats.mapped;
+   case LP_PERF_COUNTER_JIT_CODE_HUGE_PAGES:
+      lp_code_arena_get_stats(&stats);
+      return stats.huge_page_mapped;
+   default:
+      return lp_perf_read(&llvmpipe->perf, id) - pq->start[0];
+   }
+}
+
+
+int
+llvmpipe_get_driver_query_info(struct pipe_screen *screen,
+                               unsigned index,
+                               struct pipe_driver_query_info *info)
+{
+   if (!info)
+      return LP_PERF_COUNTER_COUNT;
+
+   if (index >= LP_PERF_COUNTER_COUNT)
+      return 0;
+
+   memset(info, 0, sizeof(*info));
+   info->name = lp_perf_counter_name(index);
+   info->query_type = PIPE_QUERY_DRIVER_SPECIFIC + index;
+   info->result_type = PIPE_DRIVER_QUERY_RESULT_TYPE_AVERAGE;
+   info->group_id = 0;
+
+   switch (index) {
+   case LP_PERF_COUNTER_LLVM_COMPILE_TIME:
+   case LP_PERF_COUNTER_BIN_TIME:
+   case LP_PERF_COUNTER_RAST_TIME:
+   case LP_PERF_COUNTER_SHADE_TIME:
+      info->type = PIPE_DRIVER_QUERY_TYPE_MICROSECONDS;
+      break;
+   case LP_PERF_COUNTER_JIT_CODE_USED:
+   case LP_PERF_COUNTER_JIT_CODE_MAPPED:
+   case LP_PERF_COUNTER_JIT_CODE_HUGE_PAGES:
+      info->type = PIPE_DRIVER_QUERY_TYPE_BYTES;
+      break;
+   default:
+      info->type = PIPE_DRIVER_QUERY_TYPE_UINT64;
+      break;
+   }
+
+   return 1;
+}
+
+
+int
+llvmpipe_get_driver_query_group_info(struct pipe_screen *screen,
+                                     unsigned index,
+                                     struct pipe_driver_query_group_info *info)
+{
+   if (!info)
+      return 1;
+
+   if (index != 0)
+      return 0;
+
+   info->name = "llvmpipe";
+   info->max_active_queries = LP_PERF_COUNTER_COUNT;
+   info->num_queries = LP_PERF_COUNTER_COUNT;
+   return 1;
+}
+
+
 static struct pipe_query *
 llvmpipe_create_query(struct pipe_context *pipe,
                       unsigned type,
                       unsigned index)
 {
-   assert(type < PIPE_QUERY_TYPES);
+   assert(type < PIPE_QUERY_TYPES || is_perf_query(type));
 
    struct llvmpipe_query *pq = CALLOC_STRUCT(llvmpipe_query);
    if (pq) {
@@ -210,7 +307,10 @@ llvmpipe_get_query_result(struct pipe_context *pipe,
       }
       break;
    default:
-      assert(0);
+      if (is_perf_query(pq->type))
+         result->u64 = perf_query_value(llvmpipe_context(pipe), pq);
+      else
+         assert(0);
       break;
    }
 
@@ -354,7 +454,10 @@ llvmpipe_get_query_result_resource(struct pipe_context *pipe,
          }
          break;
       default:
-         fprintf(stderr, "Unknown query type %d\n", pq->type);
+         if (is_perf_query(pq->type))
+            value = perf_query_value(llvmpipe_context(pipe), pq);
+         else
+            fprintf(stderr, "Unknown query type %d\n", pq->type);
          break;
       }
    }
@@ -451,6 +554,9 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
       llvmpipe->dirty |= LP_NEW_OCCLUSION_QUERY;
       break;
    default:
+      if (is_perf_query(pq->type))
+         pq->start[0] = lp_perf_read(&llvmpipe->perf,
+                                     pq->type - PIPE_QUERY_DRIVER_SPECIFIC);
       break;
    }
    return true;
@@ -39,6 +39,9 @@
 
 
 struct llvmpipe_context;
+struct pipe_driver_query_group_info;
+struct pipe_driver_query_info;
+struct pipe_screen;
 
 
 struct llvmpipe_query {
@@ -58,4 +61,14 @@ extern void llvmpipe_init_query_funcs(struct llvmpipe_context * );
 
 extern bool llvmpipe_check_render_cond(struct llvmpipe_context *);
 
+extern int
+llvmpipe_get_driver_query_info(struct pipe_screen *screen,
+                               unsigned index,
+                               struct pipe_driver_query_info *info);
+
+extern int
+llvmpipe_get_driver_query_group_info(struct pipe_screen *screen,
+                                     unsigned index,
+                                     struct pipe_driver_query_group_info *info);
+
 #endif /* LP_QUERY_H */
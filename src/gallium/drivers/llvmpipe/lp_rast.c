@@ -35,6 +35,7 @@
 #include "util/u_thread.h"
 #include "util/u_memset.h"
 #include "util/os_time.h"
+#include "util/perf/cpu_trace.h"
 
 #include "lp_scene_queue.h"
 #include "lp_context.h"
@@ -74,6 +75,8 @@ lp_rast_begin(struct lp_rasterizer *rast,
               struct lp_scene *scene)
 {
    rast->curr_scene = scene;
+   rast->scene_start = os_time_get();
+   rast->scene_tasks_left = MAX2(1, rast->num_threads);
 
    LP_DBG(DEBUG_RAST, "%s\n", __func__);
 
@@ -114,6 +117,9 @@ lp_rast_tile_begin(struct lp_rasterizer_task *task,
    task->thread_data.vis_counter = 0;
    task->thread_data.ps_invocations = 0;
 
+   /* Nothing is known about the depth buffer until it gets cleared. */
+   task->depth_max = INFINITY;
+
    for (unsigned i = 0; i < scene->fb.nr_cbufs; i++) {
       if (scene->fb.cbufs[i]) {
          task->color_tiles[i] = scene->cbufs[i].map +
@@ -174,6 +180,7 @@ lp_rast_clear_color(struct lp_rasterizer_task *task,
 
    /* this will increase for each rb which probably doesn't mean much */
    LP_COUNT(nr_color_tile_clear);
+   task->counters[LP_PERF_COUNTER_TILE_CLEARS]++;
 }
 
 
@@ -285,6 +292,18 @@ lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
             dst_layer += scene->zsbuf.layer_stride;
          }
       }
+
+      /* If all the depth bits were cleared, the tile's depth is now known
+       * exactly, which lets tri_rasterize_bin() skip occluded primitives.
+       */
+      const enum pipe_format format = scene->fb.zsbuf->format;
+      if (util_format_has_depth(util_format_description(format))) {
+         const uint64_t zmask = util_pack64_mask_z(format, ~0);
+         if ((arg.clear_zstencil.mask & zmask) == zmask) {
+            const uint64_t value = arg.clear_zstencil.value;
+            util_format_unpack_z_float(format, &task->depth_max, &value, 1);
+         }
+      }
    }
 }
 
@@ -948,6 +967,30 @@ blit_rasterize_bin(struct lp_rasterizer_task *task,
 }
 
 
+/**
+ * Return the shader inputs of a primitive command, or NULL for other
+ * commands.
+ */
+static inline const struct lp_rast_shader_inputs *
+lp_rast_cmd_inputs(unsigned cmd, const union lp_rast_cmd_arg arg)
+{
+   if ((cmd >= LP_RAST_OP_TRIANGLE_1 && cmd <= LP_RAST_OP_TRIANGLE_4_16) ||
+       (cmd >= LP_RAST_OP_TRIANGLE_32_1 && cmd <= LP_RAST_OP_MS_TRIANGLE_4_16))
+      return &arg.triangle.tri->inputs;
+
+   switch (cmd) {
+   case LP_RAST_OP_SHADE_TILE:
+   case LP_RAST_OP_SHADE_TILE_OPAQUE:
+   case LP_RAST_OP_BLIT:
+      return arg.shade_tile;
+   case LP_RAST_OP_RECTANGLE:
+      return &arg.rectangle->inputs;
+   default:
+      return NULL;
+   }
+}
+
+
 static void
 tri_rasterize_bin(struct lp_rasterizer_task *task,
                   const struct cmd_bin *bin,
@@ -957,7 +1000,22 @@ tri_rasterize_bin(struct lp_rasterizer_task *task,
 
    for (const struct cmd_block *block = bin->head; block; block = block->next) {
       for (unsigned k = 0; k < block->count; k++) {
-         dispatch_tri[block->cmd[k]](task, block->arg[k]);
+         const unsigned cmd = block->cmd[k];
+         const struct lp_rast_shader_inputs *inputs =
+            lp_rast_cmd_inputs(cmd, block->arg[k]);
+
+         /* Skip primitives lying entirely behind everything in the tile,
+          * see lp_setup_depth_bounds().
+          */
+         if (inputs && inputs->zmin > task->depth_max) {
+            LP_COUNT(nr_depth_culled_64);
+            continue;
+         }
+
+         dispatch_tri[cmd](task, block->arg[k]);
+
+         if (inputs)
+            task->depth_max = MAX2(task->depth_max, inputs->zmax);
       }
    }
 }
@@ -991,13 +1049,17 @@ rasterize_bin(struct lp_rasterizer_task *task,
 
    lp_rast_tile_begin(task, bin, x, y);
 
+   task->counters[LP_PERF_COUNTER_TILES]++;
+
    if (LP_DEBUG & DEBUG_NO_FASTPATH) {
       debug_rasterize_bin(task, bin);
    } else if (info.type & LP_RAST_FLAGS_BLIT) {
+      task->counters[LP_PERF_COUNTER_BLIT_TILES]++;
       blit_rasterize_bin(task, bin);
    } else if (task->scene->permit_linear_rasterizer &&
             !(LP_PERF & PERF_NO_RAST_LINEAR) &&
             (info.type & LP_RAST_FLAGS_RECT)) {
+      task->counters[LP_PERF_COUNTER_LINEAR_TILES]++;
       lp_linear_rasterize_bin(task, bin);
    } else {
       tri_rasterize_bin(task, bin, x, y);
@@ -1034,6 +1096,36 @@ is_empty_bin(const struct cmd_bin *bin)
 }
 
 
+/**
+ * Add this thread's counters for the scene to the context totals.  The
+ * last thread to get here also accounts the scene's rasterization time.
+ * This must happen before the scene fence is signalled so that queries
+ * waiting on it see the totals.
+ */
+static void
+lp_rast_flush_counters(struct lp_rasterizer_task *task,
+                       struct lp_scene *scene)
+{
+   struct llvmpipe_context *lp = llvmpipe_context(scene->pipe);
+   struct lp_rasterizer *rast = task->rast;
+
+   for (unsigned i = 0; i < LP_PERF_COUNTER_COUNT; i++) {
+      if (task->counters[i]) {
+         lp_perf_add(&lp->perf, i, task->counters[i]);
+         task->counters[i] = 0;
+      }
+   }
+
+   if (p_atomic_dec_zero(&rast->scene_tasks_left)) {
+      int64_t dt = os_time_get() - rast->scene_start;
+
+      lp_perf_add(&lp->perf, LP_PERF_COUNTER_SCENES, 1);
+      lp_perf_add(&lp->perf, LP_PERF_COUNTER_RAST_TIME, dt);
+      MESA_TRACE_SET_COUNTER("llvmpipe rast time (us)", dt);
+   }
+}
+
+
 /**
  * Rasterize/execute all bins within a scene.
  * Called per thread.
@@ -1042,6 +1134,8 @@ static void
 rasterize_scene(struct lp_rasterizer_task *task,
                 struct lp_scene *scene)
 {
+   MESA_TRACE_FUNC();
+
    task->scene = scene;
 
    /* Clear the cache tags. This should not always be necessary but
@@ -1062,10 +1156,12 @@ rasterize_scene(struct lp_rasterizer_task *task,
       int i, j;
 
       assert(scene);
+      int64_t t0 = os_time_get();
       while ((bin = lp_scene_bin_iter_next(scene, &i, &j))) {
          if (!is_empty_bin(bin))
             rasterize_bin(task, bin, i, j);
       }
+      task->counters[LP_PERF_COUNTER_SHADE_TIME] += os_time_get() - t0;
    }
 
 #if LP_BUILD_FORMAT_CACHE_DEBUG
@@ -1082,6 +1178,8 @@ rasterize_scene(struct lp_rasterizer_task *task,
    }
 #endif
 
+   lp_rast_flush_counters(task, scene);
+
    if (scene->fence) {
       lp_fence_signal(scene->fence);
    }
@@ -117,7 +117,8 @@ struct lp_rast_shader_inputs {
    unsigned layer:11;
    unsigned view_index:14;
    unsigned stride;             /* how much to advance data between a0, dadx, dady */
-   unsigned pad[2];
+   float zmin;                  /* skip if the tile's depth is below this */
+   float zmax;                  /* upper bound of the depth values written */
    /* followed by a0, dadx, dady and planes[] */
 };
 
@@ -37,6 +37,7 @@
 #include "lp_state.h"
 #include "lp_texture.h"
 #include "lp_limits.h"
+#include "lp_perf.h"
 
 
 #define TILE_VECTOR_HEIGHT 4
@@ -91,6 +92,9 @@ struct lp_rasterizer_task
    uint8_t *color_tiles[PIPE_MAX_COLOR_BUFS];
    uint8_t *depth_tile;
 
+   /** Upper bound of the depth values in the current tile, or INFINITY */
+   float depth_max;
+
    /** "back" pointer */
    struct lp_rasterizer *rast;
 
@@ -100,6 +104,9 @@ struct lp_rasterizer_task
    /** Non-interpolated passthru state and occlude counter for visible pixels */
    struct lp_jit_thread_data thread_data;
 
+   /** Counted without atomics, flushed to the context at the end of a scene */
+   uint64_t counters[LP_PERF_COUNTER_COUNT];
+
    util_semaphore work_ready;
    util_semaphore work_done;
 #ifdef _WIN32
@@ -134,6 +141,11 @@ struct lp_rasterizer
    util_barrier barrier;
 
    struct lp_fence *last_fence;
+
+   /** os_time_get() when the current scene started rasterizing */
+   int64_t scene_start;
+   /** Threads still rasterizing the current scene */
+   int32_t scene_tasks_left;
 };
 
 
@@ -102,6 +102,8 @@ lp_scene_destroy(struct lp_scene *scene)
 {
    lp_scene_end_rasterization(scene);
    mtx_destroy(&scene->mutex);
+   for (unsigned i = 0; i < ARRAY_SIZE(scene->bin_slices); i++)
+      FREE(scene->bin_slices[i]);
    free(scene->tiles);
    assert(scene->data.head == &scene->data.first);
    slab_free_st(&scene->setup->scene_slab, scene);
@@ -213,6 +215,22 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
 }
 
 
+static void
+free_data_blocks(struct data_block_list *list)
+{
+   struct data_block *block, *tmp;
+
+   for (block = list->head; block; block = tmp) {
+      tmp = block->next;
+      if (block != &list->first)
+         FREE(block);
+   }
+
+   list->head = &list->first;
+   list->head->next = NULL;
+}
+
+
 /**
  * Free all the temporary data in a scene.
  */
@@ -299,20 +317,16 @@ lp_scene_end_rasterization(struct lp_scene *scene)
       }
    }
 
-   /* Free all scene data blocks:
+   /* Free all scene data blocks, including those of the bin slices:
     */
-   {
-      struct data_block_list *list = &scene->data;
-      struct data_block *block, *tmp;
+   free_data_blocks(&scene->data);
 
-      for (block = list->head; block; block = tmp) {
-         tmp = block->next;
-         if (block != &list->first)
-            FREE(block);
+   for (unsigned i = 0; i < ARRAY_SIZE(scene->bin_slices); i++) {
+      struct lp_scene *slice = scene->bin_slices[i];
+      if (slice) {
+         free_data_blocks(&slice->data);
+         slice->data.first.used = 0;
       }
-
-      list->head = &list->first;
-      list->head->next = NULL;
    }
 
    lp_fence_reference(&scene->fence, NULL);
@@ -352,6 +366,65 @@ lp_scene_new_cmd_block(struct lp_scene *scene,
 }
 
 
+/**
+ * Prepare the first num_slices bin slices for binning into this scene.
+ * The remaining scene memory budget is split evenly between the slices
+ * so that their combined allocations respect LP_SCENE_MAX_SIZE.
+ */
+bool
+lp_scene_begin_bin_slices(struct lp_scene *scene, unsigned num_slices)
+{
+   assert(num_slices <= ARRAY_SIZE(scene->bin_slices));
+
+   if (scene->scene_size >= LP_SCENE_MAX_SIZE)
+      return false;
+
+   unsigned budget = (LP_SCENE_MAX_SIZE - scene->scene_size) / num_slices;
+
+   for (unsigned i = 0; i < num_slices; i++) {
+      struct lp_scene *slice = scene->bin_slices[i];
+
+      if (!slice) {
+         slice = CALLOC_STRUCT(lp_scene);
+         if (!slice)
+            return false;
+
+         slice->data.head = &slice->data.first;
+         scene->bin_slices[i] = slice;
+      }
+
+      slice->pipe = scene->pipe;
+      slice->setup = scene->setup;
+      slice->had_queries = scene->had_queries;
+      slice->fb_max_layer = scene->fb_max_layer;
+      slice->fb.zsbuf = scene->fb.zsbuf;  /* not referenced */
+      slice->tiles_x = scene->tiles_x;
+      slice->tiles_y = scene->tiles_y;
+      slice->tiles = scene->tiles;
+      slice->alloc_failed = false;
+      slice->num_tris = 0;
+      slice->scene_size = LP_SCENE_MAX_SIZE - budget;
+      scene->bin_slice_base[i] = slice->scene_size;
+   }
+
+   return true;
+}
+
+
+/**
+ * Account the memory allocated by the bin slices to this scene.
+ */
+void
+lp_scene_end_bin_slices(struct lp_scene *scene, unsigned num_slices)
+{
+   for (unsigned i = 0; i < num_slices; i++) {
+      struct lp_scene *slice = scene->bin_slices[i];
+      scene->scene_size += slice->scene_size - scene->bin_slice_base[i];
+      scene->num_tris += slice->num_tris;
+   }
+}
+
+
 struct data_block *
 lp_scene_new_data_block(struct lp_scene *scene)
 {
@@ -652,6 +725,7 @@ lp_scene_begin_binning(struct lp_scene *scene,
    }
 
    scene->fb_max_layer = max_layer;
+   scene->num_tris = 0;
    scene->fb_max_samples = util_framebuffer_get_num_samples(fb);
    if (scene->fb_max_samples == 4) {
       for (unsigned i = 0; i < 4; i++) {
@@ -189,6 +189,11 @@ struct lp_scene {
    bool alloc_failed;
    bool permit_linear_rasterizer;
 
+   /** Triangles binned into this scene, for the perf counters */
+   unsigned num_tris;
+   /** os_time_get() when the first command was binned */
+   int64_t binning_start;
+
    /**
     * Number of active tiles in each dimension.
     * This basically the framebuffer size divided by tile size
@@ -201,6 +206,14 @@ struct lp_scene {
    unsigned num_alloced_tiles;
    struct cmd_bin *tiles;
    struct data_block_list data;
+
+   /**
+    * Helper scenes used when binning on several threads.  They share
+    * this scene's bins but each has its own data blocks, which are kept
+    * alive until this scene has been rasterized.
+    */
+   struct lp_scene *bin_slices[LP_MAX_BIN_THREADS];
+   unsigned bin_slice_base[LP_MAX_BIN_THREADS];
 };
 
 
@@ -218,6 +231,10 @@ struct data_block *lp_scene_new_data_block(struct lp_scene *scene);
 struct cmd_block *lp_scene_new_cmd_block(struct lp_scene *scene,
                                          struct cmd_bin *bin);
 
+bool lp_scene_begin_bin_slices(struct lp_scene *scene, unsigned num_slices);
+
+void lp_scene_end_bin_slices(struct lp_scene *scene, unsigned num_slices);
+
 bool lp_scene_add_resource_reference(struct lp_scene *scene,
                                      struct pipe_resource *resource,
                                      bool initializing_scene,
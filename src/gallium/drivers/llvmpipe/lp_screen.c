@@ -54,6 +54,7 @@
 #include "lp_rast.h"
 #include "lp_cs_tpool.h"
 #include "lp_flush.h"
+#include "lp_query.h"
 
 #include "frontend/sw_winsys.h"
 
@@ -921,6 +922,9 @@ llvmpipe_destroy_screen(struct pipe_screen *_screen)
 
    lp_jit_screen_cleanup(screen);
 
+   if (screen->sample_functions)
+      lp_sample_function_cache_destroy(screen->sample_functions);
+
    disk_cache_destroy(screen->disk_shader_cache);
 
    glsl_type_singleton_decref();
@@ -1150,6 +1154,8 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->base.get_timestamp = u_default_get_timestamp;
 
    screen->base.query_memory_info = util_sw_query_memory_info;
+   screen->base.get_driver_query_info = llvmpipe_get_driver_query_info;
+   screen->base.get_driver_query_group_info = llvmpipe_get_driver_query_group_info;
 
    screen->base.get_driver_uuid = llvmpipe_get_driver_uuid;
    screen->base.get_device_uuid = llvmpipe_get_device_uuid;
@@ -1160,11 +1166,14 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    llvmpipe_init_screen_resource_funcs(&screen->base);
 
    screen->allow_cl = !!getenv("LP_CL");
+   screen->tiled_textures = debug_get_bool_option("LP_TILED_TEXTURES", false);
    screen->num_threads = util_get_cpu_caps()->nr_cpus > 1
       ? util_get_cpu_caps()->nr_cpus : 0;
    screen->num_threads = debug_get_num_option("LP_NUM_THREADS",
                                               screen->num_threads);
    screen->num_threads = MIN2(screen->num_threads, LP_MAX_THREADS);
+   screen->num_bin_threads = debug_get_num_option("LP_BIN_THREADS", 0);
+   screen->num_bin_threads = MIN2(screen->num_bin_threads, LP_MAX_BIN_THREADS);
 
 #ifdef HAVE_LINUX_UDMABUF_H
    screen->udmabuf_fd = open("/dev/udmabuf", O_RDWR);
@@ -1181,5 +1190,11 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
 
    (void) mtx_init(&screen->late_mutex, mtx_plain);
 
+   screen->sample_functions = lp_sample_function_cache_create();
+   if (!screen->sample_functions) {
+      llvmpipe_destroy_screen(&screen->base);
+      return NULL;
+   }
+
    return &screen->base;
 }
@@ -43,6 +43,7 @@
 
 struct sw_winsys;
 struct lp_cs_tpool;
+struct lp_sample_function_cache;
 
 struct llvmpipe_screen
 {
@@ -51,6 +52,7 @@ struct llvmpipe_screen
    struct sw_winsys *winsys;
 
    unsigned num_threads;
+   unsigned num_bin_threads;
 
    /* Increments whenever textures are modified.  Contexts can track this.
     */
@@ -64,6 +66,9 @@ struct llvmpipe_screen
 
    bool allow_cl;
 
+   /* Use the micro-tiled layout for sampled-only textures. */
+   bool tiled_textures;
+
    mtx_t late_mutex;
    bool late_init_done;
 
@@ -74,6 +79,9 @@ struct llvmpipe_screen
 
    struct disk_cache *disk_shader_cache;
 
+   /* Bindless sample functions shared by all contexts */
+   struct lp_sample_function_cache *sample_functions;
+
 #ifdef HAVE_LIBDRM
    int udmabuf_fd;
 #endif
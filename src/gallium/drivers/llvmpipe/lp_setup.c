@@ -43,6 +43,7 @@
 #include "util/u_viewport.h"
 #include "draw/draw_pipe.h"
 #include "util/os_time.h"
+#include "util/perf/cpu_trace.h"
 #include "lp_context.h"
 #include "lp_memory.h"
 #include "lp_scene.h"
@@ -203,12 +204,21 @@ lp_setup_rasterize_scene(struct lp_setup_context *setup)
    struct lp_scene *scene = setup->scene;
    struct llvmpipe_screen *screen = llvmpipe_screen(scene->pipe->screen);
 
+   MESA_TRACE_FUNC();
+
    scene->num_active_queries = setup->active_binned_queries;
    memcpy(scene->active_queries, setup->active_queries,
           scene->num_active_queries * sizeof(scene->active_queries[0]));
 
    lp_scene_end_binning(scene);
 
+   struct llvmpipe_context *lp = llvmpipe_context(scene->pipe);
+   int64_t bin_time = os_time_get() - scene->binning_start;
+   lp_perf_add(&lp->perf, LP_PERF_COUNTER_TRIANGLES, scene->num_tris);
+   lp_perf_add(&lp->perf, LP_PERF_COUNTER_BIN_TIME, bin_time);
+   MESA_TRACE_SET_COUNTER("llvmpipe binned triangles", scene->num_tris);
+   MESA_TRACE_SET_COUNTER("llvmpipe bin time (us)", bin_time);
+
    mtx_lock(&screen->rast_mutex);
    lp_rast_queue_scene(screen->rast, scene);
    mtx_unlock(&screen->rast_mutex);
@@ -233,6 +243,8 @@ begin_binning(struct lp_setup_context *setup)
    if (!scene->fence)
       return false;
 
+   scene->binning_start = os_time_get();
+
    if (!try_update_scene_state(setup)) {
       return false;
    }
@@ -1280,6 +1292,7 @@ lp_setup_update_state(struct lp_setup_context *setup,
 void
 lp_setup_destroy(struct lp_setup_context *setup)
 {
+   lp_setup_destroy_bin_threads(setup);
    lp_setup_reset(setup);
 
    util_unreference_framebuffer_state(&setup->fb);
@@ -1347,6 +1360,7 @@ lp_setup_create(struct pipe_context *pipe,
    setup->pipe = pipe;
 
    setup->num_threads = screen->num_threads;
+   setup->num_bin_threads = screen->num_bin_threads;
    setup->vbuf = draw_vbuf_stage(draw, &setup->base);
    if (!setup->vbuf) {
       goto no_vbuf;
@@ -44,6 +44,7 @@
 #include "util/u_rect.h"
 #include "util/u_pack_color.h"
 #include "util/slab.h"
+#include "util/u_queue.h"
 
 #define LP_SETUP_NEW_FS          0x01
 #define LP_SETUP_NEW_CONSTANTS   0x02
@@ -53,6 +54,7 @@
 #define LP_SETUP_NEW_SSBOS       0x20
 
 struct lp_setup_variant;
+struct lp_setup_bin_job;
 
 
 /** Max number of scenes */
@@ -91,6 +93,12 @@ struct lp_setup_context
    unsigned num_threads;
    unsigned scene_idx;
 
+   /** Threaded binning of large triangle lists, see lp_setup_vbuf.c */
+   unsigned num_bin_threads;
+   struct util_queue bin_queue;
+   bool bin_queue_initialized;
+   struct lp_setup_bin_job *bin_jobs;
+
    struct slab_mempool scene_slab;
    int num_active_scenes;
    struct lp_scene *scenes[MAX_SCENES];  /**< all the scenes */
@@ -109,6 +117,8 @@ struct lp_setup_context
    unsigned permit_linear_rasterizer:1;
    unsigned multisample:1;
    unsigned rectangular_lines:1;
+   unsigned bin_slice:1;   /**< band copy used by a binning thread */
+   unsigned bin_failed:1;  /**< bin_slice ran out of scene memory */
    unsigned cullmode:2; /**< PIPE_FACE_x */
    unsigned bottom_edge_rule;
    float pixel_offset;
@@ -239,6 +249,9 @@ lp_setup_update_state(struct lp_setup_context *setup,
 void
 lp_setup_destroy(struct lp_setup_context *setup);
 
+void
+lp_setup_destroy_bin_threads(struct lp_setup_context *setup);
+
 bool
 lp_setup_flush_and_restart(struct lp_setup_context *setup);
 
@@ -247,6 +260,11 @@ lp_setup_whole_tile(struct lp_setup_context *setup,
                     const struct lp_rast_shader_inputs *inputs,
                     int tx, int ty, bool opaque);
 
+void
+lp_setup_depth_bounds(const struct lp_setup_context *setup,
+                      struct lp_rast_shader_inputs *inputs,
+                      float zmin, float zmax);
+
 bool
 lp_setup_is_blit(const struct lp_setup_context *setup,
                  const struct lp_rast_shader_inputs *inputs);
@@ -668,6 +668,9 @@ try_setup_line(struct lp_setup_context *setup,
    line->inputs.disable = false;
    line->inputs.layer = layer;
    line->inputs.viewport_index = viewport_index;
+
+   /* Line ends get extended, so depth isn't bounded by the endpoints. */
+   lp_setup_depth_bounds(setup, &line->inputs, -INFINITY, INFINITY);
    line->inputs.view_index = setup->view_index;
 
    /*
@@ -508,6 +508,7 @@ try_setup_point(struct lp_setup_context *setup,
       point->inputs.is_blit = false;
       point->inputs.layer = layer;
       point->inputs.viewport_index = viewport_index;
+      lp_setup_depth_bounds(setup, &point->inputs, v0[0][2], v0[0][2]);
       point->inputs.view_index = setup->view_index;
 
       plane = GET_PLANES(point);
@@ -592,6 +593,7 @@ try_setup_point(struct lp_setup_context *setup,
       point->inputs.is_blit = false;
       point->inputs.layer = layer;
       point->inputs.viewport_index = viewport_index;
+      lp_setup_depth_bounds(setup, &point->inputs, v0[0][2], v0[0][2]);
       point->inputs.view_index = setup->view_index;
 
       return lp_setup_bin_rectangle(setup, point,
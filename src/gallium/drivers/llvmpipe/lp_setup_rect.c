@@ -69,6 +69,8 @@ lp_setup_alloc_rectangle(struct lp_scene *scene, unsigned nr_inputs)
       return NULL;
 
    rect->inputs.stride = input_array_sz;
+   rect->inputs.zmin = -INFINITY;
+   rect->inputs.zmax = INFINITY;
 
    return rect;
 }
@@ -341,6 +343,14 @@ try_rect_cw(struct lp_setup_context *setup,
    rect->inputs.frontfacing = frontfacing;
    rect->inputs.disable = false;
    rect->inputs.is_blit = lp_setup_is_blit(setup, &rect->inputs);
+
+   /* The fourth corner's depth is extrapolated from the other three. */
+   {
+      const float zmin = MIN3(v0[0][2], v1[0][2], v2[0][2]);
+      const float zmax = MAX3(v0[0][2], v1[0][2], v2[0][2]);
+      lp_setup_depth_bounds(setup, &rect->inputs,
+                            zmin - (zmax - zmin), zmax + (zmax - zmin));
+   }
    rect->inputs.layer = layer;
    rect->inputs.viewport_index = viewport_index;
    rect->inputs.view_index = setup->view_index;
@@ -109,6 +109,8 @@ lp_setup_alloc_triangle(struct lp_scene *scene,
       return NULL;
 
    tri->inputs.stride = input_array_sz;
+   tri->inputs.zmin = -INFINITY;
+   tri->inputs.zmax = INFINITY;
 
    {
       ASSERTED char *a = (char *)tri;
@@ -266,6 +268,43 @@ check_opaque(const struct lp_setup_context *setup,
 }
 
 
+/**
+ * Set the depth range the rasterizer uses to skip primitives which are
+ * completely hidden by a tile's depth values (see tri_rasterize_bin()).
+ * zmin/zmax bound the window space depth of the primitive, and are
+ * infinite if unknown.
+ */
+void
+lp_setup_depth_bounds(const struct lp_setup_context *setup,
+                      struct lp_rast_shader_inputs *inputs,
+                      float zmin, float zmax)
+{
+   const struct lp_fragment_shader_variant *variant =
+      setup->fs.current.variant;
+   const bool bounded = isfinite(zmin) && isfinite(zmax);
+
+   /* Interpolated depth can stray slightly outside the vertex range and
+    * gets rounded when converted to the depth buffer format.
+    */
+   zmin -= MAX2(1.0f, fabsf(zmin)) * (1.0f / (1 << 14));
+   zmax += MAX2(1.0f, fabsf(zmax)) * (1.0f / (1 << 14));
+
+   if (variant->key.restrict_depth_values) {
+      zmin = CLAMP(zmin, 0.0f, 1.0f);
+      zmax = CLAMP(zmax, 0.0f, 1.0f);
+   }
+
+   inputs->zmin = variant->depth_cull && bounded ? zmin : -INFINITY;
+
+   if (!variant->depth_raise)
+      inputs->zmax = -INFINITY;
+   else if (variant->depth_unbounded || !bounded)
+      inputs->zmax = INFINITY;
+   else
+      inputs->zmax = zmax;
+}
+
+
 /**
  * Do basic setup for triangle rasterization and determine which
  * framebuffer tiles are touched.  Put the triangle in the scene's
@@ -371,6 +410,7 @@ do_triangle_ccw(struct lp_setup_context *setup,
 #endif
 
    LP_COUNT(nr_tris);
+   scene->num_tris++;
 
    /*
     * Rotate the tri such that v0 is closest to the fb origin.
@@ -467,6 +507,14 @@ do_triangle_ccw(struct lp_setup_context *setup,
    tri->inputs.viewport_index = viewport_index;
    tri->inputs.view_index = setup->view_index;
 
+   if (key->pgon_offset_units == 0.0f && key->pgon_offset_scale == 0.0f) {
+      lp_setup_depth_bounds(setup, &tri->inputs,
+                            MIN3(v0[0][2], v1[0][2], v2[0][2]),
+                            MAX3(v0[0][2], v1[0][2], v2[0][2]));
+   } else {
+      lp_setup_depth_bounds(setup, &tri->inputs, -INFINITY, INFINITY);
+   }
+
    if (0)
       lp_dump_setup_coef(&setup->setup.variant->key,
                          GET_A0(&tri->inputs),
@@ -1018,6 +1066,12 @@ retry_triangle_ccw(struct lp_setup_context *setup,
    }
 
    if (!do_triangle_ccw(setup, position, v0, v1, v2, front)) {
+      /* Binning threads can't flush the scene, let the caller do it. */
+      if (setup->bin_slice) {
+         setup->bin_failed = true;
+         return;
+      }
+
       if (!lp_setup_flush_and_restart(setup))
          return;
 
@@ -165,6 +165,228 @@ rect(struct lp_setup_context *setup,
 }
 
 
+/*
+ * Threaded binning.
+ *
+ * Large triangle lists may be binned by several threads at once, each
+ * owning a band of tile rows.  Every thread walks the whole list using a
+ * private copy of the setup context whose draw regions are clipped to its
+ * band and whose scene is a bin slice sharing the current scene's bins.
+ * Each bin is only written by one thread and receives its commands in
+ * the same order as with serial binning.
+ */
+
+#define LP_BIN_THREADS_MIN_TRIANGLES 128
+
+struct lp_setup_bin_job {
+   struct util_queue_fence fence;
+   struct lp_setup_context shadow;
+   const void *vertex_buffer;
+   const uint16_t *indices;
+   unsigned stride;
+   unsigned nr;
+   unsigned start;
+   unsigned failed_at;  /**< first vertex of the triangle that failed */
+};
+
+
+static bool
+lp_setup_init_bin_threads(struct lp_setup_context *setup)
+{
+   if (setup->bin_queue_initialized)
+      return true;
+
+   if (!setup->bin_jobs) {
+      setup->bin_jobs = CALLOC(LP_MAX_BIN_THREADS,
+                               sizeof(struct lp_setup_bin_job));
+      if (!setup->bin_jobs)
+         return false;
+
+      for (unsigned i = 0; i < LP_MAX_BIN_THREADS; i++)
+         util_queue_fence_init(&setup->bin_jobs[i].fence);
+   }
+
+   if (!util_queue_init(&setup->bin_queue, "lpbin", LP_MAX_BIN_THREADS,
+                        setup->num_bin_threads - 1,
+                        UTIL_QUEUE_INIT_RESIZE_IF_FULL, NULL)) {
+      /* don't try again */
+      setup->num_bin_threads = 0;
+      return false;
+   }
+
+   setup->bin_queue_initialized = true;
+   return true;
+}
+
+
+void
+lp_setup_destroy_bin_threads(struct lp_setup_context *setup)
+{
+   if (setup->bin_queue_initialized) {
+      util_queue_destroy(&setup->bin_queue);
+      setup->bin_queue_initialized = false;
+   }
+
+   if (setup->bin_jobs) {
+      for (unsigned i = 0; i < LP_MAX_BIN_THREADS; i++)
+         util_queue_fence_destroy(&setup->bin_jobs[i].fence);
+      FREE(setup->bin_jobs);
+      setup->bin_jobs = NULL;
+   }
+}
+
+
+/**
+ * Set up a job to bin into the given band of tile rows of 'scene', which
+ * is either a bin slice of the current scene or the current scene itself.
+ */
+static void
+lp_setup_bin_job_init(struct lp_setup_context *setup,
+                      struct lp_setup_bin_job *job,
+                      struct lp_scene *scene,
+                      unsigned band, unsigned num_bands)
+{
+   struct lp_setup_context *shadow = &job->shadow;
+   const unsigned tiles_y = setup->scene->tiles_y;
+   struct u_rect rows;
+
+   memcpy(shadow, setup, sizeof *shadow);
+   shadow->scene = scene;
+   shadow->bin_slice = 1;
+   shadow->bin_failed = 0;
+
+   rows.x0 = 0;
+   rows.x1 = setup->scene->tiles_x * TILE_SIZE - 1;
+   rows.y0 = band * tiles_y / num_bands * TILE_SIZE;
+   rows.y1 = (band + 1) * tiles_y / num_bands * TILE_SIZE - 1;
+
+   for (unsigned i = 0; i < PIPE_MAX_VIEWPORTS; i++)
+      u_rect_possible_intersection(&rows, &shadow->draw_regions[i]);
+}
+
+
+static void
+lp_setup_bin_job_run(struct lp_setup_bin_job *job)
+{
+   struct lp_setup_context *shadow = &job->shadow;
+   const uint16_t *indices = job->indices;
+   const void *vertex_buffer = job->vertex_buffer;
+   const unsigned stride = job->stride;
+
+   for (unsigned i = job->start + 2; i < job->nr; i += 3) {
+      if (indices) {
+         shadow->triangle(shadow,
+                          get_vert(vertex_buffer, indices[i-2], stride),
+                          get_vert(vertex_buffer, indices[i-1], stride),
+                          get_vert(vertex_buffer, indices[i-0], stride));
+      } else {
+         shadow->triangle(shadow,
+                          get_vert(vertex_buffer, i-2, stride),
+                          get_vert(vertex_buffer, i-1, stride),
+                          get_vert(vertex_buffer, i-0, stride));
+      }
+
+      if (shadow->bin_failed) {
+         job->failed_at = i - 2;
+         return;
+      }
+   }
+
+   job->failed_at = job->nr;
+}
+
+
+static void
+lp_setup_bin_job_execute(void *data, void *gdata, int thread_index)
+{
+   lp_setup_bin_job_run(data);
+}
+
+
+/**
+ * Bin a triangle list on several threads.  Returns false if the list
+ * should be binned serially instead.
+ */
+static bool
+lp_setup_bin_triangles_threaded(struct lp_setup_context *setup,
+                                const void *vertex_buffer,
+                                unsigned stride,
+                                const uint16_t *indices,
+                                unsigned nr)
+{
+   struct llvmpipe_context *lp_context = llvmpipe_context(setup->pipe);
+   struct lp_scene *scene = setup->scene;
+
+   if (setup->num_bin_threads < 2 ||
+       nr / 3 < LP_BIN_THREADS_MIN_TRIANGLES ||
+       setup->permit_linear_rasterizer ||
+       setup->rasterizer_discard ||
+       lp_context->active_statistics_queries ||
+       !scene || scene->tiles_y < 2)
+      return false;
+
+   const unsigned num_bands = MIN2(setup->num_bin_threads, scene->tiles_y);
+
+   if (!lp_setup_init_bin_threads(setup) ||
+       !lp_scene_begin_bin_slices(scene, num_bands))
+      return false;
+
+   for (unsigned b = 0; b < num_bands; b++) {
+      struct lp_setup_bin_job *job = &setup->bin_jobs[b];
+
+      lp_setup_bin_job_init(setup, job, scene->bin_slices[b], b, num_bands);
+      job->vertex_buffer = vertex_buffer;
+      job->indices = indices;
+      job->stride = stride;
+      job->nr = nr;
+      job->start = 0;
+
+      if (b > 0) {
+         util_queue_add_job(&setup->bin_queue, job, &job->fence,
+                            lp_setup_bin_job_execute, NULL, 0);
+      }
+   }
+
+   lp_setup_bin_job_run(&setup->bin_jobs[0]);
+
+   for (unsigned b = 1; b < num_bands; b++)
+      util_queue_fence_wait(&setup->bin_jobs[b].fence);
+
+   lp_scene_end_bin_slices(scene, num_bands);
+
+   /* Bands which ran out of scene memory continue from the triangle that
+    * failed, binning directly into a fresh scene.  As in retry_triangle_ccw()
+    * a triangle which doesn't fit right after a flush is dropped.
+    */
+   bool fresh = false;
+   for (unsigned b = 0; b < num_bands; b++) {
+      struct lp_setup_bin_job *job = &setup->bin_jobs[b];
+      unsigned start = job->failed_at;
+
+      while (start < nr) {
+         if (!fresh) {
+            if (!lp_setup_flush_and_restart(setup))
+               return true;
+            fresh = true;
+         }
+
+         lp_setup_bin_job_init(setup, job, setup->scene, b, num_bands);
+         job->start = start;
+         lp_setup_bin_job_run(job);
+
+         if (job->failed_at == start) {
+            start += 3;
+         } else {
+            start = job->failed_at;
+            fresh = false;
+         }
+      }
+   }
+
+   return true;
+}
+
+
 /**
  * draw elements / indexed primitives
  */
@@ -223,7 +445,10 @@ lp_setup_draw_elements(struct vbuf_render *vbr, const uint16_t *indices, uint nr
       break;
 
    case MESA_PRIM_TRIANGLES:
-      if (nr % 6 == 0 && !uses_constant_interp) {
+      if (lp_setup_bin_triangles_threaded(setup, vertex_buffer, stride,
+                                          indices, nr)) {
+         /* binned on the bin threads */
+      } else if (nr % 6 == 0 && !uses_constant_interp) {
          for (i = 5; i < nr; i += 6) {
             rect(setup,
                  get_vert(vertex_buffer, indices[i-5], stride),
@@ -431,7 +656,10 @@ lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
       break;
 
    case MESA_PRIM_TRIANGLES:
-      if (nr % 6 == 0 && !uses_constant_interp) {
+      if (lp_setup_bin_triangles_threaded(setup, vertex_buffer, stride,
+                                          NULL, nr)) {
+         /* binned on the bin threads */
+      } else if (nr % 6 == 0 && !uses_constant_interp) {
          for (i = 5; i < nr; i += 6) {
             rect(setup,
                  get_vert(vertex_buffer, i-5, stride),
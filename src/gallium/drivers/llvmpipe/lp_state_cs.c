@@ -101,7 +101,6 @@ enum {
    CS_ARG_CORO_BLOCK_Y_SIZE,
    CS_ARG_CORO_BLOCK_Z_SIZE,
    CS_ARG_CORO_IDX,
-   CS_ARG_CORO_MEM,
    CS_ARG_CORO_OUTPUTS,
    CS_ARG_MAX,
 };
@@ -310,6 +309,37 @@ mesh_convert_to_aos(struct gallivm_state *gallivm,
 #endif
 }
 
+/**
+ * Whether the workgroup invocations have to be run as coroutines.
+ *
+ * Only execution barriers and the mesh shader output sync point suspend
+ * the invocations, without them each SIMD chunk of the workgroup runs to
+ * completion in turn anyway.  Shared memory alone doesn't need
+ * coroutines, without a barrier there's no ordering between the chunks.
+ */
+static bool
+cs_needs_coroutines(const struct nir_shader *nir)
+{
+   if (nir->info.stage == MESA_SHADER_MESH)
+      return true;
+
+   nir_foreach_function_impl(impl, nir) {
+      nir_foreach_block(block, impl) {
+         nir_foreach_instr(instr, block) {
+            if (instr->type != nir_instr_type_intrinsic)
+               continue;
+
+            nir_intrinsic_instr *intr = nir_instr_as_intrinsic(instr);
+            if (intr->intrinsic == nir_intrinsic_barrier &&
+                nir_intrinsic_execution_scope(intr) != SCOPE_NONE)
+               return true;
+         }
+      }
+   }
+   return false;
+}
+
+
 static void
 generate_compute(struct llvmpipe_context *lp,
                  struct lp_compute_shader *shader,
@@ -335,6 +365,7 @@ generate_compute(struct llvmpipe_context *lp,
    struct lp_type cs_type;
    struct lp_mesh_llvm_iface mesh_iface;
    bool is_mesh = nir->info.stage == MESA_SHADER_MESH;
+   bool use_coro = cs_needs_coroutines(nir);
    unsigned i;
 
    LLVMValueRef output_array = NULL;
@@ -343,6 +374,9 @@ generate_compute(struct llvmpipe_context *lp,
     * This function has two parts
     * a) setup the coroutine execution environment loop.
     * b) build the compute shader llvm for use inside the coroutine.
+    *
+    * Shaders that never suspend skip the coroutine machinery, (a) is then
+    * a plain loop calling (b) once per SIMD chunk.
     */
    assert(lp_native_vector_width / 32 >= 4);
 
@@ -354,7 +388,7 @@ generate_compute(struct llvmpipe_context *lp,
    cs_type.length = MIN2(lp_native_vector_width / 32, 16); /* n*4 elements per vector */
    snprintf(func_name, sizeof(func_name), "cs_variant");
 
-   snprintf(func_name_coro, sizeof(func_name), "cs_co_variant");
+   snprintf(func_name_coro, sizeof(func_name), use_coro ? "cs_co_variant" : "cs_sg_variant");
 
    arg_types[CS_ARG_CONTEXT] = variant->jit_cs_context_ptr_type;       /* context */
    arg_types[CS_ARG_RESOURCES]=  variant->jit_resources_ptr_type;
@@ -380,13 +414,13 @@ generate_compute(struct llvmpipe_context *lp,
    arg_types[CS_ARG_CORO_BLOCK_Y_SIZE] = int32_type;                   /* coro block_y_size */
    arg_types[CS_ARG_CORO_BLOCK_Z_SIZE] = int32_type;                   /* coro block_z_size */
    arg_types[CS_ARG_CORO_IDX] = int32_type;                            /* coro idx */
-   arg_types[CS_ARG_CORO_MEM] = LLVMPointerType(LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0), 0);
    arg_types[CS_ARG_CORO_OUTPUTS] = LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0); /* mesh shaders only */
 
    func_type = LLVMFunctionType(LLVMVoidTypeInContext(gallivm->context),
                                 arg_types, CS_ARG_OUTER_COUNT, 0);
 
-   coro_func_type = LLVMFunctionType(LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0),
+   coro_func_type = LLVMFunctionType(use_coro ? LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0) :
+                                                LLVMVoidTypeInContext(gallivm->context),
                                      arg_types, CS_ARG_MAX - (!is_mesh), 0);
 
    function = LLVMAddFunction(gallivm->module, func_name, func_type);
@@ -394,7 +428,8 @@ generate_compute(struct llvmpipe_context *lp,
 
    coro = LLVMAddFunction(gallivm->module, func_name_coro, coro_func_type);
    LLVMSetFunctionCallConv(coro, LLVMCCallConv);
-   lp_build_coro_add_presplit(coro);
+   if (use_coro)
+      lp_build_coro_add_presplit(coro);
 
    variant->function = function;
 
@@ -579,91 +614,96 @@ generate_compute(struct llvmpipe_context *lp,
    LLVMValueRef num_subgroup_loop = LLVMBuildAdd(gallivm->builder, invocation_count, lp_build_const_int32(gallivm, cs_type.length - 1), "");
    num_subgroup_loop = LLVMBuildUDiv(gallivm->builder, num_subgroup_loop, vec_length, "");
 
-   /* build a ptr in memory to store all the frames in later. */
-   LLVMTypeRef hdl_ptr_type = LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0);
-   LLVMValueRef coro_mem = LLVMBuildAlloca(gallivm->builder, hdl_ptr_type, "coro_mem");
-   LLVMBuildStore(builder, LLVMConstNull(hdl_ptr_type), coro_mem);
+   LLVMValueRef args[CS_ARG_MAX];
+   args[CS_ARG_CONTEXT] = context_ptr;
+   args[CS_ARG_RESOURCES] = resources_ptr;
+   args[CS_ARG_BLOCK_X_SIZE] = LLVMGetUndef(int32_type);
+   args[CS_ARG_BLOCK_Y_SIZE] = LLVMGetUndef(int32_type);
+   args[CS_ARG_BLOCK_Z_SIZE] = LLVMGetUndef(int32_type);
+   args[CS_ARG_GRID_X] = grid_x_arg;
+   args[CS_ARG_GRID_Y] = grid_y_arg;
+   args[CS_ARG_GRID_Z] = grid_z_arg;
+   args[CS_ARG_GRID_SIZE_X] = grid_size_x_arg;
+   args[CS_ARG_GRID_SIZE_Y] = grid_size_y_arg;
+   args[CS_ARG_GRID_SIZE_Z] = grid_size_z_arg;
+   args[CS_ARG_WORK_DIM] = work_dim_arg;
+   args[CS_ARG_DRAW_ID] = draw_id_arg;
+   args[CS_ARG_VERTEX_DATA] = io_ptr;
+   args[CS_ARG_PER_THREAD_DATA] = thread_data_ptr;
+   args[CS_ARG_CORO_SUBGROUP_COUNT] = num_subgroup_loop;
+   args[CS_ARG_CORO_PARTIALS] = partials;
+   args[CS_ARG_CORO_BLOCK_X_SIZE] = block_x_size_arg;
+   args[CS_ARG_CORO_BLOCK_Y_SIZE] = block_y_size_arg;
+   args[CS_ARG_CORO_BLOCK_Z_SIZE] = block_z_size_arg;
 
-   LLVMValueRef coro_hdls = LLVMBuildArrayAlloca(gallivm->builder, hdl_ptr_type, num_subgroup_loop, "coro_hdls");
+   if (is_mesh)
+      args[CS_ARG_CORO_OUTPUTS] = output_array;
+
+   if (!use_coro) {
+      /* Nothing suspends, run the SIMD chunks one after the other. */
+      struct lp_build_loop_state subgroup_loop;
+
+      lp_build_loop_begin(&subgroup_loop, gallivm,
+                          lp_build_const_int32(gallivm, 0));
+      args[CS_ARG_CORO_IDX] = subgroup_loop.counter;
+      LLVMBuildCall2(gallivm->builder, coro_func_type, coro, args, CS_ARG_MAX - !is_mesh, "");
+      lp_build_loop_end_cond(&subgroup_loop,
+                             num_subgroup_loop,
+                             NULL, LLVMIntUGE);
+   } else {
+      /* build a ptr in memory to store all the frames in later. */
+      LLVMTypeRef hdl_ptr_type = LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0);
+      LLVMValueRef coro_hdls = LLVMBuildArrayAlloca(gallivm->builder, hdl_ptr_type, num_subgroup_loop, "coro_hdls");
 
-   unsigned end_coroutine = INT_MAX;
+      unsigned end_coroutine = INT_MAX;
 
-   /*
-    * This is the main coroutine execution loop. It iterates over the dimensions
-    * and calls the coroutine main entrypoint on the first pass, but in subsequent
-    * passes it checks if the coroutine has completed and resumes it if not.
-    */
-   lp_build_loop_begin(&loop_state[1], gallivm,
-                       lp_build_const_int32(gallivm, 0)); /* coroutine reentry loop */
-   lp_build_loop_begin(&loop_state[0], gallivm,
-                       lp_build_const_int32(gallivm, 0)); /* subgroup loop */
-   {
-      LLVMValueRef args[CS_ARG_MAX];
-      args[CS_ARG_CONTEXT] = context_ptr;
-      args[CS_ARG_RESOURCES] = resources_ptr;
-      args[CS_ARG_BLOCK_X_SIZE] = LLVMGetUndef(int32_type);
-      args[CS_ARG_BLOCK_Y_SIZE] = LLVMGetUndef(int32_type);
-      args[CS_ARG_BLOCK_Z_SIZE] = LLVMGetUndef(int32_type);
-      args[CS_ARG_GRID_X] = grid_x_arg;
-      args[CS_ARG_GRID_Y] = grid_y_arg;
-      args[CS_ARG_GRID_Z] = grid_z_arg;
-      args[CS_ARG_GRID_SIZE_X] = grid_size_x_arg;
-      args[CS_ARG_GRID_SIZE_Y] = grid_size_y_arg;
-      args[CS_ARG_GRID_SIZE_Z] = grid_size_z_arg;
-      args[CS_ARG_WORK_DIM] = work_dim_arg;
-      args[CS_ARG_DRAW_ID] = draw_id_arg;
-      args[CS_ARG_VERTEX_DATA] = io_ptr;
-      args[CS_ARG_PER_THREAD_DATA] = thread_data_ptr;
-      args[CS_ARG_CORO_SUBGROUP_COUNT] = num_subgroup_loop;
-      args[CS_ARG_CORO_PARTIALS] = partials;
-      args[CS_ARG_CORO_BLOCK_X_SIZE] = block_x_size_arg;
-      args[CS_ARG_CORO_BLOCK_Y_SIZE] = block_y_size_arg;
-      args[CS_ARG_CORO_BLOCK_Z_SIZE] = block_z_size_arg;
-
-      args[CS_ARG_CORO_IDX] = loop_state[0].counter;
-
-      args[CS_ARG_CORO_MEM] = coro_mem;
-
-      if (is_mesh)
-         args[CS_ARG_CORO_OUTPUTS] = output_array;
-
-      LLVMValueRef coro_entry = LLVMBuildGEP2(gallivm->builder, hdl_ptr_type, coro_hdls, &loop_state[0].counter, 1, "");
-
-      LLVMValueRef coro_hdl = LLVMBuildLoad2(gallivm->builder, hdl_ptr_type, coro_entry, "coro_hdl");
-
-      struct lp_build_if_state ifstate;
-      LLVMValueRef cmp = LLVMBuildICmp(gallivm->builder, LLVMIntEQ, loop_state[1].counter,
-                                       lp_build_const_int32(gallivm, 0), "");
-      /* first time here - call the coroutine function entry point */
-      lp_build_if(&ifstate, gallivm, cmp);
-      LLVMValueRef coro_ret = LLVMBuildCall2(gallivm->builder, coro_func_type, coro, args, CS_ARG_MAX - !is_mesh, "");
-      LLVMBuildStore(gallivm->builder, coro_ret, coro_entry);
-      lp_build_else(&ifstate);
-      /* subsequent calls for this invocation - check if done. */
-      LLVMValueRef coro_done = lp_build_coro_done(gallivm, coro_hdl);
-      struct lp_build_if_state ifstate2;
-      lp_build_if(&ifstate2, gallivm, coro_done);
-      /* if done destroy and force loop exit */
-      lp_build_coro_destroy(gallivm, coro_hdl);
-      lp_build_loop_force_set_counter(&loop_state[1], lp_build_const_int32(gallivm, end_coroutine - 1));
-      lp_build_else(&ifstate2);
-      /* otherwise resume the coroutine */
-      lp_build_coro_resume(gallivm, coro_hdl);
-      lp_build_endif(&ifstate2);
-      lp_build_endif(&ifstate);
-      lp_build_loop_force_reload_counter(&loop_state[1]);
+      /*
+       * This is the main coroutine execution loop. It iterates over the dimensions
+       * and calls the coroutine main entrypoint on the first pass, but in subsequent
+       * passes it checks if the coroutine has completed and resumes it if not.
+       */
+      lp_build_loop_begin(&loop_state[1], gallivm,
+                          lp_build_const_int32(gallivm, 0)); /* coroutine reentry loop */
+      lp_build_loop_begin(&loop_state[0], gallivm,
+                          lp_build_const_int32(gallivm, 0)); /* subgroup loop */
+      {
+         args[CS_ARG_CORO_IDX] = loop_state[0].counter;
+
+         LLVMValueRef coro_entry = LLVMBuildGEP2(gallivm->builder, hdl_ptr_type, coro_hdls, &loop_state[0].counter, 1, "");
+
+         LLVMValueRef coro_hdl = LLVMBuildLoad2(gallivm->builder, hdl_ptr_type, coro_entry, "coro_hdl");
+
+         struct lp_build_if_state ifstate;
+         LLVMValueRef cmp = LLVMBuildICmp(gallivm->builder, LLVMIntEQ, loop_state[1].counter,
+                                          lp_build_const_int32(gallivm, 0), "");
+         /* first time here - call the coroutine function entry point */
+         lp_build_if(&ifstate, gallivm, cmp);
+         LLVMValueRef coro_ret = LLVMBuildCall2(gallivm->builder, coro_func_type, coro, args, CS_ARG_MAX - !is_mesh, "");
+         LLVMBuildStore(gallivm->builder, coro_ret, coro_entry);
+         lp_build_else(&ifstate);
+         /* subsequent calls for this invocation - check if done. */
+         LLVMValueRef coro_done = lp_build_coro_done(gallivm, coro_hdl);
+         struct lp_build_if_state ifstate2;
+         lp_build_if(&ifstate2, gallivm, coro_done);
+         /* if done destroy and force loop exit */
+         lp_build_coro_destroy(gallivm, coro_hdl);
+         lp_build_loop_force_set_counter(&loop_state[1], lp_build_const_int32(gallivm, end_coroutine - 1));
+         lp_build_else(&ifstate2);
+         /* otherwise resume the coroutine */
+         lp_build_coro_resume(gallivm, coro_hdl);
+         lp_build_endif(&ifstate2);
+         lp_build_endif(&ifstate);
+         lp_build_loop_force_reload_counter(&loop_state[1]);
+      }
+      lp_build_loop_end_cond(&loop_state[0],
+                             num_subgroup_loop,
+                             NULL,  LLVMIntUGE);
+      lp_build_loop_end_cond(&loop_state[1],
+                             lp_build_const_int32(gallivm, end_coroutine),
+                             NULL, LLVMIntEQ);
+
+      /* The frame memory stays with the thread data, cs_exec_fn owns it. */
    }
-   lp_build_loop_end_cond(&loop_state[0],
-                          num_subgroup_loop,
-                          NULL,  LLVMIntUGE);
-   lp_build_loop_end_cond(&loop_state[1],
-                          lp_build_const_int32(gallivm, end_coroutine),
-                          NULL, LLVMIntEQ);
-
-   LLVMValueRef coro_mem_ptr = LLVMBuildLoad2(builder, hdl_ptr_type, coro_mem, "");
-   LLVMTypeRef mem_ptr_type = LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0);
-   LLVMTypeRef free_type = LLVMFunctionType(LLVMVoidTypeInContext(gallivm->context), &mem_ptr_type, 1, 0);
-   LLVMBuildCall2(gallivm->builder, free_type, gallivm->coro_free_hook, &coro_mem_ptr, 1, "");
 
    LLVMBuildRetVoid(builder);
 
@@ -686,7 +726,6 @@ generate_compute(struct llvmpipe_context *lp,
    block_y_size_arg = LLVMGetParam(coro, CS_ARG_CORO_BLOCK_Y_SIZE);
    block_z_size_arg = LLVMGetParam(coro, CS_ARG_CORO_BLOCK_Z_SIZE);
    LLVMValueRef subgroup_id = LLVMGetParam(coro, CS_ARG_CORO_IDX);
-   coro_mem = LLVMGetParam(coro, CS_ARG_CORO_MEM);
    if (is_mesh)
       output_array = LLVMGetParam(coro, CS_ARG_CORO_OUTPUTS);
    block = LLVMAppendBasicBlockInContext(gallivm->context, coro, "entry");
@@ -715,12 +754,23 @@ generate_compute(struct llvmpipe_context *lp,
                                                   thread_data_ptr);
 
       /* these are coroutine entrypoint necessities */
-      LLVMValueRef coro_id = lp_build_coro_id(gallivm);
-      LLVMValueRef coro_entry = lp_build_coro_alloc_mem_array(gallivm, coro_mem, subgroup_id, num_subgroup_loop);
-      LLVMTypeRef mem_ptr_type = LLVMInt8TypeInContext(gallivm->context);
-      LLVMValueRef alloced_ptr = LLVMBuildLoad2(gallivm->builder, hdl_ptr_type, coro_mem, "");
-      alloced_ptr = LLVMBuildGEP2(gallivm->builder, mem_ptr_type, alloced_ptr, &coro_entry, 1, "");
-      LLVMValueRef coro_hdl = lp_build_coro_begin(gallivm, coro_id, alloced_ptr);
+      LLVMValueRef coro_hdl = NULL;
+      if (use_coro) {
+         LLVMTypeRef hdl_ptr_type = LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0);
+         LLVMValueRef coro_mem = lp_jit_cs_thread_data_coro_mem(gallivm,
+                                                                variant->jit_cs_thread_data_type,
+                                                                thread_data_ptr);
+         LLVMValueRef coro_mem_size = lp_jit_cs_thread_data_coro_mem_size(gallivm,
+                                                                          variant->jit_cs_thread_data_type,
+                                                                          thread_data_ptr);
+         LLVMValueRef coro_id = lp_build_coro_id(gallivm);
+         LLVMValueRef coro_entry = lp_build_coro_alloc_mem_array(gallivm, coro_mem, coro_mem_size,
+                                                                 subgroup_id, num_subgroup_loop);
+         LLVMTypeRef mem_ptr_type = LLVMInt8TypeInContext(gallivm->context);
+         LLVMValueRef alloced_ptr = LLVMBuildLoad2(gallivm->builder, hdl_ptr_type, coro_mem, "");
+         alloced_ptr = LLVMBuildGEP2(gallivm->builder, mem_ptr_type, alloced_ptr, &coro_entry, 1, "");
+         coro_hdl = lp_build_coro_begin(gallivm, coro_id, alloced_ptr);
+      }
       LLVMValueRef has_partials = LLVMBuildICmp(gallivm->builder, LLVMIntNE, partials, lp_build_const_int32(gallivm, 0), "");
 
       struct lp_build_context bld;
@@ -780,9 +830,12 @@ generate_compute(struct llvmpipe_context *lp,
       lp_build_mask_begin(&mask, gallivm, cs_type, mask_val);
 
       struct lp_build_coro_suspend_info coro_info;
+      LLVMBasicBlockRef sus_block = NULL, clean_block = NULL;
 
-      LLVMBasicBlockRef sus_block = LLVMAppendBasicBlockInContext(gallivm->context, coro, "suspend");
-      LLVMBasicBlockRef clean_block = LLVMAppendBasicBlockInContext(gallivm->context, coro, "cleanup");
+      if (use_coro) {
+         sus_block = LLVMAppendBasicBlockInContext(gallivm->context, coro, "suspend");
+         clean_block = LLVMAppendBasicBlockInContext(gallivm->context, coro, "cleanup");
+      }
 
       coro_info.suspend = sus_block;
       coro_info.cleanup = clean_block;
@@ -813,7 +866,7 @@ generate_compute(struct llvmpipe_context *lp,
       params.image = image;
       params.shared_ptr = shared_ptr;
       params.payload_ptr = payload_ptr;
-      params.coro = &coro_info;
+      params.coro = use_coro ? &coro_info : NULL;
       params.kernel_args = kernel_args_ptr;
       params.aniso_filter_table = lp_jit_resources_aniso_filter_table(gallivm,
                                                                       variant->jit_resources_type,
@@ -894,14 +947,18 @@ generate_compute(struct llvmpipe_context *lp,
 
       mask_val = lp_build_mask_end(&mask);
 
-      lp_build_coro_suspend_switch(gallivm, &coro_info, NULL, true);
-      LLVMPositionBuilderAtEnd(builder, clean_block);
+      if (!use_coro) {
+         LLVMBuildRetVoid(builder);
+      } else {
+         lp_build_coro_suspend_switch(gallivm, &coro_info, NULL, true);
+         LLVMPositionBuilderAtEnd(builder, clean_block);
 
-      LLVMBuildBr(builder, sus_block);
-      LLVMPositionBuilderAtEnd(builder, sus_block);
+         LLVMBuildBr(builder, sus_block);
+         LLVMPositionBuilderAtEnd(builder, sus_block);
 
-      lp_build_coro_end(gallivm, coro_hdl);
-      LLVMBuildRet(builder, coro_hdl);
+         lp_build_coro_end(gallivm, coro_hdl);
+         LLVMBuildRet(builder, coro_hdl);
+      }
    }
 
    lp_bld_llvm_sampler_soa_destroy(sampler);
@@ -1374,6 +1431,8 @@ llvmpipe_update_cs_variant(struct llvmpipe_context *lp,
       dt = t1 - t0;
       LP_COUNT_ADD(llvm_compile_time, dt);
       LP_COUNT_ADD(nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
+      lp_perf_add(&lp->perf, LP_PERF_COUNTER_LLVM_COMPILE_TIME, dt);
+      lp_perf_add(&lp->perf, LP_PERF_COUNTER_LLVM_COMPILES, 1);
 
       /* Put the new variant into the list */
       if (variant) {
@@ -1641,6 +1700,8 @@ cs_exec_fn(void *init_data, int iter_idx, struct lp_cs_local_mem *lmem)
    thread_data.shared = lmem->local_mem_ptr;
 
    thread_data.payload = job_info->payload;
+   thread_data.coro_mem = lmem->coro_mem_ptr;
+   thread_data.coro_mem_size = lmem->coro_mem_size;
 
    unsigned grid_z, grid_y, grid_x;
 
@@ -1676,6 +1737,10 @@ cs_exec_fn(void *init_data, int iter_idx, struct lp_cs_local_mem *lmem)
                          job_info->work_dim, job_info->draw_id,
                          io_ptr,
                          &thread_data);
+
+   /* keep the coroutine frames for the next workgroup on this thread */
+   lmem->coro_mem_ptr = thread_data.coro_mem;
+   lmem->coro_mem_size = thread_data.coro_mem_size;
 }
 
 
@@ -3161,6 +3161,17 @@ generate_fragment(struct llvmpipe_context *lp,
    fs_type.norm = false;         /* values are not limited to [0,1] or [-1,1] */
    fs_type.width = 32;           /* 32-bit float */
    fs_type.length = MIN2(lp_native_vector_width / 32, 16); /* n*4 elements per vector */
+   /* 1d resources only run the upper half of the stamp, which is 8 pixels */
+   if (key->resource_1d)
+      fs_type.length = MIN2(fs_type.length, 8);
+
+   /*
+    * The blend code works on at most 8-wide vectors. With 16-wide shading
+    * a vector covers the whole 4x4 stamp in the same order as two 8-wide
+    * ones, so blending just reads the shader outputs in 8-wide pieces.
+    */
+   struct lp_type blend_fs_type = fs_type;
+   blend_fs_type.length = MIN2(fs_type.length, 8);
 
    struct lp_type blend_type;
    memset(&blend_type, 0, sizeof blend_type);
@@ -3293,6 +3304,7 @@ generate_fragment(struct llvmpipe_context *lp,
    /* for 1d resources only run "upper half" of stamp */
    if (key->resource_1d)
       num_fs /= 2;
+   const unsigned blend_num_fs = num_fs * fs_type.length / blend_fs_type.length;
 
    {
       LLVMValueRef num_loop = lp_build_const_int32(gallivm, num_fs);
@@ -3428,20 +3440,21 @@ generate_fragment(struct llvmpipe_context *lp,
                        variant->jit_thread_data_type,
                        thread_data_ptr);
 
-      LLVMTypeRef fs_vec_type = lp_build_vec_type(gallivm, fs_type);
-      for (unsigned i = 0; i < num_fs; i++) {
+      LLVMTypeRef fs_vec_type = lp_build_vec_type(gallivm, blend_fs_type);
+      LLVMTypeRef blend_mask_type = lp_build_int_vec_type(gallivm, blend_fs_type);
+      for (unsigned i = 0; i < blend_num_fs; i++) {
          LLVMValueRef ptr;
          for (unsigned s = 0; s < key->coverage_samples; s++) {
-            int idx = (i + (s * num_fs));
+            int idx = (i + (s * blend_num_fs));
             LLVMValueRef sindexi = lp_build_const_int32(gallivm, idx);
-            ptr = LLVMBuildGEP2(builder, mask_type, mask_store, &sindexi, 1, "");
+            ptr = LLVMBuildGEP2(builder, blend_mask_type, mask_store, &sindexi, 1, "");
 
-            fs_mask[idx] = LLVMBuildLoad2(builder, mask_type, ptr, "smask");
+            fs_mask[idx] = LLVMBuildLoad2(builder, blend_mask_type, ptr, "smask");
          }
 
          for (unsigned s = 0; s < key->min_samples; s++) {
             /* This is fucked up need to reorganize things */
-            int idx = s * num_fs + i;
+            int idx = s * blend_num_fs + i;
             LLVMValueRef sindexi = lp_build_const_int32(gallivm, idx);
             for (unsigned cbuf = 0; cbuf < key->nr_cbufs; cbuf++) {
                for (unsigned chan = 0; chan < TGSI_NUM_CHANNELS; ++chan) {
@@ -3502,7 +3515,7 @@ generate_fragment(struct llvmpipe_context *lp,
                                                          &index, 1, ""), "");
 
          for (unsigned s = 0; s < key->cbuf_nr_samples[cbuf]; s++) {
-            unsigned mask_idx = num_fs * (key->multisample ? s : 0);
+            unsigned mask_idx = blend_num_fs * (key->multisample ? s : 0);
             unsigned out_idx = key->min_samples == 1 ? 0 : s;
             LLVMValueRef out_ptr = color_ptr;
 
@@ -3519,7 +3532,8 @@ generate_fragment(struct llvmpipe_context *lp,
 
             generate_unswizzled_blend(gallivm, cbuf, variant,
                                       key->cbuf_format[cbuf],
-                                      num_fs, fs_type, &fs_mask[mask_idx],
+                                      blend_num_fs, blend_fs_type,
+                                      &fs_mask[mask_idx],
                                       fs_out_color[out_idx],
                                       variant->jit_context_type,
                                       context_ptr, blend_vec_type, out_ptr, stride,
@@ -3633,6 +3647,8 @@ dump_fs_variant_key(struct lp_fragment_shader_variant_key *key)
                    util_str_tex_target(texture->target, true));
       debug_printf("  .level_zero_only = %u\n",
                    texture->level_zero_only);
+      debug_printf("  .tiled = %u\n",
+                   texture->tiled);
       debug_printf("  .pot = %u %u %u\n",
                    texture->pot_width,
                    texture->pot_height,
@@ -3686,6 +3702,8 @@ lp_debug_fs_variant(struct lp_fragment_shader_variant *variant)
    debug_printf("variant->opaque = %u\n", variant->opaque);
    debug_printf("variant->potentially_opaque = %u\n", variant->potentially_opaque);
    debug_printf("variant->blit = %u\n", variant->blit);
+   debug_printf("variant->depth_cull = %u\n", variant->depth_cull);
+   debug_printf("variant->depth_raise = %u\n", variant->depth_raise);
    debug_printf("shader->kind = %s\n", lp_debug_fs_kind(variant->shader->kind));
    debug_printf("\n");
 }
@@ -3831,6 +3849,7 @@ generate_variant(struct llvmpipe_context *lp,
       }
 
       if (target == PIPE_TEXTURE_2D &&
+          !samp0->texture_state.tiled &&
           min_img_filter == PIPE_TEX_FILTER_NEAREST &&
           mag_img_filter == PIPE_TEX_FILTER_NEAREST &&
           min_mip_filter == PIPE_TEX_MIPFILTER_NONE &&
@@ -3846,6 +3865,33 @@ generate_variant(struct llvmpipe_context *lp,
       }
    }
 
+   /* Primitives lying entirely behind the depth buffer contents can only
+    * be skipped if the fragments failing the depth test have no other
+    * effect, and the depth they're tested with is the interpolated one.
+    */
+   const bool depth_func_le =
+         key->depth.func == PIPE_FUNC_NEVER ||
+         key->depth.func == PIPE_FUNC_LESS ||
+         key->depth.func == PIPE_FUNC_EQUAL ||
+         key->depth.func == PIPE_FUNC_LEQUAL;
+   const bool shader_depth =
+         (nir->info.outputs_written & BITFIELD64_BIT(FRAG_RESULT_DEPTH)) != 0;
+
+   variant->depth_cull =
+         key->depth.enabled &&
+         depth_func_le &&
+         !key->stencil[0].enabled &&
+         !key->depth_clamp &&
+         !shader_depth &&
+         (!nir->info.writes_memory || nir->info.fs.early_fragment_tests);
+
+   variant->depth_raise =
+         key->depth.enabled &&
+         key->depth.writemask &&
+         !depth_func_le;
+
+   variant->depth_unbounded = shader_depth || key->depth_clamp;
+
    /* Determine whether this shader + pipeline state is a candidate for
     * the linear path.
     */
@@ -4703,6 +4749,8 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
       int64_t dt = t1 - t0;
       LP_COUNT_ADD(llvm_compile_time, dt);
       LP_COUNT_ADD(nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
+      lp_perf_add(&lp->perf, LP_PERF_COUNTER_LLVM_COMPILE_TIME, dt);
+      lp_perf_add(&lp->perf, LP_PERF_COUNTER_LLVM_COMPILES, 1);
 
       /* Put the new variant into the list */
       if (variant) {
@@ -150,6 +150,14 @@ struct lp_fragment_shader_variant
 
    unsigned opaque:1;
    unsigned blit:1;
+
+   /*
+    * Depth culling, see lp_setup_depth_bounds().
+    */
+   unsigned depth_cull:1;        /**< occluded primitives may be skipped */
+   unsigned depth_raise:1;       /**< depth writes may increase depth */
+   unsigned depth_unbounded:1;   /**< written depth may lie outside the
+                                      primitive's depth range */
    unsigned linear_input_mask:16;
    struct pipe_reference reference;
 
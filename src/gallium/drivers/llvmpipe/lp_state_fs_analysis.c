@@ -202,13 +202,59 @@ check_load_const_in_zero_one(const nir_load_const_instr *load)
 }
 
 
+/*
+ * Check that the sources of an arithmetic instruction are known to be in
+ * [0,1]: immediates must be in range and FS inputs aren't allowed.
+ * Texels and uniforms are in range or are checked at draw time.
+ */
+static bool
+check_alu_srcs_in_zero_one(const nir_alu_instr *alu)
+{
+   unsigned num_src = nir_op_infos[alu->op].num_inputs;
+   for (unsigned s = 0; s < num_src; s++) {
+      if (nir_src_is_const(alu->src[s].src)) {
+         nir_load_const_instr *load =
+            nir_instr_as_load_const(alu->src[s].src.ssa->parent_instr);
+         if (!check_load_const_in_zero_one(load)) {
+            return false;
+         }
+      } else if (is_fs_input(&alu->src[s].src)) {
+         /* we don't know if the fs inputs are in [0,1] */
+         return false;
+      }
+   }
+   return true;
+}
+
+
+/*
+ * Check whether the given value is (transitively) used by an fmul.
+ */
+static bool
+def_reaches_fmul(const nir_def *def)
+{
+   nir_foreach_use(src, def) {
+      const nir_instr *user = nir_src_parent_instr(src);
+      if (user->type != nir_instr_type_alu)
+         continue;
+
+      const nir_alu_instr *alu = nir_instr_as_alu(user);
+      if (alu->op == nir_op_fmul || def_reaches_fmul(&alu->def))
+         return true;
+   }
+   return false;
+}
+
+
 /*
  * Examine the NIR shader to determine if it's "linear".
  * For the linear path, we're optimizing the case of rendering a window-
  * aligned, textured quad.  Basically, FS must get the output color from
- * a texture lookup and, possibly, a constant color.  If the color comes
- * from some other sort of computation or from a VS output (FS input), we
- * can't use the linear path.
+ * a texture lookup and, possibly, a constant color.  Texels may be
+ * modulated by other texels or constants, and simple color-matrix ops
+ * (sums, min/max and saturation) are allowed as long as every value stays
+ * in [0,1].  If the color comes from some other sort of computation or
+ * from a VS output (FS input), we can't use the linear path.
  */
 static bool
 llvmpipe_nir_fn_is_linear_compat(const struct nir_shader *shader,
@@ -248,6 +294,9 @@ llvmpipe_nir_fn_is_linear_compat(const struct nir_shader *shader,
                   nir_instr_as_load_const(intrin->src[0].ssa->parent_instr);
                if (load->value[0].u32 != 0 || load->def.num_components > 1)
                   return false;
+               /* e.g. color matrix columns, fetched at fixed offsets */
+               if (!nir_src_is_const(intrin->src[1]))
+                  return false;
             } else if (intrin->intrinsic == nir_intrinsic_store_deref) {
                /*
                 * Assume the store destination is the FS output color.
@@ -325,25 +374,20 @@ llvmpipe_nir_fn_is_linear_compat(const struct nir_shader *shader,
             case nir_op_vec4:
                // these instructions are OK
                break;
-            case nir_op_fmul: {
-               unsigned num_src = nir_op_infos[alu->op].num_inputs;;
-               for (unsigned s = 0; s < num_src; s++) {
-                  /* If the MUL uses immediate values, the values must
-                   * be 32-bit floats in the range [0,1].
-                   */
-                  if (nir_src_is_const(alu->src[s].src)) {
-                     nir_load_const_instr *load =
-                        nir_instr_as_load_const(alu->src[s].src.ssa->parent_instr);
-                     if (!check_load_const_in_zero_one(load)) {
-                        return false;
-                     }
-                  } else if (is_fs_input(&alu->src[s].src)) {
-                     /* we don't know if the fs inputs are in [0,1] */
-                     return false;
-                  }
-               }
+            case nir_op_fadd:
+               /* The unorm8 code saturates every sum, which only matches
+                * float math if the sum isn't scaled down again later.
+                */
+               if (def_reaches_fmul(&alu->def))
+                  return false;
+               FALLTHROUGH;
+            case nir_op_fmul:
+            case nir_op_fmin:
+            case nir_op_fmax:
+            case nir_op_fsat:
+               if (!check_alu_srcs_in_zero_one(alu))
+                  return false;
                break;
-            }
             default:
                // disallowed instruction
                return false;
@@ -28,6 +28,7 @@
 #include "util/u_rect.h"
 #include "util/u_surface.h"
 #include "util/u_memset.h"
+#include "lp_blit_kernel.h"
 #include "lp_context.h"
 #include "lp_flush.h"
 #include "lp_limits.h"
@@ -145,6 +146,9 @@ lp_blit(struct pipe_context *pipe,
       return;
    }
 
+   if (llvmpipe_blit_with_kernel(lp, &info))
+      return;
+
    if (!util_blitter_is_blit_supported(lp->blitter, &info)) {
       debug_printf("llvmpipe: blit unsupported %s -> %s\n",
                    util_format_short_name(info.src.resource->format),
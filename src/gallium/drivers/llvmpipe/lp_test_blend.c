@@ -627,6 +627,8 @@ blend_funcs[] = {
 const struct lp_type blend_types[] = {
    /* float, fixed,  sign,  norm, width, len */
    {   true, false,  true, false,    32,   4 }, /* f32 x 4 */
+   {   true, false,  true, false,    32,   8 }, /* f32 x 8 */
+   {   true, false,  true, false,    32,  16 }, /* f32 x 16 */
    {  false, false, false,  true,     8,  16 }, /* u8n x 16 */
 };
 
@@ -0,0 +1,377 @@
+/*
+ * Copyright © 2024 Mesa contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/**
+ * @file
+ * Unit tests and benchmarks for the JIT blit kernels.
+ *
+ * Each kernel is checked against the util_format pack/unpack functions
+ * for unscaled, scaled and flipped rows, with destination widths which
+ * are not a multiple of the vector width.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <float.h>
+#include <math.h>
+
+#include "util/u_memory.h"
+#include "util/format/u_format.h"
+
+#include "gallivm/lp_bld_init.h"
+
+#include "lp_blit_kernel.h"
+#include "lp_test.h"
+
+
+#define MAX_WIDTH 1024
+#define BENCH_WIDTH 1024
+
+
+static const struct {
+   enum pipe_format src;
+   enum pipe_format dst;
+} blit_formats[] = {
+   { PIPE_FORMAT_R8G8B8A8_UNORM, PIPE_FORMAT_B8G8R8A8_UNORM },
+   { PIPE_FORMAT_B8G8R8A8_UNORM, PIPE_FORMAT_R8G8B8A8_UNORM },
+   { PIPE_FORMAT_B8G8R8X8_UNORM, PIPE_FORMAT_R8G8B8A8_UNORM },
+   { PIPE_FORMAT_R8G8B8A8_UNORM, PIPE_FORMAT_R8G8B8X8_UNORM },
+   { PIPE_FORMAT_R8_UNORM, PIPE_FORMAT_R8G8B8A8_UNORM },
+   { PIPE_FORMAT_R8G8B8A8_UNORM, PIPE_FORMAT_R8_UNORM },
+   { PIPE_FORMAT_B5G6R5_UNORM, PIPE_FORMAT_R8G8B8A8_UNORM },
+   { PIPE_FORMAT_R8G8B8A8_UNORM, PIPE_FORMAT_B5G6R5_UNORM },
+   { PIPE_FORMAT_R10G10B10A2_UNORM, PIPE_FORMAT_R16G16B16A16_UNORM },
+   { PIPE_FORMAT_R8G8B8A8_SNORM, PIPE_FORMAT_R16G16_SNORM },
+   { PIPE_FORMAT_R8G8B8A8_UNORM, PIPE_FORMAT_R16G16B16A16_FLOAT },
+   { PIPE_FORMAT_R16G16B16A16_FLOAT, PIPE_FORMAT_R8G8B8A8_UNORM },
+   { PIPE_FORMAT_R32G32B32A32_FLOAT, PIPE_FORMAT_B8G8R8A8_UNORM },
+   { PIPE_FORMAT_R16G16B16A16_FLOAT, PIPE_FORMAT_R32G32B32A32_FLOAT },
+   { PIPE_FORMAT_R32_FLOAT, PIPE_FORMAT_R16_FLOAT },
+   { PIPE_FORMAT_R8G8B8A8_UINT, PIPE_FORMAT_R16G16B16A16_UINT },
+   { PIPE_FORMAT_R16G16B16A16_UINT, PIPE_FORMAT_R8G8B8A8_UINT },
+   { PIPE_FORMAT_R8G8_SINT, PIPE_FORMAT_R32G32B32A32_SINT },
+};
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "cycles_per_pixel\t"
+           "src_format\t"
+           "dst_format\n");
+
+   fflush(fp);
+}
+
+
+static void
+write_tsv_row(FILE *fp,
+              enum pipe_format src_format,
+              enum pipe_format dst_format,
+              double cycles,
+              bool success)
+{
+   fprintf(fp, "%s\t", success ? "pass" : "fail");
+
+   fprintf(fp, "%.2f\t", cycles);
+
+   fprintf(fp, "%s\t%s\n",
+           util_format_name(src_format),
+           util_format_name(dst_format));
+
+   fflush(fp);
+}
+
+
+static void
+setup_fixed_point(int src_size, int dst_size, int32_t *start, int32_t *step)
+{
+   const int32_t abs_step = (abs(src_size) << 16) / dst_size;
+
+   if (src_size > 0) {
+      *start = abs_step / 2;
+      *step = abs_step;
+   } else {
+      *start = (-src_size << 16) - abs_step / 2;
+      *step = -abs_step;
+   }
+}
+
+
+static void
+fill_src(enum pipe_format format, uint8_t *src, unsigned width)
+{
+   const unsigned bpp = util_format_get_blocksize(format);
+
+   for (unsigned x = 0; x < width; x++) {
+      union {
+         float f[4];
+         uint32_t ui[4];
+         int32_t i[4];
+      } rgba;
+
+      for (unsigned c = 0; c < 4; c++) {
+         if (util_format_is_pure_uint(format))
+            rgba.ui[c] = rand() % 256;
+         else if (util_format_is_pure_sint(format))
+            rgba.i[c] = rand() % 201 - 100;
+         else if (util_format_is_snorm(format))
+            rgba.f[c] = random_float() * 2.0f - 1.0f;
+         else
+            rgba.f[c] = random_float();
+      }
+
+      util_format_pack_rgba(format, src + x * bpp, &rgba, 1);
+   }
+}
+
+
+/**
+ * Maximum difference allowed in component c of an unpacked pixel, one
+ * unit in the last place for normalized formats.
+ */
+static double
+component_eps(const struct util_format_description *desc, unsigned c,
+              double ref)
+{
+   const unsigned swz = desc->swizzle[c];
+
+   if (swz > PIPE_SWIZZLE_W)
+      return 0.0;
+
+   const struct util_format_channel_description *chan =
+      &desc->channel[swz];
+
+   if (chan->pure_integer)
+      return 0.0;
+
+   if (chan->type == UTIL_FORMAT_TYPE_FLOAT)
+      return chan->size == 16 ? MAX2(fabs(ref), 1.0) / 1024.0 : FLT_EPSILON;
+
+   const unsigned bits = chan->type == UTIL_FORMAT_TYPE_SIGNED ?
+                         chan->size - 1 : chan->size;
+   return 1.01 / ((1ull << bits) - 1);
+}
+
+
+static bool
+compare_pixel(const struct util_format_description *desc,
+              const uint8_t *res, const uint8_t *ref)
+{
+   union {
+      float f[4];
+      int32_t i[4];
+   } res_rgba, ref_rgba;
+
+   util_format_unpack_rgba(desc->format, &res_rgba, res, 1);
+   util_format_unpack_rgba(desc->format, &ref_rgba, ref, 1);
+
+   for (unsigned c = 0; c < 4; c++) {
+      if (util_format_is_pure_integer(desc->format)) {
+         if (res_rgba.i[c] != ref_rgba.i[c])
+            return false;
+      } else {
+         const double diff = fabs(res_rgba.f[c] - ref_rgba.f[c]);
+         if (diff > component_eps(desc, c, ref_rgba.f[c]))
+            return false;
+      }
+   }
+
+   return true;
+}
+
+
+static bool
+test_row(unsigned verbose,
+         const struct lp_blit_kernel *kernel,
+         const uint8_t *src, int src_width,
+         uint8_t *dst, uint8_t *ref, int dst_width)
+{
+   const struct util_format_description *dst_desc =
+      util_format_description(kernel->dst_format);
+   const unsigned src_bpp = util_format_get_blocksize(kernel->src_format);
+   const unsigned dst_bpp = util_format_get_blocksize(kernel->dst_format);
+   int32_t x0, dx;
+
+   setup_fixed_point(src_width, dst_width, &x0, &dx);
+
+   for (int x = 0; x < dst_width; x++) {
+      union {
+         float f[4];
+         uint32_t ui[4];
+      } rgba;
+      const int sx = (x0 + x * dx) >> 16;
+
+      util_format_unpack_rgba(kernel->src_format, &rgba,
+                              src + sx * src_bpp, 1);
+      util_format_pack_rgba(kernel->dst_format, ref + x * dst_bpp, &rgba, 1);
+   }
+
+   /* the guard pixel after the row must not be written */
+   memset(dst, 0xa5, (dst_width + 1) * dst_bpp);
+
+   kernel->row(src, dst, dst_width, x0, dx);
+
+   for (int x = 0; x < dst_width; x++) {
+      if (!compare_pixel(dst_desc, dst + x * dst_bpp, ref + x * dst_bpp)) {
+         printf("FAILED %s -> %s, %i -> %i pixels, at pixel %i\n",
+                util_format_short_name(kernel->src_format),
+                util_format_short_name(kernel->dst_format),
+                src_width, dst_width, x);
+         return false;
+      }
+   }
+
+   for (unsigned i = 0; i < dst_bpp; i++) {
+      if (dst[dst_width * dst_bpp + i] != 0xa5) {
+         printf("FAILED %s -> %s, %i pixels, wrote past the end\n",
+                util_format_short_name(kernel->src_format),
+                util_format_short_name(kernel->dst_format),
+                dst_width);
+         return false;
+      }
+   }
+
+   return true;
+}
+
+
+static bool
+test_one(unsigned verbose, FILE *fp,
+         enum pipe_format src_format,
+         enum pipe_format dst_format)
+{
+   LLVMContextRef context;
+   struct lp_blit_kernel *kernel;
+   uint8_t *src, *dst, *ref;
+   int64_t cycles[LP_TEST_NUM_SAMPLES];
+   double cycles_avg = 0.0;
+   bool success = true;
+
+   if (!lp_blit_kernel_supported(src_format, dst_format)) {
+      printf("FAILED %s -> %s not supported\n",
+             util_format_short_name(src_format),
+             util_format_short_name(dst_format));
+      return false;
+   }
+
+   if (verbose >= 1) {
+      printf("Testing %s -> %s ...\n",
+             util_format_short_name(src_format),
+             util_format_short_name(dst_format));
+      fflush(stdout);
+   }
+
+   context = LLVMContextCreate();
+#if LLVM_VERSION_MAJOR == 15
+   LLVMContextSetOpaquePointers(context, false);
+#endif
+
+   kernel = lp_blit_kernel_create(context, src_format, dst_format);
+   if (!kernel) {
+      LLVMContextDispose(context);
+      return false;
+   }
+
+   src = MALLOC(MAX_WIDTH * 16);
+   dst = MALLOC((MAX_WIDTH + 1) * 16);
+   ref = MALLOC(MAX_WIDTH * 16);
+
+   fill_src(src_format, src, MAX_WIDTH);
+
+   static const int sizes[][2] = {
+      /* src width, dst width */
+      { 1, 1 },
+      { 3, 3 },
+      { 37, 37 },
+      { 64, 64 },
+      { 37, 111 },
+      { 500, 67 },
+      { -37, 37 },
+      { -64, 29 },
+   };
+
+   for (unsigned i = 0; i < ARRAY_SIZE(sizes); i++) {
+      if (!test_row(verbose, kernel, src, sizes[i][0],
+                    dst, ref, sizes[i][1]))
+         success = false;
+   }
+
+   for (unsigned i = 0; i < LP_TEST_NUM_SAMPLES; i++) {
+      int64_t start_counter = rdtsc();
+      kernel->row(src, dst, BENCH_WIDTH, 1 << 15, 1 << 16);
+      int64_t end_counter = rdtsc();
+      cycles[i] = end_counter - start_counter;
+   }
+
+   /* skip the first sample, it includes the cold caches */
+   for (unsigned i = 1; i < LP_TEST_NUM_SAMPLES; i++)
+      cycles_avg += (double)cycles[i];
+   cycles_avg /= (LP_TEST_NUM_SAMPLES - 1) * (double)BENCH_WIDTH;
+
+   if (fp)
+      write_tsv_row(fp, src_format, dst_format, cycles_avg, success);
+
+   FREE(ref);
+   FREE(dst);
+   FREE(src);
+
+   lp_blit_kernel_destroy(kernel);
+   LLVMContextDispose(context);
+
+   return success;
+}
+
+
+bool
+test_all(unsigned verbose, FILE *fp)
+{
+   bool success = true;
+
+   for (unsigned i = 0; i < ARRAY_SIZE(blit_formats); i++) {
+      if (!test_one(verbose, fp, blit_formats[i].src, blit_formats[i].dst))
+         success = false;
+   }
+
+   return success;
+}
+
+
+bool
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_all(verbose, fp);
+}
+
+
+bool
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_one(verbose, fp,
+                   PIPE_FORMAT_R8G8B8A8_UNORM, PIPE_FORMAT_B8G8R8A8_UNORM);
+}
@@ -357,6 +357,11 @@ const struct lp_type conv_types[] = {
    {   true, false, false,  true,    32,   8 },
    {   true, false, false, false,    32,   8 },
 
+   {   true, false,  true,  true,    32,  16 },
+   {   true, false,  true, false,    32,  16 },
+   {   true, false, false,  true,    32,  16 },
+   {   true, false, false, false,    32,  16 },
+
    /* Fixed */
    {  false,  true,  true,  true,    32,   4 },
    {  false,  true,  true, false,    32,   4 },
@@ -0,0 +1,432 @@
+/*
+ * Copyright © 2024 Mesa contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/**
+ * @file
+ * Unit tests and benchmark for the linear path samplers.
+ *
+ * The AVX2 row kernels are checked against scalar versions of the SSE2
+ * code for all row widths up to a tile.
+ *
+ * The benchmark samples a compositor-like scene -- a background plus
+ * scaled and rotated windows, each with a mask texture, all bilinear
+ * filtered -- through lp_linear_init_sampler() one tile at a time, like
+ * the linear rasterizer does.  Run it with GALLIUM_OVERRIDE_CPU_CAPS=sse4.1
+ * to measure the SSE2 code instead of the AVX2 code.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "util/detect.h"
+#include "util/u_memory.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_sse.h"
+
+#include "lp_jit.h"
+#include "lp_limits.h"
+#include "lp_state_fs.h"
+#include "lp_linear_priv.h"
+#include "lp_linear_avx2.h"
+#include "lp_test.h"
+
+
+#define TEX_WIDTH 67
+#define TEX_HEIGHT 45
+#define TEX_STRIDE 80
+
+#define SCENE_WIDTH 1024
+#define SCENE_HEIGHT 768
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "cycles_per_pixel\t"
+           "test\n");
+
+   fflush(fp);
+}
+
+
+static void
+write_tsv_row(FILE *fp, const char *name, double cycles, bool success)
+{
+   fprintf(fp, "%s\t", success ? "pass" : "fail");
+
+   fprintf(fp, "%.2f\t", cycles);
+
+   fprintf(fp, "%s\n", name);
+
+   fflush(fp);
+}
+
+
+#if DETECT_ARCH_SSE
+
+static void
+fill_texels(uint32_t *data, unsigned count)
+{
+   for (unsigned i = 0; i < count; i++)
+      data[i] = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+
+/* Scalar version of util_sse2_lerp_epi16() on the four channels */
+static uint32_t
+lerp_pixel(uint32_t a, uint32_t b, unsigned w)
+{
+   uint32_t res = 0;
+
+   for (unsigned c = 0; c < 32; c += 8) {
+      int ca = (a >> c) & 0xff;
+      int cb = (b >> c) & 0xff;
+      uint16_t d = (uint16_t)((cb - ca) * (int)w);
+
+      res |= (uint32_t)(((d >> 8) + ca) & 0xff) << c;
+   }
+
+   return res;
+}
+
+
+static uint32_t
+lerp_2d_pixel(const uint32_t *data, int stride,
+              int s0, int s1, int t0, int t1, int s, int t)
+{
+   const unsigned ws = (s >> 8) & 0xff;
+   const unsigned wt = (t >> 8) & 0xff;
+
+   uint32_t a = lerp_pixel(data[t0 * stride + s0], data[t1 * stride + s0], wt);
+   uint32_t b = lerp_pixel(data[t0 * stride + s1], data[t1 * stride + s1], wt);
+
+   return lerp_pixel(a, b, ws);
+}
+
+
+static bool
+compare_row(unsigned verbose, const char *name, int width,
+            const uint32_t *row, const uint32_t *ref)
+{
+   for (int i = 0; i < width; i++) {
+      if (row[i] != ref[i]) {
+         if (verbose >= 1)
+            printf("FAILED %s width %d pixel %d: 0x%08x != 0x%08x\n",
+                   name, width, i, row[i], ref[i]);
+         return false;
+      }
+   }
+
+   return true;
+}
+
+
+static bool
+test_kernels(unsigned verbose, FILE *fp)
+{
+   uint32_t *tex = MALLOC(TEX_STRIDE * TEX_HEIGHT * sizeof *tex);
+   alignas(32) uint32_t row[64 + 8];
+   uint32_t ref[64];
+   bool success = true;
+
+   fill_texels(tex, TEX_STRIDE * TEX_HEIGHT);
+
+   for (int width = 1; width <= 64; width++) {
+      for (unsigned iter = 0; iter < 16; iter++) {
+         const int w = rand() & 0xff;
+         const uint32_t *src0 = &tex[(rand() % TEX_HEIGHT) * TEX_STRIDE];
+         const uint32_t *src1 = &tex[(rand() % TEX_HEIGHT) * TEX_STRIDE];
+
+         for (int i = 0; i < width; i++)
+            ref[i] = lerp_pixel(src0[i], src1[i], w);
+
+         lp_linear_lerp_row_avx2(row, src0, src1, width, w);
+         if (!compare_row(verbose, "lerp_row", width, row, ref))
+            success = false;
+
+         /* Coordinates which stay inside the texture. */
+         int s = rand() & 0xffff;
+         int t = rand() & 0xffff;
+         int dsdx = rand() % (((TEX_WIDTH - 2) << 16) / 64);
+         int dtdx = rand() % (((TEX_HEIGHT - 2) << 16) / 64);
+
+         for (int i = 0; i < width; i++) {
+            int si = s + i * dsdx;
+            int ti = t + i * dtdx;
+            ref[i] = lerp_2d_pixel(tex, TEX_STRIDE,
+                                   si >> 16, (si >> 16) + 1,
+                                   ti >> 16, (ti >> 16) + 1, si, ti);
+         }
+
+         lp_linear_fetch_linear_row_avx2(row, tex, TEX_STRIDE,
+                                         s, t, dsdx, dtdx, width);
+         if (!compare_row(verbose, "fetch_linear_row", width, row, ref))
+            success = false;
+
+         /* Coordinates which need clamping. */
+         s = (rand() % ((TEX_WIDTH + 8) << 16)) - (4 << 16);
+         t = (rand() % ((TEX_HEIGHT + 8) << 16)) - (4 << 16);
+         dsdx = (rand() % (4 << 16)) - (2 << 16);
+         dtdx = (rand() % (4 << 16)) - (2 << 16);
+
+         for (int i = 0; i < width; i++) {
+            int si = s + i * dsdx;
+            int ti = t + i * dtdx;
+            ref[i] = lerp_2d_pixel(tex, TEX_STRIDE,
+                                   CLAMP(si >> 16, 0, TEX_WIDTH - 1),
+                                   CLAMP((si >> 16) + 1, 0, TEX_WIDTH - 1),
+                                   CLAMP(ti >> 16, 0, TEX_HEIGHT - 1),
+                                   CLAMP((ti >> 16) + 1, 0, TEX_HEIGHT - 1),
+                                   si, ti);
+         }
+
+         lp_linear_fetch_clamp_linear_row_avx2(row, tex, TEX_STRIDE,
+                                               TEX_WIDTH, TEX_HEIGHT,
+                                               s, t, dsdx, dtdx, width);
+         if (!compare_row(verbose, "fetch_clamp_linear_row", width, row, ref))
+            success = false;
+      }
+   }
+
+   if (fp)
+      write_tsv_row(fp, "kernels", 0.0, success);
+
+   FREE(tex);
+
+   return success;
+}
+
+
+struct scene_window {
+   int x, y, width, height;
+   float angle;
+};
+
+/* 1080p-ish desktop scaled down to SCENE_WIDTH x SCENE_HEIGHT */
+static const struct scene_window scene[] = {
+   { 0, 0, SCENE_WIDTH, SCENE_HEIGHT, 0.0f },   /* wallpaper */
+   { 64, 48, 640, 480, 0.0f },                  /* magnified window */
+   { 600, 320, 320, 240, 0.0f },                /* minified window */
+   { 256, 256, 384, 288, 0.08f },               /* window being animated */
+   { 32, 600, 960, 96, 0.0f },                  /* panel */
+};
+
+
+static void
+init_sampler_state(struct lp_sampler_static_state *state)
+{
+   memset(state, 0, sizeof *state);
+   state->texture_state.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+   state->texture_state.target = PIPE_TEXTURE_2D;
+   state->texture_state.level_zero_only = 1;
+   state->texture_state.swizzle_r = PIPE_SWIZZLE_X;
+   state->texture_state.swizzle_g = PIPE_SWIZZLE_Y;
+   state->texture_state.swizzle_b = PIPE_SWIZZLE_Z;
+   state->texture_state.swizzle_a = PIPE_SWIZZLE_W;
+   state->sampler_state.wrap_s = PIPE_TEX_WRAP_CLAMP_TO_EDGE;
+   state->sampler_state.wrap_t = PIPE_TEX_WRAP_CLAMP_TO_EDGE;
+   state->sampler_state.min_img_filter = PIPE_TEX_FILTER_LINEAR;
+   state->sampler_state.mag_img_filter = PIPE_TEX_FILTER_LINEAR;
+   state->sampler_state.min_mip_filter = PIPE_TEX_MIPFILTER_NONE;
+   state->sampler_state.normalized_coords = 1;
+}
+
+
+/*
+ * Set up the texcoord interpolant (input 0) so the window's texture covers
+ * its rectangle, rotated about its center.
+ */
+static void
+init_window_coords(const struct scene_window *win,
+                   float (*a0)[4], float (*dadx)[4], float (*dady)[4])
+{
+   const float c = cosf(win->angle);
+   const float s = sinf(win->angle);
+   const float cx = win->x + win->width * 0.5f;
+   const float cy = win->y + win->height * 0.5f;
+
+   memset(a0, 0, 2 * sizeof a0[0]);
+   memset(dadx, 0, 2 * sizeof dadx[0]);
+   memset(dady, 0, 2 * sizeof dady[0]);
+
+   a0[0][3] = 1.0f;
+
+   dadx[1][0] = c / win->width;
+   dady[1][0] = s / win->width;
+   dadx[1][1] = -s / win->height;
+   dady[1][1] = c / win->height;
+
+   /* pixel centers */
+   a0[1][0] = 0.5f + ((0.5f - cx) * c + (0.5f - cy) * s) / win->width;
+   a0[1][1] = 0.5f + ((cx - 0.5f) * s + (0.5f - cy) * c) / win->height;
+}
+
+
+static bool
+draw_scene(const struct lp_jit_texture *tex,
+           const struct lp_jit_texture *mask,
+           unsigned *pixels)
+{
+   static const struct lp_tgsi_texture_info tex_info = {
+      .coord = {
+         { .file = TGSI_FILE_INPUT, .swizzle = 0, .u.index = 0 },
+         { .file = TGSI_FILE_INPUT, .swizzle = 1, .u.index = 0 },
+      },
+      .target = TGSI_TEXTURE_2D,
+   };
+   struct lp_sampler_static_state sampler_state;
+   struct lp_linear_sampler *samp = MALLOC(2 * sizeof *samp);
+   float a0[2][4], dadx[2][4], dady[2][4];
+   bool success = true;
+
+   init_sampler_state(&sampler_state);
+   *pixels = 0;
+
+   for (unsigned w = 0; w < ARRAY_SIZE(scene); w++) {
+      const struct scene_window *win = &scene[w];
+
+      init_window_coords(win, a0, dadx, dady);
+
+      for (int y = win->y; y < win->y + win->height; y += TILE_SIZE) {
+         for (int x = win->x; x < win->x + win->width; x += TILE_SIZE) {
+            const int width = MIN2(TILE_SIZE, win->x + win->width - x);
+            const int height = MIN2(TILE_SIZE, win->y + win->height - y);
+
+            if (!lp_linear_init_sampler(&samp[0], &tex_info, &sampler_state,
+                                        tex, x, y, width, height,
+                                        (const float (*)[4])a0,
+                                        (const float (*)[4])dadx,
+                                        (const float (*)[4])dady, false) ||
+                !lp_linear_init_sampler(&samp[1], &tex_info, &sampler_state,
+                                        mask, x, y, width, height,
+                                        (const float (*)[4])a0,
+                                        (const float (*)[4])dadx,
+                                        (const float (*)[4])dady, false)) {
+               success = false;
+               continue;
+            }
+
+            for (int i = 0; i < height; i++) {
+               samp[0].base.fetch(&samp[0].base);
+               samp[1].base.fetch(&samp[1].base);
+            }
+
+            *pixels += width * height;
+         }
+      }
+   }
+
+   FREE(samp);
+
+   return success;
+}
+
+
+static bool
+test_scene(unsigned verbose, FILE *fp)
+{
+   struct lp_jit_texture tex, mask;
+   int64_t cycles[LP_TEST_NUM_SAMPLES];
+   double cycles_avg = 0.0;
+   unsigned pixels = 0;
+   bool success = true;
+
+   memset(&tex, 0, sizeof tex);
+   tex.width = 512;
+   tex.height = 384;
+   tex.depth = 1;
+   tex.row_stride[0] = tex.width * 4;
+   tex.base = MALLOC(tex.row_stride[0] * tex.height);
+   fill_texels((uint32_t *)tex.base, tex.width * tex.height);
+
+   mask = tex;
+   mask.base = MALLOC(mask.row_stride[0] * mask.height);
+   fill_texels((uint32_t *)mask.base, mask.width * mask.height);
+
+   for (unsigned i = 0; i < LP_TEST_NUM_SAMPLES; i++) {
+      int64_t start_counter = rdtsc();
+      if (!draw_scene(&tex, &mask, &pixels))
+         success = false;
+      int64_t end_counter = rdtsc();
+      cycles[i] = end_counter - start_counter;
+   }
+
+   /* skip the first sample, it includes the cold caches */
+   for (unsigned i = 1; i < LP_TEST_NUM_SAMPLES; i++)
+      cycles_avg += (double)cycles[i];
+   cycles_avg /= (LP_TEST_NUM_SAMPLES - 1) * (double)pixels;
+
+   if (verbose >= 1)
+      printf("compositor scene (%s): %.2f cycles/pixel\n",
+             util_get_cpu_caps()->has_avx2 ? "avx2" : "sse2", cycles_avg);
+
+   if (fp)
+      write_tsv_row(fp, "scene", cycles_avg, success);
+
+   FREE((void *)mask.base);
+   FREE((void *)tex.base);
+
+   return success;
+}
+
+
+#endif /* DETECT_ARCH_SSE */
+
+
+bool
+test_all(unsigned verbose, FILE *fp)
+{
+   bool success = true;
+
+#if DETECT_ARCH_SSE
+   if (util_get_cpu_caps()->has_avx2) {
+      if (!test_kernels(verbose, fp))
+         success = false;
+   }
+
+   if (!test_scene(verbose, fp))
+      success = false;
+#endif
+
+   return success;
+}
+
+
+bool
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_all(verbose, fp);
+}
+
+
+bool
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_all(verbose, fp);
+}
@@ -0,0 +1,760 @@
+/*
+ * Copyright © 2024 Mesa contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/**
+ * @file
+ * Round-trip tests for the LP_TILED_TEXTURES texture layout.
+ *
+ * Every level of a micro-tiled texture is uploaded through a transfer,
+ * which retiles the linear staging copy on unmap.  The texel storage is
+ * then read at the addresses lp_build_sample_offset_tiled() computes for
+ * the samplers, and the level is read back through a detiling transfer.
+ * Unaligned sub-boxes are written both with and without discarding, so
+ * the partial micro-tile paths are covered too.
+ *
+ * The benchmark fetches every texel of a large texture in 2x2 quads, as
+ * the SoA sampler addresses them, walking the quads along rows and along
+ * columns, once with the tiled and once with the linear layout.  Column
+ * walks over a linear texture touch two cache lines per quad, while a
+ * micro-tile holds two quads of a column in one line for 32-bit texels.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "util/u_memory.h"
+#include "util/u_dump.h"
+#include "util/u_inlines.h"
+#include "util/format/u_format.h"
+#include "frontend/sw_winsys.h"
+#include "pipe/p_context.h"
+#include "pipe/p_screen.h"
+
+#include "gallivm/lp_bld_arit.h"
+#include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_flow.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_sample.h"
+#include "gallivm/lp_bld_swizzle.h"
+#include "gallivm/lp_bld_type.h"
+
+#include "lp_public.h"
+#include "lp_texture.h"
+#include "lp_test.h"
+
+
+#define OFFSET_LENGTH 4
+
+#define BENCH_SIZE 2048
+#define BENCH_SAMPLES 8
+
+
+typedef void (*tiled_offset_func_t)(const int32_t *x,
+                                     const int32_t *y,
+                                     const int32_t *z,
+                                     int32_t row_stride,
+                                     int32_t img_stride,
+                                     int32_t *offset);
+
+typedef uint32_t (*fetch_func_t)(const uint8_t *base,
+                                 int32_t row_stride,
+                                 int32_t quads);
+
+
+static const struct {
+   enum pipe_format format;
+   enum pipe_texture_target target;
+   unsigned width, height, depth, array_size, last_level;
+} tiled_textures[] = {
+   { PIPE_FORMAT_R8G8B8A8_UNORM, PIPE_TEXTURE_2D, 37, 23, 1, 1, 2 },
+   { PIPE_FORMAT_R8_UNORM, PIPE_TEXTURE_2D_ARRAY, 13, 9, 1, 3, 1 },
+   { PIPE_FORMAT_R16G16_UNORM, PIPE_TEXTURE_CUBE, 8, 8, 1, 6, 0 },
+   { PIPE_FORMAT_R32G32B32A32_FLOAT, PIPE_TEXTURE_3D, 10, 7, 5, 1, 1 },
+   { PIPE_FORMAT_B5G6R5_UNORM, PIPE_TEXTURE_RECT, 3, 2, 1, 1, 0 },
+};
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "cycles_per_texel\t"
+           "format\t"
+           "test\n");
+
+   fflush(fp);
+}
+
+
+/* cycles is only written for the benchmark rows */
+static void
+write_tsv_row(FILE *fp,
+              enum pipe_format format,
+              const char *test,
+              double cycles,
+              bool success)
+{
+   fprintf(fp, "%s\t", success ? "pass" : "fail");
+
+   if (cycles > 0.0)
+      fprintf(fp, "%.2f", cycles);
+
+   fprintf(fp, "\t%s\t%s\n", util_format_name(format), test);
+
+   fflush(fp);
+}
+
+
+/*
+ * Build a function which returns the offsets of OFFSET_LENGTH texels, as
+ * the SoA sampler computes them for tiled textures.
+ */
+static LLVMValueRef
+build_offset_func(struct gallivm_state *gallivm,
+                  const struct util_format_description *format_desc)
+{
+   struct lp_type type = lp_type_int_vec(32, OFFSET_LENGTH * 32);
+   LLVMContextRef context = gallivm->context;
+   LLVMModuleRef module = gallivm->module;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef vi32t = lp_build_vec_type(gallivm, type);
+   LLVMTypeRef i32t = LLVMInt32TypeInContext(context);
+   LLVMTypeRef args[6] = {
+      LLVMPointerType(vi32t, 0), LLVMPointerType(vi32t, 0),
+      LLVMPointerType(vi32t, 0), i32t, i32t, LLVMPointerType(vi32t, 0)
+   };
+   LLVMValueRef func = LLVMAddFunction(module, "tiled_offset",
+                                       LLVMFunctionType(LLVMVoidTypeInContext(context),
+                                                        args, ARRAY_SIZE(args), 0));
+   LLVMBasicBlockRef block = LLVMAppendBasicBlockInContext(context, func, "entry");
+   struct lp_build_context bld;
+   LLVMValueRef x, y, z, row_stride, img_stride, offset, i, j;
+
+   lp_build_context_init(&bld, gallivm, type);
+
+   LLVMSetFunctionCallConv(func, LLVMCCallConv);
+
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   x = LLVMBuildLoad2(builder, vi32t, LLVMGetParam(func, 0), "");
+   y = LLVMBuildLoad2(builder, vi32t, LLVMGetParam(func, 1), "");
+   z = LLVMBuildLoad2(builder, vi32t, LLVMGetParam(func, 2), "");
+   row_stride = lp_build_broadcast_scalar(&bld, LLVMGetParam(func, 3));
+   img_stride = lp_build_broadcast_scalar(&bld, LLVMGetParam(func, 4));
+
+   lp_build_sample_offset_tiled(&bld, format_desc, x, y, z,
+                                row_stride, img_stride, &offset, &i, &j);
+
+   LLVMBuildStore(builder, offset, LLVMGetParam(func, 5));
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, func);
+
+   return func;
+}
+
+
+static unsigned
+level_depth(struct pipe_resource *tex, unsigned level)
+{
+   return tex->target == PIPE_TEXTURE_3D ?
+          u_minify(tex->depth0, level) : tex->array_size;
+}
+
+
+/*
+ * Fill a box of the reference image with a pattern that differs for
+ * every byte of every texel and for every seed.
+ */
+static void
+fill_box(uint8_t *ref, unsigned ref_stride, uint64_t ref_layer_stride,
+         unsigned bpp, const struct pipe_box *box, unsigned seed)
+{
+   for (int z = box->z; z < box->z + box->depth; z++) {
+      for (int y = box->y; y < box->y + box->height; y++) {
+         for (int x = box->x; x < box->x + box->width; x++) {
+            uint8_t *texel = ref + z * ref_layer_stride + y * ref_stride +
+                             x * bpp;
+
+            for (unsigned b = 0; b < bpp; b++)
+               texel[b] = (x * 7 + y * 13 + z * 29 + b * 3 + seed * 53) & 0xff;
+         }
+      }
+   }
+}
+
+
+/*
+ * Copy between a box of the reference image and a transfer mapping.
+ */
+static void
+copy_box(uint8_t *ref, unsigned ref_stride, uint64_t ref_layer_stride,
+         unsigned bpp, const struct pipe_box *box,
+         uint8_t *map, const struct pipe_transfer *transfer, bool to_map)
+{
+   for (int z = 0; z < box->depth; z++) {
+      for (int y = 0; y < box->height; y++) {
+         uint8_t *r = ref + (box->z + z) * ref_layer_stride +
+                      (box->y + y) * ref_stride + box->x * bpp;
+         uint8_t *m = map + z * transfer->layer_stride + y * transfer->stride;
+
+         if (to_map)
+            memcpy(m, r, box->width * bpp);
+         else
+            memcpy(r, m, box->width * bpp);
+      }
+   }
+}
+
+
+/*
+ * Map a box, check that the mapping holds the current contents unless they
+ * are discarded, and write a new pattern to both the box and the reference.
+ */
+static bool
+write_box(struct pipe_context *pipe, struct pipe_resource *tex,
+          unsigned level, const struct pipe_box *box, unsigned usage,
+          unsigned seed,
+          uint8_t *ref, unsigned ref_stride, uint64_t ref_layer_stride)
+{
+   const unsigned bpp = util_format_get_blocksize(tex->format);
+   struct pipe_transfer *transfer;
+   uint8_t *map;
+
+   map = pipe->texture_map(pipe, tex, level, usage, box, &transfer);
+   if (!map) {
+      printf("FAILED to map level %u for writing\n", level);
+      return false;
+   }
+
+   if (!(usage & PIPE_MAP_DISCARD_RANGE)) {
+      for (int z = 0; z < box->depth; z++) {
+         for (int y = 0; y < box->height; y++) {
+            const uint8_t *r = ref + (box->z + z) * ref_layer_stride +
+                               (box->y + y) * ref_stride + box->x * bpp;
+            const uint8_t *m = map + z * transfer->layer_stride +
+                               y * transfer->stride;
+
+            if (memcmp(m, r, box->width * bpp) != 0) {
+               printf("FAILED level %u mapping, row %i of layer %i\n",
+                      level, box->y + y, box->z + z);
+               pipe->texture_unmap(pipe, transfer);
+               return false;
+            }
+         }
+      }
+   }
+
+   fill_box(ref, ref_stride, ref_layer_stride, bpp, box, seed);
+   copy_box(ref, ref_stride, ref_layer_stride, bpp, box,
+            map, transfer, true);
+   pipe->texture_unmap(pipe, transfer);
+   return true;
+}
+
+
+static bool
+test_level(unsigned verbose, struct pipe_context *pipe,
+           struct pipe_resource *tex, unsigned level,
+           tiled_offset_func_t offset_func)
+{
+   struct llvmpipe_resource *lpr = llvmpipe_resource(tex);
+   const unsigned bpp = util_format_get_blocksize(tex->format);
+   const unsigned width = u_minify(tex->width0, level);
+   const unsigned height = u_minify(tex->height0, level);
+   const unsigned depth = level_depth(tex, level);
+   const unsigned ref_stride = width * bpp;
+   const uint64_t ref_layer_stride = (uint64_t)ref_stride * height;
+   uint8_t *ref = MALLOC(ref_layer_stride * depth);
+   uint8_t *res = MALLOC(ref_layer_stride * depth);
+   const uint8_t *base = llvmpipe_get_texture_image_address(lpr, 0, level);
+   const int32_t row_stride = lpr->row_stride[level];
+   const int32_t img_stride = lpr->img_stride[level];
+   alignas(16) int32_t xs[OFFSET_LENGTH];
+   alignas(16) int32_t ys[OFFSET_LENGTH];
+   alignas(16) int32_t zs[OFFSET_LENGTH];
+   alignas(16) int32_t offsets[OFFSET_LENGTH];
+   struct pipe_transfer *transfer;
+   struct pipe_box box;
+   unsigned n = 0;
+   uint8_t *map;
+   bool success = true;
+
+   /* whole level upload */
+   u_box_3d(0, 0, 0, width, height, depth, &box);
+   if (!write_box(pipe, tex, level, &box,
+                  PIPE_MAP_WRITE | PIPE_MAP_DISCARD_RANGE, level,
+                  ref, ref_stride, ref_layer_stride)) {
+      success = false;
+      goto out;
+   }
+
+   /* the samplers must find every texel where the upload put it */
+   for (unsigned z = 0; z < depth && success; z++) {
+      for (unsigned y = 0; y < height && success; y++) {
+         for (unsigned x = 0; x < width && success; x++) {
+            xs[n] = x;
+            ys[n] = y;
+            zs[n] = z;
+            if (++n < OFFSET_LENGTH &&
+                !(x == width - 1 && y == height - 1 && z == depth - 1))
+               continue;
+
+            offset_func(xs, ys, zs, row_stride, img_stride, offsets);
+
+            for (unsigned i = 0; i < n; i++) {
+               const uint8_t *expected = ref + zs[i] * ref_layer_stride +
+                                         ys[i] * ref_stride + xs[i] * bpp;
+
+               if (memcmp(base + offsets[i], expected, bpp) != 0) {
+                  printf("FAILED level %u texel (%i, %i, %i) at offset %i\n",
+                         level, xs[i], ys[i], zs[i], offsets[i]);
+                  success = false;
+                  break;
+               }
+            }
+            n = 0;
+         }
+      }
+   }
+   if (!success)
+      goto out;
+
+   /* unaligned sub-boxes, overwritten and read-modify-written */
+   if (width > 2 && height > 2) {
+      u_box_3d(1, 1, depth - 1, width - 2, height - 2, 1, &box);
+      if (!write_box(pipe, tex, level, &box,
+                     PIPE_MAP_WRITE | PIPE_MAP_DISCARD_RANGE, level + 1,
+                     ref, ref_stride, ref_layer_stride)) {
+         success = false;
+         goto out;
+      }
+
+      u_box_3d(width / 2, height / 3, 0, width - width / 2,
+               height / 3 + 1, depth, &box);
+      if (!write_box(pipe, tex, level, &box, PIPE_MAP_READ_WRITE, level + 2,
+                     ref, ref_stride, ref_layer_stride)) {
+         success = false;
+         goto out;
+      }
+   }
+
+   /* whole level readback */
+   u_box_3d(0, 0, 0, width, height, depth, &box);
+   map = pipe->texture_map(pipe, tex, level, PIPE_MAP_READ, &box, &transfer);
+   if (!map) {
+      printf("FAILED to map level %u for reading\n", level);
+      success = false;
+      goto out;
+   }
+   copy_box(res, ref_stride, ref_layer_stride, bpp, &box,
+            map, transfer, false);
+   pipe->texture_unmap(pipe, transfer);
+
+   if (memcmp(res, ref, ref_layer_stride * depth) != 0) {
+      printf("FAILED level %u readback\n", level);
+      success = false;
+   }
+
+   if (verbose >= 1)
+      printf("  level %u: %ux%ux%u %s\n", level, width, height, depth,
+             success ? "ok" : "failed");
+
+out:
+   FREE(res);
+   FREE(ref);
+   return success;
+}
+
+
+static bool
+test_one(unsigned verbose, FILE *fp, struct pipe_context *pipe,
+         unsigned index)
+{
+   struct pipe_screen *screen = pipe->screen;
+   const enum pipe_format format = tiled_textures[index].format;
+   const enum pipe_texture_target target = tiled_textures[index].target;
+   struct pipe_resource templ;
+   struct pipe_resource *tex;
+   LLVMContextRef context;
+   struct gallivm_state *gallivm;
+   tiled_offset_func_t offset_func;
+   bool success = true;
+
+   if (verbose >= 1) {
+      printf("Testing %s %s ...\n", util_format_short_name(format),
+             util_str_tex_target(target, true));
+      fflush(stdout);
+   }
+
+   memset(&templ, 0, sizeof templ);
+   templ.format = format;
+   templ.target = target;
+   templ.width0 = tiled_textures[index].width;
+   templ.height0 = tiled_textures[index].height;
+   templ.depth0 = tiled_textures[index].depth;
+   templ.array_size = tiled_textures[index].array_size;
+   templ.last_level = tiled_textures[index].last_level;
+   templ.bind = PIPE_BIND_SAMPLER_VIEW;
+   templ.usage = PIPE_USAGE_DEFAULT;
+
+   tex = screen->resource_create(screen, &templ);
+   if (!tex) {
+      printf("FAILED to create %s texture\n", util_format_short_name(format));
+      return false;
+   }
+
+   if (!(tex->flags & LP_RESOURCE_FLAG_TILED)) {
+      printf("FAILED %s texture is not tiled\n",
+             util_format_short_name(format));
+      pipe_resource_reference(&tex, NULL);
+      return false;
+   }
+
+   context = LLVMContextCreate();
+#if LLVM_VERSION_MAJOR == 15
+   LLVMContextSetOpaquePointers(context, false);
+#endif
+   gallivm = gallivm_create("test_module", context, NULL);
+
+   LLVMValueRef func = build_offset_func(gallivm,
+                                         util_format_description(format));
+
+   gallivm_compile_module(gallivm);
+
+   offset_func = (tiled_offset_func_t)gallivm_jit_function(gallivm, func);
+
+   gallivm_free_ir(gallivm);
+
+   for (unsigned level = 0; level <= templ.last_level; level++) {
+      if (!test_level(verbose, pipe, tex, level, offset_func))
+         success = false;
+   }
+
+   if (fp)
+      write_tsv_row(fp, format, util_str_tex_target(target, true), 0.0,
+                    success);
+
+   gallivm_destroy(gallivm);
+   LLVMContextDispose(context);
+
+   pipe_resource_reference(&tex, NULL);
+
+   return success;
+}
+
+
+/*
+ * Build a function which fetches the 32-bit texels of a quads x quads grid
+ * of 2x2 quads and returns their sum, walking the quads along rows or
+ * along columns.
+ */
+static LLVMValueRef
+build_fetch_func(struct gallivm_state *gallivm,
+                 const struct util_format_description *format_desc,
+                 bool tiled, bool columns)
+{
+   struct lp_type type = lp_type_int_vec(32, 4 * 32);
+   LLVMContextRef context = gallivm->context;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef i8t = LLVMInt8TypeInContext(context);
+   LLVMTypeRef i32t = LLVMInt32TypeInContext(context);
+   LLVMTypeRef vi32t = lp_build_vec_type(gallivm, type);
+   LLVMTypeRef args[3] = { LLVMPointerType(i8t, 0), i32t, i32t };
+   LLVMValueRef func = LLVMAddFunction(gallivm->module, "fetch",
+                                       LLVMFunctionType(i32t, args,
+                                                        ARRAY_SIZE(args), 0));
+   LLVMBasicBlockRef block = LLVMAppendBasicBlockInContext(context, func, "entry");
+   struct lp_build_for_loop_state outer, inner;
+   struct lp_build_context bld;
+   LLVMValueRef base, row_stride, quads, sum_ptr, one;
+   LLVMValueRef quad_x[4], quad_y[4];
+
+   lp_build_context_init(&bld, gallivm, type);
+
+   LLVMSetFunctionCallConv(func, LLVMCCallConv);
+
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   base = LLVMGetParam(func, 0);
+   row_stride = lp_build_broadcast_scalar(&bld, LLVMGetParam(func, 1));
+   quads = LLVMGetParam(func, 2);
+   one = lp_build_const_int32(gallivm, 1);
+
+   for (unsigned i = 0; i < 4; i++) {
+      quad_x[i] = lp_build_const_int32(gallivm, i & 1);
+      quad_y[i] = lp_build_const_int32(gallivm, i >> 1);
+   }
+
+   sum_ptr = lp_build_alloca(gallivm, vi32t, "sum");
+
+   lp_build_for_loop_begin(&outer, gallivm, lp_build_const_int32(gallivm, 0),
+                           LLVMIntULT, quads, one);
+   lp_build_for_loop_begin(&inner, gallivm, lp_build_const_int32(gallivm, 0),
+                           LLVMIntULT, quads, one);
+   {
+      LLVMValueRef qx = columns ? outer.counter : inner.counter;
+      LLVMValueRef qy = columns ? inner.counter : outer.counter;
+      LLVMValueRef x, y, offset, i, j;
+      LLVMValueRef texels = bld.undef;
+
+      qx = LLVMBuildShl(builder, qx, one, "");
+      qy = LLVMBuildShl(builder, qy, one, "");
+      x = lp_build_add(&bld, lp_build_broadcast_scalar(&bld, qx),
+                       LLVMConstVector(quad_x, 4));
+      y = lp_build_add(&bld, lp_build_broadcast_scalar(&bld, qy),
+                       LLVMConstVector(quad_y, 4));
+
+      if (tiled)
+         lp_build_sample_offset_tiled(&bld, format_desc, x, y, NULL,
+                                      row_stride, NULL, &offset, &i, &j);
+      else
+         lp_build_sample_offset(&bld, format_desc, x, y, NULL,
+                                row_stride, NULL, &offset, &i, &j);
+
+      for (unsigned k = 0; k < 4; k++) {
+         LLVMValueRef index = lp_build_const_int32(gallivm, k);
+         LLVMValueRef texel_offset =
+            LLVMBuildExtractElement(builder, offset, index, "");
+         LLVMValueRef ptr = LLVMBuildGEP2(builder, i8t, base,
+                                          &texel_offset, 1, "");
+         ptr = LLVMBuildBitCast(builder, ptr, LLVMPointerType(i32t, 0), "");
+         texels = LLVMBuildInsertElement(builder, texels,
+                                         LLVMBuildLoad2(builder, i32t, ptr, ""),
+                                         index, "");
+      }
+
+      LLVMBuildStore(builder,
+                     lp_build_add(&bld, LLVMBuildLoad2(builder, vi32t,
+                                                       sum_ptr, ""),
+                                  texels),
+                     sum_ptr);
+   }
+   lp_build_for_loop_end(&inner);
+   lp_build_for_loop_end(&outer);
+
+   LLVMBuildRet(builder,
+                lp_build_horizontal_add(&bld, LLVMBuildLoad2(builder, vi32t,
+                                                             sum_ptr, "")));
+
+   gallivm_verify_function(gallivm, func);
+
+   return func;
+}
+
+
+static bool
+bench_one(unsigned verbose, FILE *fp, struct pipe_context *pipe,
+          bool tiled, bool columns, uint32_t *sum)
+{
+   struct pipe_screen *screen = pipe->screen;
+   const enum pipe_format format = PIPE_FORMAT_R8G8B8A8_UNORM;
+   const char *name = tiled ?
+      (columns ? "fetch tiled columns" : "fetch tiled rows") :
+      (columns ? "fetch linear columns" : "fetch linear rows");
+   struct pipe_resource templ;
+   struct pipe_resource *tex;
+   struct llvmpipe_resource *lpr;
+   struct pipe_transfer *transfer;
+   struct pipe_box box;
+   LLVMContextRef context;
+   struct gallivm_state *gallivm;
+   fetch_func_t fetch_func;
+   int64_t cycles[BENCH_SAMPLES];
+   double cycles_avg = 0.0;
+   uint8_t *map;
+   bool success = true;
+
+   memset(&templ, 0, sizeof templ);
+   templ.format = format;
+   templ.target = PIPE_TEXTURE_2D;
+   templ.width0 = BENCH_SIZE;
+   templ.height0 = BENCH_SIZE;
+   templ.depth0 = 1;
+   templ.array_size = 1;
+   /* being a render target keeps the texture linear */
+   templ.bind = tiled ? PIPE_BIND_SAMPLER_VIEW :
+                        PIPE_BIND_SAMPLER_VIEW | PIPE_BIND_RENDER_TARGET;
+   templ.usage = PIPE_USAGE_DEFAULT;
+
+   tex = screen->resource_create(screen, &templ);
+   if (!tex) {
+      printf("FAILED to create benchmark texture\n");
+      return false;
+   }
+   lpr = llvmpipe_resource(tex);
+
+   if (!!(tex->flags & LP_RESOURCE_FLAG_TILED) != tiled) {
+      printf("FAILED benchmark texture has the wrong layout\n");
+      pipe_resource_reference(&tex, NULL);
+      return false;
+   }
+
+   u_box_2d(0, 0, BENCH_SIZE, BENCH_SIZE, &box);
+   map = pipe->texture_map(pipe, tex, 0,
+                           PIPE_MAP_WRITE | PIPE_MAP_DISCARD_RANGE,
+                           &box, &transfer);
+   if (!map) {
+      printf("FAILED to map benchmark texture\n");
+      pipe_resource_reference(&tex, NULL);
+      return false;
+   }
+   for (unsigned y = 0; y < BENCH_SIZE; y++) {
+      uint32_t *row = (uint32_t *)(map + y * transfer->stride);
+      for (unsigned x = 0; x < BENCH_SIZE; x++)
+         row[x] = x * 7 + y * 13;
+   }
+   pipe->texture_unmap(pipe, transfer);
+
+   context = LLVMContextCreate();
+#if LLVM_VERSION_MAJOR == 15
+   LLVMContextSetOpaquePointers(context, false);
+#endif
+   gallivm = gallivm_create("test_module", context, NULL);
+
+   LLVMValueRef func = build_fetch_func(gallivm,
+                                        util_format_description(format),
+                                        tiled, columns);
+
+   gallivm_compile_module(gallivm);
+
+   fetch_func = (fetch_func_t)gallivm_jit_function(gallivm, func);
+
+   gallivm_free_ir(gallivm);
+
+   for (unsigned i = 0; i < BENCH_SAMPLES; i++) {
+      int64_t start_counter = rdtsc();
+      uint32_t result =
+         fetch_func(llvmpipe_get_texture_image_address(lpr, 0, 0),
+                    lpr->row_stride[0], BENCH_SIZE / 2);
+      int64_t end_counter = rdtsc();
+      cycles[i] = end_counter - start_counter;
+
+      /* every layout and walk must fetch the same texels */
+      if (*sum && result != *sum) {
+         printf("FAILED %s fetched the wrong texels\n", name);
+         success = false;
+      }
+      *sum = result;
+   }
+
+   /* skip the first sample, it includes the cold caches */
+   for (unsigned i = 1; i < BENCH_SAMPLES; i++)
+      cycles_avg += (double)cycles[i];
+   cycles_avg /= (BENCH_SAMPLES - 1) * (double)BENCH_SIZE * BENCH_SIZE;
+
+   if (verbose >= 1)
+      printf("%s %ux%u: %.2f cycles/texel\n", name, BENCH_SIZE, BENCH_SIZE,
+             cycles_avg);
+
+   if (fp)
+      write_tsv_row(fp, format, name, cycles_avg, success);
+
+   gallivm_destroy(gallivm);
+   LLVMContextDispose(context);
+
+   pipe_resource_reference(&tex, NULL);
+
+   return success;
+}
+
+
+static bool
+bench_fetch(unsigned verbose, FILE *fp, struct pipe_context *pipe)
+{
+   uint32_t sum = 0;
+   bool success = true;
+
+   for (unsigned tiled = 0; tiled < 2; tiled++) {
+      for (unsigned columns = 0; columns < 2; columns++) {
+         if (!bench_one(verbose, fp, pipe, tiled, columns, &sum))
+            success = false;
+      }
+   }
+
+   return success;
+}
+
+
+static bool
+test_textures(unsigned verbose, FILE *fp, unsigned first, unsigned count,
+              bool bench)
+{
+   static struct sw_winsys winsys;
+   struct pipe_screen *screen;
+   struct pipe_context *pipe;
+   bool success = true;
+
+   /* the layout is only used when asked for */
+   setenv("LP_TILED_TEXTURES", "true", 1);
+
+   screen = llvmpipe_create_screen(&winsys);
+   if (!screen)
+      return false;
+
+   pipe = screen->context_create(screen, NULL, 0);
+   if (!pipe) {
+      screen->destroy(screen);
+      return false;
+   }
+
+   for (unsigned i = first; i < first + count; i++) {
+      if (!test_one(verbose, fp, pipe, i))
+         success = false;
+   }
+
+   if (bench && !bench_fetch(verbose, fp, pipe))
+      success = false;
+
+   pipe->destroy(pipe);
+   screen->destroy(screen);
+
+   return success;
+}
+
+
+bool
+test_all(unsigned verbose, FILE *fp)
+{
+   return test_textures(verbose, fp, 0, ARRAY_SIZE(tiled_textures), true);
+}
+
+
+bool
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_all(verbose, fp);
+}
+
+
+bool
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_textures(verbose, fp, 0, 1, false);
+}
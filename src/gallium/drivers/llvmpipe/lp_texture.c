@@ -43,7 +43,10 @@
 #include "util/u_memory.h"
 #include "util/u_transfer.h"
 
+#include "gallivm/lp_bld_sample.h"
+
 #include "lp_context.h"
+#include "lp_debug.h"
 #include "lp_flush.h"
 #include "lp_screen.h"
 #include "lp_texture.h"
@@ -79,6 +82,55 @@ static const char *driver_id = "llvmpipe" MESA_GIT_SHA1;
 
 #endif
 
+static inline bool
+llvmpipe_resource_is_tiled(const struct pipe_resource *resource)
+{
+   return resource->flags & LP_RESOURCE_FLAG_TILED;
+}
+
+
+/**
+ * Whether a texture may use the LP_RESOURCE_FLAG_TILED layout.
+ *
+ * Only the samplers know how to address micro-tiled textures and transfers
+ * go through a linear staging copy, so this is limited to textures that
+ * are never rendered to, used as images, shared or mapped persistently.
+ */
+static bool
+llvmpipe_resource_can_tile(const struct pipe_resource *pt)
+{
+   const struct util_format_description *desc =
+      util_format_description(pt->format);
+
+   if (!llvmpipe_screen(pt->screen)->tiled_textures)
+      return false;
+
+   if (pt->bind != PIPE_BIND_SAMPLER_VIEW ||
+       pt->usage == PIPE_USAGE_STAGING ||
+       (pt->flags & (PIPE_RESOURCE_FLAG_MAP_PERSISTENT |
+                     PIPE_RESOURCE_FLAG_MAP_COHERENT)) ||
+       pt->nr_samples > 1)
+      return false;
+
+   switch (pt->target) {
+   case PIPE_TEXTURE_2D:
+   case PIPE_TEXTURE_RECT:
+   case PIPE_TEXTURE_2D_ARRAY:
+   case PIPE_TEXTURE_CUBE:
+   case PIPE_TEXTURE_CUBE_ARRAY:
+   case PIPE_TEXTURE_3D:
+      break;
+   default:
+      return false;
+   }
+
+   return desc &&
+          desc->layout == UTIL_FORMAT_LAYOUT_PLAIN &&
+          desc->block.width == 1 && desc->block.height == 1 &&
+          !util_format_is_depth_or_stencil(pt->format);
+}
+
+
 /**
  * Conventional allocation path for non-display textures:
  * Compute strides and allocate data (unless asked not to).
@@ -278,6 +330,13 @@ llvmpipe_resource_create_all(struct pipe_screen *_screen,
             goto fail;
       } else {
          /* texture map */
+         if (alloc_backing && llvmpipe_resource_can_tile(&lpr->base))
+            lpr->base.flags |= LP_RESOURCE_FLAG_TILED;
+
+         /*
+          * The 4x4 pixel alignment below means the tiled layout fits in
+          * the same rows and images as the linear one.
+          */
          if (!llvmpipe_texture_layout(screen, lpr, alloc_backing))
             goto fail;
       }
@@ -523,6 +582,50 @@ llvmpipe_resource_destroy(struct pipe_screen *pscreen,
 }
 
 
+/**
+ * Copy a box between a LP_RESOURCE_FLAG_TILED texture level and linear
+ * memory, in either direction.
+ */
+static void
+llvmpipe_tiled_copy_box(struct llvmpipe_resource *lpr,
+                        unsigned level,
+                        const struct pipe_box *box,
+                        uint8_t *linear,
+                        unsigned stride,
+                        uint64_t layer_stride,
+                        bool to_linear)
+{
+   const unsigned tile = LP_TEXTURE_MICROTILE_SIZE;
+   const unsigned bpp = util_format_get_blocksize(lpr->base.format);
+   const unsigned row_stride = lpr->row_stride[level];
+
+   for (unsigned z = 0; z < box->depth; z++) {
+      uint8_t *image = llvmpipe_get_texture_image_address(lpr, box->z + z,
+                                                          level);
+      for (unsigned y = 0; y < box->height; y++) {
+         const unsigned ty = box->y + y;
+         uint8_t *tile_row = image + (ty & ~(tile - 1)) * row_stride +
+                             (ty & (tile - 1)) * tile * bpp;
+         uint8_t *lin = linear + z * layer_stride + y * stride;
+
+         /* at most one micro-tile row of pixels is contiguous */
+         for (unsigned x = 0; x < box->width;) {
+            const unsigned tx = box->x + x;
+            const unsigned n = MIN2(tile - (tx & (tile - 1)), box->width - x);
+            uint8_t *texels = tile_row + (tx & ~(tile - 1)) * tile * bpp +
+                              (tx & (tile - 1)) * bpp;
+
+            if (to_linear)
+               memcpy(lin + x * bpp, texels, n * bpp);
+            else
+               memcpy(texels, lin + x * bpp, n * bpp);
+            x += n;
+         }
+      }
+   }
+}
+
+
 /**
  * Map a resource for read/write.
  */
@@ -831,6 +934,10 @@ llvmpipe_transfer_map_ms(struct pipe_context *pipe,
    assert(resource);
    assert(level <= resource->last_level);
 
+   /* tiled textures are only ever mapped through a linear copy */
+   if (llvmpipe_resource_is_tiled(resource) && (usage & PIPE_MAP_DIRECTLY))
+      return NULL;
+
    /*
     * Transfers, like other pipe operations, must happen in order, so flush
     * the context if necessary.
@@ -903,6 +1010,28 @@ llvmpipe_transfer_map_ms(struct pipe_context *pipe,
 
    format = lpr->base.format;
 
+   if (llvmpipe_resource_is_tiled(resource)) {
+      pt->stride = box->width * util_format_get_blocksize(format);
+      pt->layer_stride = (uint64_t)pt->stride * box->height;
+      lpt->staging = MALLOC(pt->layer_stride * box->depth);
+      if (!lpt->staging) {
+         pipe_resource_reference(&pt->resource, NULL);
+         FREE(lpt);
+         *transfer = NULL;
+         return NULL;
+      }
+
+      if (usage & PIPE_MAP_WRITE)
+         screen->timestamp++;
+
+      if (!(usage & (PIPE_MAP_DISCARD_RANGE |
+                     PIPE_MAP_DISCARD_WHOLE_RESOURCE))) {
+         llvmpipe_tiled_copy_box(lpr, level, box, lpt->staging,
+                                 pt->stride, pt->layer_stride, true);
+      }
+      return lpt->staging;
+   }
+
    map = llvmpipe_resource_map(resource, level, box->z, tex_usage);
 
 
@@ -941,11 +1070,23 @@ static void
 llvmpipe_transfer_unmap(struct pipe_context *pipe,
                         struct pipe_transfer *transfer)
 {
+   struct llvmpipe_transfer *lpt = llvmpipe_transfer(transfer);
+
    assert(transfer->resource);
 
-   llvmpipe_resource_unmap(transfer->resource,
-                           transfer->level,
-                           transfer->box.z);
+   if (lpt->staging) {
+      if (transfer->usage & PIPE_MAP_WRITE) {
+         llvmpipe_tiled_copy_box(llvmpipe_resource(transfer->resource),
+                                 transfer->level, &transfer->box,
+                                 lpt->staging, transfer->stride,
+                                 transfer->layer_stride, false);
+      }
+      FREE(lpt->staging);
+   } else {
+      llvmpipe_resource_unmap(transfer->resource,
+                              transfer->level,
+                              transfer->box.z);
+   }
 
    /* Effectively do the texture_update work here - if texture images
     * needed post-processing to put them into hardware layout, this is
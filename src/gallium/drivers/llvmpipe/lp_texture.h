@@ -130,6 +130,9 @@ struct llvmpipe_resource
 struct llvmpipe_transfer
 {
    struct pipe_transfer base;
+
+   /** linear copy of the box for LP_RESOURCE_FLAG_TILED textures */
+   void *staging;
 };
 
 
@@ -34,13 +34,234 @@
 
 #include "pipe/p_context.h"
 #include "pipe/p_screen.h"
+#include "util/hash_table.h"
+#include "util/list.h"
 #include "util/mesa-sha1.h"
+#include "util/u_queue.h"
 
 static const char *image_function_base_hash = "8ca89d7a4ab5830be6a1ba1140844081235b01164a8fce8316ca6a2f81f1a899";
 static const char *sample_function_base_hash = "0789b032c4a1ddba086e07496fe2a992b1ee08f78c0884a2923564b1ed52b9cc";
 static const char *size_function_base_hash = "6d249ab9c1106c68b87ec9fdb5ade28368171d27f221c687f32ae1544231d2fe";
 static const char *jit_sample_function_base_hash = "21de75bb5dbcfea1f90d03b8b688f19bdb0d96f95681cbe8b26853e1723846e4";
 
+/* Number of functions without any context using them which are kept for
+ * contexts created later.
+ */
+#define LP_MAX_UNUSED_SAMPLE_FUNCTIONS 4096
+
+/**
+ * A sample, image or size function shared by all contexts of a screen,
+ * keyed by the same hash of the static state that is used for the disk cache.
+ */
+struct lp_sample_function {
+   uint8_t key[SHA1_DIGEST_LENGTH];
+
+   void *function;
+   struct gallivm_state *gallivm;
+
+   /* Signaled once function is valid. */
+   struct util_queue_fence ready;
+
+   /* Number of references held by contexts, protected by the cache lock. */
+   uint32_t refcount;
+   struct list_head unused_link;
+
+   /* Compilation failed and the function was removed from the cache, so a
+    * later lookup compiles it again.  Freed with its last reference.
+    */
+   bool failed;
+};
+
+struct lp_sample_function_cache {
+   simple_mtx_t lock;
+   struct hash_table *functions;
+
+   /* Functions with a refcount of zero, least recently released first. */
+   struct list_head unused;
+   uint32_t unused_count;
+};
+
+static uint32_t
+sample_function_key_hash(const void *key)
+{
+   return _mesa_hash_data(key, SHA1_DIGEST_LENGTH);
+}
+
+static bool
+sample_function_key_equal(const void *a, const void *b)
+{
+   return !memcmp(a, b, SHA1_DIGEST_LENGTH);
+}
+
+struct lp_sample_function_cache *
+lp_sample_function_cache_create(void)
+{
+   struct lp_sample_function_cache *cache = calloc(1, sizeof(struct lp_sample_function_cache));
+   if (!cache)
+      return NULL;
+
+   simple_mtx_init(&cache->lock, mtx_plain);
+   cache->functions = _mesa_hash_table_create(NULL, sample_function_key_hash, sample_function_key_equal);
+   list_inithead(&cache->unused);
+
+   return cache;
+}
+
+static void
+destroy_sample_function(struct lp_sample_function *function)
+{
+   util_queue_fence_destroy(&function->ready);
+   if (function->gallivm)
+      gallivm_destroy(function->gallivm);
+   free(function);
+}
+
+void
+lp_sample_function_cache_destroy(struct lp_sample_function_cache *cache)
+{
+   /* All contexts are gone, so every function is unused. */
+   assert(cache->unused_count == _mesa_hash_table_num_entries(cache->functions));
+
+   list_for_each_entry_safe (struct lp_sample_function, function, &cache->unused, unused_link)
+      destroy_sample_function(function);
+
+   _mesa_hash_table_destroy(cache->functions, NULL);
+   simple_mtx_destroy(&cache->lock);
+   free(cache);
+}
+
+/**
+ * Look up a function in the screen wide cache and take a reference to it
+ * for the context.
+ *
+ * Returns true if the function does not exist yet, in which case the caller
+ * has to compile it and hand it to publish_function().  Other threads asking
+ * for the same function wait until then, all other lookups go ahead.
+ *
+ * *out is NULL if the function could not be allocated.
+ */
+static bool
+acquire_function(struct llvmpipe_context *ctx, const uint8_t cache_key[SHA1_DIGEST_LENGTH],
+                 struct lp_sample_function **out)
+{
+   struct lp_sample_function_cache *cache = llvmpipe_screen(ctx->pipe.screen)->sample_functions;
+   struct lp_sample_function *function;
+   bool compile = false;
+
+   simple_mtx_lock(&cache->lock);
+
+   struct hash_entry *entry = _mesa_hash_table_search(cache->functions, cache_key);
+   if (entry) {
+      function = entry->data;
+      if (!function->refcount) {
+         list_del(&function->unused_link);
+         cache->unused_count--;
+      }
+      function->refcount++;
+   } else {
+      function = calloc(1, sizeof(struct lp_sample_function));
+      if (!function) {
+         simple_mtx_unlock(&cache->lock);
+         *out = NULL;
+         return false;
+      }
+      memcpy(function->key, cache_key, SHA1_DIGEST_LENGTH);
+      util_queue_fence_init(&function->ready);
+      util_queue_fence_reset(&function->ready);
+      function->refcount = 1;
+      _mesa_hash_table_insert(cache->functions, function->key, function);
+      compile = true;
+   }
+
+   simple_mtx_unlock(&cache->lock);
+
+   simple_mtx_lock(&ctx->sampler_matrix.lock);
+   util_dynarray_append(&ctx->sampler_matrix.functions, struct lp_sample_function *, function);
+   simple_mtx_unlock(&ctx->sampler_matrix.lock);
+
+   if (!compile)
+      util_queue_fence_wait(&function->ready);
+
+   *out = function;
+   return compile;
+}
+
+/**
+ * Make a function acquired for compilation available to the threads waiting
+ * for it.  A NULL function_ptr means compilation failed: the waiting threads
+ * get NULL, and the function is taken out of the cache so the next lookup
+ * tries again instead of finding the failure.
+ */
+static void
+publish_function(struct lp_sample_function_cache *cache, struct lp_sample_function *function,
+                 struct gallivm_state *gallivm, void *function_ptr)
+{
+   function->gallivm = gallivm;
+   function->function = function_ptr;
+
+   if (!function_ptr) {
+      simple_mtx_lock(&cache->lock);
+      /* Still ours: a referenced function is never evicted. */
+      _mesa_hash_table_remove_key(cache->functions, function->key);
+      function->failed = true;
+      simple_mtx_unlock(&cache->lock);
+   }
+
+   util_queue_fence_signal(&function->ready);
+}
+
+static void
+release_function(struct lp_sample_function_cache *cache, struct lp_sample_function *function)
+{
+   struct lp_sample_function *evicted = NULL;
+
+   simple_mtx_lock(&cache->lock);
+
+   assert(function->refcount);
+   if (!--function->refcount && function->failed) {
+      evicted = function;
+   } else if (!function->refcount) {
+      list_addtail(&function->unused_link, &cache->unused);
+      cache->unused_count++;
+
+      if (cache->unused_count > LP_MAX_UNUSED_SAMPLE_FUNCTIONS) {
+         evicted = list_first_entry(&cache->unused, struct lp_sample_function, unused_link);
+         list_del(&evicted->unused_link);
+         cache->unused_count--;
+         _mesa_hash_table_remove_key(cache->functions, evicted->key);
+      }
+   }
+
+   simple_mtx_unlock(&cache->lock);
+
+   if (evicted)
+      destroy_sample_function(evicted);
+}
+
+/**
+ * Functions are compiled in a LLVMContext of their own: they can be
+ * compiled from several threads at once, and once compiled they do not
+ * depend on the context that asked for them first.
+ */
+static struct gallivm_state *
+create_function_gallivm(const char *name, struct lp_cached_code *cached)
+{
+   LLVMContextRef context = LLVMContextCreate();
+#if LLVM_VERSION_MAJOR == 15
+   LLVMContextSetOpaquePointers(context, false);
+#endif
+
+   return gallivm_create(name, context, cached);
+}
+
+static void
+destroy_function_gallivm(struct gallivm_state *gallivm)
+{
+   LLVMContextRef context = gallivm->context;
+   gallivm_destroy(gallivm);
+   LLVMContextDispose(context);
+}
+
 static void
 llvmpipe_register_texture(struct llvmpipe_context *ctx, struct lp_static_texture_state *state, bool sampled);
 
@@ -160,7 +381,7 @@ llvmpipe_init_sampler_matrix(struct llvmpipe_context *ctx)
    ctx->pipe.create_image_handle = llvmpipe_create_image_handle;
    ctx->pipe.delete_image_handle = llvmpipe_delete_image_handle;
 
-   util_dynarray_init(&ctx->sampler_matrix.gallivms, NULL);
+   util_dynarray_init(&ctx->sampler_matrix.functions, NULL);
 
    ctx->sampler_matrix.ctx = ctx;
 
@@ -173,6 +394,12 @@ void
 llvmpipe_sampler_matrix_destroy(struct llvmpipe_context *ctx)
 {
    struct lp_sampler_matrix *matrix = &ctx->sampler_matrix;
+   struct lp_sample_function_cache *cache = llvmpipe_screen(ctx->pipe.screen)->sample_functions;
+
+   util_dynarray_foreach (&matrix->functions, struct lp_sample_function *, function)
+      release_function(cache, *function);
+
+   util_dynarray_fini(&matrix->functions);
 
    simple_mtx_destroy(&matrix->lock);
    _mesa_hash_table_destroy(matrix->cache, NULL);
@@ -195,15 +422,11 @@ llvmpipe_sampler_matrix_destroy(struct llvmpipe_context *ctx)
       free(texture);
    }
    free(matrix->textures);
-
-   util_dynarray_foreach (&ctx->sampler_matrix.gallivms, struct gallivm_state *, gallivm)
-      gallivm_destroy(*gallivm);
-
-   util_dynarray_fini(&ctx->sampler_matrix.gallivms);
 }
 
 static void *
-compile_function(struct llvmpipe_context *ctx, struct gallivm_state *gallivm, LLVMValueRef function,
+compile_function(struct llvmpipe_context *ctx, struct lp_sample_function *cached_function,
+                 struct gallivm_state *gallivm, LLVMValueRef function,
                  bool needs_caching,
                  uint8_t cache_key[SHA1_DIGEST_LENGTH])
 {
@@ -212,12 +435,20 @@ compile_function(struct llvmpipe_context *ctx, struct gallivm_state *gallivm, LL
 
    void *function_ptr = func_to_pointer(gallivm_jit_function(gallivm, function));
 
-   if (needs_caching)
+   if (needs_caching && function_ptr)
       lp_disk_cache_insert_shader(llvmpipe_screen(ctx->pipe.screen), gallivm->cache, cache_key);
 
+   LLVMContextRef context = gallivm->context;
    gallivm_free_ir(gallivm);
+   LLVMContextDispose(context);
 
-   util_dynarray_append(&ctx->sampler_matrix.gallivms, struct gallivm_state *, gallivm);
+   if (!function_ptr) {
+      gallivm_destroy(gallivm);
+      gallivm = NULL;
+   }
+
+   publish_function(llvmpipe_screen(ctx->pipe.screen)->sample_functions, cached_function,
+                    gallivm, function_ptr);
 
    return function_ptr;
 }
@@ -257,11 +488,15 @@ compile_image_function(struct llvmpipe_context *ctx, struct lp_static_texture_st
    _mesa_sha1_update(&hash_ctx, &ms, sizeof(ms));
    _mesa_sha1_final(&hash_ctx, cache_key);
 
+   struct lp_sample_function *cached_function;
+   if (!acquire_function(ctx, cache_key, &cached_function))
+      return cached_function ? cached_function->function : NULL;
+
    struct lp_cached_code cached = { 0 };
    lp_disk_cache_find_shader(llvmpipe_screen(ctx->pipe.screen), &cached, cache_key);
    bool needs_caching = !cached.data_size;
 
-   struct gallivm_state *gallivm = gallivm_create("sample_function", ctx->context, &cached);
+   struct gallivm_state *gallivm = create_function_gallivm("sample_function", &cached);
 
    struct lp_image_static_state state = {
       .image_state = *texture,
@@ -287,7 +522,9 @@ compile_image_function(struct llvmpipe_context *ctx, struct lp_static_texture_st
    LLVMTypeRef function_type = lp_build_image_function_type(gallivm, &params, ms);
    if (!function_type) {
       free(image_soa);
-      gallivm_destroy(gallivm);
+      destroy_function_gallivm(gallivm);
+      publish_function(llvmpipe_screen(ctx->pipe.screen)->sample_functions, cached_function,
+                       NULL, NULL);
       return NULL;
    }
 
@@ -338,7 +575,7 @@ compile_image_function(struct llvmpipe_context *ctx, struct lp_static_texture_st
 
    free(image_soa);
 
-   return compile_function(ctx, gallivm, function, needs_caching, cache_key);
+   return compile_function(ctx, cached_function, gallivm, function, needs_caching, cache_key);
 }
 
 static void *
@@ -410,11 +647,15 @@ compile_sample_function(struct llvmpipe_context *ctx, struct lp_static_texture_s
    _mesa_sha1_update(&hash_ctx, &sample_key, sizeof(sample_key));
    _mesa_sha1_final(&hash_ctx, cache_key);
 
+   struct lp_sample_function *cached_function;
+   if (!acquire_function(ctx, cache_key, &cached_function))
+      return cached_function ? cached_function->function : NULL;
+
    struct lp_cached_code cached = { 0 };
    lp_disk_cache_find_shader(llvmpipe_screen(ctx->pipe.screen), &cached, cache_key);
    bool needs_caching = !cached.data_size;
 
-   struct gallivm_state *gallivm = gallivm_create("sample_function", ctx->context, &cached);
+   struct gallivm_state *gallivm = create_function_gallivm("sample_function", &cached);
 
    struct lp_sampler_static_state state = {
       .texture_state = *texture,
@@ -486,7 +727,7 @@ compile_sample_function(struct llvmpipe_context *ctx, struct lp_static_texture_s
 
    free(sampler_soa);
 
-   return compile_function(ctx, gallivm, function, needs_caching, cache_key);
+   return compile_function(ctx, cached_function, gallivm, function, needs_caching, cache_key);
 }
 
 static uint64_t
@@ -500,16 +741,22 @@ get_sample_function(uint64_t _matrix, uint64_t _texture_functions, uint64_t _sam
    void *key = &texture_functions->sample_functions[sampler_index][sample_key];
 
    simple_mtx_lock(&matrix->lock);
-
-   void *result;
    struct hash_entry *entry = _mesa_hash_table_search(matrix->cache, key);
-   if (entry) {
-      result = entry->data;
-   } else {
-      result = compile_sample_function(matrix->ctx, &texture_functions->state, matrix->samplers + sampler_index, sample_key);
-      _mesa_hash_table_insert(matrix->cache, key, result);
-   }
+   void *result = entry ? entry->data : NULL;
+   simple_mtx_unlock(&matrix->lock);
+
+   if (entry)
+      return (uint64_t)(uintptr_t)result;
 
+   /* Compile without holding the lock, so that threads needing other
+    * functions are not held up.  Threads racing for the same function end
+    * up waiting for the same screen cache entry.
+    */
+   result = compile_sample_function(matrix->ctx, &texture_functions->state, matrix->samplers + sampler_index, sample_key);
+
+   simple_mtx_lock(&matrix->lock);
+   if (!_mesa_hash_table_search(matrix->cache, key))
+      _mesa_hash_table_insert(matrix->cache, key, result);
    simple_mtx_unlock(&matrix->lock);
 
    return (uint64_t)(uintptr_t)result;
@@ -539,11 +786,15 @@ compile_jit_sample_function(struct llvmpipe_context *ctx, uint32_t sample_key)
    _mesa_sha1_update(&hash_ctx, &sample_key, sizeof(sample_key));
    _mesa_sha1_final(&hash_ctx, cache_key);
 
+   struct lp_sample_function *cached_function;
+   if (!acquire_function(ctx, cache_key, &cached_function))
+      return cached_function ? cached_function->function : NULL;
+
    struct lp_cached_code cached = { 0 };
    lp_disk_cache_find_shader(llvmpipe_screen(ctx->pipe.screen), &cached, cache_key);
    bool needs_caching = !cached.data_size;
 
-   struct gallivm_state *gallivm = gallivm_create("jit_sample_function", ctx->context, &cached);
+   struct gallivm_state *gallivm = create_function_gallivm("jit_sample_function", &cached);
 
    struct lp_type type;
    memset(&type, 0, sizeof type);
@@ -632,7 +883,7 @@ compile_jit_sample_function(struct llvmpipe_context *ctx, uint32_t sample_key)
    LLVMDisposeBuilder(gallivm->builder);
    gallivm->builder = old_builder;
 
-   return compile_function(ctx, gallivm, function, needs_caching, cache_key);
+   return compile_function(ctx, cached_function, gallivm, function, needs_caching, cache_key);
 }
 
 static void *
@@ -646,11 +897,15 @@ compile_size_function(struct llvmpipe_context *ctx, struct lp_static_texture_sta
    _mesa_sha1_update(&hash_ctx, &samples, sizeof(samples));
    _mesa_sha1_final(&hash_ctx, cache_key);
 
+   struct lp_sample_function *cached_function;
+   if (!acquire_function(ctx, cache_key, &cached_function))
+      return cached_function ? cached_function->function : NULL;
+
    struct lp_cached_code cached = { 0 };
    lp_disk_cache_find_shader(llvmpipe_screen(ctx->pipe.screen), &cached, cache_key);
    bool needs_caching = !cached.data_size;
 
-   struct gallivm_state *gallivm = gallivm_create("sample_function", ctx->context, &cached);
+   struct gallivm_state *gallivm = create_function_gallivm("sample_function", &cached);
 
    struct lp_sampler_static_state state = {
       .texture_state = *texture,
@@ -714,7 +969,7 @@ compile_size_function(struct llvmpipe_context *ctx, struct lp_static_texture_sta
 
    free(sampler_soa);
 
-   return compile_function(ctx, gallivm, function, needs_caching, cache_key);
+   return compile_function(ctx, cached_function, gallivm, function, needs_caching, cache_key);
 }
 
 static void
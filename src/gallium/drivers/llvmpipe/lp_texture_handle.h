@@ -51,9 +51,16 @@ struct lp_sampler_matrix {
 
    struct llvmpipe_context *ctx;
 
-   struct util_dynarray gallivms;
+   /* References to the struct lp_sample_function entries used by this context. */
+   struct util_dynarray functions;
 };
 
+struct lp_sample_function_cache;
+
+struct lp_sample_function_cache *lp_sample_function_cache_create(void);
+
+void lp_sample_function_cache_destroy(struct lp_sample_function_cache *cache);
+
 void llvmpipe_init_sampler_matrix(struct llvmpipe_context *ctx);
 
 void llvmpipe_sampler_matrix_destroy(struct llvmpipe_context *ctx);
@@ -6,14 +6,28 @@
 #include "lvp_acceleration_structure.h"
 #include "lvp_entrypoints.h"
 
+#include "vk_deferred_operation.h"
+
 #include "util/format/format_utils.h"
 #include "util/half_float.h"
+#include "util/u_call_once.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_queue.h"
 
 static_assert(sizeof(struct lvp_bvh_triangle_node) % 8 == 0, "lvp_bvh_triangle_node is not padded");
 static_assert(sizeof(struct lvp_bvh_aabb_node) % 8 == 0, "lvp_bvh_aabb_node is not padded");
 static_assert(sizeof(struct lvp_bvh_instance_node) % 8 == 0, "lvp_bvh_instance_node is not padded");
 static_assert(sizeof(struct lvp_bvh_box_node) % 8 == 0, "lvp_bvh_box_node is not padded");
 
+/* Number of box nodes built for leaf_count leaves.  Every box node but the
+ * root has LVP_BVH_WIDTH children, see lvp_bvh_build_range.
+ */
+static uint32_t
+lvp_bvh_box_node_count(uint32_t leaf_count)
+{
+   return leaf_count < 2 ? 1 : DIV_ROUND_UP(leaf_count - 1, LVP_BVH_WIDTH - 1);
+}
+
 VKAPI_ATTR void VKAPI_CALL
 lvp_GetAccelerationStructureBuildSizesKHR(
    VkDevice _device, VkAccelerationStructureBuildTypeKHR buildType,
@@ -27,7 +41,7 @@ lvp_GetAccelerationStructureBuildSizesKHR(
    for (uint32_t i = 0; i < pBuildInfo->geometryCount; i++)
       leaf_count += pMaxPrimitiveCounts[i];
 
-   uint32_t internal_count = MAX2(leaf_count, 2) - 1;
+   uint32_t internal_count = lvp_bvh_box_node_count(leaf_count);
 
    VkGeometryTypeKHR geometry_type = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
    if (pBuildInfo->geometryCount) {
@@ -59,14 +73,96 @@ lvp_GetAccelerationStructureBuildSizesKHR(
    pSizeInfo->accelerationStructureSize = bvh_size;
 }
 
+uint64_t
+lvp_get_acceleration_structure_property(struct vk_acceleration_structure *accel_struct,
+                                        VkQueryType query_type)
+{
+   struct lvp_bvh_header *header = (void *)(uintptr_t)vk_acceleration_structure_get_va(accel_struct);
+
+   switch (query_type) {
+   case VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR:
+   case VK_QUERY_TYPE_ACCELERATION_STRUCTURE_SIZE_KHR:
+      return accel_struct->size;
+   case VK_QUERY_TYPE_ACCELERATION_STRUCTURE_SERIALIZATION_SIZE_KHR:
+      return header->serialization_size;
+   case VK_QUERY_TYPE_ACCELERATION_STRUCTURE_SERIALIZATION_BOTTOM_LEVEL_POINTERS_KHR:
+      return header->instance_count;
+   default:
+      unreachable("Unsupported query type");
+   }
+}
+
+void
+lvp_serialize_acceleration_structure(struct vk_acceleration_structure *accel_struct, void *data)
+{
+   struct lvp_bvh_header *src = (void *)(uintptr_t)vk_acceleration_structure_get_va(accel_struct);
+   struct lvp_accel_struct_serialization_header *dst = data;
+
+   lvp_device_get_cache_uuid(dst->driver_uuid);
+   lvp_device_get_cache_uuid(dst->accel_struct_compat);
+   dst->serialization_size = src->serialization_size;
+   dst->compacted_size = accel_struct->size;
+   dst->instance_count = src->instance_count;
+
+   for (uint32_t i = 0; i < src->instance_count; i++) {
+      uint8_t *leaf_nodes = (uint8_t *)src;
+      leaf_nodes += src->leaf_nodes_offset;
+      struct lvp_bvh_instance_node *node = (struct lvp_bvh_instance_node *)leaf_nodes;
+      dst->instances[i] = node[i].bvh_ptr;
+   }
+
+   memcpy(&dst->instances[dst->instance_count], src, accel_struct->size);
+}
+
+void
+lvp_deserialize_acceleration_structure(struct vk_acceleration_structure *accel_struct,
+                                       const void *data)
+{
+   struct lvp_bvh_header *dst = (void *)(uintptr_t)vk_acceleration_structure_get_va(accel_struct);
+   const struct lvp_accel_struct_serialization_header *src = data;
+
+   memcpy(dst, &src->instances[src->instance_count], src->compacted_size);
+
+   for (uint32_t i = 0; i < src->instance_count; i++) {
+      uint8_t *leaf_nodes = (uint8_t *)dst;
+      leaf_nodes += dst->leaf_nodes_offset;
+      struct lvp_bvh_instance_node *node = (struct lvp_bvh_instance_node *)leaf_nodes;
+      node[i].bvh_ptr = src->instances[i];
+   }
+}
+
 VKAPI_ATTR VkResult VKAPI_CALL
 lvp_WriteAccelerationStructuresPropertiesKHR(
    VkDevice _device, uint32_t accelerationStructureCount,
    const VkAccelerationStructureKHR *pAccelerationStructures, VkQueryType queryType,
    size_t dataSize, void *pData, size_t stride)
 {
-   unreachable("Unimplemented");
-   return VK_ERROR_FEATURE_NOT_PRESENT;
+   for (uint32_t i = 0; i < accelerationStructureCount; i++) {
+      VK_FROM_HANDLE(vk_acceleration_structure, accel_struct, pAccelerationStructures[i]);
+
+      uint64_t value = lvp_get_acceleration_structure_property(accel_struct, queryType);
+
+      uint8_t *dst = (uint8_t *)pData + i * stride;
+      if (queryType == VK_QUERY_TYPE_ACCELERATION_STRUCTURE_SERIALIZATION_BOTTOM_LEVEL_POINTERS_KHR)
+         *(size_t *)dst = value;
+      else
+         *(VkDeviceSize *)dst = value;
+   }
+
+   return VK_SUCCESS;
+}
+
+struct lvp_host_build {
+   const VkAccelerationStructureBuildGeometryInfoKHR *infos;
+   const VkAccelerationStructureBuildRangeInfoKHR *const *range_infos;
+};
+
+static VkResult
+lvp_host_build_execute(void *data, uint32_t index)
+{
+   struct lvp_host_build *build = data;
+
+   return lvp_build_acceleration_structure(&build->infos[index], build->range_infos[index]);
 }
 
 VKAPI_ATTR VkResult VKAPI_CALL
@@ -75,8 +171,31 @@ lvp_BuildAccelerationStructuresKHR(
    const VkAccelerationStructureBuildGeometryInfoKHR *pInfos,
    const VkAccelerationStructureBuildRangeInfoKHR *const *ppBuildRangeInfos)
 {
-   unreachable("Unimplemented");
-   return VK_ERROR_FEATURE_NOT_PRESENT;
+   VK_FROM_HANDLE(vk_deferred_operation, op, deferredOperation);
+
+   if (!op) {
+      VkResult result = VK_SUCCESS;
+      for (uint32_t i = 0; i < infoCount; i++) {
+         VkResult build_result = lvp_build_acceleration_structure(&pInfos[i], ppBuildRangeInfos[i]);
+         if (result == VK_SUCCESS)
+            result = build_result;
+      }
+
+      return result;
+   }
+
+   /* Every joining thread builds whole acceleration structures; large
+    * builds are additionally split across the builder's own threads. The
+    * application keeps the parameters alive until the operation completes.
+    */
+   struct lvp_host_build *build = malloc(sizeof(*build));
+   if (!build)
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+
+   build->infos = pInfos;
+   build->range_infos = ppBuildRangeInfos;
+
+   return vk_deferred_operation_defer(op, infoCount, lvp_host_build_execute, free, build);
 }
 
 VKAPI_ATTR void VKAPI_CALL
@@ -95,24 +214,36 @@ VKAPI_ATTR VkResult VKAPI_CALL
 lvp_CopyAccelerationStructureKHR(VkDevice _device, VkDeferredOperationKHR deferredOperation,
                                  const VkCopyAccelerationStructureInfoKHR *pInfo)
 {
-   unreachable("Unimplemented");
-   return VK_ERROR_FEATURE_NOT_PRESENT;
+   VK_FROM_HANDLE(vk_acceleration_structure, src, pInfo->src);
+   VK_FROM_HANDLE(vk_acceleration_structure, dst, pInfo->dst);
+
+   memcpy((void *)(uintptr_t)vk_acceleration_structure_get_va(dst),
+          (const void *)(uintptr_t)vk_acceleration_structure_get_va(src),
+          MIN2(src->size, dst->size));
+
+   return deferredOperation ? VK_OPERATION_NOT_DEFERRED_KHR : VK_SUCCESS;
 }
 
 VKAPI_ATTR VkResult VKAPI_CALL
 lvp_CopyMemoryToAccelerationStructureKHR(VkDevice _device, VkDeferredOperationKHR deferredOperation,
                                          const VkCopyMemoryToAccelerationStructureInfoKHR *pInfo)
 {
-   unreachable("Unimplemented");
-   return VK_ERROR_FEATURE_NOT_PRESENT;
+   VK_FROM_HANDLE(vk_acceleration_structure, accel_struct, pInfo->dst);
+
+   lvp_deserialize_acceleration_structure(accel_struct, pInfo->src.hostAddress);
+
+   return deferredOperation ? VK_OPERATION_NOT_DEFERRED_KHR : VK_SUCCESS;
 }
 
 VKAPI_ATTR VkResult VKAPI_CALL
 lvp_CopyAccelerationStructureToMemoryKHR(VkDevice _device, VkDeferredOperationKHR deferredOperation,
                                          const VkCopyAccelerationStructureToMemoryInfoKHR *pInfo)
 {
-   unreachable("Unimplemented");
-   return VK_ERROR_FEATURE_NOT_PRESENT;
+   VK_FROM_HANDLE(vk_acceleration_structure, accel_struct, pInfo->src);
+
+   lvp_serialize_acceleration_structure(accel_struct, pInfo->dst.hostAddress);
+
+   return deferredOperation ? VK_OPERATION_NOT_DEFERRED_KHR : VK_SUCCESS;
 }
 
 static uint32_t
@@ -140,158 +271,803 @@ lvp_pack_sbt_offset_and_flags(uint32_t sbt_offset, VkGeometryInstanceFlagsKHR fl
    return ret;
 }
 
-struct lvp_build_internal_ctx {
+static void
+lvp_aabb_init_empty(lvp_aabb *aabb)
+{
+   aabb->min.x = INFINITY;
+   aabb->min.y = INFINITY;
+   aabb->min.z = INFINITY;
+   aabb->max.x = -INFINITY;
+   aabb->max.y = -INFINITY;
+   aabb->max.z = -INFINITY;
+}
+
+static void
+lvp_aabb_extend(lvp_aabb *aabb, const lvp_aabb *other)
+{
+   aabb->min.x = MIN2(aabb->min.x, other->min.x);
+   aabb->min.y = MIN2(aabb->min.y, other->min.y);
+   aabb->min.z = MIN2(aabb->min.z, other->min.z);
+   aabb->max.x = MAX2(aabb->max.x, other->max.x);
+   aabb->max.y = MAX2(aabb->max.y, other->max.y);
+   aabb->max.z = MAX2(aabb->max.z, other->max.z);
+}
+
+static float
+lvp_aabb_half_area(const lvp_aabb *aabb)
+{
+   float x = aabb->max.x - aabb->min.x;
+   float y = aabb->max.y - aabb->min.y;
+   float z = aabb->max.z - aabb->min.z;
+   return x * y + y * z + z * x;
+}
+
+static float
+lvp_vec3_component(const lvp_vec3 *v, unsigned axis)
+{
+   return axis == 0 ? v->x : (axis == 1 ? v->y : v->z);
+}
+
+static void
+lvp_vec3_set_component(lvp_vec3 *v, unsigned axis, float value)
+{
+   if (axis == 0)
+      v->x = value;
+   else if (axis == 1)
+      v->y = value;
+   else
+      v->z = value;
+}
+
+static float
+lvp_bvh_dequantize(float origin, float scale, uint32_t q)
+{
+   /* q * scale is exact, so this matches the traversal shader even if the
+    * multiply and add are fused.
+    */
+   return origin + (float)q * scale;
+}
+
+static void
+lvp_bvh_box_child_bounds(const struct lvp_bvh_box_node *box, uint32_t child, lvp_aabb *aabb)
+{
+   for (unsigned axis = 0; axis < 3; axis++) {
+      float origin = lvp_vec3_component(&box->origin, axis);
+      float scale = lvp_vec3_component(&box->scale, axis);
+
+      lvp_vec3_set_component(&aabb->min, axis,
+                             lvp_bvh_dequantize(origin, scale, box->min[axis][child]));
+      lvp_vec3_set_component(&aabb->max, axis,
+                             lvp_bvh_dequantize(origin, scale, box->max[axis][child]));
+   }
+}
+
+/* Finds the smallest range of quantized planes enclosing [min, max]. */
+static bool
+lvp_bvh_quantize_range(float origin, float scale, float min, float max,
+                       uint8_t *qmin, uint8_t *qmax)
+{
+   double lo = floor(((double)min - origin) / scale);
+   uint32_t q = lo > 0.0 ? (uint32_t)MIN2(lo, 255.0) : 0;
+   while (q > 0 && lvp_bvh_dequantize(origin, scale, q) > min)
+      q--;
+   *qmin = q;
+
+   double hi = ceil(((double)max - origin) / scale);
+   if (hi > 255.0)
+      return false;
+
+   q = hi > 0.0 ? (uint32_t)hi : 0;
+   while (lvp_bvh_dequantize(origin, scale, q) < max) {
+      if (q == 255)
+         return false;
+      q++;
+   }
+   *qmax = q;
+
+   return true;
+}
+
+/* Stores child_bounds into the quantized bounds of the valid children of box. */
+static void
+lvp_bvh_encode_box_node(struct lvp_bvh_box_node *box, const lvp_aabb *child_bounds)
+{
+   lvp_aabb bounds[LVP_BVH_WIDTH];
+   lvp_aabb total;
+   lvp_aabb_init_empty(&total);
+
+   for (uint32_t i = 0; i < LVP_BVH_WIDTH; i++) {
+      if (box->children[i] == LVP_BVH_INVALID_NODE)
+         continue;
+
+      /* Infinite planes can't be quantized; nothing can be hit beyond FLT_MAX anyway. */
+      bounds[i].min.x = CLAMP(child_bounds[i].min.x, -FLT_MAX, FLT_MAX);
+      bounds[i].min.y = CLAMP(child_bounds[i].min.y, -FLT_MAX, FLT_MAX);
+      bounds[i].min.z = CLAMP(child_bounds[i].min.z, -FLT_MAX, FLT_MAX);
+      bounds[i].max.x = CLAMP(child_bounds[i].max.x, -FLT_MAX, FLT_MAX);
+      bounds[i].max.y = CLAMP(child_bounds[i].max.y, -FLT_MAX, FLT_MAX);
+      bounds[i].max.z = CLAMP(child_bounds[i].max.z, -FLT_MAX, FLT_MAX);
+      lvp_aabb_extend(&total, &bounds[i]);
+   }
+
+   memset(box->min, 0, sizeof(box->min));
+   memset(box->max, 0, sizeof(box->max));
+
+   if (total.min.x > total.max.x) {
+      box->origin = (lvp_vec3){ 0.0f, 0.0f, 0.0f };
+      box->scale = (lvp_vec3){ 1.0f, 1.0f, 1.0f };
+      return;
+   }
+
+   for (unsigned axis = 0; axis < 3; axis++) {
+      float origin = lvp_vec3_component(&total.min, axis);
+      double extent = (double)lvp_vec3_component(&total.max, axis) - origin;
+
+      /* Start with the smallest power of two that spans the extent in 255
+       * steps. Rounding outwards may need one more step, in which case the
+       * scale is doubled.
+       */
+      int exponent = -149;
+      if (extent > 0.0) {
+         frexp(extent / 255.0, &exponent);
+         exponent = CLAMP(exponent, -149, 127);
+      }
+
+      while (true) {
+         float scale = ldexpf(1.0f, exponent);
+         bool fits = true;
+
+         for (uint32_t i = 0; i < LVP_BVH_WIDTH && fits; i++) {
+            if (box->children[i] == LVP_BVH_INVALID_NODE)
+               continue;
+
+            fits = lvp_bvh_quantize_range(origin, scale,
+                                          lvp_vec3_component(&bounds[i].min, axis),
+                                          lvp_vec3_component(&bounds[i].max, axis),
+                                          &box->min[axis][i], &box->max[axis][i]);
+         }
+
+         if (fits || exponent >= 127) {
+            lvp_vec3_set_component(&box->origin, axis, origin);
+            lvp_vec3_set_component(&box->scale, axis, scale);
+            break;
+         }
+
+         exponent++;
+      }
+   }
+}
+
+/* Computes the bounds of any node, decoding the child bounds of internal nodes. */
+static void
+lvp_bvh_node_bounds(const uint8_t *dst, uint32_t node_id, lvp_aabb *aabb)
+{
+   if (node_id == LVP_BVH_INVALID_NODE) {
+      lvp_aabb_init_empty(aabb);
+      return;
+   }
+
+   uint32_t node_offset = node_id & (~3u);
+   uint32_t node_type = node_id & 3u;
+   const void *node = dst + node_offset;
+
+   switch (node_type) {
+   case lvp_bvh_node_triangle: {
+      const struct lvp_bvh_triangle_node *triangle = node;
+
+      aabb->min.x = MIN3(triangle->coords[0][0], triangle->coords[1][0], triangle->coords[2][0]);
+      aabb->min.y = MIN3(triangle->coords[0][1], triangle->coords[1][1], triangle->coords[2][1]);
+      aabb->min.z = MIN3(triangle->coords[0][2], triangle->coords[1][2], triangle->coords[2][2]);
+
+      aabb->max.x = MAX3(triangle->coords[0][0], triangle->coords[1][0], triangle->coords[2][0]);
+      aabb->max.y = MAX3(triangle->coords[0][1], triangle->coords[1][1], triangle->coords[2][1]);
+      aabb->max.z = MAX3(triangle->coords[0][2], triangle->coords[1][2], triangle->coords[2][2]);
+
+      break;
+   }
+   case lvp_bvh_node_internal: {
+      const struct lvp_bvh_box_node *box = node;
+
+      lvp_aabb_init_empty(aabb);
+      for (uint32_t i = 0; i < LVP_BVH_WIDTH; i++) {
+         if (box->children[i] == LVP_BVH_INVALID_NODE)
+            continue;
+
+         lvp_aabb child_bounds;
+         lvp_bvh_box_child_bounds(box, i, &child_bounds);
+         lvp_aabb_extend(aabb, &child_bounds);
+      }
+
+      break;
+   }
+   case lvp_bvh_node_instance: {
+      const struct lvp_bvh_instance_node *instance = node;
+      struct lvp_bvh_header *instance_header = (void *)(uintptr_t)instance->bvh_ptr;
+
+      float bounds[2][3];
+
+      float header_bounds[2][3];
+      memcpy(header_bounds, &instance_header->bounds, sizeof(struct lvp_aabb));
+
+      for (unsigned j = 0; j < 3; ++j) {
+         bounds[0][j] = instance->otw_matrix.values[j][3];
+         bounds[1][j] = instance->otw_matrix.values[j][3];
+         for (unsigned k = 0; k < 3; ++k) {
+            bounds[0][j] += MIN2(instance->otw_matrix.values[j][k] * header_bounds[0][k],
+                                 instance->otw_matrix.values[j][k] * header_bounds[1][k]);
+            bounds[1][j] += MAX2(instance->otw_matrix.values[j][k] * header_bounds[0][k],
+                                 instance->otw_matrix.values[j][k] * header_bounds[1][k]);
+         }
+      }
+
+      memcpy(aabb, bounds, sizeof(struct lvp_aabb));
+
+      break;
+   }
+   case lvp_bvh_node_aabb: {
+      const struct lvp_bvh_aabb_node *aabb_node = node;
+
+      memcpy(aabb, &aabb_node->bounds, sizeof(struct lvp_aabb));
+
+      break;
+   }
+   default:
+      unreachable("Invalid node type");
+   }
+}
+
+/*
+ * Top-down binned SAH builder.
+ *
+ * The builder first produces a binary tree in a temporary array, laid out
+ * in depth-first order: a node covering n leaves is followed by the n - 2
+ * nodes of its subtrees, left subtree first.  This makes the position of
+ * every subtree known as soon as its parent is split, so subtrees can be
+ * built independently.
+ *
+ * The binary tree is then collapsed into box nodes.  Every binary node
+ * carries a slot count for each child: the number of box node children the
+ * subtree below it provides to the box node it ends up in.  A child with a
+ * single slot is a leaf or starts a new box node with LVP_BVH_WIDTH slots.
+ * The root gets the remainder so that every other box node is full, which
+ * keeps the node count at ceil((leaf_count - 1) / (LVP_BVH_WIDTH - 1)).
+ * Box nodes are allocated before their children, which refitting relies on.
+ */
+
+#define LVP_BVH_BINS 16
+
+/* Below this many leaves the BVH is built on the calling thread. */
+#define LVP_BVH_PARALLEL_MIN_LEAVES 4096
+
+#define LVP_BVH_MAX_TASKS 256
+
+struct lvp_bvh_prim {
+   lvp_aabb bounds;
+   lvp_vec3 centroid;
+   uint32_t node_id;
+};
+
+struct lvp_bvh_binary_node {
+   lvp_aabb bounds[2];
+   /* Internal children are (index << 2) | lvp_bvh_node_internal. */
+   uint32_t children[2];
+   uint32_t slots[2];
+};
+
+struct lvp_bvh_task {
+   struct util_queue_fence fence;
+   struct lvp_bvh_builder *builder;
+   uint32_t begin;
+   uint32_t end;
+   uint32_t node_index;
+   uint32_t slots;
+   uint32_t depth;
+};
+
+struct lvp_bvh_builder {
+   struct lvp_bvh_prim *prims;
+   struct lvp_bvh_binary_node *nodes;
+
+   /* Bin of each prim during a split, indexed like prims.  Subtrees own
+    * disjoint prim ranges so tasks can share it.
+    */
+   uint8_t *prim_bins;
+
+   /* Next free box node while collapsing. */
    uint8_t *dst;
    uint32_t dst_offset;
 
-   void *leaf_nodes;
-   uint32_t leaf_nodes_offset;
-   uint32_t leaf_node_type;
-   uint32_t leaf_node_size;
+   /* Subtrees of at most task_max_leaves leaves are deferred to tasks. */
+   struct lvp_bvh_task *tasks;
+   uint32_t task_count;
+   uint32_t task_max_leaves;
 };
 
+static struct util_queue lvp_bvh_queue;
+static bool lvp_bvh_queue_initialized;
+
+static void
+lvp_bvh_queue_init(void)
+{
+   unsigned num_threads = util_get_cpu_caps()->nr_cpus;
+
+   if (num_threads > 1) {
+      lvp_bvh_queue_initialized =
+         util_queue_init(&lvp_bvh_queue, "lvp_bvh", LVP_BVH_MAX_TASKS,
+                         num_threads, UTIL_QUEUE_INIT_RESIZE_IF_FULL, NULL);
+   }
+}
+
+/* Rounds left_count to the nearest size that lets both halves of a subtree
+ * with count leaves and slots slots fill their slots with full box nodes.
+ * The left half gets slots / 2 slots, the right half the rest.
+ */
 static uint32_t
-lvp_build_internal_node(struct lvp_build_internal_ctx *ctx, uint32_t first_leaf, uint32_t last_leaf)
+lvp_bvh_round_split(uint32_t count, uint32_t slots, uint32_t left_count)
 {
-   uint32_t dst_offset = ctx->dst_offset;
-   ctx->dst_offset += sizeof(struct lvp_bvh_box_node);
+   const uint32_t step = LVP_BVH_WIDTH - 1;
+   const uint32_t left_slots = slots / 2;
 
-   uint32_t node_id = dst_offset | lvp_bvh_node_internal;
+   left_count = CLAMP(left_count, left_slots, count - (slots - left_slots));
+   return left_slots + (left_count - left_slots + step / 2) / step * step;
+}
 
-   struct lvp_bvh_box_node *node = (void *)(ctx->dst + dst_offset);
+/**
+ * Partitions prims[begin, end) using the surface area heuristic evaluated
+ * at LVP_BVH_BINS bin boundaries along the axis of largest centroid
+ * extent, or in the middle if sah is false.  The split is then moved by the
+ * few prims closest to it so that it fits the subtree's slots.
+ * prim_bins[begin, end) is used as scratch.  Returns the first index of the
+ * right half.
+ */
+static uint32_t
+lvp_bvh_split(struct lvp_bvh_prim *prims, uint8_t *prim_bins,
+              uint32_t begin, uint32_t end, uint32_t slots, bool sah,
+              lvp_aabb *left_bounds, lvp_aabb *right_bounds)
+{
+   lvp_aabb centroid_bounds;
+   lvp_aabb_init_empty(&centroid_bounds);
+   for (uint32_t i = begin; i < end; i++) {
+      lvp_aabb c = { prims[i].centroid, prims[i].centroid };
+      lvp_aabb_extend(&centroid_bounds, &c);
+   }
 
-   uint32_t split = (first_leaf + last_leaf) / 2;
+   float extent[3] = {
+      centroid_bounds.max.x - centroid_bounds.min.x,
+      centroid_bounds.max.y - centroid_bounds.min.y,
+      centroid_bounds.max.z - centroid_bounds.min.z,
+   };
+   unsigned axis = 0;
+   if (extent[1] > extent[axis])
+      axis = 1;
+   if (extent[2] > extent[axis])
+      axis = 2;
+
+   /* Identical centroids can't be told apart, split in the middle. */
+   uint32_t mid = begin + (end - begin) / 2;
+
+   if (sah && extent[axis] > 0.0f) {
+      struct {
+         lvp_aabb bounds;
+         uint32_t count;
+      } bins[LVP_BVH_BINS];
+
+      for (unsigned b = 0; b < LVP_BVH_BINS; b++) {
+         lvp_aabb_init_empty(&bins[b].bounds);
+         bins[b].count = 0;
+      }
 
-   if (first_leaf < split)
-      node->children[0] = lvp_build_internal_node(ctx, first_leaf, split);
-   else
-      node->children[0] =
-         (ctx->leaf_nodes_offset + (first_leaf * ctx->leaf_node_size)) | ctx->leaf_node_type;
+      const float axis_min = lvp_vec3_component(&centroid_bounds.min, axis);
+      const float scale = LVP_BVH_BINS / extent[axis];
 
-   if (first_leaf < last_leaf) {
-      if (split + 1 < last_leaf)
-         node->children[1] = lvp_build_internal_node(ctx, split + 1, last_leaf);
-      else
-         node->children[1] =
-            (ctx->leaf_nodes_offset + (last_leaf * ctx->leaf_node_size)) | ctx->leaf_node_type;
-   } else {
-      node->children[1] = LVP_BVH_INVALID_NODE;
+      for (uint32_t i = begin; i < end; i++) {
+         float f = (lvp_vec3_component(&prims[i].centroid, axis) - axis_min) * scale;
+         unsigned b = f > 0.0f ? (unsigned)MIN2(f, LVP_BVH_BINS - 1) : 0;
+
+         lvp_aabb_extend(&bins[b].bounds, &prims[i].bounds);
+         bins[b].count++;
+         prim_bins[i] = b;
+      }
+
+      /* Cost of everything right of each bin boundary. */
+      float right_cost[LVP_BVH_BINS];
+      lvp_aabb acc;
+      uint32_t count = 0;
+      lvp_aabb_init_empty(&acc);
+      for (unsigned b = LVP_BVH_BINS - 1; b > 0; b--) {
+         lvp_aabb_extend(&acc, &bins[b].bounds);
+         count += bins[b].count;
+         right_cost[b] = count ? lvp_aabb_half_area(&acc) * count : 0.0f;
+      }
+
+      unsigned best_bin = 0;
+      float best_cost = INFINITY;
+      lvp_aabb_init_empty(&acc);
+      count = 0;
+      for (unsigned b = 0; b < LVP_BVH_BINS - 1; b++) {
+         lvp_aabb_extend(&acc, &bins[b].bounds);
+         count += bins[b].count;
+         if (!count || count == end - begin)
+            continue;
+
+         float cost = lvp_aabb_half_area(&acc) * count + right_cost[b + 1];
+         if (cost < best_cost) {
+            best_cost = cost;
+            best_bin = b + 1;
+         }
+      }
+
+      if (best_bin) {
+         uint32_t i = begin, j = end;
+         while (i < j) {
+            if (prim_bins[i] < best_bin) {
+               i++;
+            } else {
+               j--;
+               struct lvp_bvh_prim tmp = prims[i];
+               prims[i] = prims[j];
+               prims[j] = tmp;
+               uint8_t tmp_bin = prim_bins[i];
+               prim_bins[i] = prim_bins[j];
+               prim_bins[j] = tmp_bin;
+            }
+         }
+         mid = i;
+      }
    }
 
-   for (uint32_t i = 0; i < 2; i++) {
-      struct lvp_aabb *aabb = &node->bounds[i];
-
-      if (node->children[i] == LVP_BVH_INVALID_NODE) {
-         aabb->min.x = INFINITY;
-         aabb->min.y = INFINITY;
-         aabb->min.z = INFINITY;
-         aabb->max.x = -INFINITY;
-         aabb->max.y = -INFINITY;
-         aabb->max.z = -INFINITY;
-         continue;
+   const uint32_t target = begin + lvp_bvh_round_split(end - begin, slots, mid - begin);
+
+   while (mid > target) {
+      uint32_t max_index = begin;
+      for (uint32_t i = begin + 1; i < mid; i++) {
+         if (lvp_vec3_component(&prims[i].centroid, axis) >
+             lvp_vec3_component(&prims[max_index].centroid, axis))
+            max_index = i;
       }
 
-      uint32_t child_offset = node->children[i] & (~3u);
-      uint32_t child_type = node->children[i] & 3u;
-      void *child_node = (void *)(ctx->dst + child_offset);
+      mid--;
+      struct lvp_bvh_prim tmp = prims[max_index];
+      prims[max_index] = prims[mid];
+      prims[mid] = tmp;
+   }
 
-      switch (child_type) {
-      case lvp_bvh_node_triangle: {
-         struct lvp_bvh_triangle_node *triangle = child_node;
+   while (mid < target) {
+      uint32_t min_index = mid;
+      for (uint32_t i = mid + 1; i < end; i++) {
+         if (lvp_vec3_component(&prims[i].centroid, axis) <
+             lvp_vec3_component(&prims[min_index].centroid, axis))
+            min_index = i;
+      }
 
-         aabb->min.x = MIN3(triangle->coords[0][0], triangle->coords[1][0], triangle->coords[2][0]);
-         aabb->min.y = MIN3(triangle->coords[0][1], triangle->coords[1][1], triangle->coords[2][1]);
-         aabb->min.z = MIN3(triangle->coords[0][2], triangle->coords[1][2], triangle->coords[2][2]);
+      struct lvp_bvh_prim tmp = prims[min_index];
+      prims[min_index] = prims[mid];
+      prims[mid] = tmp;
+      mid++;
+   }
 
-         aabb->max.x = MAX3(triangle->coords[0][0], triangle->coords[1][0], triangle->coords[2][0]);
-         aabb->max.y = MAX3(triangle->coords[0][1], triangle->coords[1][1], triangle->coords[2][1]);
-         aabb->max.z = MAX3(triangle->coords[0][2], triangle->coords[1][2], triangle->coords[2][2]);
+   lvp_aabb_init_empty(left_bounds);
+   for (uint32_t i = begin; i < mid; i++)
+      lvp_aabb_extend(left_bounds, &prims[i].bounds);
 
-         break;
+   lvp_aabb_init_empty(right_bounds);
+   for (uint32_t i = mid; i < end; i++)
+      lvp_aabb_extend(right_bounds, &prims[i].bounds);
+
+   return mid;
+}
+
+/* Builds the binary subtree for prims[begin, end), which holds at least two
+ * leaves and provides slots children to its box node, 2 <= slots <= count
+ * and (count - slots) % (LVP_BVH_WIDTH - 1) == 0.  depth is the number of
+ * nodes from the root to this one.
+ */
+static void
+lvp_bvh_build_range(struct lvp_bvh_builder *builder, uint32_t begin, uint32_t end,
+                    uint32_t node_index, uint32_t slots, uint32_t depth)
+{
+   while (true) {
+      struct lvp_bvh_binary_node *node = &builder->nodes[node_index];
+
+      /* Fall back to balanced splits where an unbalanced one could exceed
+       * LVP_BVH_MAX_DEPTH, which bounds the traversal stack.  Rounded
+       * balanced splits need up to LVP_BVH_WIDTH_LOG2 - 1 levels more than
+       * log2 of the leaf count.
+       */
+      bool sah = depth + util_logbase2_ceil(end - begin) + LVP_BVH_WIDTH_LOG2 - 1 <=
+                 LVP_BVH_MAX_DEPTH;
+      uint32_t mid = lvp_bvh_split(builder->prims, builder->prim_bins, begin, end, slots, sah,
+                                   &node->bounds[0], &node->bounds[1]);
+
+      const uint32_t child_begin[2] = { begin, mid };
+      const uint32_t child_end[2] = { mid, end };
+      const uint32_t child_index[2] = { node_index + 1, node_index + (mid - begin) };
+
+      node->slots[0] = slots / 2;
+      node->slots[1] = slots - slots / 2;
+
+      /* Slots of the child subtrees, a single slot starts a new box node. */
+      uint32_t child_slots[2];
+      for (unsigned i = 0; i < 2; i++)
+         child_slots[i] = node->slots[i] == 1 ? LVP_BVH_WIDTH : node->slots[i];
+
+      /* Subtrees left to build on this thread. */
+      unsigned pending[2];
+      unsigned pending_count = 0;
+
+      for (unsigned i = 0; i < 2; i++) {
+         uint32_t leaf_count = child_end[i] - child_begin[i];
+
+         if (leaf_count == 1) {
+            node->children[i] = builder->prims[child_begin[i]].node_id;
+            continue;
+         }
+
+         node->children[i] = (child_index[i] << 2) | lvp_bvh_node_internal;
+
+         if (builder->tasks && leaf_count <= builder->task_max_leaves &&
+             leaf_count >= builder->task_max_leaves / 8 &&
+             builder->task_count < LVP_BVH_MAX_TASKS) {
+            struct lvp_bvh_task *task = &builder->tasks[builder->task_count++];
+            task->begin = child_begin[i];
+            task->end = child_end[i];
+            task->node_index = child_index[i];
+            task->slots = child_slots[i];
+            task->depth = depth + 1;
+            continue;
+         }
+
+         pending[pending_count++] = i;
       }
-      case lvp_bvh_node_internal: {
-         struct lvp_bvh_box_node *box = child_node;
 
-         aabb->min.x = MIN2(box->bounds[0].min.x, box->bounds[1].min.x);
-         aabb->min.y = MIN2(box->bounds[0].min.y, box->bounds[1].min.y);
-         aabb->min.z = MIN2(box->bounds[0].min.z, box->bounds[1].min.z);
+      if (!pending_count)
+         return;
+
+      /* Recurse into the smaller subtree and iterate on the larger one to
+       * keep the recursion depth logarithmic.
+       */
+      unsigned next = pending[0];
+      if (pending_count == 2) {
+         unsigned smaller = (mid - begin) <= (end - mid) ? 0 : 1;
+         lvp_bvh_build_range(builder, child_begin[smaller], child_end[smaller],
+                             child_index[smaller], child_slots[smaller], depth + 1);
+         next = 1 - smaller;
+      }
 
-         aabb->max.x = MAX2(box->bounds[0].max.x, box->bounds[1].max.x);
-         aabb->max.y = MAX2(box->bounds[0].max.y, box->bounds[1].max.y);
-         aabb->max.z = MAX2(box->bounds[0].max.z, box->bounds[1].max.z);
+      begin = child_begin[next];
+      end = child_end[next];
+      node_index = child_index[next];
+      slots = child_slots[next];
+      depth++;
+   }
+}
 
-         break;
+static void
+lvp_bvh_task_execute(void *data, void *gdata, int thread_index)
+{
+   struct lvp_bvh_task *task = data;
+   struct lvp_bvh_builder builder = *task->builder;
+
+   builder.tasks = NULL;
+   lvp_bvh_build_range(&builder, task->begin, task->end, task->node_index, task->slots,
+                       task->depth);
+}
+
+/* Writes the box node at node_offset for the binary node at binary_index
+ * and, recursively, the box nodes below it.
+ */
+static void
+lvp_bvh_collapse(struct lvp_bvh_builder *builder, uint32_t binary_index, uint32_t node_offset)
+{
+   const struct lvp_bvh_binary_node *binary = &builder->nodes[binary_index];
+
+   uint32_t children[LVP_BVH_WIDTH];
+   lvp_aabb child_bounds[LVP_BVH_WIDTH];
+   uint32_t child_slots[LVP_BVH_WIDTH];
+   uint32_t child_count = 2;
+
+   for (uint32_t i = 0; i < 2; i++) {
+      children[i] = binary->children[i];
+      child_bounds[i] = binary->bounds[i];
+      child_slots[i] = binary->slots[i];
+   }
+
+   /* Pull up binary children until every child has a single slot. */
+   for (uint32_t i = 0; i < child_count;) {
+      if (child_slots[i] == 1) {
+         i++;
+         continue;
       }
-      case lvp_bvh_node_instance: {
-         struct lvp_bvh_instance_node *instance = child_node;
-         struct lvp_bvh_header *instance_header = (void *)(uintptr_t)instance->bvh_ptr;
-
-         float bounds[2][3];
-
-         float header_bounds[2][3];
-         memcpy(header_bounds, &instance_header->bounds, sizeof(struct lvp_aabb));
-
-         for (unsigned j = 0; j < 3; ++j) {
-            bounds[0][j] = instance->otw_matrix.values[j][3];
-            bounds[1][j] = instance->otw_matrix.values[j][3];
-            for (unsigned k = 0; k < 3; ++k) {
-               bounds[0][j] += MIN2(instance->otw_matrix.values[j][k] * header_bounds[0][k],
-                                    instance->otw_matrix.values[j][k] * header_bounds[1][k]);
-               bounds[1][j] += MAX2(instance->otw_matrix.values[j][k] * header_bounds[0][k],
-                                    instance->otw_matrix.values[j][k] * header_bounds[1][k]);
-            }
-         }
 
-         memcpy(aabb, bounds, sizeof(struct lvp_aabb));
+      const struct lvp_bvh_binary_node *child = &builder->nodes[children[i] >> 2];
 
-         break;
+      children[i] = child->children[0];
+      child_bounds[i] = child->bounds[0];
+      child_slots[i] = child->slots[0];
+      children[child_count] = child->children[1];
+      child_bounds[child_count] = child->bounds[1];
+      child_slots[child_count] = child->slots[1];
+      child_count++;
+   }
+
+   struct lvp_bvh_box_node *node = (void *)(builder->dst + node_offset);
+
+   for (uint32_t i = 0; i < LVP_BVH_WIDTH; i++) {
+      if (i >= child_count) {
+         node->children[i] = LVP_BVH_INVALID_NODE;
+      } else if ((children[i] & 3u) == lvp_bvh_node_internal) {
+         node->children[i] = builder->dst_offset | lvp_bvh_node_internal;
+         builder->dst_offset += sizeof(struct lvp_bvh_box_node);
+      } else {
+         node->children[i] = children[i];
       }
-      case lvp_bvh_node_aabb: {
-         struct lvp_bvh_aabb_node *aabb_node = child_node;
+   }
 
-         memcpy(aabb, &aabb_node->bounds, sizeof(struct lvp_aabb));
+   lvp_bvh_encode_box_node(node, child_bounds);
 
-         break;
+   for (uint32_t i = 0; i < child_count; i++) {
+      if ((children[i] & 3u) == lvp_bvh_node_internal)
+         lvp_bvh_collapse(builder, children[i] >> 2, node->children[i] & (~3u));
+   }
+}
+
+/* Triangles and AABBs with a NaN x coordinate are inactive. */
+static bool
+lvp_bvh_leaf_is_inactive(const uint8_t *dst, uint32_t node_id)
+{
+   const void *node = dst + (node_id & (~3u));
+
+   switch (node_id & 3u) {
+   case lvp_bvh_node_triangle: {
+      const struct lvp_bvh_triangle_node *triangle = node;
+      return isnan(triangle->coords[0][0]) || isnan(triangle->coords[1][0]) ||
+             isnan(triangle->coords[2][0]);
+   }
+   case lvp_bvh_node_aabb: {
+      const struct lvp_bvh_aabb_node *aabb = node;
+      return isnan(aabb->bounds.min.x);
+   }
+   default:
+      return false;
+   }
+}
+
+/* Writes a root with at most one child, which is all a BVH with fewer than
+ * two leaves needs.
+ */
+static void
+lvp_bvh_write_single_root(uint8_t *dst, const struct lvp_bvh_prim *prim)
+{
+   struct lvp_bvh_box_node *root = (void *)(dst + LVP_BVH_ROOT_NODE_OFFSET);
+   lvp_aabb child_bounds[LVP_BVH_WIDTH] = { 0 };
+
+   for (uint32_t i = 0; i < LVP_BVH_WIDTH; i++)
+      root->children[i] = LVP_BVH_INVALID_NODE;
+
+   if (prim) {
+      root->children[0] = prim->node_id;
+      child_bounds[0] = prim->bounds;
+   }
+
+   lvp_bvh_encode_box_node(root, child_bounds);
+}
+
+/* Builds the box nodes for leaf_count prims and stores how many were
+ * written in internal_count.
+ */
+static VkResult
+lvp_bvh_build(uint8_t *dst, struct lvp_bvh_prim *prims, uint32_t leaf_count,
+              uint32_t *internal_count)
+{
+   static util_once_flag once = UTIL_ONCE_FLAG_INIT;
+
+   *internal_count = 1;
+
+   if (leaf_count < 2) {
+      lvp_bvh_write_single_root(dst, leaf_count ? &prims[0] : NULL);
+      return VK_SUCCESS;
+   }
+
+   struct lvp_bvh_builder builder = {
+      .prims = prims,
+      .dst = dst,
+      .dst_offset = LVP_BVH_ROOT_NODE_OFFSET + sizeof(struct lvp_bvh_box_node),
+   };
+
+   builder.nodes = malloc((leaf_count - 1) * sizeof(struct lvp_bvh_binary_node));
+   builder.prim_bins = malloc(leaf_count);
+   if (!builder.nodes || !builder.prim_bins) {
+      free(builder.nodes);
+      free(builder.prim_bins);
+      lvp_bvh_write_single_root(dst, NULL);
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   if (leaf_count >= LVP_BVH_PARALLEL_MIN_LEAVES) {
+      util_call_once(&once, lvp_bvh_queue_init);
+
+      if (lvp_bvh_queue_initialized)
+         builder.tasks = calloc(LVP_BVH_MAX_TASKS, sizeof(struct lvp_bvh_task));
+   }
+
+   if (builder.tasks) {
+      /* Split serially until there are a few subtrees per thread. */
+      builder.task_max_leaves =
+         MAX2(leaf_count / (4 * lvp_bvh_queue.max_threads), LVP_BVH_PARALLEL_MIN_LEAVES / 4);
+   }
+
+   /* The root takes the slots left over by full box nodes. */
+   uint32_t root_slots = (leaf_count - 2) % (LVP_BVH_WIDTH - 1) + 2;
+   lvp_bvh_build_range(&builder, 0, leaf_count, 0, root_slots, 1);
+
+   if (builder.tasks) {
+      for (uint32_t i = 0; i < builder.task_count; i++) {
+         struct lvp_bvh_task *task = &builder.tasks[i];
+         task->builder = &builder;
+         util_queue_fence_init(&task->fence);
+         util_queue_add_job(&lvp_bvh_queue, task, &task->fence, lvp_bvh_task_execute, NULL, 0);
       }
-      default:
-         unreachable("Invalid node type");
+
+      for (uint32_t i = 0; i < builder.task_count; i++) {
+         util_queue_fence_wait(&builder.tasks[i].fence);
+         util_queue_fence_destroy(&builder.tasks[i].fence);
       }
+
+      free(builder.tasks);
    }
 
-   return node_id;
+   lvp_bvh_collapse(&builder, 0, LVP_BVH_ROOT_NODE_OFFSET);
+
+   free(builder.nodes);
+   free(builder.prim_bins);
+
+   *internal_count = (builder.dst_offset - LVP_BVH_ROOT_NODE_OFFSET) / sizeof(struct lvp_bvh_box_node);
+   assert(*internal_count == lvp_bvh_box_node_count(leaf_count));
+   return VK_SUCCESS;
 }
 
-void
-lvp_build_acceleration_structure(VkAccelerationStructureBuildGeometryInfoKHR *info,
+/* Recomputes all box node bounds, children before their parents. */
+static void
+lvp_bvh_refit(uint8_t *dst, uint32_t internal_count)
+{
+   for (uint32_t i = internal_count; i-- > 0;) {
+      struct lvp_bvh_box_node *node =
+         (void *)(dst + LVP_BVH_ROOT_NODE_OFFSET + i * sizeof(struct lvp_bvh_box_node));
+
+      lvp_aabb child_bounds[LVP_BVH_WIDTH];
+      for (uint32_t c = 0; c < LVP_BVH_WIDTH; c++)
+         lvp_bvh_node_bounds(dst, node->children[c], &child_bounds[c]);
+
+      lvp_bvh_encode_box_node(node, child_bounds);
+   }
+}
+
+VkResult
+lvp_build_acceleration_structure(const VkAccelerationStructureBuildGeometryInfoKHR *info,
                                  const VkAccelerationStructureBuildRangeInfoKHR *ranges)
 {
    VK_FROM_HANDLE(vk_acceleration_structure, accel_struct, info->dstAccelerationStructure);
    void *dst = (void *)(uintptr_t)vk_acceleration_structure_get_va(accel_struct);
 
-   memset(dst, 0, accel_struct->size);
+   /* Updates keep the topology of the source and only refit the bounds. */
+   bool update = info->mode == VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR;
+   if (update) {
+      VK_FROM_HANDLE(vk_acceleration_structure, src_accel_struct, info->srcAccelerationStructure);
+      void *src = (void *)(uintptr_t)vk_acceleration_structure_get_va(src_accel_struct);
+      if (src != dst)
+         memcpy(dst, src, MIN2(src_accel_struct->size, accel_struct->size));
+   } else {
+      memset(dst, 0, accel_struct->size);
+   }
 
    struct lvp_bvh_header *header = dst;
    header->instance_count = 0;
 
-   struct lvp_bvh_box_node *root = (void *)((uint8_t *)dst + sizeof(struct lvp_bvh_header));
-
    uint32_t leaf_count = 0;
    for (unsigned i = 0; i < info->geometryCount; i++)
       leaf_count += ranges[i].primitiveCount;
 
-   if (!leaf_count) {
-      for (uint32_t i = 0; i < 2; i++) {
-         root->bounds[i].min.x = INFINITY;
-         root->bounds[i].min.y = INFINITY;
-         root->bounds[i].min.z = INFINITY;
-         root->bounds[i].max.x = -INFINITY;
-         root->bounds[i].max.y = -INFINITY;
-         root->bounds[i].max.z = -INFINITY;
-      }
-      return;
-   }
-
-   uint32_t internal_count = MAX2(leaf_count, 2) - 1;
+   uint32_t internal_count = lvp_bvh_box_node_count(leaf_count);
 
    uint32_t primitive_index = 0;
 
@@ -558,13 +1334,8 @@ lvp_build_acceleration_structure(VkAccelerationStructureBuildGeometryInfoKHR *in
 
    leaf_count = primitive_index;
 
-   struct lvp_build_internal_ctx internal_ctx = {
-      .dst = dst,
-      .dst_offset = sizeof(struct lvp_bvh_header),
-
-      .leaf_nodes = leaf_nodes,
-      .leaf_nodes_offset = header->leaf_nodes_offset,
-   };
+   uint32_t leaf_node_type;
+   uint32_t leaf_node_size;
 
    VkGeometryTypeKHR geometry_type = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
    if (info->geometryCount) {
@@ -576,36 +1347,62 @@ lvp_build_acceleration_structure(VkAccelerationStructureBuildGeometryInfoKHR *in
 
    switch (geometry_type) {
    case VK_GEOMETRY_TYPE_TRIANGLES_KHR:
-      internal_ctx.leaf_node_type = lvp_bvh_node_triangle;
-      internal_ctx.leaf_node_size = sizeof(struct lvp_bvh_triangle_node);
+      leaf_node_type = lvp_bvh_node_triangle;
+      leaf_node_size = sizeof(struct lvp_bvh_triangle_node);
       break;
    case VK_GEOMETRY_TYPE_AABBS_KHR:
-      internal_ctx.leaf_node_type = lvp_bvh_node_aabb;
-      internal_ctx.leaf_node_size = sizeof(struct lvp_bvh_aabb_node);
+      leaf_node_type = lvp_bvh_node_aabb;
+      leaf_node_size = sizeof(struct lvp_bvh_aabb_node);
       break;
    case VK_GEOMETRY_TYPE_INSTANCES_KHR:
-      internal_ctx.leaf_node_type = lvp_bvh_node_instance;
-      internal_ctx.leaf_node_size = sizeof(struct lvp_bvh_instance_node);
+      leaf_node_type = lvp_bvh_node_instance;
+      leaf_node_size = sizeof(struct lvp_bvh_instance_node);
       break;
    default:
       unreachable("Unknown VkGeometryTypeKHR");
    }
 
-   if (leaf_count) {
-      lvp_build_internal_node(&internal_ctx, 0, leaf_count - 1);
+   VkResult result = VK_SUCCESS;
+
+   if (update) {
+      lvp_bvh_refit(dst, header->internal_node_count);
    } else {
-      root->children[0] = LVP_BVH_INVALID_NODE;
-      root->children[1] = LVP_BVH_INVALID_NODE;
-   }
+      struct lvp_bvh_prim *prims = malloc(MAX2(leaf_count, 1) * sizeof(struct lvp_bvh_prim));
+      uint32_t prim_count = 0;
+
+      for (uint32_t i = 0; prims && i < leaf_count; i++) {
+         struct lvp_bvh_prim *prim = &prims[prim_count];
+
+         prim->node_id = (header->leaf_nodes_offset + i * leaf_node_size) | leaf_node_type;
 
-   header->bounds.min.x = MIN2(root->bounds[0].min.x, root->bounds[1].min.x);
-   header->bounds.min.y = MIN2(root->bounds[0].min.y, root->bounds[1].min.y);
-   header->bounds.min.z = MIN2(root->bounds[0].min.z, root->bounds[1].min.z);
+         /* Inactive primitives can never become active again, leave them out. */
+         if (lvp_bvh_leaf_is_inactive(dst, prim->node_id))
+            continue;
 
-   header->bounds.max.x = MAX2(root->bounds[0].max.x, root->bounds[1].max.x);
-   header->bounds.max.y = MAX2(root->bounds[0].max.y, root->bounds[1].max.y);
-   header->bounds.max.z = MAX2(root->bounds[0].max.z, root->bounds[1].max.z);
+         lvp_bvh_node_bounds(dst, prim->node_id, &prim->bounds);
+
+         prim->centroid.x = (prim->bounds.min.x + prim->bounds.max.x) * 0.5f;
+         prim->centroid.y = (prim->bounds.min.y + prim->bounds.max.y) * 0.5f;
+         prim->centroid.z = (prim->bounds.min.z + prim->bounds.max.z) * 0.5f;
+         prim_count++;
+      }
+
+      if (prims) {
+         result = lvp_bvh_build(dst, prims, prim_count, &header->internal_node_count);
+      } else {
+         /* Leave a valid, empty BVH behind. */
+         lvp_bvh_write_single_root(dst, NULL);
+         header->internal_node_count = 1;
+         result = VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+
+      free(prims);
+   }
+
+   lvp_bvh_node_bounds(dst, LVP_BVH_ROOT_NODE, &header->bounds);
 
    header->serialization_size = sizeof(struct lvp_accel_struct_serialization_header) +
                                 sizeof(uint64_t) * header->instance_count + accel_struct->size;
+
+   return result;
 }
@@ -72,9 +72,23 @@ struct lvp_bvh_instance_node {
    lvp_mat3x4 otw_matrix;
 };
 
+/* Internal nodes have up to LVP_BVH_WIDTH children, and all of them but
+ * the root have exactly LVP_BVH_WIDTH.  8-wide nodes halve the traversal
+ * depth again but need a deeper stack, see LVP_BVH_STACK_SIZE.
+ */
+#define LVP_BVH_WIDTH_LOG2 2
+#define LVP_BVH_WIDTH      (1 << LVP_BVH_WIDTH_LOG2)
+
+/* The child bounds are quantized to 8 bits per plane: the planes are at
+ * origin + q * scale, rounded outwards. scale is a power of two, so the
+ * decoded planes are exact up to the final addition.
+ */
 struct lvp_bvh_box_node {
-   lvp_aabb bounds[2];
-   uint32_t children[2];
+   lvp_vec3 origin;
+   lvp_vec3 scale;
+   uint8_t min[3][LVP_BVH_WIDTH];
+   uint8_t max[3][LVP_BVH_WIDTH];
+   uint32_t children[LVP_BVH_WIDTH];
 };
 
 struct lvp_bvh_header {
@@ -84,7 +98,8 @@ struct lvp_bvh_header {
    uint32_t instance_count;
    uint32_t leaf_nodes_offset;
 
-   uint32_t padding;
+   /* Number of box nodes, stored consecutively starting with the root. */
+   uint32_t internal_node_count;
 };
 
 struct lvp_accel_struct_serialization_header {
@@ -101,8 +116,34 @@ struct lvp_accel_struct_serialization_header {
 #define LVP_BVH_ROOT_NODE        (LVP_BVH_ROOT_NODE_OFFSET | lvp_bvh_node_internal)
 #define LVP_BVH_INVALID_NODE     0xFFFFFFFF
 
-void
-lvp_build_acceleration_structure(VkAccelerationStructureBuildGeometryInfoKHR *info,
+/* Maximum number of internal nodes on a path from the root to a leaf of the
+ * binary tree the box nodes are collapsed from.  Balanced splits of
+ * maxPrimitiveCount leaves need 24 levels, and rounding the splits so that
+ * every box node below the root is full adds up to LVP_BVH_WIDTH_LOG2 - 1.
+ */
+#define LVP_BVH_MAX_DEPTH (24 + LVP_BVH_WIDTH_LOG2 - 1)
+
+/* Traversal stack entries needed for a top and a bottom level BVH. Every
+ * box node on the path to the current node leaves at most
+ * LVP_BVH_WIDTH - 1 siblings on the stack.  The root may pull up fewer than
+ * LVP_BVH_WIDTH_LOG2 binary levels, all other box nodes pull up exactly that.
+ */
+#define LVP_BVH_STACK_SIZE \
+   (2 * (1 + DIV_ROUND_UP(LVP_BVH_MAX_DEPTH - 1, LVP_BVH_WIDTH_LOG2)) * (LVP_BVH_WIDTH - 1))
+
+VkResult
+lvp_build_acceleration_structure(const VkAccelerationStructureBuildGeometryInfoKHR *info,
                                  const VkAccelerationStructureBuildRangeInfoKHR *ranges);
 
+uint64_t
+lvp_get_acceleration_structure_property(struct vk_acceleration_structure *accel_struct,
+                                        VkQueryType query_type);
+
+void
+lvp_serialize_acceleration_structure(struct vk_acceleration_structure *accel_struct, void *data);
+
+void
+lvp_deserialize_acceleration_structure(struct vk_acceleration_structure *accel_struct,
+                                       const void *data);
+
 #endif
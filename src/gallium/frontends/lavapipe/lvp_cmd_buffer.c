@@ -56,6 +56,9 @@ lvp_create_cmd_buffer(struct vk_command_pool *pool,
    }
 
    cmd_buffer->device = device;
+   cmd_buffer->one_time_submit = false;
+   cmd_buffer->filtered_cmds = NULL;
+   cmd_buffer->filtered_cmd_count = 0;
 
    *cmd_buffer_out = &cmd_buffer->vk;
 
@@ -66,7 +69,12 @@ static void
 lvp_reset_cmd_buffer(struct vk_command_buffer *vk_cmd_buffer,
                      UNUSED VkCommandBufferResetFlags flags)
 {
+   struct lvp_cmd_buffer *cmd_buffer =
+      container_of(vk_cmd_buffer, struct lvp_cmd_buffer, vk);
+
    vk_command_buffer_reset(vk_cmd_buffer);
+   cmd_buffer->filtered_cmds = NULL;
+   cmd_buffer->filtered_cmd_count = 0;
 }
 
 const struct vk_command_buffer_ops lvp_cmd_buffer_ops = {
@@ -82,6 +90,8 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_BeginCommandBuffer(
    LVP_FROM_HANDLE(lvp_cmd_buffer, cmd_buffer, commandBuffer);
 
    vk_command_buffer_begin(&cmd_buffer->vk, pBeginInfo);
+   cmd_buffer->one_time_submit =
+      pBeginInfo->flags & VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
    return VK_SUCCESS;
 }
@@ -91,6 +101,10 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_EndCommandBuffer(
 {
    LVP_FROM_HANDLE(lvp_cmd_buffer, cmd_buffer, commandBuffer);
 
+   if (!cmd_buffer->one_time_submit && !cmd_buffer->device->print_cmds &&
+       !vk_command_buffer_has_error(&cmd_buffer->vk))
+      lvp_filter_cmd_buffer(cmd_buffer);
+
    return vk_command_buffer_end(&cmd_buffer->vk);
 }
 
@@ -109,9 +123,7 @@ VKAPI_ATTR void VKAPI_CALL lvp_CmdPushDescriptorSetWithTemplate2KHR(
    LVP_FROM_HANDLE(lvp_cmd_buffer, cmd_buffer, commandBuffer);
    LVP_FROM_HANDLE(lvp_descriptor_update_template, templ, pPushDescriptorSetWithTemplateInfo->descriptorUpdateTemplate);
    size_t info_size = 0;
-   struct vk_cmd_queue_entry *cmd = vk_zalloc(cmd_buffer->vk.cmd_queue.alloc,
-                                              vk_cmd_queue_type_sizes[VK_CMD_PUSH_DESCRIPTOR_SET_WITH_TEMPLATE2_KHR], 8,
-                                              VK_SYSTEM_ALLOCATION_SCOPE_COMMAND);
+   struct vk_cmd_queue_entry *cmd = vk_cmd_queue_zalloc(&cmd_buffer->vk.cmd_queue, vk_cmd_queue_type_sizes[VK_CMD_PUSH_DESCRIPTOR_SET_WITH_TEMPLATE2_KHR]);
    if (!cmd)
       return;
 
@@ -121,7 +133,7 @@ VKAPI_ATTR void VKAPI_CALL lvp_CmdPushDescriptorSetWithTemplate2KHR(
    cmd->driver_free_cb = lvp_free_CmdPushDescriptorSetWithTemplate2KHR;
    cmd->driver_data = cmd_buffer->device;
    lvp_descriptor_template_templ_ref(templ);
-   cmd->u.push_descriptor_set_with_template2_khr.push_descriptor_set_with_template_info = vk_zalloc(cmd_buffer->vk.cmd_queue.alloc, sizeof(VkPushDescriptorSetWithTemplateInfoKHR), 8, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+   cmd->u.push_descriptor_set_with_template2_khr.push_descriptor_set_with_template_info = vk_cmd_queue_zalloc(&cmd_buffer->vk.cmd_queue, sizeof(VkPushDescriptorSetWithTemplateInfoKHR));
    memcpy(cmd->u.push_descriptor_set_with_template2_khr.push_descriptor_set_with_template_info, pPushDescriptorSetWithTemplateInfo, sizeof(VkPushDescriptorSetWithTemplateInfoKHR));
 
    for (unsigned i = 0; i < templ->entry_count; i++) {
@@ -152,7 +164,7 @@ VKAPI_ATTR void VKAPI_CALL lvp_CmdPushDescriptorSetWithTemplate2KHR(
       }
    }
 
-   cmd->u.push_descriptor_set_with_template2_khr.push_descriptor_set_with_template_info->pData = vk_zalloc(cmd_buffer->vk.cmd_queue.alloc, info_size, 8, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND);
+   cmd->u.push_descriptor_set_with_template2_khr.push_descriptor_set_with_template_info->pData = vk_cmd_queue_zalloc(&cmd_buffer->vk.cmd_queue, info_size);
 
    uint64_t offset = 0;
    for (unsigned i = 0; i < templ->entry_count; i++) {
@@ -168,59 +180,41 @@ VKAPI_ATTR void VKAPI_CALL lvp_CmdPushDescriptorSetWithTemplate2KHR(
 }
 
 
-static void
-vk_free_cmd_push_constants2_khr(struct vk_cmd_queue *queue,
-                                struct vk_cmd_queue_entry *cmd)
-{
-   vk_free(queue->alloc, (void*)cmd->u.push_constants2_khr.push_constants_info->pValues);
-   vk_free(queue->alloc, (VkPushConstantsInfoKHR*)cmd->u.push_constants2_khr.push_constants_info);
-   vk_free(queue->alloc, cmd);
-}
-
 VKAPI_ATTR void VKAPI_CALL lvp_CmdPushConstants2KHR(
    VkCommandBuffer                             commandBuffer,
    const VkPushConstantsInfoKHR* pPushConstantsInfo)
 {
    LVP_FROM_HANDLE(lvp_cmd_buffer, cmd_buffer, commandBuffer);
-   struct vk_cmd_queue_entry *cmd = vk_zalloc(cmd_buffer->vk.cmd_queue.alloc, vk_cmd_queue_type_sizes[VK_CMD_PUSH_CONSTANTS2_KHR], 8,
-                                              VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+   struct vk_cmd_queue_entry *cmd = vk_cmd_queue_zalloc(&cmd_buffer->vk.cmd_queue, vk_cmd_queue_type_sizes[VK_CMD_PUSH_CONSTANTS2_KHR]);
    if (!cmd)
       return;
 
    cmd->type = VK_CMD_PUSH_CONSTANTS2_KHR;
       
-   cmd->u.push_constants2_khr.push_constants_info = vk_zalloc(cmd_buffer->vk.cmd_queue.alloc, sizeof(VkPushConstantsInfoKHR), 8, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+   cmd->u.push_constants2_khr.push_constants_info = vk_cmd_queue_zalloc(&cmd_buffer->vk.cmd_queue, sizeof(VkPushConstantsInfoKHR));
    memcpy((void*)cmd->u.push_constants2_khr.push_constants_info, pPushConstantsInfo, sizeof(VkPushConstantsInfoKHR));
 
-   cmd->u.push_constants2_khr.push_constants_info->pValues = vk_zalloc(cmd_buffer->vk.cmd_queue.alloc, pPushConstantsInfo->size, 8, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+   cmd->u.push_constants2_khr.push_constants_info->pValues = vk_cmd_queue_zalloc(&cmd_buffer->vk.cmd_queue, pPushConstantsInfo->size);
    memcpy((void*)cmd->u.push_constants2_khr.push_constants_info->pValues, pPushConstantsInfo->pValues, pPushConstantsInfo->size);
 
    list_addtail(&cmd->cmd_link, &cmd_buffer->vk.cmd_queue.cmds);
 }
 
 
-static void
-lvp_free_cmd_push_descriptor_set2_khr(struct vk_cmd_queue *queue,
-                                     struct vk_cmd_queue_entry *cmd)
-{
-   ralloc_free(cmd->driver_data);
-}
-
 VKAPI_ATTR void VKAPI_CALL lvp_CmdPushDescriptorSet2KHR(
     VkCommandBuffer                             commandBuffer,
     const VkPushDescriptorSetInfoKHR*           pPushDescriptorSetInfo)
 {
    LVP_FROM_HANDLE(lvp_cmd_buffer, cmd_buffer, commandBuffer);
-   struct vk_cmd_queue_entry *cmd = vk_zalloc(cmd_buffer->vk.cmd_queue.alloc, vk_cmd_queue_type_sizes[VK_CMD_PUSH_DESCRIPTOR_SET2_KHR], 8,
-                                              VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+   struct vk_cmd_queue *queue = &cmd_buffer->vk.cmd_queue;
+   struct vk_cmd_queue_entry *cmd = vk_cmd_queue_zalloc(queue, vk_cmd_queue_type_sizes[VK_CMD_PUSH_DESCRIPTOR_SET2_KHR]);
+   if (!cmd)
+      return;
 
    cmd->type = VK_CMD_PUSH_DESCRIPTOR_SET2_KHR;
-   cmd->driver_free_cb = lvp_free_cmd_push_descriptor_set2_khr;
 
-   void *ctx = cmd->driver_data = ralloc_context(NULL);
    if (pPushDescriptorSetInfo) {
-      cmd->u.push_descriptor_set2_khr.push_descriptor_set_info = vk_zalloc(cmd_buffer->vk.cmd_queue.alloc, sizeof(VkPushDescriptorSetInfoKHR), 8,
-                                                                           VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+      cmd->u.push_descriptor_set2_khr.push_descriptor_set_info = vk_cmd_queue_zalloc(queue, sizeof(VkPushDescriptorSetInfoKHR));
 
       memcpy((void*)cmd->u.push_descriptor_set2_khr.push_descriptor_set_info, pPushDescriptorSetInfo, sizeof(VkPushDescriptorSetInfoKHR));
       VkPushDescriptorSetInfoKHR *tmp_dst1 = (void *) cmd->u.push_descriptor_set2_khr.push_descriptor_set_info; (void) tmp_dst1;
@@ -231,18 +225,18 @@ VKAPI_ATTR void VKAPI_CALL lvp_CmdPushDescriptorSet2KHR(
          switch ((int32_t)pnext->sType) {
          case VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO:
             if (pnext) {
-               tmp_dst1->pNext = rzalloc(ctx, VkPipelineLayoutCreateInfo);
+               tmp_dst1->pNext = vk_cmd_queue_zalloc(queue, sizeof(VkPipelineLayoutCreateInfo));
 
                memcpy((void*)tmp_dst1->pNext, pnext, sizeof(VkPipelineLayoutCreateInfo));
                VkPipelineLayoutCreateInfo *tmp_dst2 = (void *) tmp_dst1->pNext; (void) tmp_dst2;
                VkPipelineLayoutCreateInfo *tmp_src2 = (void *) pnext; (void) tmp_src2;
                if (tmp_src2->pSetLayouts) {
-                  tmp_dst2->pSetLayouts = rzalloc_array_size(ctx, sizeof(*tmp_dst2->pSetLayouts), tmp_dst2->setLayoutCount);
+                  tmp_dst2->pSetLayouts = vk_cmd_queue_zalloc(queue, sizeof(*tmp_dst2->pSetLayouts) * tmp_dst2->setLayoutCount);
 
                   memcpy((void*)tmp_dst2->pSetLayouts, tmp_src2->pSetLayouts, sizeof(*tmp_dst2->pSetLayouts) * tmp_dst2->setLayoutCount);
                }
                if (tmp_src2->pPushConstantRanges) {
-                  tmp_dst2->pPushConstantRanges = rzalloc_array_size(ctx, sizeof(*tmp_dst2->pPushConstantRanges), tmp_dst2->pushConstantRangeCount);
+                  tmp_dst2->pPushConstantRanges = vk_cmd_queue_zalloc(queue, sizeof(*tmp_dst2->pPushConstantRanges) * tmp_dst2->pushConstantRangeCount);
 
                   memcpy((void*)tmp_dst2->pPushConstantRanges, tmp_src2->pPushConstantRanges, sizeof(*tmp_dst2->pPushConstantRanges) * tmp_dst2->pushConstantRangeCount);
                }
@@ -254,8 +248,7 @@ VKAPI_ATTR void VKAPI_CALL lvp_CmdPushDescriptorSet2KHR(
          }
       }
       if (tmp_src1->pDescriptorWrites) {
-         tmp_dst1->pDescriptorWrites = vk_zalloc(cmd_buffer->vk.cmd_queue.alloc, sizeof(*tmp_dst1->pDescriptorWrites) * tmp_dst1->descriptorWriteCount, 8,
-                                                 VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+         tmp_dst1->pDescriptorWrites = vk_cmd_queue_zalloc(queue, sizeof(*tmp_dst1->pDescriptorWrites) * tmp_dst1->descriptorWriteCount);
 
          memcpy((void*)tmp_dst1->pDescriptorWrites, tmp_src1->pDescriptorWrites, sizeof(*tmp_dst1->pDescriptorWrites) * tmp_dst1->descriptorWriteCount);
          for (unsigned i = 0; i < tmp_src1->descriptorWriteCount; i++) {
@@ -265,9 +258,9 @@ VKAPI_ATTR void VKAPI_CALL lvp_CmdPushDescriptorSet2KHR(
             case VK_DESCRIPTOR_TYPE_INLINE_UNIFORM_BLOCK: {
                const VkWriteDescriptorSetInlineUniformBlock *uniform_data = vk_find_struct_const(write->pNext, WRITE_DESCRIPTOR_SET_INLINE_UNIFORM_BLOCK);
                assert(uniform_data);
-               VkWriteDescriptorSetInlineUniformBlock *dst = rzalloc(ctx, VkWriteDescriptorSetInlineUniformBlock);
+               VkWriteDescriptorSetInlineUniformBlock *dst = vk_cmd_queue_zalloc(queue, sizeof(VkWriteDescriptorSetInlineUniformBlock));
                memcpy((void*)dst, uniform_data, sizeof(*uniform_data));
-               dst->pData = ralloc_size(ctx, uniform_data->dataSize);
+               dst->pData = vk_cmd_queue_zalloc(queue, uniform_data->dataSize);
                memcpy((void*)dst->pData, uniform_data->pData, uniform_data->dataSize);
                dstwrite->pNext = dst;
                break;
@@ -278,7 +271,7 @@ VKAPI_ATTR void VKAPI_CALL lvp_CmdPushDescriptorSet2KHR(
             case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
             case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
             case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
-               dstwrite->pImageInfo = rzalloc_array(ctx, VkDescriptorImageInfo, write->descriptorCount);
+               dstwrite->pImageInfo = vk_cmd_queue_zalloc(queue, sizeof(VkDescriptorImageInfo) * write->descriptorCount);
                {
                   VkDescriptorImageInfo *arr = (void*)dstwrite->pImageInfo;
                   typed_memcpy(arr, write->pImageInfo, write->descriptorCount);
@@ -287,7 +280,7 @@ VKAPI_ATTR void VKAPI_CALL lvp_CmdPushDescriptorSet2KHR(
 
             case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
             case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
-               dstwrite->pTexelBufferView = rzalloc_array(ctx, VkBufferView, write->descriptorCount);
+               dstwrite->pTexelBufferView = vk_cmd_queue_zalloc(queue, sizeof(VkBufferView) * write->descriptorCount);
                {
                   VkBufferView *arr = (void*)dstwrite->pTexelBufferView;
                   typed_memcpy(arr, write->pTexelBufferView, write->descriptorCount);
@@ -298,7 +291,7 @@ VKAPI_ATTR void VKAPI_CALL lvp_CmdPushDescriptorSet2KHR(
             case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
             case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
             case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
-               dstwrite->pBufferInfo = rzalloc_array(ctx, VkDescriptorBufferInfo, write->descriptorCount);
+               dstwrite->pBufferInfo = vk_cmd_queue_zalloc(queue, sizeof(VkDescriptorBufferInfo) * write->descriptorCount);
                {
                   VkDescriptorBufferInfo *arr = (void*)dstwrite->pBufferInfo;
                   typed_memcpy(arr, write->pBufferInfo, write->descriptorCount);
@@ -311,7 +304,7 @@ VKAPI_ATTR void VKAPI_CALL lvp_CmdPushDescriptorSet2KHR(
 
                uint32_t accel_structs_size = sizeof(VkAccelerationStructureKHR) * accel_structs->accelerationStructureCount;
                VkWriteDescriptorSetAccelerationStructureKHR *write_accel_structs =
-                  rzalloc_size(ctx, sizeof(VkWriteDescriptorSetAccelerationStructureKHR) + accel_structs_size);
+                  vk_cmd_queue_zalloc(queue, sizeof(VkWriteDescriptorSetAccelerationStructureKHR) + accel_structs_size);
             
                write_accel_structs->sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR;
                write_accel_structs->accelerationStructureCount = accel_structs->accelerationStructureCount;
@@ -429,7 +429,7 @@ lvp_get_features(const struct lvp_physical_device *pdevice,
       .accelerationStructure = true,
       .accelerationStructureCaptureReplay = false,
       .accelerationStructureIndirectBuild = false,
-      .accelerationStructureHostCommands = false,
+      .accelerationStructureHostCommands = true,
       .descriptorBindingAccelerationStructureUpdateAfterBind = true,
 
       /* VK_EXT_descriptor_buffer */
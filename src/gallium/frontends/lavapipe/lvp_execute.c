@@ -2818,13 +2818,15 @@ static void handle_push_constants(struct vk_cmd_queue_entry *cmd,
 
 static void lvp_execute_cmd_buffer(struct list_head *cmds,
                                    struct rendering_state *state, bool print_cmds);
+static void lvp_execute_lvp_cmd_buffer(struct lvp_cmd_buffer *cmd_buffer,
+                                       struct rendering_state *state, bool print_cmds);
 
 static void handle_execute_commands(struct vk_cmd_queue_entry *cmd,
                                     struct rendering_state *state, bool print_cmds)
 {
    for (unsigned i = 0; i < cmd->u.execute_commands.command_buffer_count; i++) {
       LVP_FROM_HANDLE(lvp_cmd_buffer, secondary_buf, cmd->u.execute_commands.command_buffers[i]);
-      lvp_execute_cmd_buffer(&secondary_buf->vk.cmd_queue.cmds, state, print_cmds);
+      lvp_execute_lvp_cmd_buffer(secondary_buf, state, print_cmds);
    }
 }
 
@@ -4429,17 +4431,7 @@ handle_copy_memory_to_acceleration_structure(struct vk_cmd_queue_entry *cmd, str
 
    VK_FROM_HANDLE(vk_acceleration_structure, accel_struct, copy->info->dst);
 
-   struct lvp_bvh_header *dst = (void *)(uintptr_t)vk_acceleration_structure_get_va(accel_struct);
-   const struct lvp_accel_struct_serialization_header *src = copy->info->src.hostAddress;
-
-   memcpy(dst, &src->instances[src->instance_count], src->compacted_size);
-
-   for (uint32_t i = 0; i < src->instance_count; i++) {
-      uint8_t *leaf_nodes = (uint8_t *)dst;
-      leaf_nodes += dst->leaf_nodes_offset;
-      struct lvp_bvh_instance_node *node = (struct lvp_bvh_instance_node *)leaf_nodes;
-      node[i].bvh_ptr = src->instances[i];
-   }
+   lvp_deserialize_acceleration_structure(accel_struct, copy->info->src.hostAddress);
 }
 
 static void
@@ -4449,23 +4441,7 @@ handle_copy_acceleration_structure_to_memory(struct vk_cmd_queue_entry *cmd, str
 
    VK_FROM_HANDLE(vk_acceleration_structure, accel_struct, copy->info->src);
 
-   struct lvp_bvh_header *src = (void *)(uintptr_t)vk_acceleration_structure_get_va(accel_struct);
-   struct lvp_accel_struct_serialization_header *dst = copy->info->dst.hostAddress;
-
-   lvp_device_get_cache_uuid(dst->driver_uuid);
-   lvp_device_get_cache_uuid(dst->accel_struct_compat);
-   dst->serialization_size = src->serialization_size;
-   dst->compacted_size = accel_struct->size;
-   dst->instance_count = src->instance_count;
-
-   for (uint32_t i = 0; i < src->instance_count; i++) {
-      uint8_t *leaf_nodes = (uint8_t *)src;
-      leaf_nodes += src->leaf_nodes_offset;
-      struct lvp_bvh_instance_node *node = (struct lvp_bvh_instance_node *)leaf_nodes;
-      dst->instances[i] = node[i].bvh_ptr;
-   }
-
-   memcpy(&dst->instances[dst->instance_count], src, accel_struct->size);
+   lvp_serialize_acceleration_structure(accel_struct, copy->info->dst.hostAddress);
 }
 
 static void
@@ -4490,26 +4466,7 @@ handle_write_acceleration_structures_properties(struct vk_cmd_queue_entry *cmd,
    for (uint32_t i = 0; i < write->acceleration_structure_count; i++) {
       VK_FROM_HANDLE(vk_acceleration_structure, accel_struct, write->acceleration_structures[i]);
 
-      switch ((uint32_t)pool->base_type) {
-      case LVP_QUERY_ACCELERATION_STRUCTURE_COMPACTED_SIZE:
-         dst[i] = accel_struct->size;
-         break;
-      case LVP_QUERY_ACCELERATION_STRUCTURE_SERIALIZATION_SIZE: {
-         struct lvp_bvh_header *header = (void *)(uintptr_t)vk_acceleration_structure_get_va(accel_struct);
-         dst[i] = header->serialization_size;
-         break;
-      }
-      case LVP_QUERY_ACCELERATION_STRUCTURE_SIZE:
-         dst[i] = accel_struct->size;
-         break;
-      case LVP_QUERY_ACCELERATION_STRUCTURE_INSTANCE_COUNT: {
-         struct lvp_bvh_header *header = (void *)(uintptr_t)vk_acceleration_structure_get_va(accel_struct);
-         dst[i] = header->instance_count;
-         break;
-      }
-      default:
-         unreachable("Unsupported query type");
-      }
+      dst[i] = lvp_get_acceleration_structure_property(accel_struct, pool->type);
    }
 }
 
@@ -4796,6 +4753,396 @@ void lvp_add_enqueue_cmd_entrypoints(struct vk_device_dispatch_table *disp)
 #undef ENQUEUE_CMD
 }
 
+static void lvp_execute_cmd(struct vk_cmd_queue_entry *cmd,
+                            struct rendering_state *state, bool print_cmds)
+{
+   if (print_cmds)
+      fprintf(stderr, "%s\n", vk_cmd_queue_type_names[cmd->type]);
+   switch (cmd->type) {
+   case VK_CMD_BIND_PIPELINE:
+      handle_pipeline(cmd, state);
+      break;
+   case VK_CMD_SET_VIEWPORT:
+      handle_set_viewport(cmd, state);
+      break;
+   case VK_CMD_SET_VIEWPORT_WITH_COUNT:
+      handle_set_viewport_with_count(cmd, state);
+      break;
+   case VK_CMD_SET_SCISSOR:
+      handle_set_scissor(cmd, state);
+      break;
+   case VK_CMD_SET_SCISSOR_WITH_COUNT:
+      handle_set_scissor_with_count(cmd, state);
+      break;
+   case VK_CMD_SET_LINE_WIDTH:
+      handle_set_line_width(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_BIAS:
+      handle_set_depth_bias(cmd, state);
+      break;
+   case VK_CMD_SET_BLEND_CONSTANTS:
+      handle_set_blend_constants(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_BOUNDS:
+      handle_set_depth_bounds(cmd, state);
+      break;
+   case VK_CMD_SET_STENCIL_COMPARE_MASK:
+      handle_set_stencil_compare_mask(cmd, state);
+      break;
+   case VK_CMD_SET_STENCIL_WRITE_MASK:
+      handle_set_stencil_write_mask(cmd, state);
+      break;
+   case VK_CMD_SET_STENCIL_REFERENCE:
+      handle_set_stencil_reference(cmd, state);
+      break;
+   case VK_CMD_BIND_DESCRIPTOR_SETS2_KHR:
+      handle_descriptor_sets_cmd(cmd, state);
+      break;
+   case VK_CMD_BIND_INDEX_BUFFER:
+      handle_index_buffer(cmd, state);
+      break;
+   case VK_CMD_BIND_INDEX_BUFFER2_KHR:
+      handle_index_buffer2(cmd, state);
+      break;
+   case VK_CMD_BIND_VERTEX_BUFFERS2:
+      handle_vertex_buffers2(cmd, state);
+      break;
+   case VK_CMD_DRAW:
+      emit_state(state);
+      handle_draw(cmd, state);
+      break;
+   case VK_CMD_DRAW_MULTI_EXT:
+      emit_state(state);
+      handle_draw_multi(cmd, state);
+      break;
+   case VK_CMD_DRAW_INDEXED:
+      emit_state(state);
+      handle_draw_indexed(cmd, state);
+      break;
+   case VK_CMD_DRAW_INDIRECT:
+      emit_state(state);
+      handle_draw_indirect(cmd, state, false);
+      break;
+   case VK_CMD_DRAW_INDEXED_INDIRECT:
+      emit_state(state);
+      handle_draw_indirect(cmd, state, true);
+      break;
+   case VK_CMD_DRAW_MULTI_INDEXED_EXT:
+      emit_state(state);
+      handle_draw_multi_indexed(cmd, state);
+      break;
+   case VK_CMD_DISPATCH:
+      emit_compute_state(state);
+      handle_dispatch(cmd, state);
+      break;
+   case VK_CMD_DISPATCH_BASE:
+      emit_compute_state(state);
+      handle_dispatch_base(cmd, state);
+      break;
+   case VK_CMD_DISPATCH_INDIRECT:
+      emit_compute_state(state);
+      handle_dispatch_indirect(cmd, state);
+      break;
+   case VK_CMD_COPY_BUFFER2:
+      handle_copy_buffer(cmd, state);
+      break;
+   case VK_CMD_COPY_IMAGE2:
+      handle_copy_image(cmd, state);
+      break;
+   case VK_CMD_BLIT_IMAGE2:
+      handle_blit_image(cmd, state);
+      break;
+   case VK_CMD_COPY_BUFFER_TO_IMAGE2:
+      handle_copy_buffer_to_image(cmd, state);
+      break;
+   case VK_CMD_COPY_IMAGE_TO_BUFFER2:
+      handle_copy_image_to_buffer2(cmd, state);
+      break;
+   case VK_CMD_UPDATE_BUFFER:
+      handle_update_buffer(cmd, state);
+      break;
+   case VK_CMD_FILL_BUFFER:
+      handle_fill_buffer(cmd, state);
+      break;
+   case VK_CMD_CLEAR_COLOR_IMAGE:
+      handle_clear_color_image(cmd, state);
+      break;
+   case VK_CMD_CLEAR_DEPTH_STENCIL_IMAGE:
+      handle_clear_ds_image(cmd, state);
+      break;
+   case VK_CMD_CLEAR_ATTACHMENTS:
+      handle_clear_attachments(cmd, state);
+      break;
+   case VK_CMD_RESOLVE_IMAGE2:
+      handle_resolve_image(cmd, state);
+      break;
+   case VK_CMD_PIPELINE_BARRIER2:
+      handle_pipeline_barrier(cmd, state);
+      break;
+   case VK_CMD_BEGIN_QUERY_INDEXED_EXT:
+      handle_begin_query_indexed_ext(cmd, state);
+      break;
+   case VK_CMD_END_QUERY_INDEXED_EXT:
+      handle_end_query_indexed_ext(cmd, state);
+      break;
+   case VK_CMD_BEGIN_QUERY:
+      handle_begin_query(cmd, state);
+      break;
+   case VK_CMD_END_QUERY:
+      handle_end_query(cmd, state);
+      break;
+   case VK_CMD_RESET_QUERY_POOL:
+      handle_reset_query_pool(cmd, state);
+      break;
+   case VK_CMD_COPY_QUERY_POOL_RESULTS:
+      handle_copy_query_pool_results(cmd, state);
+      break;
+   case VK_CMD_PUSH_CONSTANTS2_KHR:
+      handle_push_constants(cmd, state);
+      break;
+   case VK_CMD_EXECUTE_COMMANDS:
+      handle_execute_commands(cmd, state, print_cmds);
+      break;
+   case VK_CMD_DRAW_INDIRECT_COUNT:
+      emit_state(state);
+      handle_draw_indirect_count(cmd, state, false);
+      break;
+   case VK_CMD_DRAW_INDEXED_INDIRECT_COUNT:
+      emit_state(state);
+      handle_draw_indirect_count(cmd, state, true);
+      break;
+   case VK_CMD_PUSH_DESCRIPTOR_SET2_KHR:
+      handle_push_descriptor_set(cmd, state);
+      break;
+   case VK_CMD_PUSH_DESCRIPTOR_SET_WITH_TEMPLATE2_KHR:
+      handle_push_descriptor_set_with_template(cmd, state);
+      break;
+   case VK_CMD_BIND_TRANSFORM_FEEDBACK_BUFFERS_EXT:
+      handle_bind_transform_feedback_buffers(cmd, state);
+      break;
+   case VK_CMD_BEGIN_TRANSFORM_FEEDBACK_EXT:
+      handle_begin_transform_feedback(cmd, state);
+      break;
+   case VK_CMD_END_TRANSFORM_FEEDBACK_EXT:
+      handle_end_transform_feedback(cmd, state);
+      break;
+   case VK_CMD_DRAW_INDIRECT_BYTE_COUNT_EXT:
+      emit_state(state);
+      handle_draw_indirect_byte_count(cmd, state);
+      break;
+   case VK_CMD_BEGIN_CONDITIONAL_RENDERING_EXT:
+      handle_begin_conditional_rendering(cmd, state);
+      break;
+   case VK_CMD_END_CONDITIONAL_RENDERING_EXT:
+      handle_end_conditional_rendering(state);
+      break;
+   case VK_CMD_SET_VERTEX_INPUT_EXT:
+      handle_set_vertex_input(cmd, state);
+      break;
+   case VK_CMD_SET_CULL_MODE:
+      handle_set_cull_mode(cmd, state);
+      break;
+   case VK_CMD_SET_FRONT_FACE:
+      handle_set_front_face(cmd, state);
+      break;
+   case VK_CMD_SET_PRIMITIVE_TOPOLOGY:
+      handle_set_primitive_topology(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_TEST_ENABLE:
+      handle_set_depth_test_enable(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_WRITE_ENABLE:
+      handle_set_depth_write_enable(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_COMPARE_OP:
+      handle_set_depth_compare_op(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_BOUNDS_TEST_ENABLE:
+      handle_set_depth_bounds_test_enable(cmd, state);
+      break;
+   case VK_CMD_SET_STENCIL_TEST_ENABLE:
+      handle_set_stencil_test_enable(cmd, state);
+      break;
+   case VK_CMD_SET_STENCIL_OP:
+      handle_set_stencil_op(cmd, state);
+      break;
+   case VK_CMD_SET_LINE_STIPPLE_KHR:
+      handle_set_line_stipple(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_BIAS_ENABLE:
+      handle_set_depth_bias_enable(cmd, state);
+      break;
+   case VK_CMD_SET_LOGIC_OP_EXT:
+      handle_set_logic_op(cmd, state);
+      break;
+   case VK_CMD_SET_PATCH_CONTROL_POINTS_EXT:
+      handle_set_patch_control_points(cmd, state);
+      break;
+   case VK_CMD_SET_PRIMITIVE_RESTART_ENABLE:
+      handle_set_primitive_restart_enable(cmd, state);
+      break;
+   case VK_CMD_SET_RASTERIZER_DISCARD_ENABLE:
+      handle_set_rasterizer_discard_enable(cmd, state);
+      break;
+   case VK_CMD_SET_COLOR_WRITE_ENABLE_EXT:
+      handle_set_color_write_enable(cmd, state);
+      break;
+   case VK_CMD_BEGIN_RENDERING:
+      handle_begin_rendering(cmd, state);
+      break;
+   case VK_CMD_END_RENDERING:
+      handle_end_rendering(cmd, state);
+      break;
+   case VK_CMD_SET_DEVICE_MASK:
+      /* no-op */
+      break;
+   case VK_CMD_RESET_EVENT2:
+      handle_event_reset2(cmd, state);
+      break;
+   case VK_CMD_SET_EVENT2:
+      handle_event_set2(cmd, state);
+      break;
+   case VK_CMD_WAIT_EVENTS2:
+      handle_wait_events2(cmd, state);
+      break;
+   case VK_CMD_WRITE_TIMESTAMP2:
+      handle_write_timestamp2(cmd, state);
+      break;
+   case VK_CMD_SET_POLYGON_MODE_EXT:
+      handle_set_polygon_mode(cmd, state);
+      break;
+   case VK_CMD_SET_TESSELLATION_DOMAIN_ORIGIN_EXT:
+      handle_set_tessellation_domain_origin(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_CLAMP_ENABLE_EXT:
+      handle_set_depth_clamp_enable(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_CLIP_ENABLE_EXT:
+      handle_set_depth_clip_enable(cmd, state);
+      break;
+   case VK_CMD_SET_LOGIC_OP_ENABLE_EXT:
+      handle_set_logic_op_enable(cmd, state);
+      break;
+   case VK_CMD_SET_SAMPLE_MASK_EXT:
+      handle_set_sample_mask(cmd, state);
+      break;
+   case VK_CMD_SET_RASTERIZATION_SAMPLES_EXT:
+      handle_set_samples(cmd, state);
+      break;
+   case VK_CMD_SET_ALPHA_TO_COVERAGE_ENABLE_EXT:
+      handle_set_alpha_to_coverage(cmd, state);
+      break;
+   case VK_CMD_SET_ALPHA_TO_ONE_ENABLE_EXT:
+      handle_set_alpha_to_one(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_CLIP_NEGATIVE_ONE_TO_ONE_EXT:
+      handle_set_halfz(cmd, state);
+      break;
+   case VK_CMD_SET_LINE_RASTERIZATION_MODE_EXT:
+      handle_set_line_rasterization_mode(cmd, state);
+      break;
+   case VK_CMD_SET_LINE_STIPPLE_ENABLE_EXT:
+      handle_set_line_stipple_enable(cmd, state);
+      break;
+   case VK_CMD_SET_PROVOKING_VERTEX_MODE_EXT:
+      handle_set_provoking_vertex_mode(cmd, state);
+      break;
+   case VK_CMD_SET_COLOR_BLEND_ENABLE_EXT:
+      handle_set_color_blend_enable(cmd, state);
+      break;
+   case VK_CMD_SET_COLOR_WRITE_MASK_EXT:
+      handle_set_color_write_mask(cmd, state);
+      break;
+   case VK_CMD_SET_COLOR_BLEND_EQUATION_EXT:
+      handle_set_color_blend_equation(cmd, state);
+      break;
+   case VK_CMD_BIND_SHADERS_EXT:
+      handle_shaders(cmd, state);
+      break;
+   case VK_CMD_SET_ATTACHMENT_FEEDBACK_LOOP_ENABLE_EXT:
+      break;
+   case VK_CMD_DRAW_MESH_TASKS_EXT:
+      emit_state(state);
+      handle_draw_mesh_tasks(cmd, state);
+      break;
+   case VK_CMD_DRAW_MESH_TASKS_INDIRECT_EXT:
+      emit_state(state);
+      handle_draw_mesh_tasks_indirect(cmd, state);
+      break;
+   case VK_CMD_DRAW_MESH_TASKS_INDIRECT_COUNT_EXT:
+      emit_state(state);
+      handle_draw_mesh_tasks_indirect_count(cmd, state);
+      break;
+   case VK_CMD_BIND_PIPELINE_SHADER_GROUP_NV:
+      handle_graphics_pipeline_group(cmd, state);
+      break;
+   case VK_CMD_PREPROCESS_GENERATED_COMMANDS_NV:
+      handle_preprocess_generated_commands(cmd, state, print_cmds);
+      break;
+   case VK_CMD_EXECUTE_GENERATED_COMMANDS_NV:
+      handle_execute_generated_commands(cmd, state, print_cmds);
+      break;
+   case VK_CMD_BIND_DESCRIPTOR_BUFFERS_EXT:
+      handle_descriptor_buffers(cmd, state);
+      break;
+   case VK_CMD_SET_DESCRIPTOR_BUFFER_OFFSETS2_EXT:
+      handle_descriptor_buffer_offsets(cmd, state);
+      break;
+   case VK_CMD_BIND_DESCRIPTOR_BUFFER_EMBEDDED_SAMPLERS2_EXT:
+      handle_descriptor_buffer_embedded_samplers(cmd, state);
+      break;
+#ifdef VK_ENABLE_BETA_EXTENSIONS
+   case VK_CMD_INITIALIZE_GRAPH_SCRATCH_MEMORY_AMDX:
+      break;
+   case VK_CMD_DISPATCH_GRAPH_INDIRECT_COUNT_AMDX:
+      break;
+   case VK_CMD_DISPATCH_GRAPH_INDIRECT_AMDX:
+      break;
+   case VK_CMD_DISPATCH_GRAPH_AMDX:
+      handle_dispatch_graph(cmd, state);
+      break;
+#endif
+   case VK_CMD_SET_RENDERING_ATTACHMENT_LOCATIONS_KHR:
+      handle_rendering_attachment_locations(cmd, state);
+      break;
+   case VK_CMD_SET_RENDERING_INPUT_ATTACHMENT_INDICES_KHR:
+      handle_rendering_input_attachment_indices(cmd, state);
+      break;
+   case VK_CMD_COPY_ACCELERATION_STRUCTURE_KHR:
+      handle_copy_acceleration_structure(cmd, state);
+      break;
+   case VK_CMD_COPY_MEMORY_TO_ACCELERATION_STRUCTURE_KHR:
+      handle_copy_memory_to_acceleration_structure(cmd, state);
+      break;
+   case VK_CMD_COPY_ACCELERATION_STRUCTURE_TO_MEMORY_KHR:
+      handle_copy_acceleration_structure_to_memory(cmd, state);
+      break;
+   case VK_CMD_BUILD_ACCELERATION_STRUCTURES_KHR:
+      handle_build_acceleration_structures(cmd, state);
+      break;
+   case VK_CMD_BUILD_ACCELERATION_STRUCTURES_INDIRECT_KHR:
+      break;
+   case VK_CMD_WRITE_ACCELERATION_STRUCTURES_PROPERTIES_KHR:
+      handle_write_acceleration_structures_properties(cmd, state);
+      break;
+   case VK_CMD_SET_RAY_TRACING_PIPELINE_STACK_SIZE_KHR:
+      break;
+   case VK_CMD_TRACE_RAYS_INDIRECT2_KHR:
+      handle_trace_rays_indirect2(cmd, state);
+      break;
+   case VK_CMD_TRACE_RAYS_INDIRECT_KHR:
+      handle_trace_rays_indirect(cmd, state);
+      break;
+   case VK_CMD_TRACE_RAYS_KHR:
+      handle_trace_rays(cmd, state);
+      break;
+   default:
+      fprintf(stderr, "Unsupported command %s\n", vk_cmd_queue_type_names[cmd->type]);
+      unreachable("Unsupported command");
+      break;
+   }
+}
+
 static void lvp_execute_cmd_buffer(struct list_head *cmds,
                                    struct rendering_state *state, bool print_cmds)
 {
@@ -4803,399 +5150,164 @@ static void lvp_execute_cmd_buffer(struct list_head *cmds,
    bool did_flush = false;
 
    LIST_FOR_EACH_ENTRY(cmd, cmds, cmd_link) {
-      if (print_cmds)
-         fprintf(stderr, "%s\n", vk_cmd_queue_type_names[cmd->type]);
-      switch (cmd->type) {
-      case VK_CMD_BIND_PIPELINE:
-         handle_pipeline(cmd, state);
-         break;
-      case VK_CMD_SET_VIEWPORT:
-         handle_set_viewport(cmd, state);
-         break;
-      case VK_CMD_SET_VIEWPORT_WITH_COUNT:
-         handle_set_viewport_with_count(cmd, state);
-         break;
-      case VK_CMD_SET_SCISSOR:
-         handle_set_scissor(cmd, state);
-         break;
-      case VK_CMD_SET_SCISSOR_WITH_COUNT:
-         handle_set_scissor_with_count(cmd, state);
-         break;
-      case VK_CMD_SET_LINE_WIDTH:
-         handle_set_line_width(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_BIAS:
-         handle_set_depth_bias(cmd, state);
-         break;
-      case VK_CMD_SET_BLEND_CONSTANTS:
-         handle_set_blend_constants(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_BOUNDS:
-         handle_set_depth_bounds(cmd, state);
-         break;
-      case VK_CMD_SET_STENCIL_COMPARE_MASK:
-         handle_set_stencil_compare_mask(cmd, state);
-         break;
-      case VK_CMD_SET_STENCIL_WRITE_MASK:
-         handle_set_stencil_write_mask(cmd, state);
-         break;
-      case VK_CMD_SET_STENCIL_REFERENCE:
-         handle_set_stencil_reference(cmd, state);
-         break;
-      case VK_CMD_BIND_DESCRIPTOR_SETS2_KHR:
-         handle_descriptor_sets_cmd(cmd, state);
-         break;
-      case VK_CMD_BIND_INDEX_BUFFER:
-         handle_index_buffer(cmd, state);
-         break;
-      case VK_CMD_BIND_INDEX_BUFFER2_KHR:
-         handle_index_buffer2(cmd, state);
-         break;
-      case VK_CMD_BIND_VERTEX_BUFFERS2:
-         handle_vertex_buffers2(cmd, state);
-         break;
-      case VK_CMD_DRAW:
-         emit_state(state);
-         handle_draw(cmd, state);
-         break;
-      case VK_CMD_DRAW_MULTI_EXT:
-         emit_state(state);
-         handle_draw_multi(cmd, state);
-         break;
-      case VK_CMD_DRAW_INDEXED:
-         emit_state(state);
-         handle_draw_indexed(cmd, state);
-         break;
-      case VK_CMD_DRAW_INDIRECT:
-         emit_state(state);
-         handle_draw_indirect(cmd, state, false);
-         break;
-      case VK_CMD_DRAW_INDEXED_INDIRECT:
-         emit_state(state);
-         handle_draw_indirect(cmd, state, true);
-         break;
-      case VK_CMD_DRAW_MULTI_INDEXED_EXT:
-         emit_state(state);
-         handle_draw_multi_indexed(cmd, state);
-         break;
-      case VK_CMD_DISPATCH:
-         emit_compute_state(state);
-         handle_dispatch(cmd, state);
-         break;
-      case VK_CMD_DISPATCH_BASE:
-         emit_compute_state(state);
-         handle_dispatch_base(cmd, state);
-         break;
-      case VK_CMD_DISPATCH_INDIRECT:
-         emit_compute_state(state);
-         handle_dispatch_indirect(cmd, state);
-         break;
-      case VK_CMD_COPY_BUFFER2:
-         handle_copy_buffer(cmd, state);
-         break;
-      case VK_CMD_COPY_IMAGE2:
-         handle_copy_image(cmd, state);
-         break;
-      case VK_CMD_BLIT_IMAGE2:
-         handle_blit_image(cmd, state);
-         break;
-      case VK_CMD_COPY_BUFFER_TO_IMAGE2:
-         handle_copy_buffer_to_image(cmd, state);
-         break;
-      case VK_CMD_COPY_IMAGE_TO_BUFFER2:
-         handle_copy_image_to_buffer2(cmd, state);
-         break;
-      case VK_CMD_UPDATE_BUFFER:
-         handle_update_buffer(cmd, state);
-         break;
-      case VK_CMD_FILL_BUFFER:
-         handle_fill_buffer(cmd, state);
-         break;
-      case VK_CMD_CLEAR_COLOR_IMAGE:
-         handle_clear_color_image(cmd, state);
-         break;
-      case VK_CMD_CLEAR_DEPTH_STENCIL_IMAGE:
-         handle_clear_ds_image(cmd, state);
-         break;
-      case VK_CMD_CLEAR_ATTACHMENTS:
-         handle_clear_attachments(cmd, state);
-         break;
-      case VK_CMD_RESOLVE_IMAGE2:
-         handle_resolve_image(cmd, state);
-         break;
-      case VK_CMD_PIPELINE_BARRIER2:
+      if (cmd->type == VK_CMD_PIPELINE_BARRIER2) {
          /* flushes are actually stalls, so multiple flushes are redundant */
          if (did_flush)
             continue;
-         handle_pipeline_barrier(cmd, state);
          did_flush = true;
-         continue;
-      case VK_CMD_BEGIN_QUERY_INDEXED_EXT:
-         handle_begin_query_indexed_ext(cmd, state);
-         break;
-      case VK_CMD_END_QUERY_INDEXED_EXT:
-         handle_end_query_indexed_ext(cmd, state);
-         break;
-      case VK_CMD_BEGIN_QUERY:
-         handle_begin_query(cmd, state);
-         break;
-      case VK_CMD_END_QUERY:
-         handle_end_query(cmd, state);
-         break;
-      case VK_CMD_RESET_QUERY_POOL:
-         handle_reset_query_pool(cmd, state);
-         break;
-      case VK_CMD_COPY_QUERY_POOL_RESULTS:
-         handle_copy_query_pool_results(cmd, state);
-         break;
-      case VK_CMD_PUSH_CONSTANTS2_KHR:
-         handle_push_constants(cmd, state);
-         break;
-      case VK_CMD_EXECUTE_COMMANDS:
-         handle_execute_commands(cmd, state, print_cmds);
-         break;
-      case VK_CMD_DRAW_INDIRECT_COUNT:
-         emit_state(state);
-         handle_draw_indirect_count(cmd, state, false);
-         break;
-      case VK_CMD_DRAW_INDEXED_INDIRECT_COUNT:
-         emit_state(state);
-         handle_draw_indirect_count(cmd, state, true);
-         break;
-      case VK_CMD_PUSH_DESCRIPTOR_SET2_KHR:
-         handle_push_descriptor_set(cmd, state);
-         break;
-      case VK_CMD_PUSH_DESCRIPTOR_SET_WITH_TEMPLATE2_KHR:
-         handle_push_descriptor_set_with_template(cmd, state);
-         break;
-      case VK_CMD_BIND_TRANSFORM_FEEDBACK_BUFFERS_EXT:
-         handle_bind_transform_feedback_buffers(cmd, state);
-         break;
-      case VK_CMD_BEGIN_TRANSFORM_FEEDBACK_EXT:
-         handle_begin_transform_feedback(cmd, state);
-         break;
-      case VK_CMD_END_TRANSFORM_FEEDBACK_EXT:
-         handle_end_transform_feedback(cmd, state);
-         break;
-      case VK_CMD_DRAW_INDIRECT_BYTE_COUNT_EXT:
-         emit_state(state);
-         handle_draw_indirect_byte_count(cmd, state);
-         break;
-      case VK_CMD_BEGIN_CONDITIONAL_RENDERING_EXT:
-         handle_begin_conditional_rendering(cmd, state);
-         break;
-      case VK_CMD_END_CONDITIONAL_RENDERING_EXT:
-         handle_end_conditional_rendering(state);
-         break;
-      case VK_CMD_SET_VERTEX_INPUT_EXT:
-         handle_set_vertex_input(cmd, state);
-         break;
-      case VK_CMD_SET_CULL_MODE:
-         handle_set_cull_mode(cmd, state);
-         break;
-      case VK_CMD_SET_FRONT_FACE:
-         handle_set_front_face(cmd, state);
-         break;
-      case VK_CMD_SET_PRIMITIVE_TOPOLOGY:
-         handle_set_primitive_topology(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_TEST_ENABLE:
-         handle_set_depth_test_enable(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_WRITE_ENABLE:
-         handle_set_depth_write_enable(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_COMPARE_OP:
-         handle_set_depth_compare_op(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_BOUNDS_TEST_ENABLE:
-         handle_set_depth_bounds_test_enable(cmd, state);
-         break;
-      case VK_CMD_SET_STENCIL_TEST_ENABLE:
-         handle_set_stencil_test_enable(cmd, state);
-         break;
-      case VK_CMD_SET_STENCIL_OP:
-         handle_set_stencil_op(cmd, state);
-         break;
-      case VK_CMD_SET_LINE_STIPPLE_KHR:
-         handle_set_line_stipple(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_BIAS_ENABLE:
-         handle_set_depth_bias_enable(cmd, state);
-         break;
-      case VK_CMD_SET_LOGIC_OP_EXT:
-         handle_set_logic_op(cmd, state);
-         break;
-      case VK_CMD_SET_PATCH_CONTROL_POINTS_EXT:
-         handle_set_patch_control_points(cmd, state);
-         break;
-      case VK_CMD_SET_PRIMITIVE_RESTART_ENABLE:
-         handle_set_primitive_restart_enable(cmd, state);
-         break;
-      case VK_CMD_SET_RASTERIZER_DISCARD_ENABLE:
-         handle_set_rasterizer_discard_enable(cmd, state);
-         break;
-      case VK_CMD_SET_COLOR_WRITE_ENABLE_EXT:
-         handle_set_color_write_enable(cmd, state);
-         break;
-      case VK_CMD_BEGIN_RENDERING:
-         handle_begin_rendering(cmd, state);
-         break;
-      case VK_CMD_END_RENDERING:
-         handle_end_rendering(cmd, state);
-         break;
-      case VK_CMD_SET_DEVICE_MASK:
-         /* no-op */
-         break;
-      case VK_CMD_RESET_EVENT2:
-         handle_event_reset2(cmd, state);
-         break;
-      case VK_CMD_SET_EVENT2:
-         handle_event_set2(cmd, state);
-         break;
-      case VK_CMD_WAIT_EVENTS2:
-         handle_wait_events2(cmd, state);
-         break;
-      case VK_CMD_WRITE_TIMESTAMP2:
-         handle_write_timestamp2(cmd, state);
-         break;
-      case VK_CMD_SET_POLYGON_MODE_EXT:
-         handle_set_polygon_mode(cmd, state);
-         break;
-      case VK_CMD_SET_TESSELLATION_DOMAIN_ORIGIN_EXT:
-         handle_set_tessellation_domain_origin(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_CLAMP_ENABLE_EXT:
-         handle_set_depth_clamp_enable(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_CLIP_ENABLE_EXT:
-         handle_set_depth_clip_enable(cmd, state);
-         break;
-      case VK_CMD_SET_LOGIC_OP_ENABLE_EXT:
-         handle_set_logic_op_enable(cmd, state);
-         break;
-      case VK_CMD_SET_SAMPLE_MASK_EXT:
-         handle_set_sample_mask(cmd, state);
-         break;
-      case VK_CMD_SET_RASTERIZATION_SAMPLES_EXT:
-         handle_set_samples(cmd, state);
-         break;
-      case VK_CMD_SET_ALPHA_TO_COVERAGE_ENABLE_EXT:
-         handle_set_alpha_to_coverage(cmd, state);
-         break;
-      case VK_CMD_SET_ALPHA_TO_ONE_ENABLE_EXT:
-         handle_set_alpha_to_one(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_CLIP_NEGATIVE_ONE_TO_ONE_EXT:
-         handle_set_halfz(cmd, state);
-         break;
-      case VK_CMD_SET_LINE_RASTERIZATION_MODE_EXT:
-         handle_set_line_rasterization_mode(cmd, state);
-         break;
-      case VK_CMD_SET_LINE_STIPPLE_ENABLE_EXT:
-         handle_set_line_stipple_enable(cmd, state);
-         break;
-      case VK_CMD_SET_PROVOKING_VERTEX_MODE_EXT:
-         handle_set_provoking_vertex_mode(cmd, state);
-         break;
-      case VK_CMD_SET_COLOR_BLEND_ENABLE_EXT:
-         handle_set_color_blend_enable(cmd, state);
-         break;
-      case VK_CMD_SET_COLOR_WRITE_MASK_EXT:
-         handle_set_color_write_mask(cmd, state);
-         break;
-      case VK_CMD_SET_COLOR_BLEND_EQUATION_EXT:
-         handle_set_color_blend_equation(cmd, state);
-         break;
-      case VK_CMD_BIND_SHADERS_EXT:
-         handle_shaders(cmd, state);
-         break;
-      case VK_CMD_SET_ATTACHMENT_FEEDBACK_LOOP_ENABLE_EXT:
-         break;
-      case VK_CMD_DRAW_MESH_TASKS_EXT:
-         emit_state(state);
-         handle_draw_mesh_tasks(cmd, state);
-         break;
-      case VK_CMD_DRAW_MESH_TASKS_INDIRECT_EXT:
-         emit_state(state);
-         handle_draw_mesh_tasks_indirect(cmd, state);
-         break;
-      case VK_CMD_DRAW_MESH_TASKS_INDIRECT_COUNT_EXT:
-         emit_state(state);
-         handle_draw_mesh_tasks_indirect_count(cmd, state);
-         break;
-      case VK_CMD_BIND_PIPELINE_SHADER_GROUP_NV:
-         handle_graphics_pipeline_group(cmd, state);
-         break;
-      case VK_CMD_PREPROCESS_GENERATED_COMMANDS_NV:
-         handle_preprocess_generated_commands(cmd, state, print_cmds);
-         break;
-      case VK_CMD_EXECUTE_GENERATED_COMMANDS_NV:
-         handle_execute_generated_commands(cmd, state, print_cmds);
-         break;
-      case VK_CMD_BIND_DESCRIPTOR_BUFFERS_EXT:
-         handle_descriptor_buffers(cmd, state);
-         break;
-      case VK_CMD_SET_DESCRIPTOR_BUFFER_OFFSETS2_EXT:
-         handle_descriptor_buffer_offsets(cmd, state);
-         break;
-      case VK_CMD_BIND_DESCRIPTOR_BUFFER_EMBEDDED_SAMPLERS2_EXT:
-         handle_descriptor_buffer_embedded_samplers(cmd, state);
+      } else {
+         did_flush = false;
+      }
+      lvp_execute_cmd(cmd, state, print_cmds);
+      if (!cmd->cmd_link.next)
          break;
+   }
+}
+
+static void lvp_execute_lvp_cmd_buffer(struct lvp_cmd_buffer *cmd_buffer,
+                                       struct rendering_state *state, bool print_cmds)
+{
+   if (!cmd_buffer->filtered_cmds) {
+      lvp_execute_cmd_buffer(&cmd_buffer->vk.cmd_queue.cmds, state, print_cmds);
+      return;
+   }
+
+   for (uint32_t i = 0; i < cmd_buffer->filtered_cmd_count; i++)
+      lvp_execute_cmd(cmd_buffer->filtered_cmds[i], state, print_cmds);
+}
+
+/* Commands that do nothing when replayed. */
+static bool
+lvp_cmd_is_nop(enum vk_cmd_type type)
+{
+   switch (type) {
+   case VK_CMD_SET_DEVICE_MASK:
+   case VK_CMD_SET_ATTACHMENT_FEEDBACK_LOOP_ENABLE_EXT:
+   case VK_CMD_BUILD_ACCELERATION_STRUCTURES_INDIRECT_KHR:
+   case VK_CMD_SET_RAY_TRACING_PIPELINE_STACK_SIZE_KHR:
 #ifdef VK_ENABLE_BETA_EXTENSIONS
-      case VK_CMD_INITIALIZE_GRAPH_SCRATCH_MEMORY_AMDX:
-         break;
-      case VK_CMD_DISPATCH_GRAPH_INDIRECT_COUNT_AMDX:
-         break;
-      case VK_CMD_DISPATCH_GRAPH_INDIRECT_AMDX:
-         break;
-      case VK_CMD_DISPATCH_GRAPH_AMDX:
-         handle_dispatch_graph(cmd, state);
-         break;
+   case VK_CMD_INITIALIZE_GRAPH_SCRATCH_MEMORY_AMDX:
+   case VK_CMD_DISPATCH_GRAPH_INDIRECT_COUNT_AMDX:
+   case VK_CMD_DISPATCH_GRAPH_INDIRECT_AMDX:
 #endif
-      case VK_CMD_SET_RENDERING_ATTACHMENT_LOCATIONS_KHR:
-         handle_rendering_attachment_locations(cmd, state);
-         break;
-      case VK_CMD_SET_RENDERING_INPUT_ATTACHMENT_INDICES_KHR:
-         handle_rendering_input_attachment_indices(cmd, state);
-         break;
-      case VK_CMD_COPY_ACCELERATION_STRUCTURE_KHR:
-         handle_copy_acceleration_structure(cmd, state);
-         break;
-      case VK_CMD_COPY_MEMORY_TO_ACCELERATION_STRUCTURE_KHR:
-         handle_copy_memory_to_acceleration_structure(cmd, state);
-         break;
-      case VK_CMD_COPY_ACCELERATION_STRUCTURE_TO_MEMORY_KHR:
-         handle_copy_acceleration_structure_to_memory(cmd, state);
-         break;
-      case VK_CMD_BUILD_ACCELERATION_STRUCTURES_KHR:
-         handle_build_acceleration_structures(cmd, state);
-         break;
-      case VK_CMD_BUILD_ACCELERATION_STRUCTURES_INDIRECT_KHR:
-         break;
-      case VK_CMD_WRITE_ACCELERATION_STRUCTURES_PROPERTIES_KHR:
-         handle_write_acceleration_structures_properties(cmd, state);
-         break;
-      case VK_CMD_SET_RAY_TRACING_PIPELINE_STACK_SIZE_KHR:
-         break;
-      case VK_CMD_TRACE_RAYS_INDIRECT2_KHR:
-         handle_trace_rays_indirect2(cmd, state);
-         break;
-      case VK_CMD_TRACE_RAYS_INDIRECT_KHR:
-         handle_trace_rays_indirect(cmd, state);
-         break;
-      case VK_CMD_TRACE_RAYS_KHR:
-         handle_trace_rays(cmd, state);
-         break;
-      default:
-         fprintf(stderr, "Unsupported command %s\n", vk_cmd_queue_type_names[cmd->type]);
-         unreachable("Unsupported command");
-         break;
+      return true;
+   default:
+      return false;
+   }
+}
+
+/* Dynamic state commands whose handler only stores values taken from the
+ * command itself, so a later command of the same type fully replaces the
+ * state they set.
+ */
+static bool
+lvp_cmd_overwrites_state(enum vk_cmd_type type)
+{
+   switch (type) {
+   case VK_CMD_SET_LINE_WIDTH:
+   case VK_CMD_SET_DEPTH_BIAS:
+   case VK_CMD_SET_BLEND_CONSTANTS:
+   case VK_CMD_SET_DEPTH_BOUNDS:
+   case VK_CMD_SET_CULL_MODE:
+   case VK_CMD_SET_FRONT_FACE:
+   case VK_CMD_SET_PRIMITIVE_TOPOLOGY:
+   case VK_CMD_SET_DEPTH_TEST_ENABLE:
+   case VK_CMD_SET_DEPTH_WRITE_ENABLE:
+   case VK_CMD_SET_DEPTH_COMPARE_OP:
+   case VK_CMD_SET_DEPTH_BOUNDS_TEST_ENABLE:
+   case VK_CMD_SET_STENCIL_TEST_ENABLE:
+   case VK_CMD_SET_LINE_STIPPLE_KHR:
+   case VK_CMD_SET_DEPTH_BIAS_ENABLE:
+   case VK_CMD_SET_LOGIC_OP_EXT:
+   case VK_CMD_SET_PATCH_CONTROL_POINTS_EXT:
+   case VK_CMD_SET_PRIMITIVE_RESTART_ENABLE:
+   case VK_CMD_SET_RASTERIZER_DISCARD_ENABLE:
+   case VK_CMD_SET_POLYGON_MODE_EXT:
+   case VK_CMD_SET_DEPTH_CLIP_ENABLE_EXT:
+   case VK_CMD_SET_LOGIC_OP_ENABLE_EXT:
+   case VK_CMD_SET_ALPHA_TO_COVERAGE_ENABLE_EXT:
+   case VK_CMD_SET_LINE_RASTERIZATION_MODE_EXT:
+   case VK_CMD_SET_LINE_STIPPLE_ENABLE_EXT:
+   case VK_CMD_SET_PROVOKING_VERTEX_MODE_EXT:
+      return true;
+   default:
+      return false;
+   }
+}
+
+#define LVP_MAX_STATE_RUN 32
+
+/* Collects the recorded commands that are worth executing into a flat
+ * array once, so that command buffers which get submitted repeatedly don't
+ * pay for walking the list, no-op commands, state that is overwritten
+ * before it is used, or back-to-back barriers on every submission.  The
+ * remaining commands are not translated: gallium state, CSOs, push
+ * constants and descriptors are still derived from them at each submit.
+ */
+void
+lvp_filter_cmd_buffer(struct lvp_cmd_buffer *cmd_buffer)
+{
+   struct vk_cmd_queue *queue = &cmd_buffer->vk.cmd_queue;
+   unsigned count = list_length(&queue->cmds);
+
+   struct vk_cmd_queue_entry **cmds =
+      vk_cmd_queue_zalloc(queue, count * sizeof(*cmds));
+   if (!cmds)
+      return;
+
+   /* Overwriting state commands seen since the last command that may
+    * consume state, with their position in cmds.
+    */
+   struct {
+      enum vk_cmd_type type;
+      uint32_t index;
+   } run[LVP_MAX_STATE_RUN];
+   unsigned run_length = 0;
+   uint32_t length = 0;
+
+   list_for_each_entry(struct vk_cmd_queue_entry, cmd, &queue->cmds, cmd_link) {
+      if (lvp_cmd_is_nop(cmd->type))
+         continue;
+
+      if (lvp_cmd_overwrites_state(cmd->type)) {
+         unsigned i;
+         for (i = 0; i < run_length; i++) {
+            if (run[i].type == cmd->type)
+               break;
+         }
+
+         if (i < run_length) {
+            cmds[run[i].index] = NULL;
+            run[i].index = length;
+         } else if (run_length < ARRAY_SIZE(run)) {
+            run[run_length].type = cmd->type;
+            run[run_length].index = length;
+            run_length++;
+         }
+      } else {
+         run_length = 0;
       }
-      did_flush = false;
-      if (!cmd->cmd_link.next)
-         break;
+
+      cmds[length++] = cmd;
+   }
+
+   /* Drop the dead commands, and barriers that only follow other barriers:
+    * flushes are actually stalls, so multiple flushes are redundant.
+    */
+   uint32_t compacted = 0;
+   for (uint32_t i = 0; i < length; i++) {
+      if (!cmds[i])
+         continue;
+
+      if (cmds[i]->type == VK_CMD_PIPELINE_BARRIER2 && compacted &&
+          cmds[compacted - 1]->type == VK_CMD_PIPELINE_BARRIER2)
+         continue;
+
+      cmds[compacted++] = cmds[i];
    }
+
+   cmd_buffer->filtered_cmds = cmds;
+   cmd_buffer->filtered_cmd_count = compacted;
 }
 
 VkResult lvp_execute_cmds(struct lvp_device *device,
@@ -5241,7 +5353,7 @@ VkResult lvp_execute_cmds(struct lvp_device *device,
    state->index_buffer = state->device->zero_buffer;
 
    /* create a gallium context */
-   lvp_execute_cmd_buffer(&cmd_buffer->vk.cmd_queue.cmds, state, device->print_cmds);
+   lvp_execute_lvp_cmd_buffer(cmd_buffer, state, device->print_cmds);
 
    state->start_vb = -1;
    state->num_vb = 0;
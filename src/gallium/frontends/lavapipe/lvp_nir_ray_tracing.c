@@ -57,86 +57,111 @@ lvp_load_vertex_position(nir_builder *b, nir_def *instance_addr, nir_def *primit
    return nir_build_load_global(b, 3, 32, nir_iadd(b, bvh_addr, nir_u2u64(b, offset)));
 }
 
+/* Loads count consecutive 32-bit words. */
+static nir_def *
+lvp_load_box_words(nir_builder *b, nir_def *node_addr, uint32_t offset, unsigned count)
+{
+   nir_def *words[LVP_BVH_WIDTH];
+   for (unsigned i = 0; i < count; i += 4) {
+      nir_def *chunk =
+         nir_build_load_global(b, MIN2(count - i, 4), 32, nir_iadd_imm(b, node_addr, offset + i * 4));
+      for (unsigned c = 0; c < chunk->num_components; c++)
+         words[i + c] = nir_channel(b, chunk, c);
+   }
+   return nir_vec(b, words, count);
+}
+
+/* Dequantizes one plane of all children of a box node, see lvp_bvh_box_node. */
+static nir_def *
+lvp_load_box_planes(nir_builder *b, nir_def *node_addr, uint32_t offset, nir_def *origin,
+                    nir_def *scale)
+{
+   nir_def *packed = lvp_load_box_words(b, node_addr, offset, LVP_BVH_WIDTH / 4);
+
+   nir_def *q[LVP_BVH_WIDTH];
+   for (unsigned i = 0; i < LVP_BVH_WIDTH; i++) {
+      nir_def *word = nir_channel(b, packed, i / 4);
+      q[i] = nir_iand_imm(b, nir_ushr_imm(b, word, (i % 4) * 8), 0xff);
+   }
+
+   return nir_fadd(b, nir_fmul(b, nir_u2f32(b, nir_vec(b, q, LVP_BVH_WIDTH)),
+                               nir_replicate(b, scale, LVP_BVH_WIDTH)),
+                   nir_replicate(b, origin, LVP_BVH_WIDTH));
+}
+
+/* Tests the ray against all children of a box node at once. Returns the
+ * children sorted by increasing distance, with LVP_BVH_INVALID_NODE for
+ * the ones that were missed at the end.
+ */
 static nir_def *
 lvp_build_intersect_ray_box(nir_builder *b, nir_def *node_addr, nir_def *ray_tmax,
                             nir_def *origin, nir_def *dir, nir_def *inv_dir)
 {
-   const struct glsl_type *vec2_type = glsl_vector_type(GLSL_TYPE_FLOAT, 2);
-   const struct glsl_type *uvec2_type = glsl_vector_type(GLSL_TYPE_UINT, 2);
+   inv_dir = nir_bcsel(b, nir_feq_imm(b, dir, 0), nir_imm_float(b, FLT_MAX), inv_dir);
 
-   nir_variable *distances =
-      nir_variable_create(b->shader, nir_var_shader_temp, vec2_type, "distances");
-   nir_store_var(b, distances, nir_imm_vec2(b, INFINITY, INFINITY), 0xf);
+   nir_def *box_origin =
+      nir_build_load_global(b, 3, 32, nir_iadd_imm(b, node_addr, offsetof(struct lvp_bvh_box_node, origin)));
+   nir_def *box_scale =
+      nir_build_load_global(b, 3, 32, nir_iadd_imm(b, node_addr, offsetof(struct lvp_bvh_box_node, scale)));
 
-   nir_variable *child_indices =
-      nir_variable_create(b->shader, nir_var_shader_temp, uvec2_type, "child_indices");
-   nir_store_var(b, child_indices, nir_imm_ivec2(b, 0xffffffffu, 0xffffffffu), 0xf);
+   nir_def *tmin = nir_imm_zero(b, LVP_BVH_WIDTH, 32);
+   nir_def *tmax = nir_replicate(b, ray_tmax, LVP_BVH_WIDTH);
 
-   inv_dir = nir_bcsel(b, nir_feq_imm(b, dir, 0), nir_imm_float(b, FLT_MAX), inv_dir);
+   for (unsigned axis = 0; axis < 3; axis++) {
+      nir_def *axis_origin = nir_channel(b, box_origin, axis);
+      nir_def *axis_scale = nir_channel(b, box_scale, axis);
 
-   for (int i = 0; i < 2; i++) {
-      const uint32_t child_offset = offsetof(struct lvp_bvh_box_node, children[i]);
-      const uint32_t coord_offsets[2] = {
-         offsetof(struct lvp_bvh_box_node, bounds[i].min.x),
-         offsetof(struct lvp_bvh_box_node, bounds[i].max.x),
+      nir_def *planes[2] = {
+         lvp_load_box_planes(b, node_addr, offsetof(struct lvp_bvh_box_node, min[axis]),
+                             axis_origin, axis_scale),
+         lvp_load_box_planes(b, node_addr, offsetof(struct lvp_bvh_box_node, max[axis]),
+                             axis_origin, axis_scale),
       };
 
-      nir_def *child_index =
-         nir_build_load_global(b, 1, 32, nir_iadd_imm(b, node_addr, child_offset));
+      nir_def *ray_origin = nir_replicate(b, nir_channel(b, origin, axis), LVP_BVH_WIDTH);
+      nir_def *ray_inv_dir = nir_replicate(b, nir_channel(b, inv_dir, axis), LVP_BVH_WIDTH);
 
-      nir_def *node_coords[2] = {
-         nir_build_load_global(b, 3, 32, nir_iadd_imm(b, node_addr, coord_offsets[0])),
-         nir_build_load_global(b, 3, 32, nir_iadd_imm(b, node_addr, coord_offsets[1])),
-      };
+      nir_def *t0 = nir_fmul(b, nir_fsub(b, planes[0], ray_origin), ray_inv_dir);
+      nir_def *t1 = nir_fmul(b, nir_fsub(b, planes[1], ray_origin), ray_inv_dir);
 
-      /* If x of the aabb min is NaN, then this is an inactive aabb.
-       * We don't need to care about any other components being NaN as that is UB.
-       * https://www.khronos.org/registry/vulkan/specs/1.2-extensions/html/chap36.html#VkAabbPositionsKHR
-       */
-      nir_def *min_x = nir_channel(b, node_coords[0], 0);
-      nir_def *min_x_is_not_nan =
-         nir_inot(b, nir_fneu(b, min_x, min_x)); /* NaN != NaN -> true */
-
-      nir_def *bound0 = nir_fmul(b, nir_fsub(b, node_coords[0], origin), inv_dir);
-      nir_def *bound1 = nir_fmul(b, nir_fsub(b, node_coords[1], origin), inv_dir);
-
-      nir_def *tmin =
-         nir_fmax(b,
-                  nir_fmax(b, nir_fmin(b, nir_channel(b, bound0, 0), nir_channel(b, bound1, 0)),
-                           nir_fmin(b, nir_channel(b, bound0, 1), nir_channel(b, bound1, 1))),
-                  nir_fmin(b, nir_channel(b, bound0, 2), nir_channel(b, bound1, 2)));
-
-      nir_def *tmax =
-         nir_fmin(b,
-                  nir_fmin(b, nir_fmax(b, nir_channel(b, bound0, 0), nir_channel(b, bound1, 0)),
-                           nir_fmax(b, nir_channel(b, bound0, 1), nir_channel(b, bound1, 1))),
-                  nir_fmax(b, nir_channel(b, bound0, 2), nir_channel(b, bound1, 2)));
-
-      nir_push_if(b,
-                  nir_iand(b, min_x_is_not_nan,
-                           nir_iand(b, nir_fge(b, tmax, nir_fmax(b, nir_imm_float(b, 0.0f), tmin)),
-                                    nir_flt(b, tmin, ray_tmax))));
-      {
-         nir_def *new_child_indices[2] = {child_index, child_index};
-         nir_store_var(b, child_indices, nir_vec(b, new_child_indices, 2), 1u << i);
+      tmin = nir_fmax(b, tmin, nir_fmin(b, t0, t1));
+      tmax = nir_fmin(b, tmax, nir_fmax(b, t0, t1));
+   }
 
-         nir_def *new_distances[2] = {tmin, tmin};
-         nir_store_var(b, distances, nir_vec(b, new_distances, 2), 1u << i);
-      }
-      nir_pop_if(b, NULL);
+   nir_def *children =
+      lvp_load_box_words(b, node_addr, offsetof(struct lvp_bvh_box_node, children), LVP_BVH_WIDTH);
+
+   /* The ray starts at t = 0, so tmin is clamped to 0 above. A hit must
+    * also start before ray_tmax, which the tmax clamp covers.
+    */
+   nir_def *hit = nir_iand(b, nir_fge(b, tmax, tmin),
+                           nir_ine_imm(b, children, LVP_BVH_INVALID_NODE));
+
+   nir_def *distances[LVP_BVH_WIDTH];
+   nir_def *indices[LVP_BVH_WIDTH];
+   for (unsigned i = 0; i < LVP_BVH_WIDTH; i++) {
+      nir_def *child_hit = nir_channel(b, hit, i);
+      distances[i] = nir_bcsel(b, child_hit, nir_channel(b, tmin, i), nir_imm_float(b, INFINITY));
+      indices[i] = nir_bcsel(b, child_hit, nir_channel(b, children, i),
+                             nir_imm_int(b, LVP_BVH_INVALID_NODE));
    }
 
-   nir_def *ssa_distances = nir_load_var(b, distances);
-   nir_def *ssa_indices = nir_load_var(b, child_indices);
-   nir_push_if(b, nir_flt(b, nir_channel(b, ssa_distances, 1), nir_channel(b, ssa_distances, 0)));
-   {
-      nir_store_var(b, child_indices,
-                    nir_vec2(b, nir_channel(b, ssa_indices, 0), nir_channel(b, ssa_indices, 1)),
-                    0b11);
+   /* Sort without branches so that all invocations stay in lock step. */
+   for (unsigned pass = 0; pass < LVP_BVH_WIDTH - 1; pass++) {
+      for (unsigned i = 0; i < LVP_BVH_WIDTH - 1 - pass; i++) {
+         nir_def *swap = nir_flt(b, distances[i + 1], distances[i]);
+
+         nir_def *distance = distances[i];
+         distances[i] = nir_bcsel(b, swap, distances[i + 1], distance);
+         distances[i + 1] = nir_bcsel(b, swap, distance, distances[i + 1]);
+
+         nir_def *index = indices[i];
+         indices[i] = nir_bcsel(b, swap, indices[i + 1], index);
+         indices[i + 1] = nir_bcsel(b, swap, index, indices[i + 1]);
+      }
    }
-   nir_pop_if(b, NULL);
 
-   return nir_load_var(b, child_indices);
+   return nir_vec(b, indices, LVP_BVH_WIDTH);
 }
 
 static nir_def *
@@ -497,11 +522,14 @@ lvp_build_ray_traversal(nir_builder *b, const struct lvp_ray_traversal_args *arg
 
             nir_store_deref(b, args->vars.current_node, nir_channel(b, result, 0), 0x1);
 
-            nir_push_if(b, nir_ine_imm(b, nir_channel(b, result, 1), LVP_BVH_INVALID_NODE));
-            {
-               lvp_build_push_stack(b, args, nir_channel(b, result, 1));
+            /* Push the farthest child first so that the nearest one is popped next. */
+            for (unsigned i = LVP_BVH_WIDTH - 1; i > 0; i--) {
+               nir_push_if(b, nir_ine_imm(b, nir_channel(b, result, i), LVP_BVH_INVALID_NODE));
+               {
+                  lvp_build_push_stack(b, args, nir_channel(b, result, i));
+               }
+               nir_pop_if(b, NULL);
             }
-            nir_pop_if(b, NULL);
          }
          nir_pop_if(b, NULL);
       }
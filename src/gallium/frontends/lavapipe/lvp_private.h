@@ -647,6 +647,16 @@ struct lvp_cmd_buffer {
    struct lvp_device *                          device;
 
    uint8_t push_constants[MAX_PUSH_CONSTANTS_SIZE];
+
+   bool one_time_submit;
+
+   /* Pointers to the recorded commands minus dead state and no-op commands,
+    * built at vkEndCommandBuffer for command buffers that may be submitted
+    * more than once.  The commands themselves are still executed one by one
+    * at every submission.  Lives in the vk_cmd_queue arena.
+    */
+   struct vk_cmd_queue_entry **filtered_cmds;
+   uint32_t filtered_cmd_count;
 };
 
 struct lvp_indirect_command_layout_nv {
@@ -724,6 +734,7 @@ void lvp_add_enqueue_cmd_entrypoints(struct vk_device_dispatch_table *disp);
 VkResult lvp_execute_cmds(struct lvp_device *device,
                           struct lvp_queue *queue,
                           struct lvp_cmd_buffer *cmd_buffer);
+void lvp_filter_cmd_buffer(struct lvp_cmd_buffer *cmd_buffer);
 size_t
 lvp_get_rendering_state_size(void);
 struct lvp_image *lvp_swapchain_get_image(VkSwapchainKHR swapchain,
@@ -42,6 +42,9 @@
 #include "texcompress_s3tc.h"
 #include "texcompress_etc.h"
 #include "texcompress_bptc.h"
+#include "util/u_call_once.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_queue.h"
 
 
 /**
@@ -929,3 +932,120 @@ _mesa_decompress_image(mesa_format format, GLuint width, GLuint height,
       }
    }
 }
+
+
+/* Images with fewer blocks than this are decoded on the calling thread;
+ * below it, waking the workers costs more than it saves.
+ */
+#define UNPACK_PARALLEL_MIN_BLOCKS 4096
+#define UNPACK_MAX_JOBS 32
+
+struct unpack_band_job {
+   struct util_queue_fence fence;
+   compressed_unpack_band_func func;
+   const void *data;
+   uint8_t *dst_row;
+   unsigned dst_stride;
+   const uint8_t *src_row;
+   unsigned src_stride;
+   unsigned width, height;
+};
+
+static struct util_queue unpack_queue;
+static bool unpack_queue_initialized;
+
+static void
+unpack_queue_init(void)
+{
+   /* The calling thread decodes a share of the image itself. */
+   unsigned num_threads =
+      MIN2(util_get_cpu_caps()->nr_cpus, UNPACK_MAX_JOBS) - 1;
+
+   if (num_threads > 0) {
+      unpack_queue_initialized =
+         util_queue_init(&unpack_queue, "texunpack", UNPACK_MAX_JOBS,
+                         num_threads, UTIL_QUEUE_INIT_RESIZE_IF_FULL, NULL);
+   }
+}
+
+static void
+unpack_band_job_execute(void *data, void *gdata, int thread_index)
+{
+   struct unpack_band_job *job = (struct unpack_band_job *)data;
+
+   job->func(job->dst_row, job->dst_stride, job->src_row, job->src_stride,
+             job->width, job->height, job->data);
+}
+
+/**
+ * Decode a compressed image with \p func, splitting large images into
+ * bands of block rows that are decoded in parallel on a process-wide
+ * thread pool.  \p func must be safe to call concurrently on disjoint
+ * bands.
+ *
+ * \param src_stride  stride in bytes between rows of blocks
+ * \param dst_stride  stride in bytes between rows of pixels
+ * \param width, height  image size in pixels
+ */
+void
+_mesa_unpack_compressed_banded(uint8_t *dst_row, unsigned dst_stride,
+                               const uint8_t *src_row, unsigned src_stride,
+                               unsigned width, unsigned height,
+                               unsigned blk_w, unsigned blk_h,
+                               compressed_unpack_band_func func,
+                               const void *data)
+{
+   unsigned x_blocks = DIV_ROUND_UP(width, blk_w);
+   unsigned y_blocks = DIV_ROUND_UP(height, blk_h);
+
+   if (x_blocks * y_blocks < UNPACK_PARALLEL_MIN_BLOCKS || y_blocks < 2) {
+      func(dst_row, dst_stride, src_row, src_stride, width, height, data);
+      return;
+   }
+
+   /* util_call_once() orders the initialization before the read below. */
+   static util_once_flag once = UTIL_ONCE_FLAG_INIT;
+   util_call_once(&once, unpack_queue_init);
+
+   if (!unpack_queue_initialized) {
+      func(dst_row, dst_stride, src_row, src_stride, width, height, data);
+      return;
+   }
+
+   unsigned num_jobs = MIN2(unpack_queue.max_threads + 1, y_blocks);
+   unsigned rows_per_job = DIV_ROUND_UP(y_blocks, num_jobs);
+   struct unpack_band_job jobs[UNPACK_MAX_JOBS];
+   unsigned queued = 0;
+
+   /* Job 0 runs on this thread once the others have been queued. */
+   for (unsigned i = 0; i < num_jobs; i++) {
+      struct unpack_band_job *job = &jobs[i];
+      unsigned y_start = i * rows_per_job;
+
+      if (y_start >= y_blocks)
+         break;
+
+      job->func = func;
+      job->data = data;
+      job->dst_row = dst_row + (size_t)y_start * blk_h * dst_stride;
+      job->dst_stride = dst_stride;
+      job->src_row = src_row + (size_t)y_start * src_stride;
+      job->src_stride = src_stride;
+      job->width = width;
+      job->height = MIN2(rows_per_job * blk_h, height - y_start * blk_h);
+
+      if (i > 0) {
+         util_queue_fence_init(&job->fence);
+         util_queue_add_job(&unpack_queue, job, &job->fence,
+                            unpack_band_job_execute, NULL, 0);
+      }
+      queued = i + 1;
+   }
+
+   unpack_band_job_execute(&jobs[0], NULL, 0);
+
+   for (unsigned i = 1; i < queued; i++) {
+      util_queue_fence_wait(&jobs[i].fence);
+      util_queue_fence_destroy(&jobs[i].fence);
+   }
+}
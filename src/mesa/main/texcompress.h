@@ -28,6 +28,10 @@
 #include "formats.h"
 #include "util/glheader.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 struct gl_context;
 
 extern GLenum
@@ -63,4 +67,29 @@ _mesa_decompress_image(mesa_format format, GLuint width, GLuint height,
                        const GLubyte *src, GLint srcRowStride,
                        GLfloat *dest);
 
+
+/**
+ * Decode a band of a compressed image.  dst_row and src_row point at the
+ * first row of the band and height is the band height in pixels.
+ */
+typedef void (*compressed_unpack_band_func)(uint8_t *dst_row,
+                                            unsigned dst_stride,
+                                            const uint8_t *src_row,
+                                            unsigned src_stride,
+                                            unsigned width,
+                                            unsigned height,
+                                            const void *data);
+
+extern void
+_mesa_unpack_compressed_banded(uint8_t *dst_row, unsigned dst_stride,
+                               const uint8_t *src_row, unsigned src_stride,
+                               unsigned width, unsigned height,
+                               unsigned blk_w, unsigned blk_h,
+                               compressed_unpack_band_func func,
+                               const void *data);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* TEXCOMPRESS_H */
@@ -37,6 +37,9 @@
 #include "macros.h"
 #include "util/half_float.h"
 #include <stdio.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include <cstdlib>  // for abort() on windows
 
 static bool VERBOSE_DECODE = false;
@@ -270,89 +273,153 @@ static uint32_t hash52(uint32_t p)
    return p;
 }
 
-static int select_partition(int seed, int x, int y, int z, int partitioncount,
-                            int small_block)
+/*
+ * The partition of a texel is picked from a hash of the block's partition
+ * index.  The hash and the seeds derived from it are the same for all the
+ * texels of a block, so they are computed once per block here, and only
+ * the per texel part is left to select_partition().
+ */
+struct partition_selector
 {
-   if (small_block) {
-      x <<= 1;
-      y <<= 1;
-      z <<= 1;
+   int partitioncount;
+   int small_block;
+   /* x, y and z multipliers and the offset of each of the four partitions. */
+   int sx[4], sy[4], sz[4], off[4];
+
+   partition_selector(int seed, int partitioncount, int small_block)
+      : partitioncount(partitioncount), small_block(small_block)
+   {
+      seed += (partitioncount - 1) * 1024;
+      uint32_t rnum = hash52(seed);
+      uint8_t seed1 = rnum & 0xF;
+      uint8_t seed2 = (rnum >> 4) & 0xF;
+      uint8_t seed3 = (rnum >> 8) & 0xF;
+      uint8_t seed4 = (rnum >> 12) & 0xF;
+      uint8_t seed5 = (rnum >> 16) & 0xF;
+      uint8_t seed6 = (rnum >> 20) & 0xF;
+      uint8_t seed7 = (rnum >> 24) & 0xF;
+      uint8_t seed8 = (rnum >> 28) & 0xF;
+      uint8_t seed9 = (rnum >> 18) & 0xF;
+      uint8_t seed10 = (rnum >> 22) & 0xF;
+      uint8_t seed11 = (rnum >> 26) & 0xF;
+      uint8_t seed12 = ((rnum >> 30) | (rnum << 2)) & 0xF;
+
+      seed1 *= seed1;
+      seed2 *= seed2;
+      seed3 *= seed3;
+      seed4 *= seed4;
+      seed5 *= seed5;
+      seed6 *= seed6;
+      seed7 *= seed7;
+      seed8 *= seed8;
+      seed9 *= seed9;
+      seed10 *= seed10;
+      seed11 *= seed11;
+      seed12 *= seed12;
+
+      int sh1, sh2, sh3;
+      if (seed & 1) {
+         sh1 = (seed & 2 ? 4 : 5);
+         sh2 = (partitioncount == 3 ? 6 : 5);
+      } else {
+         sh1 = (partitioncount == 3 ? 6 : 5);
+         sh2 = (seed & 2 ? 4 : 5);
+      }
+      sh3 = (seed & 0x10) ? sh1 : sh2;
+
+      sx[0] = seed1 >> sh1;
+      sy[0] = seed2 >> sh2;
+      sz[0] = seed11 >> sh3;
+      off[0] = (rnum >> 14) & 0x3F;
+      sx[1] = seed3 >> sh1;
+      sy[1] = seed4 >> sh2;
+      sz[1] = seed12 >> sh3;
+      off[1] = (rnum >> 10) & 0x3F;
+      sx[2] = seed5 >> sh1;
+      sy[2] = seed6 >> sh2;
+      sz[2] = seed9 >> sh3;
+      off[2] = (rnum >> 6) & 0x3F;
+      sx[3] = seed7 >> sh1;
+      sy[3] = seed8 >> sh2;
+      sz[3] = seed10 >> sh3;
+      off[3] = (rnum >> 2) & 0x3F;
    }
-   seed += (partitioncount - 1) * 1024;
-   uint32_t rnum = hash52(seed);
-   uint8_t seed1 = rnum & 0xF;
-   uint8_t seed2 = (rnum >> 4) & 0xF;
-   uint8_t seed3 = (rnum >> 8) & 0xF;
-   uint8_t seed4 = (rnum >> 12) & 0xF;
-   uint8_t seed5 = (rnum >> 16) & 0xF;
-   uint8_t seed6 = (rnum >> 20) & 0xF;
-   uint8_t seed7 = (rnum >> 24) & 0xF;
-   uint8_t seed8 = (rnum >> 28) & 0xF;
-   uint8_t seed9 = (rnum >> 18) & 0xF;
-   uint8_t seed10 = (rnum >> 22) & 0xF;
-   uint8_t seed11 = (rnum >> 26) & 0xF;
-   uint8_t seed12 = ((rnum >> 30) | (rnum << 2)) & 0xF;
-
-   seed1 *= seed1;
-   seed2 *= seed2;
-   seed3 *= seed3;
-   seed4 *= seed4;
-   seed5 *= seed5;
-   seed6 *= seed6;
-   seed7 *= seed7;
-   seed8 *= seed8;
-   seed9 *= seed9;
-   seed10 *= seed10;
-   seed11 *= seed11;
-   seed12 *= seed12;
-
-   int sh1, sh2, sh3;
-   if (seed & 1) {
-      sh1 = (seed & 2 ? 4 : 5);
-      sh2 = (partitioncount == 3 ? 6 : 5);
-   } else {
-      sh1 = (partitioncount == 3 ? 6 : 5);
-      sh2 = (seed & 2 ? 4 : 5);
+
+   int select_partition(int x, int y, int z) const
+   {
+      if (small_block) {
+         x <<= 1;
+         y <<= 1;
+         z <<= 1;
+      }
+
+      int a = (sx[0] * x + sy[0] * y + sz[0] * z + off[0]) & 0x3F;
+      int b = (sx[1] * x + sy[1] * y + sz[1] * z + off[1]) & 0x3F;
+      int c = (sx[2] * x + sy[2] * y + sz[2] * z + off[2]) & 0x3F;
+      int d = (sx[3] * x + sy[3] * y + sz[3] * z + off[3]) & 0x3F;
+
+      if (partitioncount < 4)
+         d = 0;
+      if (partitioncount < 3)
+         c = 0;
+
+      if (a >= b && a >= c && a >= d)
+         return 0;
+      else if (b >= c && b >= d)
+         return 1;
+      else if (c >= d)
+         return 2;
+      else
+         return 3;
    }
-   sh3 = (seed & 0x10) ? sh1 : sh2;
-
-   seed1 >>= sh1;
-   seed2 >>= sh2;
-   seed3 >>= sh1;
-   seed4 >>= sh2;
-   seed5 >>= sh1;
-   seed6 >>= sh2;
-   seed7 >>= sh1;
-   seed8 >>= sh2;
-   seed9 >>= sh3;
-   seed10 >>= sh3;
-   seed11 >>= sh3;
-   seed12 >>= sh3;
-
-   int a = seed1 * x + seed2 * y + seed11 * z + (rnum >> 14);
-   int b = seed3 * x + seed4 * y + seed12 * z + (rnum >> 10);
-   int c = seed5 * x + seed6 * y + seed9 * z + (rnum >> 6);
-   int d = seed7 * x + seed8 * y + seed10 * z + (rnum >> 2);
-
-   a &= 0x3F;
-   b &= 0x3F;
-   c &= 0x3F;
-   d &= 0x3F;
-
-   if (partitioncount < 4)
-      d = 0;
-   if (partitioncount < 3)
-      c = 0;
-
-   if (a >= b && a >= c && a >= d)
-      return 0;
-   else if (b >= c && b >= d)
-      return 1;
-   else if (c >= d)
-      return 2;
-   else
-      return 3;
-}
+
+   /* Select the partitions of the texels (0, y, z) to (width - 1, y, z). */
+   void select_partition_row(int y, int z, int width, uint8_t *out) const
+   {
+      int x = 0;
+#if defined(__SSE2__)
+      /* All the terms fit in 16 bits and only their low 6 bits are used. */
+      const int shift = small_block ? 1 : 0;
+      const __m128i xs = _mm_slli_epi16(_mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7), shift);
+      const __m128i mask = _mm_set1_epi16(0x3F);
+      __m128i v[4];
+      for (int i = 0; i < 4; ++i) {
+         __m128i mul = _mm_set1_epi16(sx[i]);
+         __m128i add = _mm_set1_epi16(((sy[i] * y + sz[i] * z) << shift) + off[i]);
+         v[i] = _mm_add_epi16(_mm_mullo_epi16(mul, xs), add);
+      }
+      const __m128i step[4] = {
+         _mm_set1_epi16(sx[0] << (3 + shift)), _mm_set1_epi16(sx[1] << (3 + shift)),
+         _mm_set1_epi16(sx[2] << (3 + shift)), _mm_set1_epi16(sx[3] << (3 + shift)),
+      };
+      const __m128i zero = _mm_setzero_si128();
+      for (; x + 8 <= width; x += 8) {
+         __m128i a = _mm_and_si128(v[0], mask);
+         __m128i b = _mm_and_si128(v[1], mask);
+         __m128i c = partitioncount < 3 ? zero : _mm_and_si128(v[2], mask);
+         __m128i d = partitioncount < 4 ? zero : _mm_and_si128(v[3], mask);
+
+         /* The same cascade as select_partition(), ge(p, q) is ~(q > p). */
+         __m128i c_ge_d = _mm_cmpgt_epi16(d, c);
+         __m128i b_ge_cd = _mm_or_si128(_mm_cmpgt_epi16(c, b), _mm_cmpgt_epi16(d, b));
+         __m128i a_ge_bcd = _mm_or_si128(_mm_cmpgt_epi16(b, a),
+                                         _mm_or_si128(_mm_cmpgt_epi16(c, a),
+                                                      _mm_cmpgt_epi16(d, a)));
+         /* Each mask is all ones where the comparison fails. */
+         __m128i p = _mm_sub_epi16(_mm_set1_epi16(2), c_ge_d);
+         p = _mm_or_si128(_mm_andnot_si128(b_ge_cd, _mm_set1_epi16(1)),
+                          _mm_and_si128(b_ge_cd, p));
+         p = _mm_and_si128(a_ge_bcd, p);
+         _mm_storel_epi64((__m128i *)&out[x], _mm_packus_epi16(p, p));
+
+         for (int i = 0; i < 4; ++i)
+            v[i] = _mm_add_epi16(v[i], step[i]);
+      }
+#endif
+      for (; x < width; ++x)
+         out[x] = select_partition(x, y, z);
+   }
+};
 
 
 struct InputBitVector
@@ -1624,48 +1691,94 @@ void Block::write_decoded(const Decoder &decoder, uint16_t *output)
    }
 
    int small_block = (decoder.block_w * decoder.block_h * decoder.block_d) < 31;
+   partition_selector selector(partition_index, num_parts, small_block);
+
+   /* TODO: HDR */
+
+   /* Expand the endpoints of each partition to 16 bits. */
+   uint16_t c0[4][4], c1[4][4];
+   for (int p = 0; p < num_parts; ++p) {
+      uint8x4_t e0 = endpoints_decoded[0][p];
+      uint8x4_t e1 = endpoints_decoded[1][p];
+
+      for (int i = 0; i < 4; ++i) {
+         if (decoder.srgb) {
+            c0[p][i] = (uint16_t)((e0.v[i] << 8) | 0x80);
+            c1[p][i] = (uint16_t)((e1.v[i] << 8) | 0x80);
+         } else {
+            c0[p][i] = (uint16_t)((e0.v[i] << 8) | e0.v[i]);
+            c1[p][i] = (uint16_t)((e1.v[i] << 8) | e1.v[i]);
+         }
+      }
+   }
 
    int idx = 0;
    for (int z = 0; z < decoder.block_d; ++z) {
       for (int y = 0; y < decoder.block_h; ++y) {
-         for (int x = 0; x < decoder.block_w; ++x) {
-
-            int partition;
-            if (num_parts > 1) {
-               partition = select_partition(partition_index, x, y, z, num_parts, small_block);
-               assert(partition < num_parts);
-            } else {
-               partition = 0;
+         uint8_t partitions[12];
+         if (num_parts > 1)
+            selector.select_partition_row(y, z, decoder.block_w, partitions);
+         else
+            memset(partitions, 0, sizeof(partitions));
+
+         int x = 0;
+#if defined(__SSE2__)
+         if (decoder.output_unorm8) {
+            /*
+             * Two texels at a time.  The weights are at most 64, so the
+             * products of the 16 bit colours and weights are done with
+             * 16 bit multiplies into 32 bits.  Only the top 8 bits of the
+             * UNORM16 result are kept, hence the shift by 6 + 8.
+             */
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i w64 = _mm_set1_epi16(64);
+            const __m128i round = _mm_set1_epi32(32);
+            __m128i plane1_mask = zero;
+            if (dual_plane) {
+               uint16_t m[8] = { 0 };
+               m[colour_component_selector] = 0xffff;
+               m[colour_component_selector + 4] = 0xffff;
+               plane1_mask = _mm_loadu_si128((const __m128i *)m);
             }
 
-            /* TODO: HDR */
-
-            uint8x4_t e0 = endpoints_decoded[0][partition];
-            uint8x4_t e1 = endpoints_decoded[1][partition];
-            uint16_t c0[4], c1[4];
-
-            /* Expand to 16 bits. */
-            if (decoder.srgb) {
-               c0[0] = (uint16_t)((e0.v[0] << 8) | 0x80);
-               c0[1] = (uint16_t)((e0.v[1] << 8) | 0x80);
-               c0[2] = (uint16_t)((e0.v[2] << 8) | 0x80);
-               c0[3] = (uint16_t)((e0.v[3] << 8) | 0x80);
-
-               c1[0] = (uint16_t)((e1.v[0] << 8) | 0x80);
-               c1[1] = (uint16_t)((e1.v[1] << 8) | 0x80);
-               c1[2] = (uint16_t)((e1.v[2] << 8) | 0x80);
-               c1[3] = (uint16_t)((e1.v[3] << 8) | 0x80);
-            } else {
-               c0[0] = (uint16_t)((e0.v[0] << 8) | e0.v[0]);
-               c0[1] = (uint16_t)((e0.v[1] << 8) | e0.v[1]);
-               c0[2] = (uint16_t)((e0.v[2] << 8) | e0.v[2]);
-               c0[3] = (uint16_t)((e0.v[3] << 8) | e0.v[3]);
-
-               c1[0] = (uint16_t)((e1.v[0] << 8) | e1.v[0]);
-               c1[1] = (uint16_t)((e1.v[1] << 8) | e1.v[1]);
-               c1[2] = (uint16_t)((e1.v[2] << 8) | e1.v[2]);
-               c1[3] = (uint16_t)((e1.v[3] << 8) | e1.v[3]);
+            for (; x + 2 <= decoder.block_w; x += 2, idx += 2) {
+               __m128i e0 = _mm_unpacklo_epi64(
+                  _mm_loadl_epi64((const __m128i *)c0[partitions[x]]),
+                  _mm_loadl_epi64((const __m128i *)c0[partitions[x + 1]]));
+               __m128i e1 = _mm_unpacklo_epi64(
+                  _mm_loadl_epi64((const __m128i *)c1[partitions[x]]),
+                  _mm_loadl_epi64((const __m128i *)c1[partitions[x + 1]]));
+
+               /* Broadcast the weight of each texel to its four channels. */
+               __m128i w = _mm_cvtsi32_si128(infill_weights[0][idx] |
+                                             infill_weights[0][idx + 1] << 16);
+               w = _mm_unpacklo_epi16(w, w);
+               w = _mm_unpacklo_epi32(w, w);
+               if (dual_plane) {
+                  __m128i w1 = _mm_cvtsi32_si128(infill_weights[1][idx] |
+                                                 infill_weights[1][idx + 1] << 16);
+                  w1 = _mm_unpacklo_epi16(w1, w1);
+                  w1 = _mm_unpacklo_epi32(w1, w1);
+                  w = _mm_or_si128(_mm_andnot_si128(plane1_mask, w),
+                                   _mm_and_si128(plane1_mask, w1));
+               }
+               __m128i iw = _mm_sub_epi16(w64, w);
+
+               __m128i lo0 = _mm_mullo_epi16(e0, iw), hi0 = _mm_mulhi_epu16(e0, iw);
+               __m128i lo1 = _mm_mullo_epi16(e1, w), hi1 = _mm_mulhi_epu16(e1, w);
+               __m128i t0 = _mm_add_epi32(_mm_unpacklo_epi16(lo0, hi0),
+                                          _mm_unpacklo_epi16(lo1, hi1));
+               __m128i t1 = _mm_add_epi32(_mm_unpackhi_epi16(lo0, hi0),
+                                          _mm_unpackhi_epi16(lo1, hi1));
+               t0 = _mm_srli_epi32(_mm_add_epi32(t0, round), 14);
+               t1 = _mm_srli_epi32(_mm_add_epi32(t1, round), 14);
+               _mm_storeu_si128((__m128i *)&output[idx*4], _mm_packs_epi32(t0, t1));
             }
+         }
+#endif
+         for (; x < decoder.block_w; ++x, ++idx) {
+            int partition = partitions[x];
+            assert(partition < num_parts);
 
             int w[4];
             if (dual_plane) {
@@ -1678,12 +1791,15 @@ void Block::write_decoded(const Decoder &decoder, uint16_t *output)
                w[0] = w[1] = w[2] = w[3] = w0;
             }
 
+            const uint16_t *e0 = c0[partition];
+            const uint16_t *e1 = c1[partition];
+
             /* Interpolate to produce UNORM16, applying weights. */
             uint16_t c[4] = {
-               (uint16_t)((c0[0] * (64 - w[0]) + c1[0] * w[0] + 32) >> 6),
-               (uint16_t)((c0[1] * (64 - w[1]) + c1[1] * w[1] + 32) >> 6),
-               (uint16_t)((c0[2] * (64 - w[2]) + c1[2] * w[2] + 32) >> 6),
-               (uint16_t)((c0[3] * (64 - w[3]) + c1[3] * w[3] + 32) >> 6),
+               (uint16_t)((e0[0] * (64 - w[0]) + e1[0] * w[0] + 32) >> 6),
+               (uint16_t)((e0[1] * (64 - w[1]) + e1[1] * w[1] + 32) >> 6),
+               (uint16_t)((e0[2] * (64 - w[2]) + e1[2] * w[2] + 32) >> 6),
+               (uint16_t)((e0[3] * (64 - w[3]) + e1[3] * w[3] + 32) >> 6),
             };
 
             if (decoder.output_unorm8) {
@@ -1698,8 +1814,6 @@ void Block::write_decoded(const Decoder &decoder, uint16_t *output)
                output[idx*4+2] = c[2] == 65535 ? FP16_ONE : _mesa_uint16_div_64k_to_half(c[2]);
                output[idx*4+3] = c[3] == 65535 ? FP16_ONE : _mesa_uint16_div_64k_to_half(c[3]);
             }
-
-            idx++;
          }
       }
    }
@@ -1797,33 +1911,21 @@ decode_error::type Block::calculate_colour_endpoints_size()
 }
 
 /**
- * Decode ASTC 2D LDR texture data.
- *
- * \param src_width in pixels
- * \param src_height in pixels
- * \param dst_stride in bytes
+ * Decode a band of an ASTC 2D LDR image.  data points at the Decoder.
  */
-extern "C" void
-_mesa_unpack_astc_2d_ldr(uint8_t *dst_row,
-                         unsigned dst_stride,
-                         const uint8_t *src_row,
-                         unsigned src_stride,
-                         unsigned src_width,
-                         unsigned src_height,
-                         mesa_format format)
+static void
+unpack_astc_2d_ldr_band(uint8_t *dst_row, unsigned dst_stride,
+                        const uint8_t *src_row, unsigned src_stride,
+                        unsigned src_width, unsigned src_height,
+                        const void *data)
 {
-   assert(_mesa_is_format_astc_2d(format));
-   bool srgb = _mesa_is_format_srgb(format);
-
-   unsigned blk_w, blk_h;
-   _mesa_get_format_block_size(format, &blk_w, &blk_h);
-
+   const Decoder &dec = *(const Decoder *)data;
+   const unsigned blk_w = dec.block_w;
+   const unsigned blk_h = dec.block_h;
    const unsigned block_size = 16;
    unsigned x_blocks = (src_width + blk_w - 1) / blk_w;
    unsigned y_blocks = (src_height + blk_h - 1) / blk_h;
 
-   Decoder dec(blk_w, blk_h, 1, srgb, true);
-
    for (unsigned y = 0; y < y_blocks; ++y) {
       for (unsigned x = 0; x < x_blocks; ++x) {
          /* Same size as the largest block. */
@@ -1852,3 +1954,35 @@ _mesa_unpack_astc_2d_ldr(uint8_t *dst_row,
       dst_row += dst_stride * blk_h;
    }
 }
+
+/**
+ * Decode ASTC 2D LDR texture data.
+ *
+ * Large images are split into bands of block rows which are decoded in
+ * parallel, see _mesa_unpack_compressed_banded().
+ *
+ * \param src_width in pixels
+ * \param src_height in pixels
+ * \param dst_stride in bytes
+ */
+extern "C" void
+_mesa_unpack_astc_2d_ldr(uint8_t *dst_row,
+                         unsigned dst_stride,
+                         const uint8_t *src_row,
+                         unsigned src_stride,
+                         unsigned src_width,
+                         unsigned src_height,
+                         mesa_format format)
+{
+   assert(_mesa_is_format_astc_2d(format));
+   bool srgb = _mesa_is_format_srgb(format);
+
+   unsigned blk_w, blk_h;
+   _mesa_get_format_block_size(format, &blk_w, &blk_h);
+
+   Decoder dec(blk_w, blk_h, 1, srgb, true);
+
+   _mesa_unpack_compressed_banded(dst_row, dst_stride, src_row, src_stride,
+                                  src_width, src_height, blk_w, blk_h,
+                                  unpack_astc_2d_ldr_band, &dec);
+}
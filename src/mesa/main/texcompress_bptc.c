@@ -242,15 +242,17 @@ _mesa_texstore_bptc_rgb_unsigned_float(TEXSTORE_PARAMS)
                                   false /* unsigned */);
 }
 
-void
-_mesa_unpack_bptc(uint8_t *dst_row,
-                  unsigned dst_stride,
-                  const uint8_t *src_row,
-                  unsigned src_stride,
-                  unsigned src_width,
-                  unsigned src_height,
-                  mesa_format format)
+static void
+bptc_unpack_band(uint8_t *dst_row,
+                 unsigned dst_stride,
+                 const uint8_t *src_row,
+                 unsigned src_stride,
+                 unsigned src_width,
+                 unsigned src_height,
+                 const void *data)
 {
+   const mesa_format format = *(const mesa_format *)data;
+
    switch (format) {
    case MESA_FORMAT_BPTC_RGB_SIGNED_FLOAT:
       decompress_rgb_fp16(src_width, src_height,
@@ -273,3 +275,21 @@ _mesa_unpack_bptc(uint8_t *dst_row,
       break;
    }
 }
+
+/**
+ * Decode BPTC texture data.  Large images are decoded in parallel bands
+ * of block rows.
+ */
+void
+_mesa_unpack_bptc(uint8_t *dst_row,
+                  unsigned dst_stride,
+                  const uint8_t *src_row,
+                  unsigned src_stride,
+                  unsigned src_width,
+                  unsigned src_height,
+                  mesa_format format)
+{
+   _mesa_unpack_compressed_banded(dst_row, dst_stride, src_row, src_stride,
+                                  src_width, src_height, 4, 4,
+                                  bptc_unpack_band, &format);
+}
@@ -1229,6 +1229,14 @@ util_format_unpack_table_init(void)
       }
 #endif
 
+#if (DETECT_ARCH_X86 || DETECT_ARCH_X86_64) && defined(USE_SSE41) && !defined(NO_FORMAT_ASM)
+      const struct util_format_unpack_description *unpack_sse41 = util_format_unpack_description_sse41(format);
+      if (unpack_sse41) {
+         util_format_unpack_table[format] = unpack_sse41;
+         continue;
+      }
+#endif
+
       util_format_unpack_table[format] = util_format_unpack_description_generic(format);
    }
 }
@@ -1242,6 +1250,33 @@ util_format_unpack_description(enum pipe_format format)
    return util_format_unpack_table[format];
 }
 
+static const struct util_format_pack_description *util_format_pack_table[PIPE_FORMAT_COUNT];
+
+static void
+util_format_pack_table_init(void)
+{
+   for (enum pipe_format format = PIPE_FORMAT_NONE; format < PIPE_FORMAT_COUNT; format++) {
+#if (DETECT_ARCH_X86 || DETECT_ARCH_X86_64) && defined(USE_SSE41) && !defined(NO_FORMAT_ASM)
+      const struct util_format_pack_description *pack_sse41 = util_format_pack_description_sse41(format);
+      if (pack_sse41) {
+         util_format_pack_table[format] = pack_sse41;
+         continue;
+      }
+#endif
+
+      util_format_pack_table[format] = util_format_pack_description_generic(format);
+   }
+}
+
+const struct util_format_pack_description *
+util_format_pack_description(enum pipe_format format)
+{
+   static once_flag flag = ONCE_FLAG_INIT;
+   call_once(&flag, util_format_pack_table_init);
+
+   return util_format_pack_table[format];
+}
+
 enum pipe_format
 util_format_snorm_to_unorm(enum pipe_format format)
 {
@@ -0,0 +1,708 @@
+/*
+ * Copyright © 2024 Mesa contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "util/detect_arch.h"
+#include "util/format/u_format.h"
+
+#if (DETECT_ARCH_X86 || DETECT_ARCH_X86_64) && defined(USE_SSE41) && !defined(NO_FORMAT_ASM)
+
+#include <smmintrin.h>
+#include "u_format_pack.h"
+#include "util/format_srgb.h"
+#include "util/u_cpu_detect.h"
+
+/* Converts four packed R8G8B8A8_UNORM pixels to four RGBA float vectors,
+ * matching ubyte_to_float() exactly.
+ */
+static inline void
+unpack_4x_rgba8_to_float(float *restrict dst, __m128i pixels)
+{
+   const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+
+   _mm_storeu_ps(dst + 0, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(pixels)), scale));
+   pixels = _mm_srli_si128(pixels, 4);
+   _mm_storeu_ps(dst + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(pixels)), scale));
+   pixels = _mm_srli_si128(pixels, 4);
+   _mm_storeu_ps(dst + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(pixels)), scale));
+   pixels = _mm_srli_si128(pixels, 4);
+   _mm_storeu_ps(dst + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(pixels)), scale));
+}
+
+static void
+util_format_r8g8b8a8_unorm_unpack_rgba_float_sse41(void *restrict dst_row, const uint8_t *restrict src, unsigned width)
+{
+   float *dst = dst_row;
+
+   while (width >= 4) {
+      unpack_4x_rgba8_to_float(dst, _mm_loadu_si128((const __m128i *)src));
+      width -= 4;
+      dst += 4 * 4;
+      src += 4 * 4;
+   }
+   if (width)
+      util_format_r8g8b8a8_unorm_unpack_rgba_float(dst, src, width);
+}
+
+static void
+util_format_b8g8r8a8_unorm_unpack_rgba_float_sse41(void *restrict dst_row, const uint8_t *restrict src, unsigned width)
+{
+   const __m128i swizzle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7,
+                                         10, 9, 8, 11, 14, 13, 12, 15);
+   float *dst = dst_row;
+
+   while (width >= 4) {
+      __m128i pixels = _mm_loadu_si128((const __m128i *)src);
+      unpack_4x_rgba8_to_float(dst, _mm_shuffle_epi8(pixels, swizzle));
+      width -= 4;
+      dst += 4 * 4;
+      src += 4 * 4;
+   }
+   if (width)
+      util_format_b8g8r8a8_unorm_unpack_rgba_float(dst, src, width);
+}
+
+static void
+util_format_b8g8r8a8_unorm_unpack_rgba_8unorm_sse41(uint8_t *restrict dst, const uint8_t *restrict src, unsigned width)
+{
+   const __m128i swizzle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7,
+                                         10, 9, 8, 11, 14, 13, 12, 15);
+
+   while (width >= 4) {
+      __m128i pixels = _mm_loadu_si128((const __m128i *)src);
+      _mm_storeu_si128((__m128i *)dst, _mm_shuffle_epi8(pixels, swizzle));
+      width -= 4;
+      dst += 4 * 4;
+      src += 4 * 4;
+   }
+   if (width)
+      util_format_b8g8r8a8_unorm_unpack_rgba_8unorm(dst, src, width);
+}
+
+static void
+util_format_b8g8r8x8_unorm_unpack_rgba_8unorm_sse41(uint8_t *restrict dst, const uint8_t *restrict src, unsigned width)
+{
+   const __m128i swizzle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7,
+                                         10, 9, 8, 11, 14, 13, 12, 15);
+   const __m128i alpha = _mm_set1_epi32(0xff000000);
+
+   while (width >= 4) {
+      __m128i pixels = _mm_loadu_si128((const __m128i *)src);
+      pixels = _mm_or_si128(_mm_shuffle_epi8(pixels, swizzle), alpha);
+      _mm_storeu_si128((__m128i *)dst, pixels);
+      width -= 4;
+      dst += 4 * 4;
+      src += 4 * 4;
+   }
+   if (width)
+      util_format_b8g8r8x8_unorm_unpack_rgba_8unorm(dst, src, width);
+}
+
+static void
+util_format_r8g8b8x8_unorm_unpack_rgba_8unorm_sse41(uint8_t *restrict dst, const uint8_t *restrict src, unsigned width)
+{
+   const __m128i alpha = _mm_set1_epi32(0xff000000);
+
+   while (width >= 4) {
+      __m128i pixels = _mm_loadu_si128((const __m128i *)src);
+      _mm_storeu_si128((__m128i *)dst, _mm_or_si128(pixels, alpha));
+      width -= 4;
+      dst += 4 * 4;
+      src += 4 * 4;
+   }
+   if (width)
+      util_format_r8g8b8x8_unorm_unpack_rgba_8unorm(dst, src, width);
+}
+
+/* Expands 565 with the same bit replication as _mesa_unorm_to_unorm(). */
+static void
+util_format_b5g6r5_unorm_unpack_rgba_8unorm_sse41(uint8_t *restrict dst, const uint8_t *restrict src, unsigned width)
+{
+   const __m128i mask5 = _mm_set1_epi16(0x1f);
+   const __m128i mask6 = _mm_set1_epi16(0x3f);
+   const __m128i alpha = _mm_set1_epi16((short)0xff00);
+
+   while (width >= 8) {
+      __m128i pixels = _mm_loadu_si128((const __m128i *)src);
+      __m128i r = _mm_srli_epi16(pixels, 11);
+      __m128i g = _mm_and_si128(_mm_srli_epi16(pixels, 5), mask6);
+      __m128i b = _mm_and_si128(pixels, mask5);
+
+      r = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+      g = _mm_or_si128(_mm_slli_epi16(g, 2), _mm_srli_epi16(g, 4));
+      b = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+
+      __m128i rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+      __m128i ba = _mm_or_si128(b, alpha);
+
+      _mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi16(rg, ba));
+      _mm_storeu_si128((__m128i *)(dst + 16), _mm_unpackhi_epi16(rg, ba));
+      width -= 8;
+      dst += 8 * 4;
+      src += 8 * 2;
+   }
+   if (width)
+      util_format_b5g6r5_unorm_unpack_rgba_8unorm(dst, src, width);
+}
+
+static void
+util_format_r10g10b10a2_unorm_unpack_rgba_float_sse41(void *restrict dst_row, const uint8_t *restrict src, unsigned width)
+{
+   const __m128i mask10 = _mm_set1_epi32(0x3ff);
+   const __m128 scale10 = _mm_set1_ps(1.0f / 0x3ff);
+   const __m128 scale2 = _mm_set1_ps(1.0f / 0x3);
+   float *dst = dst_row;
+
+   while (width >= 4) {
+      __m128i pixels = _mm_loadu_si128((const __m128i *)src);
+      __m128 r = _mm_cvtepi32_ps(_mm_and_si128(pixels, mask10));
+      __m128 g = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 10), mask10));
+      __m128 b = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 20), mask10));
+      __m128 a = _mm_cvtepi32_ps(_mm_srli_epi32(pixels, 30));
+
+      r = _mm_mul_ps(r, scale10);
+      g = _mm_mul_ps(g, scale10);
+      b = _mm_mul_ps(b, scale10);
+      a = _mm_mul_ps(a, scale2);
+      _MM_TRANSPOSE4_PS(r, g, b, a);
+
+      _mm_storeu_ps(dst + 0, r);
+      _mm_storeu_ps(dst + 4, g);
+      _mm_storeu_ps(dst + 8, b);
+      _mm_storeu_ps(dst + 12, a);
+      width -= 4;
+      dst += 4 * 4;
+      src += 4 * 4;
+   }
+   if (width)
+      util_format_r10g10b10a2_unorm_unpack_rgba_float(dst, src, width);
+}
+
+/* Converts four floats to bytes in 32-bit lanes, matching float_to_ubyte()
+ * exactly: NaN and non-positive values give 0, values >= 1.0 give 255.
+ */
+static inline __m128i
+float_to_ubyte_epi32(__m128 f)
+{
+   const __m128 scale = _mm_set1_ps(255.0f / 256.0f);
+   const __m128 bias = _mm_set1_ps(32768.0f);
+   const __m128i byte_mask = _mm_set1_epi32(0xff);
+   __m128i v = _mm_castps_si128(_mm_add_ps(_mm_mul_ps(f, scale), bias));
+
+   v = _mm_and_si128(v, byte_mask);
+   v = _mm_blendv_epi8(v, byte_mask, _mm_castps_si128(_mm_cmpge_ps(f, _mm_set1_ps(1.0f))));
+   return _mm_and_si128(v, _mm_castps_si128(_mm_cmpgt_ps(f, _mm_setzero_ps())));
+}
+
+/* Converts four halfs in the low half of h to floats exactly like
+ * _mesa_half_to_float(): with F16C when the CPU has it, else with the magic
+ * multiply of _mesa_half_to_float_slow().  The two only differ in how they
+ * keep signaling NaNs.
+ */
+static inline __m128
+half4_to_float(__m128i h, bool f16c)
+{
+#if defined(USE_X86_64_ASM)
+   if (f16c) {
+      __m128 out;
+      __asm volatile("vcvtph2ps %1, %0" : "=v"(out) : "v"(h));
+      return out;
+   }
+#endif
+   const __m128 magic = _mm_castsi128_ps(_mm_set1_epi32(0xef << 23));
+   const __m128 infnan = _mm_set1_ps(65536.0f);
+   __m128i x = _mm_cvtepu16_epi32(h);
+   __m128 f = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(x, _mm_set1_epi32(0x7fff)), 13));
+
+   f = _mm_mul_ps(f, magic);
+   __m128i bits = _mm_castps_si128(f);
+   bits = _mm_or_si128(bits, _mm_and_si128(_mm_castps_si128(_mm_cmpge_ps(f, infnan)),
+                                           _mm_set1_epi32(0xff << 23)));
+   bits = _mm_or_si128(bits, _mm_slli_epi32(_mm_and_si128(x, _mm_set1_epi32(0x8000)), 16));
+   return _mm_castsi128_ps(bits);
+}
+
+static void
+util_format_r16g16b16a16_float_unpack_rgba_float_sse41(void *restrict dst_row, const uint8_t *restrict src, unsigned width)
+{
+   const bool f16c = util_get_cpu_caps()->has_f16c;
+   float *dst = dst_row;
+
+   while (width >= 2) {
+      __m128i pixels = _mm_loadu_si128((const __m128i *)src);
+      _mm_storeu_ps(dst + 0, half4_to_float(pixels, f16c));
+      _mm_storeu_ps(dst + 4, half4_to_float(_mm_srli_si128(pixels, 8), f16c));
+      width -= 2;
+      dst += 2 * 4;
+      src += 2 * 8;
+   }
+   if (width)
+      util_format_r16g16b16a16_float_unpack_rgba_float(dst, src, width);
+}
+
+static void
+util_format_r16g16b16a16_float_unpack_rgba_8unorm_sse41(uint8_t *restrict dst, const uint8_t *restrict src, unsigned width)
+{
+   const bool f16c = util_get_cpu_caps()->has_f16c;
+
+   while (width >= 4) {
+      __m128i lo = _mm_loadu_si128((const __m128i *)src);
+      __m128i hi = _mm_loadu_si128((const __m128i *)(src + 16));
+      __m128i c0 = float_to_ubyte_epi32(half4_to_float(lo, f16c));
+      __m128i c1 = float_to_ubyte_epi32(half4_to_float(_mm_srli_si128(lo, 8), f16c));
+      __m128i c2 = float_to_ubyte_epi32(half4_to_float(hi, f16c));
+      __m128i c3 = float_to_ubyte_epi32(half4_to_float(_mm_srli_si128(hi, 8), f16c));
+
+      _mm_storeu_si128((__m128i *)dst, _mm_packus_epi16(_mm_packus_epi32(c0, c1),
+                                                        _mm_packus_epi32(c2, c3)));
+      width -= 4;
+      dst += 4 * 4;
+      src += 4 * 8;
+   }
+   if (width)
+      util_format_r16g16b16a16_float_unpack_rgba_8unorm(dst, src, width);
+}
+
+static const struct util_format_unpack_description util_format_unpack_descriptions_sse41[] = {
+   [PIPE_FORMAT_B8G8R8A8_UNORM] = {
+      .unpack_rgba_8unorm = &util_format_b8g8r8a8_unorm_unpack_rgba_8unorm_sse41,
+      .unpack_rgba = &util_format_b8g8r8a8_unorm_unpack_rgba_float_sse41,
+   },
+   [PIPE_FORMAT_B8G8R8X8_UNORM] = {
+      .unpack_rgba_8unorm = &util_format_b8g8r8x8_unorm_unpack_rgba_8unorm_sse41,
+      .unpack_rgba = &util_format_b8g8r8x8_unorm_unpack_rgba_float,
+   },
+   [PIPE_FORMAT_R8G8B8A8_UNORM] = {
+      .unpack_rgba_8unorm = &util_format_r8g8b8a8_unorm_unpack_rgba_8unorm,
+      .unpack_rgba = &util_format_r8g8b8a8_unorm_unpack_rgba_float_sse41,
+   },
+   [PIPE_FORMAT_R8G8B8X8_UNORM] = {
+      .unpack_rgba_8unorm = &util_format_r8g8b8x8_unorm_unpack_rgba_8unorm_sse41,
+      .unpack_rgba = &util_format_r8g8b8x8_unorm_unpack_rgba_float,
+   },
+   [PIPE_FORMAT_B5G6R5_UNORM] = {
+      .unpack_rgba_8unorm = &util_format_b5g6r5_unorm_unpack_rgba_8unorm_sse41,
+      .unpack_rgba = &util_format_b5g6r5_unorm_unpack_rgba_float,
+   },
+   [PIPE_FORMAT_R10G10B10A2_UNORM] = {
+      .unpack_rgba_8unorm = &util_format_r10g10b10a2_unorm_unpack_rgba_8unorm,
+      .unpack_rgba = &util_format_r10g10b10a2_unorm_unpack_rgba_float_sse41,
+   },
+   [PIPE_FORMAT_R16G16B16A16_FLOAT] = {
+      .unpack_rgba_8unorm = &util_format_r16g16b16a16_float_unpack_rgba_8unorm_sse41,
+      .unpack_rgba = &util_format_r16g16b16a16_float_unpack_rgba_float_sse41,
+   },
+};
+
+/* Converts sixteen floats to bytes with float_to_ubyte_epi32(). */
+static inline __m128i
+pack_4x_float_to_ubyte(const float *src)
+{
+   __m128i c[4];
+
+   for (unsigned i = 0; i < 4; i++)
+      c[i] = float_to_ubyte_epi32(_mm_loadu_ps(src + 4 * i));
+
+   return _mm_packus_epi16(_mm_packus_epi32(c[0], c[1]), _mm_packus_epi32(c[2], c[3]));
+}
+
+static void
+util_format_r8g8b8a8_unorm_pack_rgba_float_sse41(uint8_t *restrict dst_row, unsigned dst_stride,
+                                                 const float *restrict src_row, unsigned src_stride,
+                                                 unsigned width, unsigned height)
+{
+   for (unsigned y = 0; y < height; y++) {
+      const float *src = src_row;
+      uint8_t *dst = dst_row;
+      unsigned x = 0;
+
+      for (; x + 4 <= width; x += 4) {
+         _mm_storeu_si128((__m128i *)dst, pack_4x_float_to_ubyte(src));
+         src += 4 * 4;
+         dst += 4 * 4;
+      }
+      if (x < width)
+         util_format_r8g8b8a8_unorm_pack_rgba_float(dst, 0, src, 0, width - x, 1);
+
+      dst_row += dst_stride;
+      src_row += src_stride / sizeof(*src_row);
+   }
+}
+
+static void
+util_format_b8g8r8a8_unorm_pack_rgba_float_sse41(uint8_t *restrict dst_row, unsigned dst_stride,
+                                                 const float *restrict src_row, unsigned src_stride,
+                                                 unsigned width, unsigned height)
+{
+   const __m128i swizzle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7,
+                                         10, 9, 8, 11, 14, 13, 12, 15);
+
+   for (unsigned y = 0; y < height; y++) {
+      const float *src = src_row;
+      uint8_t *dst = dst_row;
+      unsigned x = 0;
+
+      for (; x + 4 <= width; x += 4) {
+         __m128i pixels = pack_4x_float_to_ubyte(src);
+         _mm_storeu_si128((__m128i *)dst, _mm_shuffle_epi8(pixels, swizzle));
+         src += 4 * 4;
+         dst += 4 * 4;
+      }
+      if (x < width)
+         util_format_b8g8r8a8_unorm_pack_rgba_float(dst, 0, src, 0, width - x, 1);
+
+      dst_row += dst_stride;
+      src_row += src_stride / sizeof(*src_row);
+   }
+}
+
+/* Byte shuffles from R8G8B8A8 for the 8unorm packers, -1 (0x80) clears the
+ * X channel like the generated code does.
+ */
+#define PACK_RGBA8_SWIZZLED(name, ...)                                              \
+static void                                                                         \
+util_format_##name##_pack_rgba_8unorm_sse41(uint8_t *restrict dst_row, unsigned dst_stride, \
+                                            const uint8_t *restrict src_row, unsigned src_stride, \
+                                            unsigned width, unsigned height)        \
+{                                                                                   \
+   const __m128i swizzle = _mm_setr_epi8(__VA_ARGS__);                              \
+                                                                                    \
+   for (unsigned y = 0; y < height; y++) {                                          \
+      const uint8_t *src = src_row;                                                 \
+      uint8_t *dst = dst_row;                                                       \
+      unsigned x = 0;                                                               \
+                                                                                    \
+      for (; x + 4 <= width; x += 4) {                                              \
+         __m128i pixels = _mm_loadu_si128((const __m128i *)src);                    \
+         _mm_storeu_si128((__m128i *)dst, _mm_shuffle_epi8(pixels, swizzle));       \
+         src += 4 * 4;                                                              \
+         dst += 4 * 4;                                                              \
+      }                                                                             \
+      if (x < width)                                                                \
+         util_format_##name##_pack_rgba_8unorm(dst, 0, src, 0, width - x, 1);       \
+                                                                                    \
+      dst_row += dst_stride;                                                        \
+      src_row += src_stride;                                                        \
+   }                                                                                \
+}
+
+PACK_RGBA8_SWIZZLED(b8g8r8a8_unorm, 2, 1, 0, 3, 6, 5, 4, 7,
+                    10, 9, 8, 11, 14, 13, 12, 15)
+PACK_RGBA8_SWIZZLED(b8g8r8x8_unorm, 2, 1, 0, -1, 6, 5, 4, -1,
+                    10, 9, 8, -1, 14, 13, 12, -1)
+PACK_RGBA8_SWIZZLED(r8g8b8x8_unorm, 0, 1, 2, -1, 4, 5, 6, -1,
+                    8, 9, 10, -1, 12, 13, 14, -1)
+
+#undef PACK_RGBA8_SWIZZLED
+
+/* Narrows with the same rounding as _mesa_unorm_to_unorm(x, 8, n), that is
+ * (x * max + 127) / 255, using mulhi by 0x8081 >> 7 as an exact 16-bit
+ * division by 255.
+ */
+static inline __m128i
+unorm8_to_unorm_epi16(__m128i x, short max)
+{
+   __m128i n = _mm_add_epi16(_mm_mullo_epi16(x, _mm_set1_epi16(max)), _mm_set1_epi16(127));
+   return _mm_srli_epi16(_mm_mulhi_epu16(n, _mm_set1_epi16((short)0x8081)), 7);
+}
+
+static void
+util_format_b5g6r5_unorm_pack_rgba_8unorm_sse41(uint8_t *restrict dst_row, unsigned dst_stride,
+                                                const uint8_t *restrict src_row, unsigned src_stride,
+                                                unsigned width, unsigned height)
+{
+   const __m128i mask8 = _mm_set1_epi16(0xff);
+
+   for (unsigned y = 0; y < height; y++) {
+      const uint8_t *src = src_row;
+      uint8_t *dst = dst_row;
+      unsigned x = 0;
+
+      for (; x + 8 <= width; x += 8) {
+         __m128i lo = _mm_loadu_si128((const __m128i *)src);
+         __m128i hi = _mm_loadu_si128((const __m128i *)(src + 16));
+         /* RG and BA byte pairs of the eight pixels */
+         __m128i rg = _mm_packus_epi32(_mm_and_si128(lo, _mm_set1_epi32(0xffff)),
+                                       _mm_and_si128(hi, _mm_set1_epi32(0xffff)));
+         __m128i ba = _mm_packus_epi32(_mm_srli_epi32(lo, 16), _mm_srli_epi32(hi, 16));
+         __m128i r = unorm8_to_unorm_epi16(_mm_and_si128(rg, mask8), 31);
+         __m128i g = unorm8_to_unorm_epi16(_mm_srli_epi16(rg, 8), 63);
+         __m128i b = unorm8_to_unorm_epi16(_mm_and_si128(ba, mask8), 31);
+
+         __m128i pixels = _mm_or_si128(_mm_or_si128(b, _mm_slli_epi16(g, 5)),
+                                       _mm_slli_epi16(r, 11));
+         _mm_storeu_si128((__m128i *)dst, pixels);
+         src += 8 * 4;
+         dst += 8 * 2;
+      }
+      if (x < width)
+         util_format_b5g6r5_unorm_pack_rgba_8unorm(dst, 0, src, 0, width - x, 1);
+
+      dst_row += dst_stride;
+      src_row += src_stride;
+   }
+}
+
+#if defined(USE_X86_64_ASM)
+
+/* Converts eight floats to halfs rounding towards zero like
+ * _mesa_float_to_float16_rtz(), only used when the CPU has F16C.
+ */
+static inline __m128i
+float8_to_half_rtz(__m128 lo, __m128 hi)
+{
+   __m128i h0, h1;
+
+   __asm volatile("vcvtps2ph $3, %1, %0" : "=v"(h0) : "v"(lo));
+   __asm volatile("vcvtps2ph $3, %1, %0" : "=v"(h1) : "v"(hi));
+   return _mm_unpacklo_epi64(h0, h1);
+}
+
+static void
+util_format_r16g16b16a16_float_pack_rgba_float_sse41(uint8_t *restrict dst_row, unsigned dst_stride,
+                                                     const float *restrict src_row, unsigned src_stride,
+                                                     unsigned width, unsigned height)
+{
+   if (!util_get_cpu_caps()->has_f16c) {
+      util_format_r16g16b16a16_float_pack_rgba_float(dst_row, dst_stride, src_row, src_stride,
+                                                     width, height);
+      return;
+   }
+
+   for (unsigned y = 0; y < height; y++) {
+      const float *src = src_row;
+      uint8_t *dst = dst_row;
+      unsigned x = 0;
+
+      for (; x + 2 <= width; x += 2) {
+         _mm_storeu_si128((__m128i *)dst, float8_to_half_rtz(_mm_loadu_ps(src),
+                                                             _mm_loadu_ps(src + 4)));
+         src += 2 * 4;
+         dst += 2 * 8;
+      }
+      if (x < width)
+         util_format_r16g16b16a16_float_pack_rgba_float(dst, 0, src, 0, width - x, 1);
+
+      dst_row += dst_stride;
+      src_row += src_stride / sizeof(*src_row);
+   }
+}
+
+static void
+util_format_r16g16b16a16_float_pack_rgba_8unorm_sse41(uint8_t *restrict dst_row, unsigned dst_stride,
+                                                      const uint8_t *restrict src_row, unsigned src_stride,
+                                                      unsigned width, unsigned height)
+{
+   const __m128 scale = _mm_set1_ps(1.0f / 0xff);
+
+   if (!util_get_cpu_caps()->has_f16c) {
+      util_format_r16g16b16a16_float_pack_rgba_8unorm(dst_row, dst_stride, src_row, src_stride,
+                                                      width, height);
+      return;
+   }
+
+   for (unsigned y = 0; y < height; y++) {
+      const uint8_t *src = src_row;
+      uint8_t *dst = dst_row;
+      unsigned x = 0;
+
+      for (; x + 2 <= width; x += 2) {
+         __m128i pixels = _mm_loadl_epi64((const __m128i *)src);
+         __m128 lo = _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(pixels)), scale);
+         __m128 hi = _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(pixels, 4))), scale);
+
+         _mm_storeu_si128((__m128i *)dst, float8_to_half_rtz(lo, hi));
+         src += 2 * 4;
+         dst += 2 * 8;
+      }
+      if (x < width)
+         util_format_r16g16b16a16_float_pack_rgba_8unorm(dst, 0, src, 0, width - x, 1);
+
+      dst_row += dst_stride;
+      src_row += src_stride;
+   }
+}
+
+#endif /* USE_X86_64_ASM */
+
+/* util_format_linear_float_to_srgb_8unorm() on four floats.  maxps returns
+ * its second operand for NaN, so NaN clamps to minval like the scalar code;
+ * only the table lookup is done per lane.
+ */
+static inline __m128i
+linear_float_to_srgb_epi32(__m128 x)
+{
+   const __m128i minval = _mm_set1_epi32((127 - 13) << 23);
+   const __m128i almostone = _mm_set1_epi32(0x3f7fffff);
+   const unsigned *table = util_format_linear_to_srgb_helper_table;
+   uint32_t idx[4];
+
+   x = _mm_max_ps(x, _mm_castsi128_ps(minval));
+   x = _mm_min_ps(x, _mm_castsi128_ps(almostone));
+
+   __m128i bits = _mm_castps_si128(x);
+   _mm_storeu_si128((__m128i *)idx, _mm_srli_epi32(_mm_sub_epi32(bits, minval), 20));
+   __m128i tab = _mm_setr_epi32(table[idx[0]], table[idx[1]], table[idx[2]], table[idx[3]]);
+   __m128i bias = _mm_slli_epi32(_mm_srli_epi32(tab, 16), 9);
+   __m128i scale = _mm_and_si128(tab, _mm_set1_epi32(0xffff));
+   __m128i t = _mm_and_si128(_mm_srli_epi32(bits, 12), _mm_set1_epi32(0xff));
+
+   return _mm_srli_epi32(_mm_add_epi32(bias, _mm_mullo_epi32(scale, t)), 16);
+}
+
+/* Encodes the colors of four pixels to sRGB and keeps float_to_ubyte()
+ * alpha, transposed so that no lane of the table lookups is wasted on alpha.
+ */
+static inline __m128i
+pack_4x_float_to_srgb8(const float *src)
+{
+   __m128 r = _mm_loadu_ps(src + 0);
+   __m128 g = _mm_loadu_ps(src + 4);
+   __m128 b = _mm_loadu_ps(src + 8);
+   __m128 a = _mm_loadu_ps(src + 12);
+
+   _MM_TRANSPOSE4_PS(r, g, b, a);
+
+   __m128i pixels = linear_float_to_srgb_epi32(r);
+   pixels = _mm_or_si128(pixels, _mm_slli_epi32(linear_float_to_srgb_epi32(g), 8));
+   pixels = _mm_or_si128(pixels, _mm_slli_epi32(linear_float_to_srgb_epi32(b), 16));
+   return _mm_or_si128(pixels, _mm_slli_epi32(float_to_ubyte_epi32(a), 24));
+}
+
+static void
+util_format_r8g8b8a8_srgb_pack_rgba_float_sse41(uint8_t *restrict dst_row, unsigned dst_stride,
+                                                const float *restrict src_row, unsigned src_stride,
+                                                unsigned width, unsigned height)
+{
+   for (unsigned y = 0; y < height; y++) {
+      const float *src = src_row;
+      uint8_t *dst = dst_row;
+      unsigned x = 0;
+
+      for (; x + 4 <= width; x += 4) {
+         _mm_storeu_si128((__m128i *)dst, pack_4x_float_to_srgb8(src));
+         src += 4 * 4;
+         dst += 4 * 4;
+      }
+      if (x < width)
+         util_format_r8g8b8a8_srgb_pack_rgba_float(dst, 0, src, 0, width - x, 1);
+
+      dst_row += dst_stride;
+      src_row += src_stride / sizeof(*src_row);
+   }
+}
+
+static void
+util_format_b8g8r8a8_srgb_pack_rgba_float_sse41(uint8_t *restrict dst_row, unsigned dst_stride,
+                                                const float *restrict src_row, unsigned src_stride,
+                                                unsigned width, unsigned height)
+{
+   const __m128i swizzle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7,
+                                         10, 9, 8, 11, 14, 13, 12, 15);
+
+   for (unsigned y = 0; y < height; y++) {
+      const float *src = src_row;
+      uint8_t *dst = dst_row;
+      unsigned x = 0;
+
+      for (; x + 4 <= width; x += 4) {
+         __m128i pixels = pack_4x_float_to_srgb8(src);
+         _mm_storeu_si128((__m128i *)dst, _mm_shuffle_epi8(pixels, swizzle));
+         src += 4 * 4;
+         dst += 4 * 4;
+      }
+      if (x < width)
+         util_format_b8g8r8a8_srgb_pack_rgba_float(dst, 0, src, 0, width - x, 1);
+
+      dst_row += dst_stride;
+      src_row += src_stride / sizeof(*src_row);
+   }
+}
+
+static const struct util_format_pack_description util_format_pack_descriptions_sse41[] = {
+   [PIPE_FORMAT_B8G8R8A8_UNORM] = {
+      .pack_rgba_8unorm = &util_format_b8g8r8a8_unorm_pack_rgba_8unorm_sse41,
+      .pack_rgba_float = &util_format_b8g8r8a8_unorm_pack_rgba_float_sse41,
+   },
+   [PIPE_FORMAT_B8G8R8X8_UNORM] = {
+      .pack_rgba_8unorm = &util_format_b8g8r8x8_unorm_pack_rgba_8unorm_sse41,
+      .pack_rgba_float = &util_format_b8g8r8x8_unorm_pack_rgba_float,
+   },
+   [PIPE_FORMAT_R8G8B8A8_UNORM] = {
+      .pack_rgba_8unorm = &util_format_r8g8b8a8_unorm_pack_rgba_8unorm,
+      .pack_rgba_float = &util_format_r8g8b8a8_unorm_pack_rgba_float_sse41,
+   },
+   [PIPE_FORMAT_R8G8B8X8_UNORM] = {
+      .pack_rgba_8unorm = &util_format_r8g8b8x8_unorm_pack_rgba_8unorm_sse41,
+      .pack_rgba_float = &util_format_r8g8b8x8_unorm_pack_rgba_float,
+   },
+   [PIPE_FORMAT_B5G6R5_UNORM] = {
+      .pack_rgba_8unorm = &util_format_b5g6r5_unorm_pack_rgba_8unorm_sse41,
+      .pack_rgba_float = &util_format_b5g6r5_unorm_pack_rgba_float,
+   },
+#if defined(USE_X86_64_ASM)
+   [PIPE_FORMAT_R16G16B16A16_FLOAT] = {
+      .pack_rgba_8unorm = &util_format_r16g16b16a16_float_pack_rgba_8unorm_sse41,
+      .pack_rgba_float = &util_format_r16g16b16a16_float_pack_rgba_float_sse41,
+   },
+#endif
+   [PIPE_FORMAT_R8G8B8A8_SRGB] = {
+      .pack_rgba_8unorm = &util_format_r8g8b8a8_srgb_pack_rgba_8unorm,
+      .pack_rgba_float = &util_format_r8g8b8a8_srgb_pack_rgba_float_sse41,
+   },
+   [PIPE_FORMAT_B8G8R8A8_SRGB] = {
+      .pack_rgba_8unorm = &util_format_b8g8r8a8_srgb_pack_rgba_8unorm,
+      .pack_rgba_float = &util_format_b8g8r8a8_srgb_pack_rgba_float_sse41,
+   },
+};
+
+const struct util_format_pack_description *
+util_format_pack_description_sse41(enum pipe_format format)
+{
+   if (!util_get_cpu_caps()->has_sse4_1)
+      return NULL;
+
+   if (format >= ARRAY_SIZE(util_format_pack_descriptions_sse41))
+      return NULL;
+
+   if (!util_format_pack_descriptions_sse41[format].pack_rgba_8unorm)
+      return NULL;
+
+   return &util_format_pack_descriptions_sse41[format];
+}
+
+const struct util_format_unpack_description *
+util_format_unpack_description_sse41(enum pipe_format format)
+{
+   if (!util_get_cpu_caps()->has_sse4_1)
+      return NULL;
+
+   if (format >= ARRAY_SIZE(util_format_unpack_descriptions_sse41))
+      return NULL;
+
+   if (!util_format_unpack_descriptions_sse41[format].unpack_rgba)
+      return NULL;
+
+   return &util_format_unpack_descriptions_sse41[format];
+}
+
+#endif /* (DETECT_ARCH_X86 || DETECT_ARCH_X86_64) && USE_SSE41 */
@@ -28,10 +28,12 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <float.h>
 
 #include "util/half_float.h"
 #include "util/u_math.h"
+#include "util/os_time.h"
 #include "util/format/u_format.h"
 #include "util/format/u_format_tests.h"
 #include "util/format/u_format_s3tc.h"
@@ -731,6 +733,114 @@ test_format_norm_flags(const struct util_format_description *format_desc)
    return success;
 }
 
+/* Compare the CPU-specific unpack paths against the generic ones over a row
+ * wide enough to exercise both their vector loops and their scalar tails.
+ */
+static bool
+test_format_unpack_optimized(const struct util_format_description *format_desc)
+{
+   const struct util_format_unpack_description *unpack =
+      util_format_unpack_description(format_desc->format);
+   const struct util_format_unpack_description *generic =
+      util_format_unpack_description_generic(format_desc->format);
+   const unsigned width = 37;
+   uint8_t packed[37 * UTIL_FORMAT_MAX_PACKED_BYTES];
+   uint8_t unpacked[37 * 4 * sizeof(float)];
+   uint8_t expected[37 * 4 * sizeof(float)];
+   bool success = true;
+   unsigned i;
+
+   if (unpack == generic || format_desc->block.width != 1 ||
+       format_desc->block.height != 1)
+      return true;
+
+   for (i = 0; i < sizeof packed; ++i)
+      packed[i] = (uint8_t)(i * 97 + 13);
+
+   if (unpack->unpack_rgba && unpack->unpack_rgba != generic->unpack_rgba) {
+      unpack->unpack_rgba(unpacked, packed, width);
+      generic->unpack_rgba(expected, packed, width);
+      if (memcmp(unpacked, expected, width * 4 * sizeof(float)) != 0) {
+         printf("FAILED: unpack_rgba mismatch\n");
+         success = false;
+      }
+   }
+
+   if (unpack->unpack_rgba_8unorm &&
+       unpack->unpack_rgba_8unorm != generic->unpack_rgba_8unorm) {
+      unpack->unpack_rgba_8unorm(unpacked, packed, width);
+      generic->unpack_rgba_8unorm(expected, packed, width);
+      if (memcmp(unpacked, expected, width * 4) != 0) {
+         printf("FAILED: unpack_rgba_8unorm mismatch\n");
+         success = false;
+      }
+   }
+
+   return success;
+}
+
+/* Same for the CPU-specific pack paths, the float inputs include values
+ * outside [0, 1], NaNs and exact halves to check clamping and rounding.
+ */
+static bool
+test_format_pack_optimized(const struct util_format_description *format_desc)
+{
+   const struct util_format_pack_description *pack =
+      util_format_pack_description(format_desc->format);
+   const struct util_format_pack_description *generic =
+      util_format_pack_description_generic(format_desc->format);
+   const unsigned width = 37, height = 3;
+   const unsigned dst_stride = width * UTIL_FORMAT_MAX_PACKED_BYTES;
+   uint8_t src_8unorm[3 * 37 * 4];
+   float src_float[3 * 37 * 4];
+   uint8_t packed[3 * 37 * UTIL_FORMAT_MAX_PACKED_BYTES];
+   uint8_t expected[3 * 37 * UTIL_FORMAT_MAX_PACKED_BYTES];
+   bool success = true;
+   unsigned i;
+
+   if (pack == generic)
+      return true;
+
+   for (i = 0; i < height * width * 4; ++i) {
+      src_8unorm[i] = (uint8_t)(i * 97 + 13);
+      switch (i % 7) {
+      case 0: src_float[i] = -0.25f; break;
+      case 1: src_float[i] = 1.5f; break;
+      case 2: src_float[i] = NAN; break;
+      case 3: src_float[i] = (float)(i % 256) / 255.0f; break;
+      case 4: src_float[i] = ((float)(i % 256) + 0.5f) / 256.0f; break;
+      default: src_float[i] = (float)((i * 7919) % 1000) / 999.0f; break;
+      }
+   }
+
+   if (pack->pack_rgba_8unorm &&
+       pack->pack_rgba_8unorm != generic->pack_rgba_8unorm) {
+      memset(packed, 0xcd, sizeof packed);
+      memset(expected, 0xcd, sizeof expected);
+      pack->pack_rgba_8unorm(packed, dst_stride, src_8unorm, width * 4, width, height);
+      generic->pack_rgba_8unorm(expected, dst_stride, src_8unorm, width * 4, width, height);
+      if (memcmp(packed, expected, sizeof packed) != 0) {
+         printf("FAILED: pack_rgba_8unorm mismatch\n");
+         success = false;
+      }
+   }
+
+   if (pack->pack_rgba_float &&
+       pack->pack_rgba_float != generic->pack_rgba_float) {
+      memset(packed, 0xcd, sizeof packed);
+      memset(expected, 0xcd, sizeof expected);
+      pack->pack_rgba_float(packed, dst_stride, src_float, width * 4 * sizeof(float), width, height);
+      generic->pack_rgba_float(expected, dst_stride, src_float, width * 4 * sizeof(float), width, height);
+      if (memcmp(packed, expected, sizeof packed) != 0) {
+         printf("FAILED: pack_rgba_float mismatch\n");
+         success = false;
+      }
+   }
+
+   return success;
+}
+
+
 typedef bool
 (*test_func_t)(const struct util_format_description *format_desc,
                const struct util_format_test_case *test);
@@ -856,6 +966,8 @@ test_all(void)
       TEST_ONE_PACK_FUNC(pack_s_8uint);
 
       TEST_FORMAT_METADATA(norm_flags);
+      TEST_FORMAT_METADATA(unpack_optimized);
+      TEST_FORMAT_METADATA(pack_optimized);
 
 #     undef TEST_ONE_FUNC
 #     undef TEST_ONE_FORMAT
@@ -865,10 +977,122 @@ test_all(void)
 }
 
 
+/* Rows are sized to stay in L2, so this measures the conversion and not
+ * the memory bandwidth of the machine.
+ */
+#define BENCH_WIDTH 1024
+#define BENCH_HEIGHT 64
+
+/* Bytes per packed pixel of the format being measured */
+static unsigned bench_bpp;
+
+typedef void
+(*bench_func_t)(const void *func, uint8_t *packed, float *unpacked);
+
+static void
+bench_unpack_rgba_8unorm(const void *func, uint8_t *packed, float *unpacked)
+{
+   const struct util_format_unpack_description *unpack = func;
+   for (unsigned y = 0; y < BENCH_HEIGHT; y++)
+      unpack->unpack_rgba_8unorm((uint8_t *)unpacked + y * BENCH_WIDTH * 4,
+                                 packed + y * BENCH_WIDTH * bench_bpp, BENCH_WIDTH);
+}
+
+static void
+bench_unpack_rgba(const void *func, uint8_t *packed, float *unpacked)
+{
+   const struct util_format_unpack_description *unpack = func;
+   for (unsigned y = 0; y < BENCH_HEIGHT; y++)
+      unpack->unpack_rgba(unpacked + y * BENCH_WIDTH * 4,
+                          packed + y * BENCH_WIDTH * bench_bpp, BENCH_WIDTH);
+}
+
+static void
+bench_pack_rgba_8unorm(const void *func, uint8_t *packed, float *unpacked)
+{
+   const struct util_format_pack_description *pack = func;
+   pack->pack_rgba_8unorm(packed, BENCH_WIDTH * bench_bpp, (const uint8_t *)unpacked,
+                          BENCH_WIDTH * 4, BENCH_WIDTH, BENCH_HEIGHT);
+}
+
+static void
+bench_pack_rgba_float(const void *func, uint8_t *packed, float *unpacked)
+{
+   const struct util_format_pack_description *pack = func;
+   pack->pack_rgba_float(packed, BENCH_WIDTH * bench_bpp, unpacked,
+                         BENCH_WIDTH * 4 * sizeof(float), BENCH_WIDTH, BENCH_HEIGHT);
+}
+
+static double
+bench_one(bench_func_t bench, const void *func, uint8_t *packed, float *unpacked)
+{
+   const unsigned iterations = 200;
+   int64_t start, end;
+
+   bench(func, packed, unpacked);
+
+   start = os_time_get_nano();
+   for (unsigned i = 0; i < iterations; i++)
+      bench(func, packed, unpacked);
+   end = os_time_get_nano();
+
+   /* pixels per second, in millions */
+   return (double)BENCH_WIDTH * BENCH_HEIGHT * iterations * 1e3 / (end - start);
+}
+
+/* Compares the throughput of the CPU-specific and generic conversions of
+ * every format that has some, run with "u_format_test --bench".
+ */
+static void
+bench_all(void)
+{
+   uint8_t *packed = calloc(BENCH_WIDTH * BENCH_HEIGHT, 8);
+   float *unpacked = calloc(BENCH_WIDTH * BENCH_HEIGHT * 4, sizeof(float));
+
+   printf("%-32s %-20s %12s %12s\n", "format", "function", "generic", "optimized");
+
+   for (enum pipe_format format = 1; format < PIPE_FORMAT_COUNT; ++format) {
+      const struct util_format_description *format_desc = util_format_description(format);
+      const struct util_format_unpack_description *unpack = util_format_unpack_description(format);
+      const struct util_format_unpack_description *unpack_generic = util_format_unpack_description_generic(format);
+      const struct util_format_pack_description *pack = util_format_pack_description(format);
+      const struct util_format_pack_description *pack_generic = util_format_pack_description_generic(format);
+
+      if (!format_desc || format_desc->block.bits > 64 ||
+          (unpack == unpack_generic && pack == pack_generic))
+         continue;
+
+      bench_bpp = format_desc->block.bits / 8;
+
+#     define BENCH(desc, name) \
+      if (desc->name && desc->name != desc##_generic->name) {                 \
+         printf("%-32s %-20s %8.0f MP/s %8.0f MP/s\n", format_desc->short_name, #name, \
+                bench_one(bench_##name, desc##_generic, packed, unpacked),     \
+                bench_one(bench_##name, desc, packed, unpacked));              \
+      }
+
+      BENCH(unpack, unpack_rgba_8unorm);
+      BENCH(unpack, unpack_rgba);
+      BENCH(pack, pack_rgba_8unorm);
+      BENCH(pack, pack_rgba_float);
+
+#     undef BENCH
+   }
+
+   free(packed);
+   free(unpacked);
+}
+
+
 int main(int argc, char **argv)
 {
    bool success;
 
+   if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+      bench_all();
+      return 0;
+   }
+
    success = test_all();
 
    return success ? 0 : 1;
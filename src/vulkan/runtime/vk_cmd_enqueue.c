@@ -40,8 +40,7 @@ vk_cmd_enqueue_CmdDrawMultiEXT(VkCommandBuffer commandBuffer,
    VK_FROM_HANDLE(vk_command_buffer, cmd_buffer, commandBuffer);
 
    struct vk_cmd_queue_entry *cmd =
-      vk_zalloc(cmd_buffer->cmd_queue.alloc, sizeof(*cmd), 8,
-                VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+      vk_cmd_queue_zalloc(&cmd_buffer->cmd_queue, sizeof(*cmd));
    if (!cmd)
       return;
 
@@ -52,9 +51,8 @@ vk_cmd_enqueue_CmdDrawMultiEXT(VkCommandBuffer commandBuffer,
    if (pVertexInfo) {
       unsigned i = 0;
       cmd->u.draw_multi_ext.vertex_info =
-         vk_zalloc(cmd_buffer->cmd_queue.alloc,
-                   sizeof(*cmd->u.draw_multi_ext.vertex_info) * drawCount, 8,
-                   VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+         vk_cmd_queue_zalloc(&cmd_buffer->cmd_queue,
+                             sizeof(*cmd->u.draw_multi_ext.vertex_info) * drawCount);
 
       vk_foreach_multi_draw(draw, i, pVertexInfo, drawCount, stride) {
          memcpy(&cmd->u.draw_multi_ext.vertex_info[i], draw,
@@ -78,8 +76,7 @@ vk_cmd_enqueue_CmdDrawMultiIndexedEXT(VkCommandBuffer commandBuffer,
    VK_FROM_HANDLE(vk_command_buffer, cmd_buffer, commandBuffer);
 
    struct vk_cmd_queue_entry *cmd =
-      vk_zalloc(cmd_buffer->cmd_queue.alloc, sizeof(*cmd), 8,
-                VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+      vk_cmd_queue_zalloc(&cmd_buffer->cmd_queue, sizeof(*cmd));
    if (!cmd)
       return;
 
@@ -91,9 +88,8 @@ vk_cmd_enqueue_CmdDrawMultiIndexedEXT(VkCommandBuffer commandBuffer,
    if (pIndexInfo) {
       unsigned i = 0;
       cmd->u.draw_multi_indexed_ext.index_info =
-         vk_zalloc(cmd_buffer->cmd_queue.alloc,
-                   sizeof(*cmd->u.draw_multi_indexed_ext.index_info) * drawCount, 8,
-                   VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+         vk_cmd_queue_zalloc(&cmd_buffer->cmd_queue,
+                             sizeof(*cmd->u.draw_multi_indexed_ext.index_info) * drawCount);
 
       vk_foreach_multi_draw_indexed(draw, i, pIndexInfo, drawCount, stride) {
          cmd->u.draw_multi_indexed_ext.index_info[i].firstIndex = draw->firstIndex;
@@ -109,45 +105,14 @@ vk_cmd_enqueue_CmdDrawMultiIndexedEXT(VkCommandBuffer commandBuffer,
 
    if (pVertexOffset) {
       cmd->u.draw_multi_indexed_ext.vertex_offset =
-         vk_zalloc(cmd_buffer->cmd_queue.alloc,
-                   sizeof(*cmd->u.draw_multi_indexed_ext.vertex_offset), 8,
-                   VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+         vk_cmd_queue_zalloc(&cmd_buffer->cmd_queue,
+                             sizeof(*cmd->u.draw_multi_indexed_ext.vertex_offset));
 
       memcpy(cmd->u.draw_multi_indexed_ext.vertex_offset, pVertexOffset,
              sizeof(*cmd->u.draw_multi_indexed_ext.vertex_offset));
    }
 }
 
-static void
-push_descriptors_set_free(struct vk_cmd_queue *queue,
-                          struct vk_cmd_queue_entry *cmd)
-{
-  struct vk_cmd_push_descriptor_set_khr *pds = &cmd->u.push_descriptor_set_khr;
-  for (unsigned i = 0; i < pds->descriptor_write_count; i++) {
-    VkWriteDescriptorSet *entry = &pds->descriptor_writes[i];
-    switch (entry->descriptorType) {
-    case VK_DESCRIPTOR_TYPE_SAMPLER:
-    case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
-    case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
-    case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
-    case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
-       vk_free(queue->alloc, (void *)entry->pImageInfo);
-       break;
-    case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
-    case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
-       vk_free(queue->alloc, (void *)entry->pTexelBufferView);
-       break;
-    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
-    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
-    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
-    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
-    default:
-       vk_free(queue->alloc, (void *)entry->pBufferInfo);
-       break;
-    }
-  }
-}
-
 VKAPI_ATTR void VKAPI_CALL
 vk_cmd_enqueue_CmdPushDescriptorSetKHR(VkCommandBuffer commandBuffer,
                                        VkPipelineBindPoint pipelineBindPoint,
@@ -160,15 +125,13 @@ vk_cmd_enqueue_CmdPushDescriptorSetKHR(VkCommandBuffer commandBuffer,
    struct vk_cmd_push_descriptor_set_khr *pds;
 
    struct vk_cmd_queue_entry *cmd =
-      vk_zalloc(cmd_buffer->cmd_queue.alloc, sizeof(*cmd), 8,
-                VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+      vk_cmd_queue_zalloc(&cmd_buffer->cmd_queue, sizeof(*cmd));
    if (!cmd)
       return;
 
    pds = &cmd->u.push_descriptor_set_khr;
 
    cmd->type = VK_CMD_PUSH_DESCRIPTOR_SET_KHR;
-   cmd->driver_free_cb = push_descriptors_set_free;
    list_addtail(&cmd->cmd_link, &cmd_buffer->cmd_queue.cmds);
 
    pds->pipeline_bind_point = pipelineBindPoint;
@@ -178,9 +141,8 @@ vk_cmd_enqueue_CmdPushDescriptorSetKHR(VkCommandBuffer commandBuffer,
 
    if (pDescriptorWrites) {
       pds->descriptor_writes =
-         vk_zalloc(cmd_buffer->cmd_queue.alloc,
-                   sizeof(*pds->descriptor_writes) * descriptorWriteCount, 8,
-                   VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+         vk_cmd_queue_zalloc(&cmd_buffer->cmd_queue,
+                             sizeof(*pds->descriptor_writes) * descriptorWriteCount);
       memcpy(pds->descriptor_writes,
              pDescriptorWrites,
              sizeof(*pds->descriptor_writes) * descriptorWriteCount);
@@ -193,9 +155,8 @@ vk_cmd_enqueue_CmdPushDescriptorSetKHR(VkCommandBuffer commandBuffer,
          case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
          case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
             pds->descriptor_writes[i].pImageInfo =
-               vk_zalloc(cmd_buffer->cmd_queue.alloc,
-                         sizeof(VkDescriptorImageInfo) * pds->descriptor_writes[i].descriptorCount, 8,
-                         VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+               vk_cmd_queue_zalloc(&cmd_buffer->cmd_queue,
+                                   sizeof(VkDescriptorImageInfo) * pds->descriptor_writes[i].descriptorCount);
             memcpy((VkDescriptorImageInfo *)pds->descriptor_writes[i].pImageInfo,
                    pDescriptorWrites[i].pImageInfo,
                    sizeof(VkDescriptorImageInfo) * pds->descriptor_writes[i].descriptorCount);
@@ -203,9 +164,8 @@ vk_cmd_enqueue_CmdPushDescriptorSetKHR(VkCommandBuffer commandBuffer,
          case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
          case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
             pds->descriptor_writes[i].pTexelBufferView =
-               vk_zalloc(cmd_buffer->cmd_queue.alloc,
-                         sizeof(VkBufferView) * pds->descriptor_writes[i].descriptorCount, 8,
-                         VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+               vk_cmd_queue_zalloc(&cmd_buffer->cmd_queue,
+                                   sizeof(VkBufferView) * pds->descriptor_writes[i].descriptorCount);
             memcpy((VkBufferView *)pds->descriptor_writes[i].pTexelBufferView,
                    pDescriptorWrites[i].pTexelBufferView,
                    sizeof(VkBufferView) * pds->descriptor_writes[i].descriptorCount);
@@ -216,9 +176,8 @@ vk_cmd_enqueue_CmdPushDescriptorSetKHR(VkCommandBuffer commandBuffer,
          case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
          default:
             pds->descriptor_writes[i].pBufferInfo =
-               vk_zalloc(cmd_buffer->cmd_queue.alloc,
-                         sizeof(VkDescriptorBufferInfo) * pds->descriptor_writes[i].descriptorCount, 8,
-                         VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+               vk_cmd_queue_zalloc(&cmd_buffer->cmd_queue,
+                                   sizeof(VkDescriptorBufferInfo) * pds->descriptor_writes[i].descriptorCount);
             memcpy((VkDescriptorBufferInfo *)pds->descriptor_writes[i].pBufferInfo,
                    pDescriptorWrites[i].pBufferInfo,
                    sizeof(VkDescriptorBufferInfo) * pds->descriptor_writes[i].descriptorCount);
@@ -255,8 +214,7 @@ vk_cmd_enqueue_CmdBindDescriptorSets(VkCommandBuffer commandBuffer,
    VK_FROM_HANDLE(vk_command_buffer, cmd_buffer, commandBuffer);
 
    struct vk_cmd_queue_entry *cmd =
-      vk_zalloc(cmd_buffer->cmd_queue.alloc, sizeof(*cmd), 8,
-                VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+      vk_cmd_queue_zalloc(&cmd_buffer->cmd_queue, sizeof(*cmd));
    if (!cmd)
       return;
 
@@ -276,9 +234,8 @@ vk_cmd_enqueue_CmdBindDescriptorSets(VkCommandBuffer commandBuffer,
    cmd->u.bind_descriptor_sets.descriptor_set_count = descriptorSetCount;
    if (pDescriptorSets) {
       cmd->u.bind_descriptor_sets.descriptor_sets =
-         vk_zalloc(cmd_buffer->cmd_queue.alloc,
-                   sizeof(*cmd->u.bind_descriptor_sets.descriptor_sets) * descriptorSetCount, 8,
-                   VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+         vk_cmd_queue_zalloc(&cmd_buffer->cmd_queue,
+                             sizeof(*cmd->u.bind_descriptor_sets.descriptor_sets) * descriptorSetCount);
 
       memcpy(cmd->u.bind_descriptor_sets.descriptor_sets, pDescriptorSets,
              sizeof(*cmd->u.bind_descriptor_sets.descriptor_sets) * descriptorSetCount);
@@ -286,9 +243,8 @@ vk_cmd_enqueue_CmdBindDescriptorSets(VkCommandBuffer commandBuffer,
    cmd->u.bind_descriptor_sets.dynamic_offset_count = dynamicOffsetCount;
    if (pDynamicOffsets) {
       cmd->u.bind_descriptor_sets.dynamic_offsets =
-         vk_zalloc(cmd_buffer->cmd_queue.alloc,
-                   sizeof(*cmd->u.bind_descriptor_sets.dynamic_offsets) * dynamicOffsetCount, 8,
-                   VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+         vk_cmd_queue_zalloc(&cmd_buffer->cmd_queue,
+                             sizeof(*cmd->u.bind_descriptor_sets.dynamic_offsets) * dynamicOffsetCount);
 
       memcpy(cmd->u.bind_descriptor_sets.dynamic_offsets, pDynamicOffsets,
              sizeof(*cmd->u.bind_descriptor_sets.dynamic_offsets) * dynamicOffsetCount);
@@ -296,20 +252,6 @@ vk_cmd_enqueue_CmdBindDescriptorSets(VkCommandBuffer commandBuffer,
 }
 
 #ifdef VK_ENABLE_BETA_EXTENSIONS
-static void
-dispatch_graph_amdx_free(struct vk_cmd_queue *queue, struct vk_cmd_queue_entry *cmd)
-{
-   VkDispatchGraphCountInfoAMDX *count_info = cmd->u.dispatch_graph_amdx.count_info;
-   void *infos = (void *)count_info->infos.hostAddress;
-
-   for (uint32_t i = 0; i < count_info->count; i++) {
-      VkDispatchGraphInfoAMDX *info = (void *)((const uint8_t *)infos + i * count_info->stride);
-      vk_free(queue->alloc, (void *)info->payloads.hostAddress);
-   }
-
-   vk_free(queue->alloc, infos);
-}
-
 VKAPI_ATTR void VKAPI_CALL
 vk_cmd_enqueue_CmdDispatchGraphAMDX(VkCommandBuffer commandBuffer, VkDeviceAddress scratch,
                                     const VkDispatchGraphCountInfoAMDX *pCountInfo)
@@ -320,22 +262,21 @@ vk_cmd_enqueue_CmdDispatchGraphAMDX(VkCommandBuffer commandBuffer, VkDeviceAddre
       return;
 
    VkResult result = VK_SUCCESS;
-   const VkAllocationCallbacks *alloc = cmd_buffer->cmd_queue.alloc;
+   struct vk_cmd_queue *queue = &cmd_buffer->cmd_queue;
 
    struct vk_cmd_queue_entry *cmd =
-      vk_zalloc(alloc, sizeof(struct vk_cmd_queue_entry), 8, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+      vk_cmd_queue_zalloc(queue, sizeof(struct vk_cmd_queue_entry));
    if (!cmd) {
       result = VK_ERROR_OUT_OF_HOST_MEMORY;
       goto err;
    }
 
    cmd->type = VK_CMD_DISPATCH_GRAPH_AMDX;
-   cmd->driver_free_cb = dispatch_graph_amdx_free;
 
    cmd->u.dispatch_graph_amdx.scratch = scratch;
 
    cmd->u.dispatch_graph_amdx.count_info =
-      vk_zalloc(alloc, sizeof(VkDispatchGraphCountInfoAMDX), 8, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+      vk_cmd_queue_zalloc(queue, sizeof(VkDispatchGraphCountInfoAMDX));
    if (cmd->u.dispatch_graph_amdx.count_info == NULL)
       goto err;
 
@@ -343,7 +284,10 @@ vk_cmd_enqueue_CmdDispatchGraphAMDX(VkCommandBuffer commandBuffer, VkDeviceAddre
           sizeof(VkDispatchGraphCountInfoAMDX));
 
    uint32_t infos_size = pCountInfo->count * pCountInfo->stride;
-   void *infos = vk_zalloc(alloc, infos_size, 8, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+   void *infos = vk_cmd_queue_zalloc(queue, infos_size);
+   if (infos == NULL)
+      goto err;
+
    cmd->u.dispatch_graph_amdx.count_info->infos.hostAddress = infos;
    memcpy(infos, pCountInfo->infos.hostAddress, infos_size);
 
@@ -351,18 +295,18 @@ vk_cmd_enqueue_CmdDispatchGraphAMDX(VkCommandBuffer commandBuffer, VkDeviceAddre
       VkDispatchGraphInfoAMDX *info = (void *)((const uint8_t *)infos + i * pCountInfo->stride);
 
       uint32_t payloads_size = info->payloadCount * info->payloadStride;
-      void *dst_payload = vk_zalloc(alloc, payloads_size, 8, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+      void *dst_payload = vk_cmd_queue_zalloc(queue, payloads_size);
+      if (dst_payload == NULL)
+         goto err;
+
       memcpy(dst_payload, info->payloads.hostAddress, payloads_size);
       info->payloads.hostAddress = dst_payload;
    }
 
-   list_addtail(&cmd->cmd_link, &cmd_buffer->cmd_queue.cmds);
+   list_addtail(&cmd->cmd_link, &queue->cmds);
    goto finish;
 err:
-   if (cmd) {
-      vk_free(alloc, cmd);
-      dispatch_graph_amdx_free(&cmd_buffer->cmd_queue, cmd);
-   }
+   result = VK_ERROR_OUT_OF_HOST_MEMORY;
 
 finish:
    if (unlikely(result != VK_SUCCESS))
@@ -370,19 +314,6 @@ finish:
 }
 #endif
 
-static void
-vk_cmd_build_acceleration_structures_khr_free(struct vk_cmd_queue *queue,
-                                              struct vk_cmd_queue_entry *cmd)
-{
-   struct vk_cmd_build_acceleration_structures_khr *build =
-      &cmd->u.build_acceleration_structures_khr;
-   
-   for (uint32_t i = 0; i < build->info_count; i++) {
-      vk_free(queue->alloc, (void *)build->infos[i].pGeometries);
-      vk_free(queue->alloc, (void *)build->pp_build_range_infos[i]);
-   }
-}
-
 VKAPI_ATTR void VKAPI_CALL
 vk_cmd_enqueue_CmdBuildAccelerationStructuresKHR(
    VkCommandBuffer commandBuffer, uint32_t infoCount,
@@ -397,21 +328,18 @@ vk_cmd_enqueue_CmdBuildAccelerationStructuresKHR(
    struct vk_cmd_queue *queue = &cmd_buffer->cmd_queue;
 
    struct vk_cmd_queue_entry *cmd =
-      vk_zalloc(queue->alloc, vk_cmd_queue_type_sizes[VK_CMD_BUILD_ACCELERATION_STRUCTURES_KHR], 8,
-                VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+      vk_cmd_queue_zalloc(queue, vk_cmd_queue_type_sizes[VK_CMD_BUILD_ACCELERATION_STRUCTURES_KHR]);
    if (!cmd)
       goto err;
 
    cmd->type = VK_CMD_BUILD_ACCELERATION_STRUCTURES_KHR;
-   cmd->driver_free_cb = vk_cmd_build_acceleration_structures_khr_free;
 
    struct vk_cmd_build_acceleration_structures_khr *build =
       &cmd->u.build_acceleration_structures_khr;
 
    build->info_count = infoCount;
    if (pInfos) {
-      build->infos = vk_zalloc(queue->alloc, sizeof(*build->infos) * infoCount, 8,
-                               VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+      build->infos = vk_cmd_queue_zalloc(queue, sizeof(*build->infos) * infoCount);
       if (!build->infos)
          goto err;
 
@@ -422,7 +350,7 @@ vk_cmd_enqueue_CmdBuildAccelerationStructuresKHR(
          uint32_t geometries_size =
             build->infos[i].geometryCount * sizeof(VkAccelerationStructureGeometryKHR);
          VkAccelerationStructureGeometryKHR *geometries =
-            vk_zalloc(queue->alloc, geometries_size, 8, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+            vk_cmd_queue_zalloc(queue, geometries_size);
          if (!geometries)
             goto err;
 
@@ -438,8 +366,7 @@ vk_cmd_enqueue_CmdBuildAccelerationStructuresKHR(
    }
    if (ppBuildRangeInfos) {
       build->pp_build_range_infos =
-         vk_zalloc(queue->alloc, sizeof(*build->pp_build_range_infos) * infoCount, 8,
-                   VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+         vk_cmd_queue_zalloc(queue, sizeof(*build->pp_build_range_infos) * infoCount);
       if (!build->pp_build_range_infos)
          goto err;
 
@@ -450,7 +377,7 @@ vk_cmd_enqueue_CmdBuildAccelerationStructuresKHR(
          uint32_t build_range_size =
             build->infos[i].geometryCount * sizeof(VkAccelerationStructureBuildRangeInfoKHR);
          VkAccelerationStructureBuildRangeInfoKHR *p_build_range_infos =
-            vk_zalloc(queue->alloc, build_range_size, 8, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+            vk_cmd_queue_zalloc(queue, build_range_size);
          if (!p_build_range_infos)
             goto err;
 
@@ -464,8 +391,5 @@ vk_cmd_enqueue_CmdBuildAccelerationStructuresKHR(
    return;
 
 err:
-   if (cmd)
-      vk_cmd_build_acceleration_structures_khr_free(queue, cmd);
-
    vk_command_buffer_set_error(cmd_buffer, VK_ERROR_OUT_OF_HOST_MEMORY);
 }
@@ -113,6 +113,7 @@ vk_command_buffer_recycle(struct vk_command_buffer *cmd_buffer)
     */
    cmd_buffer->ops->reset(cmd_buffer,
       VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT);
+   vk_cmd_queue_release_chunks(&cmd_buffer->cmd_queue);
 
    vk_object_base_recycle(&cmd_buffer->base);
 }
@@ -126,6 +127,12 @@ vk_common_ResetCommandBuffer(VkCommandBuffer commandBuffer,
    if (cmd_buffer->state != MESA_VK_COMMAND_BUFFER_STATE_INITIAL)
       cmd_buffer->ops->reset(cmd_buffer, flags);
 
+   /* An initial command buffer may still hold chunks from before its last
+    * reset, so release them even if it wasn't reset now.
+    */
+   if (flags & VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT)
+      vk_cmd_queue_release_chunks(&cmd_buffer->cmd_queue);
+
    return VK_SUCCESS;
 }
 
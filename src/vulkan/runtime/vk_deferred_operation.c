@@ -35,13 +35,14 @@ vk_common_CreateDeferredOperationKHR(VkDevice _device,
    VK_FROM_HANDLE(vk_device, device, _device);
 
    struct vk_deferred_operation *op =
-      vk_alloc2(&device->alloc, pAllocator, sizeof(*op), 8,
-                       VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+      vk_zalloc2(&device->alloc, pAllocator, sizeof(*op), 8,
+                 VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
    if (op == NULL)
       return VK_ERROR_OUT_OF_HOST_MEMORY;
 
    vk_object_base_init(device, &op->base,
                        VK_OBJECT_TYPE_DEFERRED_OPERATION_KHR);
+   mtx_init(&op->mutex, mtx_plain);
 
    *pDeferredOperation = vk_deferred_operation_to_handle(op);
 
@@ -59,27 +60,90 @@ vk_common_DestroyDeferredOperationKHR(VkDevice _device,
    if (op == NULL)
       return;
 
+   mtx_destroy(&op->mutex);
    vk_object_base_finish(&op->base);
    vk_free2(&device->alloc, pAllocator, op);
 }
 
+VkResult
+vk_deferred_operation_defer(struct vk_deferred_operation *op,
+                            uint32_t item_count,
+                            VkResult (*execute)(void *data, uint32_t item),
+                            void (*finish)(void *data),
+                            void *data)
+{
+   if (item_count == 0) {
+      if (finish)
+         finish(data);
+      return VK_OPERATION_NOT_DEFERRED_KHR;
+   }
+
+   mtx_lock(&op->mutex);
+   op->execute = execute;
+   op->finish = finish;
+   op->data = data;
+   op->item_count = item_count;
+   op->next_item = 0;
+   op->done_count = 0;
+   op->result = VK_SUCCESS;
+   mtx_unlock(&op->mutex);
+
+   return VK_OPERATION_DEFERRED_KHR;
+}
+
 VKAPI_ATTR uint32_t VKAPI_CALL
 vk_common_GetDeferredOperationMaxConcurrencyKHR(UNUSED VkDevice device,
-                                                UNUSED VkDeferredOperationKHR operation)
+                                                VkDeferredOperationKHR operation)
 {
-   return 1;
+   VK_FROM_HANDLE(vk_deferred_operation, op, operation);
+
+   mtx_lock(&op->mutex);
+   /* Operations without deferred work report a single thread. */
+   uint32_t concurrency = op->item_count ? op->item_count - op->next_item : 1;
+   mtx_unlock(&op->mutex);
+
+   return concurrency;
 }
 
 VKAPI_ATTR VkResult VKAPI_CALL
 vk_common_GetDeferredOperationResultKHR(UNUSED VkDevice device,
-                                        UNUSED VkDeferredOperationKHR operation)
+                                        VkDeferredOperationKHR operation)
 {
-   return VK_SUCCESS;
+   VK_FROM_HANDLE(vk_deferred_operation, op, operation);
+
+   mtx_lock(&op->mutex);
+   VkResult result = op->done_count < op->item_count ? VK_NOT_READY : op->result;
+   mtx_unlock(&op->mutex);
+
+   return result;
 }
 
 VKAPI_ATTR VkResult VKAPI_CALL
 vk_common_DeferredOperationJoinKHR(UNUSED VkDevice device,
-                                   UNUSED VkDeferredOperationKHR operation)
+                                   VkDeferredOperationKHR operation)
 {
-   return VK_SUCCESS;
+   VK_FROM_HANDLE(vk_deferred_operation, op, operation);
+
+   mtx_lock(&op->mutex);
+
+   while (op->next_item < op->item_count) {
+      uint32_t item = op->next_item++;
+      mtx_unlock(&op->mutex);
+
+      VkResult result = op->execute(op->data, item);
+
+      mtx_lock(&op->mutex);
+      if (result != VK_SUCCESS && op->result == VK_SUCCESS)
+         op->result = result;
+
+      if (++op->done_count == op->item_count && op->finish)
+         op->finish(op->data);
+   }
+
+   /* Other threads may still be executing the last items. */
+   VkResult result = op->done_count < op->item_count ? VK_THREAD_DONE_KHR : VK_SUCCESS;
+
+   mtx_unlock(&op->mutex);
+
+   return result;
 }
@@ -34,12 +34,45 @@ extern "C" {
 
 struct vk_deferred_operation {
    struct vk_object_base base;
+
+   mtx_t mutex;
+
+   /* Work deferred by the last command, see vk_deferred_operation_defer() */
+   VkResult (*execute)(void *data, uint32_t item);
+   void (*finish)(void *data);
+   void *data;
+
+   uint32_t item_count;
+
+   /* Number of items handed out to joining threads */
+   uint32_t next_item;
+
+   /* Number of items that completed */
+   uint32_t done_count;
+
+   /* First error returned by execute() */
+   VkResult result;
 };
 
 VK_DEFINE_NONDISP_HANDLE_CASTS(vk_deferred_operation, base,
                                VkDeferredOperationKHR,
                                VK_OBJECT_TYPE_DEFERRED_OPERATION_KHR)
 
+/** Defers item_count independent work items to the threads joining op
+ *
+ * Joining threads call execute() for one item at a time, so different items
+ * may run concurrently.  finish(), if not NULL, is called once after the
+ * last item completed and may free data.
+ *
+ * Returns the result the deferred command should return.
+ */
+VkResult
+vk_deferred_operation_defer(struct vk_deferred_operation *op,
+                            uint32_t item_count,
+                            VkResult (*execute)(void *data, uint32_t item),
+                            void (*finish)(void *data),
+                            void *data);
+
 #ifdef __cplusplus
 }
 #endif
@@ -134,35 +134,52 @@ object_key_hash(const void *void_object)
    return _mesa_hash_data(object->key_data, object->key_size);
 }
 
-static void
-vk_pipeline_cache_lock(struct vk_pipeline_cache *cache)
+static inline bool
+vk_pipeline_cache_has_object_cache(const struct vk_pipeline_cache *cache)
 {
+   return cache->shards[0].object_cache != NULL;
+}
+
+static inline struct vk_pipeline_cache_shard *
+vk_pipeline_cache_get_shard(struct vk_pipeline_cache *cache, uint32_t hash)
+{
+   /* The sets index by the low bits of the hash, so pick the shard with the
+    * high ones to keep each shard's table evenly populated.
+    */
+   return &cache->shards[(hash >> 16) % VK_PIPELINE_CACHE_SHARD_COUNT];
+}
 
+static void
+vk_pipeline_cache_lock(struct vk_pipeline_cache *cache,
+                       struct vk_pipeline_cache_shard *shard)
+{
    if (!(cache->flags & VK_PIPELINE_CACHE_CREATE_EXTERNALLY_SYNCHRONIZED_BIT))
-      simple_mtx_lock(&cache->lock);
+      simple_mtx_lock(&shard->lock);
 }
 
 static void
-vk_pipeline_cache_unlock(struct vk_pipeline_cache *cache)
+vk_pipeline_cache_unlock(struct vk_pipeline_cache *cache,
+                         struct vk_pipeline_cache_shard *shard)
 {
    if (!(cache->flags & VK_PIPELINE_CACHE_CREATE_EXTERNALLY_SYNCHRONIZED_BIT))
-      simple_mtx_unlock(&cache->lock);
+      simple_mtx_unlock(&shard->lock);
 }
 
-/* cache->lock must be held when calling */
+/* shard->lock must be held when calling */
 static void
 vk_pipeline_cache_remove_object(struct vk_pipeline_cache *cache,
+                                struct vk_pipeline_cache_shard *shard,
                                 uint32_t hash,
                                 struct vk_pipeline_cache_object *object)
 {
    struct set_entry *entry =
-      _mesa_set_search_pre_hashed(cache->object_cache, hash, object);
+      _mesa_set_search_pre_hashed(shard->object_cache, hash, object);
    if (entry && entry->key == (const void *)object) {
       /* Drop the reference owned by the cache */
       if (!cache->weak_ref)
          vk_pipeline_cache_object_unref(cache->base.device, object);
 
-      _mesa_set_remove(cache->object_cache, entry);
+      _mesa_set_remove(shard->object_cache, entry);
    }
 }
 
@@ -185,13 +202,15 @@ vk_pipeline_cache_object_unref(struct vk_device *device, struct vk_pipeline_cach
       if (p_atomic_dec_zero(&object->ref_cnt))
          object->ops->destroy(device, object);
    } else {
-      vk_pipeline_cache_lock(weak_owner);
+      uint32_t hash = object_key_hash(object);
+      struct vk_pipeline_cache_shard *shard =
+         vk_pipeline_cache_get_shard(weak_owner, hash);
+
+      vk_pipeline_cache_lock(weak_owner, shard);
       bool destroy = p_atomic_dec_zero(&object->ref_cnt);
-      if (destroy) {
-         uint32_t hash = object_key_hash(object);
-         vk_pipeline_cache_remove_object(weak_owner, hash, object);
-      }
-      vk_pipeline_cache_unlock(weak_owner);
+      if (destroy)
+         vk_pipeline_cache_remove_object(weak_owner, shard, hash, object);
+      vk_pipeline_cache_unlock(weak_owner, shard);
       if (destroy)
          object->ops->destroy(device, object);
    }
@@ -284,15 +303,17 @@ vk_pipeline_cache_insert_object(struct vk_pipeline_cache *cache,
 {
    assert(object->ops != NULL);
 
-   if (cache->object_cache == NULL)
+   if (!vk_pipeline_cache_has_object_cache(cache))
       return object;
 
    uint32_t hash = object_key_hash(object);
+   struct vk_pipeline_cache_shard *shard =
+      vk_pipeline_cache_get_shard(cache, hash);
 
-   vk_pipeline_cache_lock(cache);
+   vk_pipeline_cache_lock(cache, shard);
    bool found = false;
    struct set_entry *entry = _mesa_set_search_or_add_pre_hashed(
-       cache->object_cache, hash, object, &found);
+       shard->object_cache, hash, object, &found);
 
    struct vk_pipeline_cache_object *result = NULL;
    /* add reference to either the found or inserted object */
@@ -315,7 +336,7 @@ vk_pipeline_cache_insert_object(struct vk_pipeline_cache *cache,
       else
          vk_pipeline_cache_object_weak_ref(cache, result);
    }
-   vk_pipeline_cache_unlock(cache);
+   vk_pipeline_cache_unlock(cache, shard);
 
    if (found) {
       vk_pipeline_cache_object_unref(cache->base.device, object);
@@ -343,21 +364,25 @@ vk_pipeline_cache_lookup_object(struct vk_pipeline_cache *cache,
 
    struct vk_pipeline_cache_object *object = NULL;
 
-   if (cache != NULL && cache->object_cache != NULL) {
-      vk_pipeline_cache_lock(cache);
+   if (cache != NULL && vk_pipeline_cache_has_object_cache(cache)) {
+      struct vk_pipeline_cache_shard *shard =
+         vk_pipeline_cache_get_shard(cache, hash);
+
+      vk_pipeline_cache_lock(cache, shard);
       struct set_entry *entry =
-         _mesa_set_search_pre_hashed(cache->object_cache, hash, &key);
+         _mesa_set_search_pre_hashed(shard->object_cache, hash, &key);
       if (entry) {
          object = vk_pipeline_cache_object_ref((void *)entry->key);
          if (cache_hit != NULL)
             *cache_hit = true;
       }
-      vk_pipeline_cache_unlock(cache);
+      vk_pipeline_cache_unlock(cache, shard);
    }
 
    if (object == NULL) {
       struct disk_cache *disk_cache = cache->base.device->physical->disk_cache;
-      if (!cache->skip_disk_cache && disk_cache && cache->object_cache) {
+      if (!cache->skip_disk_cache && disk_cache &&
+          vk_pipeline_cache_has_object_cache(cache)) {
          cache_key cache_key;
          disk_cache_compute_key(disk_cache, key_data, key_size, cache_key);
 
@@ -397,9 +422,12 @@ vk_pipeline_cache_lookup_object(struct vk_pipeline_cache *cache,
          vk_pipeline_cache_log(cache,
                                "Deserializing pipeline cache object failed");
 
-         vk_pipeline_cache_lock(cache);
-         vk_pipeline_cache_remove_object(cache, hash, object);
-         vk_pipeline_cache_unlock(cache);
+         struct vk_pipeline_cache_shard *shard =
+            vk_pipeline_cache_get_shard(cache, hash);
+
+         vk_pipeline_cache_lock(cache, shard);
+         vk_pipeline_cache_remove_object(cache, shard, hash, object);
+         vk_pipeline_cache_unlock(cache, shard);
          vk_pipeline_cache_object_unref(cache->base.device, object);
          return NULL;
       }
@@ -637,15 +665,23 @@ vk_pipeline_cache_create(struct vk_device *device,
    };
    memcpy(cache->header.uuid, pdevice_props.pipelineCacheUUID, VK_UUID_SIZE);
 
-   simple_mtx_init(&cache->lock, mtx_plain);
+   for (unsigned i = 0; i < VK_PIPELINE_CACHE_SHARD_COUNT; i++)
+      simple_mtx_init(&cache->shards[i].lock, mtx_plain);
 
    if (info->force_enable ||
        debug_get_bool_option("VK_ENABLE_PIPELINE_CACHE", true)) {
-      cache->object_cache = _mesa_set_create(NULL, object_key_hash,
-                                             object_keys_equal);
+      for (unsigned i = 0; i < VK_PIPELINE_CACHE_SHARD_COUNT; i++) {
+         cache->shards[i].object_cache =
+            _mesa_set_create(NULL, object_key_hash, object_keys_equal);
+         if (cache->shards[i].object_cache == NULL) {
+            vk_pipeline_cache_destroy(cache, pAllocator);
+            return NULL;
+         }
+      }
    }
 
-   if (cache->object_cache && pCreateInfo->initialDataSize > 0) {
+   if (vk_pipeline_cache_has_object_cache(cache) &&
+       pCreateInfo->initialDataSize > 0) {
       vk_pipeline_cache_load(cache, pCreateInfo->pInitialData,
                              pCreateInfo->initialDataSize);
    }
@@ -657,20 +693,43 @@ void
 vk_pipeline_cache_destroy(struct vk_pipeline_cache *cache,
                           const VkAllocationCallbacks *pAllocator)
 {
-   if (cache->object_cache) {
-      if (!cache->weak_ref) {
-         set_foreach(cache->object_cache, entry) {
-            vk_pipeline_cache_object_unref(cache->base.device, (void *)entry->key);
+   for (unsigned i = 0; i < VK_PIPELINE_CACHE_SHARD_COUNT; i++) {
+      struct vk_pipeline_cache_shard *shard = &cache->shards[i];
+
+      if (shard->object_cache) {
+         if (!cache->weak_ref) {
+            set_foreach(shard->object_cache, entry) {
+               vk_pipeline_cache_object_unref(cache->base.device, (void *)entry->key);
+            }
+         } else {
+            assert(shard->object_cache->entries == 0);
          }
-      } else {
-         assert(cache->object_cache->entries == 0);
+         _mesa_set_destroy(shard->object_cache, NULL);
       }
-      _mesa_set_destroy(cache->object_cache, NULL);
+      simple_mtx_destroy(&shard->lock);
    }
-   simple_mtx_destroy(&cache->lock);
    vk_object_free(cache->base.device, pAllocator, cache);
 }
 
+uint32_t
+vk_pipeline_cache_object_count(struct vk_pipeline_cache *cache)
+{
+   uint32_t count = 0;
+
+   if (!vk_pipeline_cache_has_object_cache(cache))
+      return 0;
+
+   for (unsigned i = 0; i < VK_PIPELINE_CACHE_SHARD_COUNT; i++) {
+      struct vk_pipeline_cache_shard *shard = &cache->shards[i];
+
+      vk_pipeline_cache_lock(cache, shard);
+      count += shard->object_cache->entries;
+      vk_pipeline_cache_unlock(cache, shard);
+   }
+
+   return count;
+}
+
 VKAPI_ATTR VkResult VKAPI_CALL
 vk_common_CreatePipelineCache(VkDevice _device,
                               const VkPipelineCacheCreateInfo *pCreateInfo,
@@ -732,11 +791,16 @@ vk_common_GetPipelineCacheData(VkDevice _device,
       return VK_INCOMPLETE;
    }
 
-   vk_pipeline_cache_lock(cache);
-
    VkResult result = VK_SUCCESS;
-   if (cache->object_cache != NULL) {
-      set_foreach(cache->object_cache, entry) {
+   for (unsigned i = 0; i < VK_PIPELINE_CACHE_SHARD_COUNT; i++) {
+      struct vk_pipeline_cache_shard *shard = &cache->shards[i];
+
+      if (shard->object_cache == NULL || result != VK_SUCCESS)
+         break;
+
+      vk_pipeline_cache_lock(cache, shard);
+
+      set_foreach(shard->object_cache, entry) {
          struct vk_pipeline_cache_object *object = (void *)entry->key;
 
          if (object->ops->serialize == NULL)
@@ -776,9 +840,9 @@ vk_common_GetPipelineCacheData(VkDevice _device,
 
          count++;
       }
-   }
 
-   vk_pipeline_cache_unlock(cache);
+      vk_pipeline_cache_unlock(cache, shard);
+   }
 
    blob_overwrite_uint32(&blob, count_offset, count);
 
@@ -800,53 +864,59 @@ vk_common_MergePipelineCaches(VkDevice _device,
    assert(dst->base.device == device);
    assert(!dst->weak_ref);
 
-   if (!dst->object_cache)
+   if (!vk_pipeline_cache_has_object_cache(dst))
       return VK_SUCCESS;
 
-   vk_pipeline_cache_lock(dst);
-
    for (uint32_t i = 0; i < srcCacheCount; i++) {
       VK_FROM_HANDLE(vk_pipeline_cache, src, pSrcCaches[i]);
       assert(src->base.device == device);
 
-      if (!src->object_cache)
+      if (!vk_pipeline_cache_has_object_cache(src))
          continue;
 
       assert(src != dst);
       if (src == dst)
          continue;
 
-      vk_pipeline_cache_lock(src);
-
-      set_foreach(src->object_cache, src_entry) {
-         struct vk_pipeline_cache_object *src_object = (void *)src_entry->key;
-
-         bool found_in_dst = false;
-         struct set_entry *dst_entry =
-            _mesa_set_search_or_add_pre_hashed(dst->object_cache,
-                                               src_entry->hash,
-                                               src_object, &found_in_dst);
-         if (found_in_dst) {
-            struct vk_pipeline_cache_object *dst_object = (void *)dst_entry->key;
-            if (dst_object->ops == &vk_raw_data_cache_object_ops &&
-                src_object->ops != &vk_raw_data_cache_object_ops) {
-               /* Even though dst has the object, it only has the blob version
-                * which isn't as useful.  Replace it with the real object.
-                */
-               vk_pipeline_cache_object_unref(device, dst_object);
-               dst_entry->key = vk_pipeline_cache_object_ref(src_object);
+      /* Both caches shard by the same hash so every object in a src shard
+       * belongs in the dst shard with the same index.
+       */
+      for (unsigned s = 0; s < VK_PIPELINE_CACHE_SHARD_COUNT; s++) {
+         struct vk_pipeline_cache_shard *dst_shard = &dst->shards[s];
+         struct vk_pipeline_cache_shard *src_shard = &src->shards[s];
+
+         vk_pipeline_cache_lock(dst, dst_shard);
+         vk_pipeline_cache_lock(src, src_shard);
+
+         set_foreach(src_shard->object_cache, src_entry) {
+            struct vk_pipeline_cache_object *src_object = (void *)src_entry->key;
+
+            bool found_in_dst = false;
+            struct set_entry *dst_entry =
+               _mesa_set_search_or_add_pre_hashed(dst_shard->object_cache,
+                                                  src_entry->hash,
+                                                  src_object, &found_in_dst);
+            if (found_in_dst) {
+               struct vk_pipeline_cache_object *dst_object = (void *)dst_entry->key;
+               if (dst_object->ops == &vk_raw_data_cache_object_ops &&
+                   src_object->ops != &vk_raw_data_cache_object_ops) {
+                  /* Even though dst has the object, it only has the blob version
+                   * which isn't as useful.  Replace it with the real object.
+                   */
+                  vk_pipeline_cache_object_unref(device, dst_object);
+                  dst_entry->key = vk_pipeline_cache_object_ref(src_object);
+               }
+            } else {
+               /* We inserted src_object in dst so it needs a reference */
+               assert(dst_entry->key == (const void *)src_object);
+               vk_pipeline_cache_object_ref(src_object);
             }
-         } else {
-            /* We inserted src_object in dst so it needs a reference */
-            assert(dst_entry->key == (const void *)src_object);
-            vk_pipeline_cache_object_ref(src_object);
          }
-      }
 
-      vk_pipeline_cache_unlock(src);
+         vk_pipeline_cache_unlock(src, src_shard);
+         vk_pipeline_cache_unlock(dst, dst_shard);
+      }
    }
 
-   vk_pipeline_cache_unlock(dst);
-
    return VK_SUCCESS;
 }
@@ -147,6 +147,20 @@ void
 vk_pipeline_cache_object_unref(struct vk_device *device,
                                struct vk_pipeline_cache_object *object);
 
+/** Number of independently locked tables the object cache is split into
+ *
+ * Objects are assigned to a shard by key hash so that threads creating
+ * different pipelines in parallel rarely contend on the same lock.
+ */
+#define VK_PIPELINE_CACHE_SHARD_COUNT 16
+
+struct vk_pipeline_cache_shard {
+   /** Protects object_cache */
+   simple_mtx_t lock;
+
+   struct set *object_cache;
+};
+
 /** A generic implementation of VkPipelineCache */
 struct vk_pipeline_cache {
    struct vk_object_base base;
@@ -158,10 +172,8 @@ struct vk_pipeline_cache {
 
    struct vk_pipeline_cache_header header;
 
-   /** Protects object_cache */
-   simple_mtx_t lock;
-
-   struct set *object_cache;
+   /** Either all shards have an object_cache or none of them do */
+   struct vk_pipeline_cache_shard shards[VK_PIPELINE_CACHE_SHARD_COUNT];
 };
 
 VK_DEFINE_NONDISP_HANDLE_CASTS(vk_pipeline_cache, base, VkPipelineCache,
@@ -208,6 +220,10 @@ void
 vk_pipeline_cache_destroy(struct vk_pipeline_cache *cache,
                           const VkAllocationCallbacks *pAllocator);
 
+/** Returns the number of objects currently in the object cache */
+uint32_t
+vk_pipeline_cache_object_count(struct vk_pipeline_cache *cache);
+
 /** Attempts to look up an object in the cache by key
  *
  * If an object is found in the cache matching the given key, *cache_hit is
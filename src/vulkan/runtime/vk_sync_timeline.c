@@ -27,6 +27,7 @@
 
 #include "util/os_time.h"
 #include "util/timespec.h"
+#include "util/u_atomic.h"
 
 #include "vk_alloc.h"
 #include "vk_device.h"
@@ -69,11 +70,16 @@ vk_sync_timeline_init(struct vk_device *device,
    if (ret != thrd_success)
       return vk_errorf(device, VK_ERROR_UNKNOWN, "mtx_init failed");
 
+#if UTIL_FUTEX_SUPPORTED
+   timeline->pending_seq = 0;
+   timeline->pending_waiters = 0;
+#else
    ret = cnd_init(&timeline->cond);
    if (ret != thrd_success) {
       mtx_destroy(&timeline->mutex);
       return vk_errorf(device, VK_ERROR_UNKNOWN, "cnd_init failed");
    }
+#endif
 
    timeline->highest_past =
       timeline->highest_pending = initial_value;
@@ -102,7 +108,9 @@ vk_sync_timeline_finish(struct vk_device *device,
       vk_free(&device->alloc, point);
    }
 
+#if !UTIL_FUTEX_SUPPORTED
    cnd_destroy(&timeline->cond);
+#endif
    mtx_destroy(&timeline->mutex);
 }
 
@@ -235,7 +243,7 @@ vk_sync_timeline_point_complete(struct vk_sync_timeline *timeline,
       return;
 
    assert(timeline->highest_past < point->value);
-   timeline->highest_past = point->value;
+   p_atomic_set(&timeline->highest_past, point->value);
 
    point->pending = false;
    list_del(&point->link);
@@ -289,6 +297,20 @@ vk_sync_timeline_gc_locked(struct vk_device *device,
    return VK_SUCCESS;
 }
 
+/* Wakes up everyone waiting for highest_pending to move */
+static int
+vk_sync_timeline_wake_locked(struct vk_sync_timeline *timeline)
+{
+#if UTIL_FUTEX_SUPPORTED
+   p_atomic_inc(&timeline->pending_seq);
+   if (timeline->pending_waiters > 0)
+      futex_wake(&timeline->pending_seq, INT32_MAX);
+   return thrd_success;
+#else
+   return cnd_broadcast(&timeline->cond);
+#endif
+}
+
 VkResult
 vk_sync_timeline_point_install(struct vk_device *device,
                                struct vk_sync_timeline_point *point)
@@ -298,13 +320,13 @@ vk_sync_timeline_point_install(struct vk_device *device,
    mtx_lock(&timeline->mutex);
 
    assert(point->value > timeline->highest_pending);
-   timeline->highest_pending = point->value;
+   p_atomic_set(&timeline->highest_pending, point->value);
 
    assert(point->refcount == 0);
    point->pending = true;
    list_addtail(&point->link, &timeline->pending_points);
 
-   int ret = cnd_broadcast(&timeline->cond);
+   int ret = vk_sync_timeline_wake_locked(timeline);
 
    mtx_unlock(&timeline->mutex);
 
@@ -344,6 +366,14 @@ vk_sync_timeline_get_point(struct vk_device *device,
                            uint64_t wait_value,
                            struct vk_sync_timeline_point **point_out)
 {
+   /* highest_past only ever increases so, if the value has already been
+    * reached, there's no need to take the lock.
+    */
+   if (p_atomic_read(&timeline->highest_past) >= wait_value) {
+      *point_out = NULL;
+      return VK_SUCCESS;
+   }
+
    mtx_lock(&timeline->mutex);
    VkResult result = vk_sync_timeline_get_point_locked(device, timeline,
                                                   wait_value, point_out);
@@ -379,9 +409,10 @@ vk_sync_timeline_signal_locked(struct vk_device *device,
 
    assert(list_is_empty(&timeline->pending_points));
    assert(timeline->highest_pending == timeline->highest_past);
-   timeline->highest_pending = timeline->highest_past = value;
+   p_atomic_set(&timeline->highest_past, value);
+   p_atomic_set(&timeline->highest_pending, value);
 
-   int ret = cnd_broadcast(&timeline->cond);
+   int ret = vk_sync_timeline_wake_locked(timeline);
    if (ret == thrd_error)
       return vk_errorf(device, VK_ERROR_UNKNOWN, "cnd_broadcast failed");
 
@@ -436,6 +467,28 @@ vk_sync_timeline_wait_locked(struct vk_device *device,
       if (now_ns >= abs_timeout_ns)
          return VK_TIMEOUT;
 
+#if UTIL_FUTEX_SUPPORTED
+      /* futex_wait() takes a CLOCK_MONOTONIC absolute timeout, so unlike the
+       * cnd_timedwait() path below no clock conversion is needed.  Sample
+       * the sequence number under the lock so that a wake between unlock
+       * and futex_wait() makes the wait return immediately.
+       */
+      uint32_t seq = timeline->pending_seq;
+      timeline->pending_waiters++;
+      mtx_unlock(&timeline->mutex);
+
+      if (abs_timeout_ns >= INT64_MAX) {
+         futex_wait(&timeline->pending_seq, seq, NULL);
+      } else {
+         struct timespec abs_timeout_ts;
+         abs_timeout_ts.tv_sec = abs_timeout_ns / 1000000000;
+         abs_timeout_ts.tv_nsec = abs_timeout_ns % 1000000000;
+         futex_wait(&timeline->pending_seq, seq, &abs_timeout_ts);
+      }
+
+      mtx_lock(&timeline->mutex);
+      timeline->pending_waiters--;
+#else
       int ret;
       if (abs_timeout_ns >= INT64_MAX) {
          /* Common infinite wait case */
@@ -460,6 +513,7 @@ vk_sync_timeline_wait_locked(struct vk_device *device,
       }
       if (ret == thrd_error)
          return vk_errorf(device, VK_ERROR_UNKNOWN, "cnd_timedwait failed");
+#endif
 
       /* We don't trust the timeout condition on cnd_timedwait() because of
        * the potential clock issues caused by using CLOCK_REALTIME.  Instead,
@@ -509,6 +563,16 @@ vk_sync_timeline_wait(struct vk_device *device,
 {
    struct vk_sync_timeline *timeline = to_vk_sync_timeline(sync);
 
+   /* Time points are only ever installed and completed in increasing order
+    * so, if the value has already been reached, there's no need to take the
+    * lock.
+    */
+   if (p_atomic_read(&timeline->highest_past) >= wait_value)
+      return VK_SUCCESS;
+   if ((wait_flags & VK_SYNC_WAIT_PENDING) &&
+       p_atomic_read(&timeline->highest_pending) >= wait_value)
+      return VK_SUCCESS;
+
    mtx_lock(&timeline->mutex);
    VkResult result = vk_sync_timeline_wait_locked(device, timeline,
                                              wait_value, wait_flags,
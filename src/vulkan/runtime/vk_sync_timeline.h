@@ -24,6 +24,7 @@
 #define VK_SYNC_TIMELINE_H
 
 #include "c11/threads.h"
+#include "util/futex.h"
 #include "util/list.h"
 #include "util/macros.h"
 
@@ -79,8 +80,20 @@ struct vk_sync_timeline {
    struct vk_sync sync;
 
    mtx_t mutex;
+#if UTIL_FUTEX_SUPPORTED
+   /* Bumped every time highest_pending moves.  Threads waiting for a time
+    * point to be submitted sleep on it, and it's only woken when there
+    * actually are such threads.
+    */
+   uint32_t pending_seq;
+   uint32_t pending_waiters;
+#else
    cnd_t cond;
+#endif
 
+   /* Only ever increase and are written under the mutex, but may be read
+    * without it to return early for time points that are already there.
+    */
    uint64_t highest_past;
    uint64_t highest_pending;
 
@@ -85,9 +85,19 @@ extern "C" {
 
 struct vk_device_dispatch_table;
 
+struct vk_cmd_queue_chunk;
+
 struct vk_cmd_queue {
    const VkAllocationCallbacks *alloc;
    struct list_head cmds;
+
+   /* Commands and everything they point to are carved linearly out of a
+    * list of chunks.  Nothing is freed individually; resetting the queue
+    * rewinds to the first chunk so they get reused by the next recording,
+    * until vk_cmd_queue_release_chunks() or vk_cmd_queue_finish().
+    */
+   struct list_head chunks;
+   struct vk_cmd_queue_chunk *chunk;
 };
 
 enum vk_cmd_type {
@@ -174,6 +184,11 @@ struct vk_cmd_queue_entry {
 
 % endfor
 
+/* Returns zeroed, 8-byte aligned memory that lives until the queue is
+ * reset or finished.
+ */
+void *vk_cmd_queue_zalloc(struct vk_cmd_queue *queue, size_t size);
+
 void vk_free_queue(struct vk_cmd_queue *queue);
 
 static inline void
@@ -181,6 +196,8 @@ vk_cmd_queue_init(struct vk_cmd_queue *queue, VkAllocationCallbacks *alloc)
 {
    queue->alloc = alloc;
    list_inithead(&queue->cmds);
+   list_inithead(&queue->chunks);
+   queue->chunk = NULL;
 }
 
 static inline void
@@ -190,12 +207,10 @@ vk_cmd_queue_reset(struct vk_cmd_queue *queue)
    list_inithead(&queue->cmds);
 }
 
-static inline void
-vk_cmd_queue_finish(struct vk_cmd_queue *queue)
-{
-   vk_free_queue(queue);
-   list_inithead(&queue->cmds);
-}
+/* Frees the chunks kept for reuse by an empty (reset) queue. */
+void vk_cmd_queue_release_chunks(struct vk_cmd_queue *queue);
+
+void vk_cmd_queue_finish(struct vk_cmd_queue *queue);
 
 void vk_cmd_queue_execute(struct vk_cmd_queue *queue,
                           VkCommandBuffer commandBuffer,
@@ -254,25 +269,6 @@ size_t vk_cmd_queue_type_sizes[] = {
 % if c.guard is not None:
 #ifdef ${c.guard}
 % endif
-static void
-vk_free_${to_underscore(c.name)}(struct vk_cmd_queue *queue,
-${' ' * len('vk_free_' + to_underscore(c.name) + '(')}\\
-struct vk_cmd_queue_entry *cmd)
-{
-   if (cmd->driver_free_cb)
-      cmd->driver_free_cb(queue, cmd);
-   else
-      vk_free(queue->alloc, cmd->driver_data);
-% for p in c.params[1:]:
-% if p.len:
-   vk_free(queue->alloc, (${remove_suffix(p.decl.replace("const", ""), p.name)})cmd->u.${to_struct_field_name(c.name)}.${to_field_name(p.name)});
-% elif '*' in p.decl:
-   ${get_struct_free(c, p, types)}
-% endif
-% endfor
-   vk_free(queue->alloc, cmd);
-}
-
 % if c.name not in manual_commands and c.name not in no_enqueue_commands:
 VkResult vk_enqueue_${to_underscore(c.name)}(struct vk_cmd_queue *queue
 % for p in c.params[1:]:
@@ -280,8 +276,8 @@ VkResult vk_enqueue_${to_underscore(c.name)}(struct vk_cmd_queue *queue
 % endfor
 )
 {
-   struct vk_cmd_queue_entry *cmd = vk_zalloc(queue->alloc, vk_cmd_queue_type_sizes[${to_enum_name(c.name)}], 8,
-                                              VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+   struct vk_cmd_queue_entry *cmd =
+      vk_cmd_queue_zalloc(queue, vk_cmd_queue_type_sizes[${to_enum_name(c.name)}]);
    if (!cmd) return VK_ERROR_OUT_OF_HOST_MEMORY;
 
    cmd->type = ${to_enum_name(c.name)};
@@ -311,8 +307,6 @@ VkResult vk_enqueue_${to_underscore(c.name)}(struct vk_cmd_queue *queue
 
 % if need_error_handling:
 err:
-   if (cmd)
-      vk_free_${to_underscore(c.name)}(queue, cmd);
    return VK_ERROR_OUT_OF_HOST_MEMORY;
 % endif
 }
@@ -323,25 +317,97 @@ err:
 
 % endfor
 
+#define VK_CMD_QUEUE_CHUNK_SIZE (16 * 1024)
+
+struct vk_cmd_queue_chunk {
+   struct list_head link;
+   size_t size;
+   size_t used;
+   uint64_t data[];
+};
+
+static struct vk_cmd_queue_chunk *
+vk_cmd_queue_add_chunk(struct vk_cmd_queue *queue, size_t size)
+{
+   /* Walk the chunks kept from previous recordings before growing. */
+   list_for_each_entry_from(struct vk_cmd_queue_chunk, chunk,
+                            queue->chunk ? queue->chunk->link.next :
+                                           queue->chunks.next,
+                            &queue->chunks, link) {
+      if (chunk->size >= size)
+         return chunk;
+   }
+
+   size = MAX2(size, VK_CMD_QUEUE_CHUNK_SIZE);
+   struct vk_cmd_queue_chunk *chunk =
+      vk_alloc(queue->alloc, sizeof(*chunk) + size, 8,
+               VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+   if (!chunk)
+      return NULL;
+
+   chunk->size = size;
+   chunk->used = 0;
+
+   /* Keep the new chunk right after the current one so that the recycled
+    * chunks behind it are still walked in order.
+    */
+   list_add(&chunk->link, queue->chunk ? &queue->chunk->link : &queue->chunks);
+   return chunk;
+}
+
+void *
+vk_cmd_queue_zalloc(struct vk_cmd_queue *queue, size_t size)
+{
+   struct vk_cmd_queue_chunk *chunk = queue->chunk;
+
+   size = ALIGN_POT(size, 8);
+   if (unlikely(!chunk || chunk->size - chunk->used < size)) {
+      chunk = vk_cmd_queue_add_chunk(queue, size);
+      if (!chunk)
+         return NULL;
+      queue->chunk = chunk;
+   }
+
+   void *ptr = (uint8_t *)chunk->data + chunk->used;
+   chunk->used += size;
+   memset(ptr, 0, size);
+   return ptr;
+}
+
 void
 vk_free_queue(struct vk_cmd_queue *queue)
 {
-   struct vk_cmd_queue_entry *tmp, *cmd;
-   LIST_FOR_EACH_ENTRY_SAFE(cmd, tmp, &queue->cmds, cmd_link) {
-      switch(cmd->type) {
-% for c in commands:
-% if c.guard is not None:
-#ifdef ${c.guard}
-% endif
-      case ${to_enum_name(c.name)}:
-         vk_free_${to_underscore(c.name)}(queue, cmd);
-         break;
-% if c.guard is not None:
-#endif // ${c.guard}
-% endif
-% endfor
-      }
+   /* Command memory belongs to the chunks, only driver data needs freeing. */
+   list_for_each_entry(struct vk_cmd_queue_entry, cmd, &queue->cmds, cmd_link) {
+      if (cmd->driver_free_cb)
+         cmd->driver_free_cb(queue, cmd);
+      else
+         vk_free(queue->alloc, cmd->driver_data);
    }
+
+   list_for_each_entry(struct vk_cmd_queue_chunk, chunk, &queue->chunks, link)
+      chunk->used = 0;
+   queue->chunk = NULL;
+}
+
+void
+vk_cmd_queue_release_chunks(struct vk_cmd_queue *queue)
+{
+   assert(list_is_empty(&queue->cmds));
+
+   list_for_each_entry_safe(struct vk_cmd_queue_chunk, chunk, &queue->chunks, link)
+      vk_free(queue->alloc, chunk);
+   list_inithead(&queue->chunks);
+   queue->chunk = NULL;
+}
+
+void
+vk_cmd_queue_finish(struct vk_cmd_queue *queue)
+{
+   vk_free_queue(queue);
+   list_inithead(&queue->cmds);
+
+   vk_cmd_queue_release_chunks(queue);
 }
 
 void
@@ -465,7 +531,7 @@ def get_array_copy(command, param):
         field_size = "1"
     else:
         field_size = "sizeof(*%s)" % field_name
-    allocation = "%s = vk_zalloc(queue->alloc, %s * (%s), 8, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);\n   if (%s == NULL) goto err;\n" % (field_name, field_size, param.len, field_name)
+    allocation = "%s = vk_cmd_queue_zalloc(queue, %s * (%s));\n   if (%s == NULL) goto err;\n" % (field_name, field_size, param.len, field_name)
     copy = "memcpy((void*)%s, %s, %s * (%s));" % (field_name, param.name, field_size, param.len)
     return "%s\n   %s" % (allocation, copy)
 
@@ -475,7 +541,7 @@ def get_array_member_copy(struct, src_name, member):
         field_size = "sizeof(*%s)" % (field_name)
     else:
         field_size = "sizeof(*%s) * %s->%s" % (field_name, struct, member.len)
-    allocation = "%s = vk_zalloc(queue->alloc, %s, 8, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);\n   if (%s == NULL) goto err;\n" % (field_name, field_size, field_name)
+    allocation = "%s = vk_cmd_queue_zalloc(queue, %s);\n   if (%s == NULL) goto err;\n" % (field_name, field_size, field_name)
     copy = "memcpy((void*)%s, %s->%s, %s);" % (field_name, src_name, member.name, field_size)
     return "if (%s->%s) {\n   %s\n   %s\n}\n" % (src_name, member.name, allocation, copy)
 
@@ -511,7 +577,7 @@ def get_struct_copy(dst, src_name, src_type, size, types, level=0):
     global tmp_dst_idx
     global tmp_src_idx
 
-    allocation = "%s = vk_zalloc(queue->alloc, %s, 8, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);\n      if (%s == NULL) goto err;\n" % (dst, size, dst)
+    allocation = "%s = vk_cmd_queue_zalloc(queue, %s);\n      if (%s == NULL) goto err;\n" % (dst, size, dst)
     copy = "memcpy((void*)%s, %s, %s);" % (dst, src_name, size)
 
     level += 1
@@ -531,19 +597,6 @@ def get_struct_copy(dst, src_name, src_type, size, types, level=0):
     indent = "   " * level
     return "%s\n      %s\n      %s\n      %s\n      %s\n      %s\n%s} else {\n      %s\n%s}" % (if_stmt, allocation, copy, tmp_dst, tmp_src, member_copies, indent, null_assignment, indent)
 
-def get_struct_free(command, param, types):
-    field_name = "cmd->u.%s.%s" % (to_struct_field_name(command.name), to_field_name(param.name))
-    const_cast = remove_suffix(param.decl.replace("const", ""), param.name)
-    struct_free = "vk_free(queue->alloc, (%s)%s);" % (const_cast, field_name)
-    member_frees = ""
-    if (param.type in types):
-        for member in types[param.type].members:
-            if member.len and member.len != 'null-terminated':
-                member_name = "cmd->u.%s.%s->%s" % (to_struct_field_name(command.name), to_field_name(param.name), member.name)
-                const_cast = remove_suffix(member.decl.replace("const", ""), member.name)
-                member_frees += "vk_free(queue->alloc, (%s)%s);\n" % (const_cast, member_name)
-    return "%s      %s\n" % (member_frees, struct_free)
-
 EntrypointType = namedtuple('EntrypointType', 'name enum members extended_by guard')
 
 def get_types_defines(doc):
@@ -661,7 +714,6 @@ def main():
         'to_struct_name': to_struct_name,
         'get_array_copy': get_array_copy,
         'get_struct_copy': get_struct_copy,
-        'get_struct_free': get_struct_free,
         'types': types,
         'manual_commands': MANUAL_COMMANDS,
         'no_enqueue_commands': NO_ENQUEUE_COMMANDS,
@@ -23,9 +23,20 @@
 
 /** VK_EXT_headless_surface */
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "util/anon_file.h"
+#include "util/futex.h"
+#include "util/log.h"
 #include "util/macros.h"
 #include "util/hash_table.h"
+#include "util/os_misc.h"
+#include "util/os_time.h"
 #include "util/timespec.h"
+#include "util/u_atomic.h"
 #include "util/u_thread.h"
 #include "util/xmlconfig.h"
 #include "vk_util.h"
@@ -33,6 +44,7 @@
 #include "vk_instance.h"
 #include "vk_physical_device.h"
 #include "wsi_common_entrypoints.h"
+#include "wsi_common_headless.h"
 #include "wsi_common_private.h"
 #include "wsi_common_queue.h"
 
@@ -242,6 +254,13 @@ wsi_headless_surface_get_present_rectangles(VkIcdSurfaceBase *surface,
 struct wsi_headless_image {
    struct wsi_image                             base;
    bool                                         busy;
+
+   /* Only used when exporting frames */
+   int                                          shm_fd;
+   void                                        *shm_ptr;
+   unsigned                                     shm_size;
+   uint64_t                                     acquire_time_ns;
+   uint32_t                                     export_frame_index;
 };
 
 struct wsi_headless_swapchain {
@@ -255,6 +274,10 @@ struct wsi_headless_swapchain {
    VkPresentModeKHR                            present_mode;
    bool                                        fifo_ready;
 
+   struct wsi_headless_export_ring            *export_ring;
+   size_t                                      export_ring_size;
+   uint32_t                                    export_frame_index;
+
    struct wsi_headless_image                       images[0];
 };
 VK_DEFINE_NONDISP_HANDLE_CASTS(wsi_headless_swapchain, base.base, VkSwapchainKHR,
@@ -269,6 +292,24 @@ wsi_headless_swapchain_get_wsi_image(struct wsi_swapchain *wsi_chain,
    return &chain->images[image_index].base;
 }
 
+static bool
+wsi_headless_image_is_free(const struct wsi_headless_swapchain *chain,
+                           const struct wsi_headless_image *image,
+                           uint32_t export_tail)
+{
+   if (image->busy)
+      return false;
+
+   /* The consumer maps the image memory directly, so it can't be rendered
+    * to again until the consumer is done with the last frame it backed,
+    * whatever the present mode.
+    */
+   if (chain->export_ring)
+      return (int32_t)(export_tail - image->export_frame_index) >= 0;
+
+   return true;
+}
+
 static VkResult
 wsi_headless_swapchain_acquire_next_image(struct wsi_swapchain *wsi_chain,
                                           const VkAcquireNextImageInfoKHR *info,
@@ -285,12 +326,18 @@ wsi_headless_swapchain_acquire_next_image(struct wsi_swapchain *wsi_chain,
    timespec_add(&end_time, &rel_timeout, &start_time);
 
    while (1) {
+      uint32_t export_tail = 0;
+      if (chain->export_ring)
+         export_tail = p_atomic_read(&chain->export_ring->tail);
+
       /* Try to find a free image. */
       for (uint32_t i = 0; i < chain->base.image_count; i++) {
-         if (!chain->images[i].busy) {
+         if (wsi_headless_image_is_free(chain, &chain->images[i],
+                                        export_tail)) {
             /* We found a non-busy image */
             *image_index = i;
             chain->images[i].busy = true;
+            chain->images[i].acquire_time_ns = os_time_get_nano();
             return VK_SUCCESS;
          }
       }
@@ -300,9 +347,64 @@ wsi_headless_swapchain_acquire_next_image(struct wsi_swapchain *wsi_chain,
       clock_gettime(CLOCK_MONOTONIC, &current_time);
       if (timespec_after(&current_time, &end_time))
          return VK_NOT_READY;
+
+#if UTIL_FUTEX_SUPPORTED
+      /* Sleep until the consumer releases a frame instead of spinning.  Cap
+       * the wait in case the consumer doesn't wake the futex.
+       */
+      if (chain->export_ring) {
+         struct timespec wait_end;
+         timespec_add_msec(&wait_end, &current_time, 1);
+         if (timespec_after(&wait_end, &end_time))
+            wait_end = end_time;
+         futex_wait(&chain->export_ring->tail, export_tail, &wait_end);
+      }
+#endif
    }
 }
 
+static void
+wsi_headless_export_frame(struct wsi_headless_swapchain *chain,
+                          uint32_t image_index,
+                          uint64_t present_id)
+{
+   struct wsi_headless_export_ring *ring = chain->export_ring;
+   struct wsi_headless_image *image = &chain->images[image_index];
+
+   const uint32_t frame_index = ++chain->export_frame_index;
+   struct wsi_headless_export_frame *frame =
+      &ring->frames[(frame_index - 1) % ring->slot_count];
+
+   /* Invalidate the slot first so a consumer reading past tail can tell
+    * that it changed under it.
+    */
+   p_atomic_set(&frame->frame_index, 0);
+   __sync_synchronize();
+
+   frame->image_index = image_index;
+   frame->fd = image->shm_fd;
+   frame->vk_format = chain->vk_format;
+   frame->width = chain->extent.width;
+   frame->height = chain->extent.height;
+   frame->stride = image->base.row_pitches[0];
+   frame->offset = image->base.offsets[0];
+   frame->size = image->shm_size;
+   frame->present_id = present_id;
+   frame->acquire_time_ns = image->acquire_time_ns;
+   frame->present_time_ns = os_time_get_nano();
+
+   __sync_synchronize();
+   p_atomic_set(&frame->frame_index, frame_index);
+
+   image->export_frame_index = frame_index;
+
+   __sync_synchronize();
+   p_atomic_set(&ring->head, frame_index);
+#if UTIL_FUTEX_SUPPORTED
+   futex_wake(&ring->head, INT32_MAX);
+#endif
+}
+
 static VkResult
 wsi_headless_swapchain_queue_present(struct wsi_swapchain *wsi_chain,
                                      uint32_t image_index,
@@ -314,6 +416,12 @@ wsi_headless_swapchain_queue_present(struct wsi_swapchain *wsi_chain,
 
    assert(image_index < chain->base.image_count);
 
+   /* Software drivers have already waited for rendering to finish by the
+    * time we get here, so the frame is complete.
+    */
+   if (chain->export_ring)
+      wsi_headless_export_frame(chain, image_index, present_id);
+
    chain->images[image_index].busy = false;
 
    return VK_SUCCESS;
@@ -327,10 +435,20 @@ wsi_headless_swapchain_destroy(struct wsi_swapchain *wsi_chain,
       (struct wsi_headless_swapchain *)wsi_chain;
 
    for (uint32_t i = 0; i < chain->base.image_count; i++) {
-      if (chain->images[i].base.image != VK_NULL_HANDLE)
-         wsi_destroy_image(&chain->base, &chain->images[i].base);
+      struct wsi_headless_image *image = &chain->images[i];
+
+      if (image->base.image != VK_NULL_HANDLE)
+         wsi_destroy_image(&chain->base, &image->base);
+
+      if (image->shm_ptr != NULL)
+         munmap(image->shm_ptr, image->shm_size);
+      if (image->shm_fd >= 0)
+         close(image->shm_fd);
    }
 
+   if (chain->export_ring != NULL)
+      munmap(chain->export_ring, chain->export_ring_size);
+
    u_vector_finish(&chain->modifiers);
 
    wsi_swapchain_finish(&chain->base);
@@ -431,6 +549,121 @@ wsi_create_null_image_mem(const struct wsi_swapchain *chain,
    return VK_SUCCESS;
 }
 
+static uint8_t *
+wsi_headless_alloc_image_shm(struct wsi_image *imagew, unsigned size)
+{
+   struct wsi_headless_image *image = (struct wsi_headless_image *)imagew;
+
+   int fd = os_create_anonymous_file(size, "mesa-headless-frame");
+   if (fd < 0)
+      return NULL;
+
+   void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   if (ptr == MAP_FAILED) {
+      close(fd);
+      return NULL;
+   }
+
+   image->shm_fd = fd;
+   image->shm_ptr = ptr;
+   image->shm_size = size;
+
+   return ptr;
+}
+
+/* Takes over the ring published by an earlier swapchain under the same
+ * name.  A consumer may still be reading it, so nothing but the producer
+ * fields is written.
+ */
+static VkResult
+wsi_headless_export_ring_reuse(struct wsi_headless_swapchain *chain,
+                               const char *name, int fd, size_t file_size)
+{
+   void *ptr = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   if (ptr == MAP_FAILED)
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+
+   struct wsi_headless_export_ring *ring = ptr;
+   if (ring->version != WSI_HEADLESS_EXPORT_VERSION ||
+       ring->slot_count < chain->base.image_count ||
+       file_size < sizeof(*ring) + ring->slot_count * sizeof(ring->frames[0])) {
+      mesa_loge("headless: export ring %s has an incompatible layout", name);
+      munmap(ptr, file_size);
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   ring->producer_pid = getpid();
+   chain->export_ring = ring;
+   chain->export_ring_size = file_size;
+   chain->export_frame_index = p_atomic_read(&ring->head);
+
+   /* Hold the images back until the consumer is done with the frames of the
+    * earlier swapchain, so their slots aren't overwritten under it.
+    */
+   for (uint32_t i = 0; i < chain->base.image_count; i++)
+      chain->images[i].export_frame_index = chain->export_frame_index;
+
+   return VK_SUCCESS;
+}
+
+static VkResult
+wsi_headless_export_ring_init(struct wsi_headless_swapchain *chain,
+                              const char *name)
+{
+   const size_t size = sizeof(struct wsi_headless_export_ring) +
+      chain->base.image_count * sizeof(struct wsi_headless_export_frame);
+
+   int fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+   if (fd < 0) {
+      mesa_loge("headless: failed to open export ring %s", name);
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   struct stat st;
+   if (fstat(fd, &st) < 0) {
+      close(fd);
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   /* The object may also have been created empty by a consumer waiting for
+    * the magic, which is only set once a ring has been initialized.
+    */
+   if (st.st_size >= sizeof(struct wsi_headless_export_ring)) {
+      uint32_t magic = 0;
+      if (pread(fd, &magic, sizeof(magic), 0) == sizeof(magic) &&
+          magic == WSI_HEADLESS_EXPORT_MAGIC) {
+         VkResult result = wsi_headless_export_ring_reuse(chain, name, fd, st.st_size);
+         close(fd);
+         return result;
+      }
+   }
+
+   if (ftruncate(fd, size) < 0) {
+      close(fd);
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   close(fd);
+   if (ptr == MAP_FAILED)
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+
+   struct wsi_headless_export_ring *ring = ptr;
+   memset(ring, 0, size);
+   ring->version = WSI_HEADLESS_EXPORT_VERSION;
+   ring->producer_pid = getpid();
+   ring->slot_count = chain->base.image_count;
+
+   /* Publish the magic last so consumers never see a half-written header */
+   __sync_synchronize();
+   p_atomic_set(&ring->magic, WSI_HEADLESS_EXPORT_MAGIC);
+
+   chain->export_ring = ring;
+   chain->export_ring_size = size;
+
+   return VK_SUCCESS;
+}
+
 static VkResult
 wsi_headless_surface_create_swapchain(VkIcdSurfaceBase *icd_surface,
                                       VkDevice device,
@@ -451,13 +684,34 @@ wsi_headless_surface_create_swapchain(VkIcdSurfaceBase *icd_surface,
    if (chain == NULL)
       return VK_ERROR_OUT_OF_HOST_MEMORY;
 
+   for (uint32_t i = 0; i < num_images; i++)
+      chain->images[i].shm_fd = -1;
+
+   /* Exporting frames needs presentable images that live in memory we can
+    * hand out, which we can only get from software drivers that import host
+    * pointers.
+    */
+   const char *export_name = os_get_option("MESA_VK_WSI_HEADLESS_EXPORT");
+   if (export_name != NULL &&
+       !(wsi_device->sw && wsi_device->has_import_memory_host)) {
+      mesa_logw("headless: frame export requires a software driver with "
+                "VK_EXT_external_memory_host, ignoring "
+                "MESA_VK_WSI_HEADLESS_EXPORT");
+      export_name = NULL;
+   }
+
    struct wsi_drm_image_params drm_params = {
       .base.image_type = WSI_IMAGE_TYPE_DRM,
       .same_gpu = true,
    };
+   struct wsi_cpu_image_params cpu_params = {
+      .base.image_type = WSI_IMAGE_TYPE_CPU,
+      .alloc_shm = wsi_headless_alloc_image_shm,
+   };
 
-   result = wsi_swapchain_init(wsi_device, &chain->base, device,
-                               pCreateInfo, &drm_params.base, pAllocator);
+   result = wsi_swapchain_init(wsi_device, &chain->base, device, pCreateInfo,
+                               export_name ? &cpu_params.base : &drm_params.base,
+                               pAllocator);
    if (result != VK_SUCCESS) {
       vk_free(pAllocator, chain);
       return result;
@@ -472,12 +726,23 @@ wsi_headless_surface_create_swapchain(VkIcdSurfaceBase *icd_surface,
    chain->extent = pCreateInfo->imageExtent;
    chain->vk_format = pCreateInfo->imageFormat;
 
-   result = wsi_configure_image(&chain->base, pCreateInfo,
-                                0, &chain->base.image_info);
-   if (result != VK_SUCCESS) {
-      goto fail;
+   if (export_name != NULL) {
+      result = wsi_configure_cpu_image(&chain->base, pCreateInfo,
+                                       &cpu_params, &chain->base.image_info);
+      if (result != VK_SUCCESS)
+         goto fail;
+
+      result = wsi_headless_export_ring_init(chain, export_name);
+      if (result != VK_SUCCESS)
+         goto fail;
+   } else {
+      result = wsi_configure_image(&chain->base, pCreateInfo,
+                                   0, &chain->base.image_info);
+      if (result != VK_SUCCESS) {
+         goto fail;
+      }
+      chain->base.image_info.create_mem = wsi_create_null_image_mem;
    }
-   chain->base.image_info.create_mem = wsi_create_null_image_mem;
 
 
    for (uint32_t i = 0; i < chain->base.image_count; i++) {
@@ -486,6 +751,11 @@ wsi_headless_surface_create_swapchain(VkIcdSurfaceBase *icd_surface,
       if (result != VK_SUCCESS)
          return result;
 
+      if (chain->export_ring && chain->images[i].shm_fd < 0) {
+         result = VK_ERROR_OUT_OF_HOST_MEMORY;
+         goto fail;
+      }
+
       chain->images[i].busy = false;
    }
 
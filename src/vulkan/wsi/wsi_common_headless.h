@@ -0,0 +1,98 @@
+/*
+ * Copyright © 2024 Mesa contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef WSI_COMMON_HEADLESS_H
+#define WSI_COMMON_HEADLESS_H
+
+#include <stdint.h>
+
+/* Layout of the shared-memory frame ring published by headless swapchains
+ * when MESA_VK_WSI_HEADLESS_EXPORT names a POSIX shared memory object.
+ *
+ * This is an ABI shared with consumer processes, so fields may only ever be
+ * appended and WSI_HEADLESS_EXPORT_VERSION must be bumped when they are.
+ *
+ * Only software drivers are supported.  Presentable images are linear and
+ * backed by anonymous files (memfd), so presenting a frame only publishes
+ * the file descriptor; the pixels are never copied.  The fd number is valid
+ * in the producer process, consumers get their own with pidfd_getfd() or by
+ * opening /proc/<producer_pid>/fd/<fd> and can mmap it directly.
+ *
+ * The producer writes frames[(frame_index - 1) % slot_count] and then sets
+ * head to frame_index.  Consumers set tail to the frame_index of the last
+ * frame they are done with and should futex-wake it.  Both head and tail
+ * can be waited on with a shared futex.
+ *
+ * In every present mode, an image is not handed back to the application
+ * until the consumer has moved tail past the last frame published from it,
+ * so the pixels of a frame can't change before the consumer releases it.
+ * A consumer that stops moving tail therefore stalls the application once
+ * all images are waiting on it.  There are at least as many slots as
+ * images, so a slot isn't rewritten before its frame is released either.
+ * Consumers that read slots past tail should still drop frames whose slot
+ * frame_index changed while they were being read.
+ *
+ * The ring outlives the swapchain.  A later swapchain that finds a published
+ * ring of the same version with enough slots under the same name keeps
+ * publishing into it, continuing from head with its own fds, and leaves
+ * slot_count and tail alone.
+ */
+
+#define WSI_HEADLESS_EXPORT_MAGIC   0x58454857 /* "WHEX" */
+#define WSI_HEADLESS_EXPORT_VERSION 1
+
+struct wsi_headless_export_frame {
+   /* 0 while the producer is writing the slot */
+   uint32_t frame_index;
+   uint32_t image_index;
+
+   int32_t fd;
+   uint32_t vk_format;
+   uint32_t width;
+   uint32_t height;
+   uint32_t stride;
+   uint32_t offset;
+   uint64_t size;
+
+   uint64_t present_id;
+
+   /* CLOCK_MONOTONIC */
+   uint64_t acquire_time_ns;
+   uint64_t present_time_ns;
+};
+
+struct wsi_headless_export_ring {
+   uint32_t magic;
+   uint32_t version;
+   int32_t producer_pid;
+   uint32_t slot_count;
+
+   /* frame_index of the newest published frame, written by the producer */
+   uint32_t head;
+   /* frame_index of the newest released frame, written by the consumer */
+   uint32_t tail;
+
+   struct wsi_headless_export_frame frames[];
+};
+
+#endif /* WSI_COMMON_HEADLESS_H */